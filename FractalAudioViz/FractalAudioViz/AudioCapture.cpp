@@ -0,0 +1,117 @@
+#include "AudioCapture.h"
+
+AudioCapture::AudioCapture() :
+    running(false),
+    finished(false),
+    framesCaptured(0),
+    paced(true),
+    blockFrames(256),
+    finishNanoseconds(-1)
+{
+    format.sampleRate = 0;
+    format.channels = 0;
+}
+
+AudioCapture::~AudioCapture() {
+    Stop();
+}
+
+bool AudioCapture::Start(std::unique_ptr<AudioSource> audioSource, bool pacedCapture,
+    double bufferSeconds, size_t captureBlockFrames) {
+    Stop();
+
+    if (!audioSource || !audioSource->Open()) {
+        return false;
+    }
+
+    source = std::move(audioSource);
+    format = source->GetFormat();
+    paced = pacedCapture && !source->IsRealtime();
+    blockFrames = captureBlockFrames > 0 ? captureBlockFrames : 256;
+
+    // All allocation happens here, before the threads start sharing the buffer
+    size_t capacity = static_cast<size_t>(bufferSeconds * format.sampleRate);
+    if (capacity < blockFrames * 2) capacity = blockFrames * 2;
+    ringBuffer.Initialize(format.channels, capacity);
+    block.assign(blockFrames * format.channels, 0.0f);
+
+    framesCaptured.store(0);
+    finished.store(false);
+    finishNanoseconds.store(-1);
+    startTime = std::chrono::steady_clock::now();
+
+    running.store(true, std::memory_order_release);
+    captureThread = std::thread(&AudioCapture::CaptureLoop, this);
+
+    return true;
+}
+
+void AudioCapture::Stop() {
+    running.store(false, std::memory_order_release);
+
+    // Note: a source blocked in a read (e.g. an idle stdin pipe) will hold up the join
+    // until its writer delivers data or closes
+    if (captureThread.joinable()) {
+        captureThread.join();
+    }
+
+    if (source) {
+        source->Close();
+        source.reset();
+    }
+}
+
+void AudioCapture::CaptureLoop() {
+    uint64_t produced = 0;
+
+    while (running.load(std::memory_order_acquire)) {
+        size_t framesRead = source->Read(block.data(), blockFrames);
+        if (framesRead == 0) {
+            break;
+        }
+
+        if (paced) {
+            ringBuffer.Write(block.data(), framesRead);
+        }
+        else {
+            // Lossless: wait for the consumer to make room instead of dropping
+            size_t written = 0;
+            while (written < framesRead && running.load(std::memory_order_acquire)) {
+                size_t n = ringBuffer.GetFreeFrames() > 0 ?
+                    ringBuffer.Write(block.data() + written * format.channels, framesRead - written) : 0;
+                if (n == 0) std::this_thread::yield();
+                written += n;
+            }
+        }
+        produced += framesRead;
+        framesCaptured.store(produced, std::memory_order_release);
+
+        if (paced) {
+            // Release audio no faster than real time, as a live device would
+            std::chrono::duration<double> audioTime(static_cast<double>(produced) / format.sampleRate);
+            std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(audioTime));
+        }
+    }
+
+    finishNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime).count(), std::memory_order_release);
+    finished.store(true, std::memory_order_release);
+}
+
+AudioCaptureStats AudioCapture::GetStats() const {
+    AudioCaptureStats stats;
+    stats.framesCaptured = framesCaptured.load(std::memory_order_acquire);
+    stats.overrunFrames = ringBuffer.GetOverrunFrames();
+    stats.underrunFrames = ringBuffer.GetUnderrunFrames();
+
+    int64_t finishedAt = finishNanoseconds.load(std::memory_order_acquire);
+    if (finishedAt >= 0) {
+        stats.elapsedSeconds = finishedAt * 1e-9;
+    }
+    else {
+        stats.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    stats.framesPerSecond = stats.elapsedSeconds > 0.0 ? stats.framesCaptured / stats.elapsedSeconds : 0.0;
+    return stats;
+}
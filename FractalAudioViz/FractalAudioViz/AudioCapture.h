@@ -0,0 +1,71 @@
+#pragma once
+
+#include "AudioRingBuffer.h"
+#include "AudioSource.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Snapshot of the ingest counters
+struct AudioCaptureStats {
+    uint64_t framesCaptured;  // Frames the source delivered
+    uint64_t overrunFrames;   // Frames dropped because the ring buffer was full
+    uint64_t underrunFrames;  // Frames the consumer asked for that weren't there yet
+    double elapsedSeconds;    // Time since Start (or until the source ended)
+    double framesPerSecond;   // Achieved ingest throughput
+};
+
+// Runs an AudioSource on a dedicated capture thread and feeds its frames into a
+// lock-free ring buffer that the game loop drains.
+class AudioCapture {
+private:
+    std::unique_ptr<AudioSource> source;
+    AudioFormat format;
+    AudioRingBuffer ringBuffer;
+
+    std::thread captureThread;
+    std::atomic<bool> running;
+    std::atomic<bool> finished;
+    std::atomic<uint64_t> framesCaptured;
+
+    bool paced;
+    size_t blockFrames;
+    std::vector<float> block;
+
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<int64_t> finishNanoseconds; // Elapsed time when the source ended, -1 while running
+
+    void CaptureLoop();
+
+public:
+    AudioCapture();
+    ~AudioCapture();
+
+    // Open the source and start the capture thread. Paced capture releases audio at
+    // the sample rate and drops frames (counted as overruns) if the consumer falls
+    // behind, like a live device. Unpaced capture reads the source as fast as the
+    // consumer drains it, which is what offline runs and load tests want.
+    bool Start(std::unique_ptr<AudioSource> audioSource, bool paced = true,
+        double bufferSeconds = 0.5, size_t blockFrames = 256);
+    void Stop();
+
+    // Consumer side (game loop thread only); neither call locks or allocates.
+    // Consume always fills frameCount frames, padding underruns with silence.
+    size_t Consume(float* frames, size_t frameCount) { return ringBuffer.ReadExact(frames, frameCount); }
+    size_t Drain(float* frames, size_t maxFrames) { return ringBuffer.Read(frames, maxFrames); }
+    size_t Skip(size_t frameCount) { return ringBuffer.Skip(frameCount); }
+
+    // Frames the source has delivered so far: the audio clock, read from any thread
+    uint64_t GetFramesCaptured() const { return framesCaptured.load(std::memory_order_acquire); }
+
+    size_t GetAvailableFrames() const { return ringBuffer.GetAvailableFrames(); }
+    AudioFormat GetFormat() const { return format; }
+    bool IsRunning() const { return running.load(std::memory_order_acquire); }
+
+    // True once a finite source has delivered all of its frames
+    bool IsFinished() const { return finished.load(std::memory_order_acquire); }
+
+    AudioCaptureStats GetStats() const;
+};
@@ -0,0 +1,125 @@
+#include "AudioRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer() :
+    capacityFrames(0),
+    frameMask(0),
+    channels(1),
+    overrunFrames(0),
+    underrunFrames(0)
+{
+    writeCursor.value.store(0);
+    readCursor.value.store(0);
+}
+
+void AudioRingBuffer::Initialize(int channelCount, size_t minCapacityFrames) {
+    channels = channelCount > 0 ? channelCount : 1;
+
+    // Round capacity up to a power of two so wrapping is a mask instead of a modulo
+    capacityFrames = 1;
+    while (capacityFrames < minCapacityFrames) {
+        capacityFrames <<= 1;
+    }
+    frameMask = capacityFrames - 1;
+
+    samples.assign(capacityFrames * channels, 0.0f);
+    Reset();
+}
+
+void AudioRingBuffer::Reset() {
+    writeCursor.value.store(0, std::memory_order_relaxed);
+    readCursor.value.store(0, std::memory_order_relaxed);
+    overrunFrames.store(0, std::memory_order_relaxed);
+    underrunFrames.store(0, std::memory_order_relaxed);
+}
+
+void AudioRingBuffer::CopyIn(uint64_t position, const float* source, size_t frameCount) {
+    size_t start = static_cast<size_t>(position) & frameMask;
+    size_t firstPart = std::min(frameCount, capacityFrames - start);
+
+    std::memcpy(&samples[start * channels], source, firstPart * channels * sizeof(float));
+    if (firstPart < frameCount) {
+        std::memcpy(&samples[0], source + firstPart * channels, (frameCount - firstPart) * channels * sizeof(float));
+    }
+}
+
+void AudioRingBuffer::CopyOut(uint64_t position, float* destination, size_t frameCount) const {
+    size_t start = static_cast<size_t>(position) & frameMask;
+    size_t firstPart = std::min(frameCount, capacityFrames - start);
+
+    std::memcpy(destination, &samples[start * channels], firstPart * channels * sizeof(float));
+    if (firstPart < frameCount) {
+        std::memcpy(destination + firstPart * channels, &samples[0], (frameCount - firstPart) * channels * sizeof(float));
+    }
+}
+
+size_t AudioRingBuffer::Write(const float* frames, size_t frameCount) {
+    // Only the producer modifies the write cursor, so a relaxed load is enough
+    uint64_t write = writeCursor.value.load(std::memory_order_relaxed);
+    uint64_t read = readCursor.value.load(std::memory_order_acquire);
+
+    size_t freeFrames = capacityFrames - static_cast<size_t>(write - read);
+    size_t toWrite = std::min(frameCount, freeFrames);
+
+    if (toWrite > 0) {
+        CopyIn(write, frames, toWrite);
+        writeCursor.value.store(write + toWrite, std::memory_order_release);
+    }
+
+    if (toWrite < frameCount) {
+        overrunFrames.fetch_add(frameCount - toWrite, std::memory_order_relaxed);
+    }
+
+    return toWrite;
+}
+
+size_t AudioRingBuffer::Read(float* frames, size_t frameCount) {
+    // Only the consumer modifies the read cursor
+    uint64_t read = readCursor.value.load(std::memory_order_relaxed);
+    uint64_t write = writeCursor.value.load(std::memory_order_acquire);
+
+    size_t available = static_cast<size_t>(write - read);
+    size_t toRead = std::min(frameCount, available);
+
+    if (toRead > 0) {
+        CopyOut(read, frames, toRead);
+        readCursor.value.store(read + toRead, std::memory_order_release);
+    }
+
+    return toRead;
+}
+
+size_t AudioRingBuffer::ReadExact(float* frames, size_t frameCount) {
+    size_t framesRead = Read(frames, frameCount);
+
+    if (framesRead < frameCount) {
+        // Keep the stream continuous for the analysis stages by padding with silence
+        std::memset(frames + framesRead * channels, 0, (frameCount - framesRead) * channels * sizeof(float));
+        underrunFrames.fetch_add(frameCount - framesRead, std::memory_order_relaxed);
+    }
+
+    return framesRead;
+}
+
+size_t AudioRingBuffer::Skip(size_t frameCount) {
+    uint64_t read = readCursor.value.load(std::memory_order_relaxed);
+    uint64_t write = writeCursor.value.load(std::memory_order_acquire);
+
+    size_t toSkip = std::min(frameCount, static_cast<size_t>(write - read));
+    if (toSkip > 0) {
+        readCursor.value.store(read + toSkip, std::memory_order_release);
+    }
+
+    return toSkip;
+}
+
+size_t AudioRingBuffer::GetAvailableFrames() const {
+    uint64_t write = writeCursor.value.load(std::memory_order_acquire);
+    uint64_t read = readCursor.value.load(std::memory_order_acquire);
+    return static_cast<size_t>(write - read);
+}
+
+size_t AudioRingBuffer::GetFreeFrames() const {
+    return capacityFrames - GetAvailableFrames();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Wait-free single-producer/single-consumer ring buffer of interleaved float frames.
+// The capture thread is the only writer and the game loop the only reader, so the
+// read and write cursors can be plain atomics without any locking.
+class AudioRingBuffer {
+private:
+    // Keep the cursors on separate cache lines so producer and consumer don't false-share
+    struct alignas(64) Cursor {
+        std::atomic<uint64_t> value;
+    };
+
+    std::vector<float> samples;
+    size_t capacityFrames; // Always a power of two
+    size_t frameMask;
+    int channels;
+
+    Cursor writeCursor; // Total frames ever written
+    Cursor readCursor;  // Total frames ever read
+
+    // Counters (frames dropped by the producer / missing for the consumer)
+    std::atomic<uint64_t> overrunFrames;
+    std::atomic<uint64_t> underrunFrames;
+
+    void CopyIn(uint64_t position, const float* source, size_t frameCount);
+    void CopyOut(uint64_t position, float* destination, size_t frameCount) const;
+
+public:
+    AudioRingBuffer();
+
+    // Allocate storage; capacity is rounded up to the next power of two.
+    // Must be called before the producer thread starts.
+    void Initialize(int channelCount, size_t minCapacityFrames);
+    void Reset();
+
+    // Producer side: writes as many frames as fit and returns that count.
+    // Frames that don't fit are dropped and counted as an overrun.
+    size_t Write(const float* frames, size_t frameCount);
+
+    // Consumer side: reads up to frameCount frames and returns the count read
+    size_t Read(float* frames, size_t frameCount);
+
+    // Consumer side: always fills frameCount frames, zero-padding (and counting an
+    // underrun) if the producer has not delivered enough data yet
+    size_t ReadExact(float* frames, size_t frameCount);
+
+    // Consumer side: drops up to frameCount frames unread and returns the count dropped
+    size_t Skip(size_t frameCount);
+
+    size_t GetAvailableFrames() const;
+    size_t GetFreeFrames() const;
+    size_t GetCapacityFrames() const { return capacityFrames; }
+    int GetChannels() const { return channels; }
+
+    uint64_t GetOverrunFrames() const { return overrunFrames.load(std::memory_order_relaxed); }
+    uint64_t GetUnderrunFrames() const { return underrunFrames.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Format of the interleaved float frames an audio source delivers
+struct AudioFormat {
+    int sampleRate;
+    int channels;
+};
+
+// Pluggable producer of audio for the capture thread. Implementations only ever
+// run on the capture thread, so they don't need to be thread-safe.
+class AudioSource {
+public:
+    virtual ~AudioSource() {}
+
+    // Prepare the source for reading; returns false if it can't be opened
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+
+    virtual AudioFormat GetFormat() const = 0;
+
+    // Fill up to frameCount interleaved frames. Returns the number of frames
+    // written; 0 means the stream has ended.
+    virtual size_t Read(float* frames, size_t frameCount) = 0;
+
+    // True if the source delivers data at the audio rate by itself (a live pipe).
+    // Non-realtime sources are paced by the capture thread unless load testing.
+    virtual bool IsRealtime() const { return false; }
+};
@@ -0,0 +1,104 @@
+#include "AudioTimeline.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Longest gap between readings the loop gains are scaled for; a longer one (a stall)
+    // is corrected no harder than this
+    const double MAX_GAIN_SECONDS = 0.25;
+}
+
+AudioTimeline::AudioTimeline() :
+    locked(false),
+    referenceWall(0.0),
+    referenceAudio(0.0),
+    rate(1.0),
+    stepCount(0)
+{}
+
+void AudioTimeline::Reset(const AudioTimelineSettings& timelineSettings) {
+    settings = timelineSettings;
+    locked = false;
+    referenceWall = 0.0;
+    referenceAudio = 0.0;
+    rate = 1.0;
+    stepCount = 0;
+    stats = AudioTimelineStats();
+}
+
+void AudioTimeline::Observe(uint64_t framesDelivered, double wallSeconds) {
+    const double audio = static_cast<double>(framesDelivered) / settings.sampleRate;
+    ++stats.observations;
+
+    // The first reading places the line; the rate starts at nominal
+    if (!locked) {
+        locked = true;
+        referenceWall = wallSeconds;
+        referenceAudio = audio;
+        rate = 1.0;
+        return;
+    }
+
+    const double elapsed = wallSeconds - referenceWall;
+    if (elapsed <= 0.0) {
+        return;
+    }
+    const double predicted = referenceAudio + rate * elapsed;
+    const double error = audio - predicted;
+    stats.phaseError = error;
+    referenceWall = wallSeconds;
+
+    // Far off, as after a device reset or a source switch, the line jumps to the reading
+    if (std::fabs(error) > settings.resyncSeconds) {
+        referenceAudio = audio;
+        ++stats.resyncs;
+        return;
+    }
+
+    // Proportional on the offset, integral on the rate: a constant drift is tracked with
+    // no standing phase error
+    const double omega = 2.0 * 3.14159265358979323846 * settings.bandwidth;
+    const double gainSeconds = std::min(elapsed, MAX_GAIN_SECONDS);
+    const double alpha = std::min(1.0, 2.0 * settings.damping * omega * gainSeconds);
+    const double beta = omega * omega * gainSeconds;
+    referenceAudio = predicted + alpha * error;
+    rate = std::min(std::max(rate + beta * error, 1.0 - settings.maxRateError), 1.0 + settings.maxRateError);
+}
+
+double AudioTimeline::GetAudioTime(double wallSeconds) const {
+    if (!locked) {
+        return 0.0;
+    }
+    return referenceAudio + rate * (wallSeconds - referenceWall);
+}
+
+uint64_t AudioTimeline::Advance(double wallSeconds, uint64_t& skipped) {
+    skipped = 0;
+    const double playhead = GetAudioTime(wallSeconds) - settings.latency;
+    if (!locked || playhead <= 0.0) {
+        return 0;
+    }
+
+    // Steps only move forward; a correction that pulls the line back just holds them
+    const uint64_t target = static_cast<uint64_t>(playhead / settings.stepSeconds);
+    if (target <= stepCount) {
+        return 0;
+    }
+    uint64_t due = target - stepCount;
+    const uint64_t maxSteps = std::max<uint64_t>(1, static_cast<uint64_t>(settings.maxCatchUpSeconds / settings.stepSeconds));
+    if (due > maxSteps) {
+        skipped = due - maxSteps;
+        due = maxSteps;
+    }
+
+    stepCount = target;
+    stats.steps += due;
+    stats.skippedSteps += skipped;
+    return due;
+}
+
+double AudioTimeline::GetStepFraction(double wallSeconds) const {
+    const double playhead = GetAudioTime(wallSeconds) - settings.latency;
+    const double fraction = (playhead - stepCount * settings.stepSeconds) / settings.stepSeconds;
+    return std::min(std::max(fraction, 0.0), 1.0);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+struct AudioTimelineSettings {
+    double sampleRate;          // Of the audio clock, frames per second
+    double stepSeconds;         // Audio each fixed update takes in
+    double latency;             // Seconds the timeline trails the audio clock, so a step's
+                                // frames have arrived before it runs despite block jitter
+    double bandwidth;           // Of the tracking loop, Hz: lower smooths more, higher
+                                // follows drift changes sooner
+    double damping;
+    double maxRateError;        // Largest difference from the nominal rate believed
+    double resyncSeconds;       // A phase error past this jumps instead of slewing
+    double maxCatchUpSeconds;   // Steps due past this are skipped, as GameTimer caps its delta
+
+    AudioTimelineSettings() :
+        sampleRate(48000.0),
+        stepSeconds(1.0 / 60.0),
+        latency(0.01),
+        bandwidth(0.02),
+        damping(0.707),
+        maxRateError(0.005),
+        resyncSeconds(0.1),
+        maxCatchUpSeconds(0.25)
+    {}
+};
+
+struct AudioTimelineStats {
+    uint64_t observations;
+    uint64_t steps;             // Run, not counting skipped ones
+    uint64_t skippedSteps;
+    uint64_t resyncs;
+    double phaseError;          // Of the last observation against the prediction, seconds
+
+    AudioTimelineStats() : observations(0), steps(0), skippedSteps(0), resyncs(0), phaseError(0.0) {}
+};
+
+// The master clock for fixed updates: audio time, counted in frames the audio source has
+// delivered, rather than the wall clock, so updates take in audio exactly as fast as the
+// device produces it however far its crystal is from the CPU's. The count arrives in
+// blocks and is read at frame times, so it's tracked by a second-order phase-locked loop:
+// a line from wall time to audio time whose offset and slope (the drift) are pulled
+// toward each new reading. With no readings, as once a source ends, it runs on at the
+// last rate. Wall times are seconds on any steady clock.
+class AudioTimeline {
+private:
+    AudioTimelineSettings settings;
+    bool locked;
+    double referenceWall;       // The line passes through audio time referenceAudio
+    double referenceAudio;      // at wall time referenceWall
+    double rate;                // Audio seconds per wall second
+    uint64_t stepCount;         // Run or skipped
+    AudioTimelineStats stats;
+
+public:
+    AudioTimeline();
+
+    void Reset(const AudioTimelineSettings& timelineSettings);
+
+    // The audio clock read framesDelivered at wallSeconds
+    void Observe(uint64_t framesDelivered, double wallSeconds);
+
+    // Estimated audio clock at wallSeconds, 0 before the first reading
+    double GetAudioTime(double wallSeconds) const;
+
+    // Steps whose audio, up to latency behind the clock, is complete by wallSeconds.
+    // Those past maxCatchUpSeconds are skipped instead and counted in skipped; their audio
+    // should be dropped unread.
+    uint64_t Advance(double wallSeconds, uint64_t& skipped);
+
+    // How far into the next step the playhead is at wallSeconds, 0 to 1, for drawing
+    // between the last two updates' states
+    double GetStepFraction(double wallSeconds) const;
+
+    // Audio seconds per wall second: 1 plus the drift
+    double GetRate() const { return rate; }
+    bool IsLocked() const { return locked; }
+    uint64_t GetStepCount() const { return stepCount; }
+    const AudioTimelineStats& GetStats() const { return stats; }
+};
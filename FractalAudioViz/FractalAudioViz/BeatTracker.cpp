@@ -0,0 +1,187 @@
+#include "BeatTracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Envelope mean tracker, roughly a 1 s window at 10 ms hops
+    const float MEAN_SMOOTHING = 0.01f;
+
+    // Onsets further than this from the predicted beat (in beats) don't steer the phase
+    const float CAPTURE_RANGE = 0.25f;
+
+    // Consecutive out-of-range onsets before the oscillator re-anchors
+    const int MAX_MISSED_ONSETS = 2;
+
+    // Weight of the double-period lag in a candidate's score
+    const float HARMONIC_WEIGHT = 0.5f;
+}
+
+BeatTracker::BeatTracker() :
+    minLag(1),
+    maxLag(1),
+    envelopePosition(0),
+    acfDecay(1.0f),
+    envelopeMean(0.0f),
+    periodHops(1.0f),
+    phase(0.0f),
+    phaseErrorAverage(0.5f),
+    missedOnsets(0),
+    locked(false)
+{}
+
+bool BeatTracker::Initialize(const BeatTrackerSettings& trackerSettings) {
+    const BeatTrackerSettings& s = trackerSettings;
+    if (s.hopSeconds <= 0.0f || s.minBpm <= 0.0f || s.maxBpm <= s.minBpm || s.priorWidthOctaves <= 0.0f) {
+        return false;
+    }
+
+    settings = trackerSettings;
+    minLag = static_cast<size_t>(std::floor(60.0f / settings.maxBpm / settings.hopSeconds));
+    maxLag = static_cast<size_t>(std::ceil(60.0f / settings.minBpm / settings.hopSeconds));
+    if (minLag < 2) minLag = 2;
+    if (maxLag <= minLag + 2) return false;
+
+    envelope.assign(maxLag + 1, 0.0f);
+    autocorrelation.assign(maxLag + 1, 0.0f);
+
+    // Log-Gaussian prior over tempo, so 2x/0.5x candidates lose to the preferred range
+    tempoPrior.assign(maxLag + 1, 0.0f);
+    for (size_t lag = minLag; lag <= maxLag; ++lag) {
+        float bpm = 60.0f / (lag * settings.hopSeconds);
+        float octaves = std::log2(bpm / settings.preferredBpm) / settings.priorWidthOctaves;
+        tempoPrior[lag] = std::exp(-0.5f * octaves * octaves);
+    }
+
+    float halfLifeHops = settings.acfHalfLifeSeconds / settings.hopSeconds;
+    acfDecay = halfLifeHops > 1.0f ? std::pow(0.5f, 1.0f / halfLifeHops) : 0.5f;
+
+    Reset();
+    return true;
+}
+
+void BeatTracker::Reset() {
+    std::fill(envelope.begin(), envelope.end(), 0.0f);
+    std::fill(autocorrelation.begin(), autocorrelation.end(), 0.0f);
+    envelopePosition = 0;
+    envelopeMean = 0.0f;
+    periodHops = 60.0f / settings.preferredBpm / settings.hopSeconds;
+    phase = 0.0f;
+    phaseErrorAverage = 0.5f;
+    missedOnsets = 0;
+    locked = false;
+    state = BeatState();
+    state.tempoBpm = settings.preferredBpm;
+}
+
+void BeatTracker::UpdateTempo() {
+    // Best prior-weighted autocorrelation peak. Each candidate also collects support from
+    // twice its period (capped by its own value, so a lag can't borrow a peak it doesn't
+    // have), so a steady pulse beats its own half-tempo alias, which the prior alone can't
+    // separate when the two sit symmetrically around the preferred tempo.
+    size_t bestLag = minLag;
+    float bestScore = -1.0f;
+    for (size_t lag = minLag; lag <= maxLag; ++lag) {
+        float support = 0.0f;
+        if (2 * lag + 1 <= maxLag) {
+            support = std::max(autocorrelation[2 * lag - 1], std::max(autocorrelation[2 * lag], autocorrelation[2 * lag + 1]));
+        }
+        support = std::min(support, autocorrelation[lag]);
+        float score = (autocorrelation[lag] + HARMONIC_WEIGHT * support) * tempoPrior[lag];
+        if (score > bestScore) {
+            bestScore = score;
+            bestLag = lag;
+        }
+    }
+
+    if (autocorrelation[bestLag] <= 0.0f) {
+        return;
+    }
+
+    // Parabolic interpolation for a fractional period
+    float period = static_cast<float>(bestLag);
+    if (bestLag > minLag && bestLag < maxLag) {
+        float a = autocorrelation[bestLag - 1];
+        float b = autocorrelation[bestLag];
+        float c = autocorrelation[bestLag + 1];
+        float denominator = a - 2.0f * b + c;
+        if (denominator < 0.0f) {
+            float offset = 0.5f * (a - c) / denominator;
+            period += std::max(-0.5f, std::min(0.5f, offset));
+        }
+    }
+
+    // Smooth the period so the oscillator doesn't jitter hop to hop
+    periodHops += 0.1f * (period - periodHops);
+    state.tempoBpm = 60.0f / (periodHops * settings.hopSeconds);
+
+    float periodicity = autocorrelation[0] > 0.0f ? autocorrelation[bestLag] / autocorrelation[0] : 0.0f;
+    float alignment = 1.0f - 2.0f * phaseErrorAverage;
+    float confidence = std::max(0.0f, periodicity) * std::max(0.0f, alignment);
+    state.confidence = confidence > 1.0f ? 1.0f : confidence;
+}
+
+void BeatTracker::UpdatePhase(bool onset) {
+    // Free-running oscillator
+    phase += 1.0f / periodHops;
+    state.beat = false;
+    if (phase >= 1.0f) {
+        phase -= 1.0f;
+        state.beat = locked;
+        if (locked) ++state.beatCount;
+    }
+
+    if (!onset) {
+        return;
+    }
+
+    // Phase error in beats, in [-0.5, 0.5): negative = onset came before the predicted beat
+    float error = phase >= 0.5f ? phase - 1.0f : phase;
+
+    if (!locked || std::fabs(error) > CAPTURE_RANGE) {
+        ++missedOnsets;
+        if (!locked || missedOnsets > MAX_MISSED_ONSETS) {
+            // Re-anchor the beat on this onset
+            phase = 0.0f;
+            locked = true;
+            missedOnsets = 0;
+            phaseErrorAverage = 0.5f;
+        }
+        return;
+    }
+
+    missedOnsets = 0;
+    phase -= settings.phaseGain * error;
+    phaseErrorAverage += 0.1f * (std::fabs(error) - phaseErrorAverage);
+}
+
+const BeatState& BeatTracker::Process(float detectionValue, bool onset, float onsetStrength) {
+    // Mean-removed, half-wave rectified envelope, so the autocorrelation isn't swamped by DC
+    envelopeMean += MEAN_SMOOTHING * (detectionValue - envelopeMean);
+    float current = detectionValue - envelopeMean;
+    if (current < 0.0f) current = 0.0f;
+
+    envelopePosition = (envelopePosition + 1) % envelope.size();
+    envelope[envelopePosition] = current;
+
+    // Incremental decaying autocorrelation: acf[lag] = d * acf[lag] + e[n] * e[n - lag]
+    const size_t ringSize = envelope.size();
+    autocorrelation[0] = acfDecay * autocorrelation[0] + current * current;
+    for (size_t lag = minLag - 1; lag <= maxLag; ++lag) {
+        size_t index = (envelopePosition + ringSize - lag) % ringSize;
+        autocorrelation[lag] = acfDecay * autocorrelation[lag] + current * envelope[index];
+    }
+
+    UpdateTempo();
+    UpdatePhase(onset);
+
+    state.onset = onset;
+    state.onsetStrength = onset ? onsetStrength : 0.0f;
+    state.beatPhase = phase < 0.0f ? phase + 1.0f : phase;
+    if (!locked) state.confidence = 0.0f;
+    return state;
+}
+
+float BeatTracker::GetPhaseAhead(float secondsAhead) const {
+    float ahead = state.beatPhase + secondsAhead / (periodHops * settings.hopSeconds);
+    return ahead - std::floor(ahead);
+}
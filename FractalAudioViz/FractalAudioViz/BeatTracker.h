@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BeatTrackerSettings {
+    float hopSeconds;          // Time between Process calls (the STFT hop)
+    float minBpm;
+    float maxBpm;
+    float preferredBpm;        // Center of the tempo prior, resolves octave ambiguity
+    float priorWidthOctaves;   // Standard deviation of the log-tempo prior
+    float acfHalfLifeSeconds;  // Memory of the running autocorrelation
+    float phaseGain;           // Fraction of the phase error corrected per onset
+
+    BeatTrackerSettings() :
+        hopSeconds(512.0f / 48000.0f),
+        minBpm(60.0f),
+        maxBpm(200.0f),
+        preferredBpm(120.0f),
+        priorWidthOctaves(1.0f),
+        acfHalfLifeSeconds(6.0f),
+        phaseGain(0.25f)
+    {}
+};
+
+// Beat information published once per hop
+struct BeatState {
+    float tempoBpm;
+    float beatPhase;    // 0 at a beat, rising to 1 at the next one
+    float confidence;   // 0..1
+    bool beat;          // A beat fell in this hop
+    bool onset;         // The onset detector fired in this hop
+    float onsetStrength;  // The detector's strength for that onset, 0 otherwise
+    uint64_t beatCount;
+
+    BeatState() : tempoBpm(0.0f), beatPhase(0.0f), confidence(0.0f), beat(false), onset(false), onsetStrength(0.0f), beatCount(0) {}
+};
+
+// Incremental tempo and beat-phase tracker over an onset detection function.
+//
+// Tempo comes from an exponentially decaying autocorrelation of the onset envelope,
+// updated in O(max lag) per hop from a fixed-size ring buffer of recent envelope values
+// and weighted by a log-Gaussian tempo prior. Beat phase is a free-running oscillator
+// at that tempo which each detected onset nudges towards itself (a simple PLL), and
+// which re-anchors to a strong onset after it loses lock.
+class BeatTracker {
+private:
+    BeatTrackerSettings settings;
+    size_t minLag;
+    size_t maxLag;
+
+    std::vector<float> envelope;  // Ring of the last maxLag + 1 envelope values
+    size_t envelopePosition;
+    std::vector<float> autocorrelation;  // Indexed by lag, [0, maxLag]
+    std::vector<float> tempoPrior;
+    float acfDecay;
+    float envelopeMean;
+
+    float periodHops;
+    float phase;
+    float phaseErrorAverage;
+    int missedOnsets;
+    bool locked;
+
+    BeatState state;
+
+    void UpdateTempo();
+    void UpdatePhase(bool onset);
+
+public:
+    BeatTracker();
+
+    bool Initialize(const BeatTrackerSettings& settings);
+    void Reset();
+
+    // Feed one hop's onset detection value and the detector's decision
+    const BeatState& Process(float detectionValue, bool onset, float onsetStrength);
+
+    const BeatState& GetState() const { return state; }
+
+    // Beat phase extrapolated secondsAhead past the last processed hop
+    float GetPhaseAhead(float secondsAhead) const;
+};
@@ -0,0 +1,78 @@
+#include "CameraPath.h"
+#include <cmath>
+
+namespace {
+    const float PI = 3.14159265358979f;
+
+    // Uniform Catmull-Rom between p1 and p2
+    float CatmullRom(float p0, float p1, float p2, float p3, float t) {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+            (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+}
+
+CameraPath::CameraPath() :
+    target{ 0.0f, 0.0f, 0.0f },
+    loopSeconds(30.0f)
+{}
+
+void CameraPath::AddKey(float x, float y, float z) {
+    Key key = { x, y, z };
+    keys.push_back(key);
+}
+
+void CameraPath::SetTarget(float x, float y, float z) {
+    target[0] = x;
+    target[1] = y;
+    target[2] = z;
+}
+
+void CameraPath::SetLoopSeconds(float seconds) {
+    loopSeconds = seconds > 0.0f ? seconds : 1.0f;
+}
+
+CameraPath CameraPath::Orbit(float radius, float radiusSwing, float heightSwing, int keyCount, float loopSeconds) {
+    CameraPath path;
+    if (keyCount < 4) keyCount = 4;
+    for (int i = 0; i < keyCount; ++i) {
+        float angle = 2.0f * PI * i / keyCount;
+        float r = radius + radiusSwing * std::sin(3.0f * angle);
+        float y = heightSwing * std::sin(2.0f * angle);
+        path.AddKey(r * std::sin(angle), y, -r * std::cos(angle));
+    }
+    path.SetLoopSeconds(loopSeconds);
+    return path;
+}
+
+CameraPose CameraPath::Evaluate(double seconds) const {
+    CameraPose pose;
+    if (keys.empty()) {
+        return pose;
+    }
+
+    // Position along the closed loop, in segments
+    size_t count = keys.size();
+    double loops = seconds / loopSeconds;
+    double along = (loops - std::floor(loops)) * count;
+    size_t segment = static_cast<size_t>(along) % count;
+    float t = static_cast<float>(along - std::floor(along));
+
+    const Key& k0 = keys[(segment + count - 1) % count];
+    const Key& k1 = keys[segment];
+    const Key& k2 = keys[(segment + 1) % count];
+    const Key& k3 = keys[(segment + 2) % count];
+    pose.position[0] = CatmullRom(k0.x, k1.x, k2.x, k3.x, t);
+    pose.position[1] = CatmullRom(k0.y, k1.y, k2.y, k3.y, t);
+    pose.position[2] = CatmullRom(k0.z, k1.z, k2.z, k3.z, t);
+
+    // Look at the target: yaw about y from +z, then pitch (positive looks down)
+    float dx = target[0] - pose.position[0];
+    float dy = target[1] - pose.position[1];
+    float dz = target[2] - pose.position[2];
+    pose.rotation[0] = std::atan2(-dy, std::sqrt(dx * dx + dz * dz));
+    pose.rotation[1] = std::atan2(dx, dz);
+    pose.rotation[2] = 0.0f;
+    return pose;
+}
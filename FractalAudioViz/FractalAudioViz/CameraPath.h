@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Camera placement in the terms Camera uses: position, and pitch/yaw/roll in radians
+// (positive pitch looks down, yaw 0 looks along +z)
+struct CameraPose {
+    float position[3];
+    float rotation[3];
+
+    CameraPose() : position{ 0.0f, 0.0f, -5.0f }, rotation{ 0.0f, 0.0f, 0.0f } {}
+};
+
+// Scripted camera: a closed Catmull-Rom spline through key positions, traversed at a
+// constant rate per segment and always looking at a fixed target. Evaluation only
+// depends on the time passed in, so replays are exact.
+class CameraPath {
+private:
+    struct Key {
+        float x, y, z;
+    };
+
+    std::vector<Key> keys;
+    float target[3];
+    float loopSeconds;
+
+public:
+    CameraPath();
+
+    void AddKey(float x, float y, float z);
+    void SetTarget(float x, float y, float z);
+    void SetLoopSeconds(float seconds);
+
+    // Loop around the origin through keyCount keys, the radius and height swinging so
+    // the view goes from far overview to close passes
+    static CameraPath Orbit(float radius, float radiusSwing, float heightSwing, int keyCount, float loopSeconds);
+
+    bool IsEmpty() const { return keys.empty(); }
+    size_t GetKeyCount() const { return keys.size(); }
+    float GetLoopSeconds() const { return loopSeconds; }
+
+    CameraPose Evaluate(double seconds) const;
+};
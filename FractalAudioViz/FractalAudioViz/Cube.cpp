@@ -4,6 +4,8 @@
 Cube::Cube() :
     vertexCount(0),
     indexCount(0),
+    vertexHandle(0),
+    indexHandle(0),
     position(0.0f, 0.0f, 0.0f),
     rotation(0.0f, 0.0f, 0.0f),
     scale(1.0f, 1.0f, 1.0f)
@@ -81,6 +83,10 @@ bool Cube::Initialize(DXRenderer* renderer) {
         return false;
     }
 
+    // Register the buffers so draws can be recorded as packets
+    vertexHandle = renderer->RegisterVertexBuffer(vertexBuffer.Get(), sizeof(Vertex));
+    indexHandle = renderer->RegisterIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT);
+
     return true;
 }
 
@@ -116,33 +122,27 @@ void Cube::UpdateWorldMatrix() {
     worldMatrix = scaleMatrix * rotationX * rotationY * rotationZ * translationMatrix;
 }
 
-void Cube::Render(DXRenderer* renderer) {
-    ID3D11DeviceContext* deviceContext = renderer->GetDeviceContext();
-
-    // Set vertex buffer
-    UINT stride = sizeof(Vertex);
-    UINT offset = 0;
-    ID3D11Buffer* vBuffer = vertexBuffer.Get();
-    deviceContext->IASetVertexBuffers(0, 1, &vBuffer, &stride, &offset);
-
-    // Set index buffer
-    deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-
-    // Set primitive topology
-    deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-    // Draw indexed
-    deviceContext->DrawIndexed(indexCount, 0, 0);
+void Cube::Render(RenderCommandList& list, RenderHandle pipeline, float depth,
+    RenderHandle instances, uint32_t instanceCount) {
+    // Transpose the world matrix for HLSL
+    DrawConstants constants;
+    constants.world = DirectX::XMMatrixTranspose(worldMatrix);
+
+    DrawPacket packet = {};
+    packet.sortKey = SortKey::Opaque(0, pipeline, vertexHandle, depth);
+    packet.pipeline = pipeline;
+    packet.vertexBuffer = vertexHandle;
+    packet.indexBuffer = indexHandle;
+    packet.instances = instances;
+    packet.constants = list.AddConstants(&constants, sizeof(constants));
+    packet.constantSize = sizeof(constants);
+    packet.indexCount = static_cast<uint32_t>(indexCount);
+    packet.instanceCount = instanceCount;
+    list.Add(packet);
 }
 
 void Cube::Shutdown() {
-    if (indexBuffer) {
-        indexBuffer->Release();
-        indexBuffer = nullptr;
-    }
-
-    if (vertexBuffer) {
-        vertexBuffer->Release();
-        vertexBuffer = nullptr;
-    }
+    // ComPtr releases on Reset (an explicit Release as well would drop the reference twice)
+    indexBuffer.Reset();
+    vertexBuffer.Reset();
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <d3d11.h>
 #include <DirectXMath.h>
 #include <wrl/client.h>
+#include "RenderQueue.h"
 
 class DXRenderer;
 
@@ -13,6 +14,10 @@ private:
     int vertexCount;
     int indexCount;
 
+    // The buffers as registered with the renderer, for draw packets
+    RenderHandle vertexHandle;
+    RenderHandle indexHandle;
+
     DirectX::XMMATRIX worldMatrix;
     DirectX::XMFLOAT3 position;
     DirectX::XMFLOAT3 rotation;
@@ -26,7 +31,13 @@ public:
 
     bool Initialize(DXRenderer* renderer);
     void Shutdown();
-    void Render(DXRenderer* renderer);
+
+    // Record a draw of the cube with its world matrix into a command list. With instances,
+    // the cube is the shared mesh and every instance gets a copy placed by the pipeline.
+    void Render(RenderCommandList& list, RenderHandle pipeline, float depth,
+        RenderHandle instances = 0, uint32_t instanceCount = 0);
+
+    int GetIndexCount() const { return indexCount; }
 
     // Transformation methods
     void SetPosition(float x, float y, float z);
@@ -0,0 +1,97 @@
+#include "D3DUpload.h"
+
+D3DUploadBuffer::D3DUploadBuffer() :
+    deviceContext(nullptr),
+    size(0)
+{}
+
+bool D3DUploadBuffer::Initialize(ID3D11Device* device, ID3D11DeviceContext* context, size_t byteSize, UINT bindFlags) {
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.ByteWidth = static_cast<UINT>(byteSize);
+    bufferDesc.BindFlags = bindFlags;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HRESULT hr = device->CreateBuffer(&bufferDesc, nullptr, buffer.ReleaseAndGetAddressOf());
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    deviceContext = context;
+    size = byteSize;
+    return true;
+}
+
+void D3DUploadBuffer::Shutdown() {
+    buffer.Reset();
+    deviceContext = nullptr;
+    size = 0;
+}
+
+uint8_t* D3DUploadBuffer::Map(UploadMapMode mode) {
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    D3D11_MAP mapType = mode == UploadMapMode::Discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    HRESULT hr = deviceContext->Map(buffer.Get(), 0, mapType, 0, &mappedResource);
+    if (FAILED(hr)) {
+        return nullptr;
+    }
+    return static_cast<uint8_t*>(mappedResource.pData);
+}
+
+void D3DUploadBuffer::Unmap() {
+    deviceContext->Unmap(buffer.Get(), 0);
+}
+
+D3DEventFence::D3DEventFence() :
+    deviceContext(nullptr),
+    signaledValue(0),
+    completedValue(0)
+{}
+
+bool D3DEventFence::Initialize(ID3D11Device* device, ID3D11DeviceContext* context) {
+    D3D11_QUERY_DESC queryDesc = {};
+    queryDesc.Query = D3D11_QUERY_EVENT;
+
+    for (int i = 0; i < QUERY_COUNT; ++i) {
+        HRESULT hr = device->CreateQuery(&queryDesc, queries[i].ReleaseAndGetAddressOf());
+        if (FAILED(hr)) {
+            return false;
+        }
+    }
+
+    deviceContext = context;
+    signaledValue = 0;
+    completedValue = 0;
+    return true;
+}
+
+void D3DEventFence::Shutdown() {
+    for (int i = 0; i < QUERY_COUNT; ++i) {
+        queries[i].Reset();
+    }
+    deviceContext = nullptr;
+}
+
+uint64_t D3DEventFence::Signal() {
+    ++signaledValue;
+
+    // A slot is only reused QUERY_COUNT frames later, by which point it has completed
+    if (signaledValue > QUERY_COUNT && completedValue < signaledValue - QUERY_COUNT) {
+        completedValue = signaledValue - QUERY_COUNT;
+    }
+
+    deviceContext->End(queries[signaledValue % QUERY_COUNT].Get());
+    return signaledValue;
+}
+
+uint64_t D3DEventFence::GetCompletedValue() {
+    // Queries finish in order, so stop at the first one still pending
+    while (completedValue < signaledValue) {
+        ID3D11Query* query = queries[(completedValue + 1) % QUERY_COUNT].Get();
+        if (deviceContext->GetData(query, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+            break;
+        }
+        ++completedValue;
+    }
+    return completedValue;
+}
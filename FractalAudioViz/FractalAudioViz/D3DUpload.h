@@ -0,0 +1,47 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "UploadArena.h"
+
+// Dynamic D3D11 buffer as an upload arena target
+class D3DUploadBuffer : public UploadTarget {
+private:
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    ID3D11DeviceContext* deviceContext;
+    size_t size;
+
+public:
+    D3DUploadBuffer();
+
+    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, size_t size, UINT bindFlags);
+    void Shutdown();
+
+    ID3D11Buffer* GetBuffer() const { return buffer.Get(); }
+
+    size_t GetSize() const override { return size; }
+    uint8_t* Map(UploadMapMode mode) override;
+    void Unmap() override;
+};
+
+// Frame fence built from D3D11 event queries, one per frame in flight. Present blocks
+// once the driver's frame latency (3 by default) is reached, so a ring of eight queries is
+// never reused before the GPU has passed it.
+class D3DEventFence : public UploadFence {
+private:
+    static const int QUERY_COUNT = 8;
+
+    Microsoft::WRL::ComPtr<ID3D11Query> queries[QUERY_COUNT];
+    ID3D11DeviceContext* deviceContext;
+    uint64_t signaledValue;
+    uint64_t completedValue;
+
+public:
+    D3DEventFence();
+
+    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+    void Shutdown();
+
+    uint64_t Signal() override;
+    uint64_t GetCompletedValue() override;
+};
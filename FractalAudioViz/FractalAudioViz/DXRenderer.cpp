@@ -1,9 +1,233 @@
 #include "DXRenderer.h"
 #include "Camera.h"
+#include <cstring>
 #include <stdexcept>
 
+namespace {
+    // Define the vertex shader code with matrix transformations
+    const char* const BASIC_VERTEX_SHADER = R"(
+        cbuffer FrameBuffer : register(b0)
+        {
+            matrix viewMatrix;
+            matrix projectionMatrix;
+        };
+        
+        cbuffer DrawBuffer : register(b1)
+        {
+            matrix worldMatrix;
+        };
+        
+        struct VertexInput {
+            float3 position : POSITION;
+            float4 color : COLOR;
+        };
+        
+        struct PixelInput {
+            float4 position : SV_POSITION;
+            float4 color : COLOR;
+        };
+        
+        PixelInput main(VertexInput input) {
+            PixelInput output;
+            
+            // Change the position vector to be 4 units for proper matrix calculations
+            float4 pos = float4(input.position, 1.0f);
+            
+            // Transform the vertex position using the world matrix
+            pos = mul(pos, worldMatrix);
+            
+            // Transform the position using the view matrix
+            pos = mul(pos, viewMatrix);
+            
+            // Transform the position using the projection matrix
+            pos = mul(pos, projectionMatrix);
+            
+            output.position = pos;
+            output.color = input.color;
+            
+            return output;
+        }
+    )";
+
+    // Define pixel shader code
+    const char* const BASIC_PIXEL_SHADER = R"(
+        struct PixelInput {
+            float4 position : SV_POSITION;
+            float4 color : COLOR;
+        };
+        
+        float4 main(PixelInput input) : SV_TARGET {
+            return input.color;
+        }
+    )";
+
+    // Same transform as the basic shader, with each vertex first placed by its instance
+    const char* const INSTANCED_VERTEX_SHADER = R"(
+        cbuffer FrameBuffer : register(b0)
+        {
+            matrix viewMatrix;
+            matrix projectionMatrix;
+        };
+        
+        cbuffer DrawBuffer : register(b1)
+        {
+            matrix worldMatrix;
+        };
+        
+        struct VertexInput {
+            float3 position : POSITION;
+            float4 color : COLOR;
+            float instanceX : INSTANCE0;
+            float instanceY : INSTANCE1;
+            float instanceZ : INSTANCE2;
+            float instanceScale : INSTANCE3;
+            float4 instanceColor : INSTANCECOLOR;
+        };
+        
+        struct PixelInput {
+            float4 position : SV_POSITION;
+            float4 color : COLOR;
+        };
+        
+        PixelInput main(VertexInput input) {
+            PixelInput output;
+            
+            // Scale the unit mesh and move it to the instance position
+            float3 instancePosition = float3(input.instanceX, input.instanceY, input.instanceZ);
+            float4 pos = float4(input.position * input.instanceScale + instancePosition, 1.0f);
+            
+            pos = mul(pos, worldMatrix);
+            pos = mul(pos, viewMatrix);
+            pos = mul(pos, projectionMatrix);
+            
+            // Tint the instance color with the mesh's vertex colors so faces stay distinct
+            output.position = pos;
+            output.color = input.instanceColor * (0.6f + 0.4f * input.color);
+            output.color.a = 1.0f;
+            
+            return output;
+        }
+    )";
+
+    // The basic transform, with the world matrix also scaling UNORM positions back to the
+    // mesh's grid, and the color lit from the decoded normal
+    const char* const PACKED_VERTEX_SHADER = R"(
+        cbuffer FrameBuffer : register(b0)
+        {
+            matrix viewMatrix;
+            matrix projectionMatrix;
+        };
+        
+        cbuffer DrawBuffer : register(b1)
+        {
+            matrix worldMatrix;
+        };
+        
+        struct VertexInput {
+            float4 position : POSITION;
+            float4 color : COLOR;
+            float2 normal : NORMAL;
+        };
+        
+        struct PixelInput {
+            float4 position : SV_POSITION;
+            float4 color : COLOR;
+        };
+        
+        // Unfold the octahedral encoding back onto the sphere
+        float3 DecodeNormal(float2 encoded) {
+            float3 n = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+            if (n.z < 0.0f) {
+                n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0.0f ? 1.0f : -1.0f);
+            }
+            return normalize(n);
+        }
+        
+        PixelInput main(VertexInput input) {
+            PixelInput output;
+            
+            float4 pos = float4(input.position.xyz, 1.0f);
+            pos = mul(pos, worldMatrix);
+            pos = mul(pos, viewMatrix);
+            pos = mul(pos, projectionMatrix);
+            
+            // The world matrix scales uniformly, so it keeps normals' directions
+            float3 normal = normalize(mul(DecodeNormal(input.normal), (float3x3)worldMatrix));
+            float light = 0.5f + 0.5f * saturate(dot(normal, normalize(float3(0.4f, 0.8f, -0.45f))));
+            
+            output.position = pos;
+            output.color = float4(input.color.rgb * light, input.color.a);
+            
+            return output;
+        }
+    )";
+
+    // ShaderCache's compiler: D3DCompile is safe to call from several threads
+    class D3DShaderCompiler : public ShaderCompiler {
+    public:
+        uint64_t GetVersion() const override { return D3D_COMPILER_VERSION; }
+
+        bool Compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) override {
+            std::vector<D3D_SHADER_MACRO> macros;
+            for (const ShaderDefine& define : desc.defines) {
+                macros.push_back({ define.name.c_str(), define.value.c_str() });
+            }
+            macros.push_back({ nullptr, nullptr });
+
+            Microsoft::WRL::ComPtr<ID3DBlob> blob;
+            Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
+            HRESULT hr = D3DCompile(
+                desc.source.data(), desc.source.size(),
+                desc.name.c_str(), macros.data(), nullptr, desc.entryPoint.c_str(), desc.profile.c_str(),
+                desc.flags, 0,
+                blob.GetAddressOf(), errorBlob.GetAddressOf()
+            );
+
+            if (FAILED(hr)) {
+                if (errorBlob) {
+                    errors.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+                }
+                return false;
+            }
+
+            const uint8_t* code = static_cast<const uint8_t*>(blob->GetBufferPointer());
+            bytecode.assign(code, code + blob->GetBufferSize());
+            return true;
+        }
+    };
+
+    ShaderDesc MakeShaderDesc(const char* name, const char* source, const char* profile) {
+        ShaderDesc desc;
+        desc.name = name;
+        desc.source = source;
+        desc.entryPoint = "main";
+        desc.profile = profile;
+        desc.flags = D3DCOMPILE_ENABLE_STRICTNESS;
+        return desc;
+    }
+
+    // The pack beside the executable
+    std::string GetShaderPackPath() {
+        char path[MAX_PATH];
+        DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+        std::string directory(path, length < MAX_PATH ? length : 0);
+        size_t slash = directory.find_last_of("\\/");
+        directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+        return directory + "FractalAudioViz.shaders";
+    }
+}
+
 
 DXRenderer::DXRenderer() :
+    instanceCapacity(0),
+    instanceCount(0),
+    meshVertexHandle(0),
+    meshIndexHandle(0),
+    meshIndexCount(0),
+    constantOffsetting(false),
+    basicPipeline(0),
+    instancedPipeline(0),
+    packedPipeline(0),
     hwnd(nullptr),
     width(0),
     height(0),
@@ -91,6 +315,14 @@ bool DXRenderer::Initialize(HWND windowHandle, int windowWidth, int windowHeight
         return false;
     }
 
+    // At most one frame queued, so Present blocks until the vblank before this frame's
+    // rather than letting the CPU run frames ahead; its return then tracks the display
+    // closely enough for the frame scheduler to plan starts from
+    Microsoft::WRL::ComPtr<IDXGIDevice1> dxgiDevice;
+    if (SUCCEEDED(device.As(&dxgiDevice))) {
+        dxgiDevice->SetMaximumFrameLatency(1);
+    }
+
     // Create the render target view
     ID3D11Texture2D* backBuffer = nullptr;
     hr = swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer));
@@ -202,11 +434,37 @@ bool DXRenderer::Initialize(HWND windowHandle, int windowWidth, int windowHeight
     viewport.TopLeftY = 0.0f;
     deviceContext->RSSetViewports(1, &viewport);
 
+    // Bytecode for every shader, from the pack or compiled in parallel
+    if (!CompileShaders()) {
+        return false;
+    }
+
     // Create basic shaders and input layout
     if (!CreateBasicShaders()) {
         return false;
     }
 
+    if (!CreateInstancedShaders()) {
+        return false;
+    }
+
+    if (!CreatePackedShaders()) {
+        return false;
+    }
+
+    // The shaders hold their own copies; unmap the pack
+    shaderCode.clear();
+    shaderCache.Close();
+
+    // Handle 0 in each resource table means nothing bound
+    pipelines.resize(1);
+    vertexBuffers.resize(1);
+    indexBuffers.resize(1);
+    basicPipeline = RegisterPipeline(vertexShader.Get(), pixelShader.Get(), inputLayout.Get(), D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    instancedPipeline = RegisterPipeline(instancedVertexShader.Get(), pixelShader.Get(), instancedInputLayout.Get(), D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    packedPipeline = RegisterPipeline(packedVertexShader.Get(), pixelShader.Get(), packedInputLayout.Get(), D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    stateCache.Invalidate();
+
     if (!CreateConstantBuffers()) {
         return false;
     }
@@ -215,68 +473,28 @@ bool DXRenderer::Initialize(HWND windowHandle, int windowWidth, int windowHeight
     return true;
 }
 
-bool DXRenderer::CreateBasicShaders() {
-    // Define the vertex shader code with matrix transformations
-    const char* vertexShaderCode = R"(
-        cbuffer MatrixBuffer : register(b0)
-        {
-            matrix worldMatrix;
-            matrix viewMatrix;
-            matrix projectionMatrix;
-        };
-        
-        struct VertexInput {
-            float3 position : POSITION;
-            float4 color : COLOR;
-        };
-        
-        struct PixelInput {
-            float4 position : SV_POSITION;
-            float4 color : COLOR;
-        };
-        
-        PixelInput main(VertexInput input) {
-            PixelInput output;
-            
-            // Change the position vector to be 4 units for proper matrix calculations
-            float4 pos = float4(input.position, 1.0f);
-            
-            // Transform the vertex position using the world matrix
-            pos = mul(pos, worldMatrix);
-            
-            // Transform the position using the view matrix
-            pos = mul(pos, viewMatrix);
-            
-            // Transform the position using the projection matrix
-            pos = mul(pos, projectionMatrix);
-            
-            output.position = pos;
-            output.color = input.color;
-            
-            return output;
-        }
-    )";
-
-    // Compile the vertex shader
-    Microsoft::WRL::ComPtr<ID3DBlob> vsBlob;
-    Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
-    HRESULT hr = D3DCompile(
-        vertexShaderCode, strlen(vertexShaderCode),
-        "VertexShader", nullptr, nullptr, "main", "vs_4_0",
-        D3DCOMPILE_ENABLE_STRICTNESS, 0,
-        vsBlob.GetAddressOf(), errorBlob.GetAddressOf()
-    );
-
-    if (FAILED(hr)) {
-        if (errorBlob) {
-            MessageBoxA(hwnd, (char*)errorBlob->GetBufferPointer(), "Vertex Shader Compilation Error", MB_OK | MB_ICONERROR);
-        }
+bool DXRenderer::CompileShaders() {
+    std::vector<ShaderDesc> shaders(ShaderCount);
+    shaders[BasicVertexShader] = MakeShaderDesc("VertexShader", BASIC_VERTEX_SHADER, "vs_4_0");
+    shaders[BasicPixelShader] = MakeShaderDesc("PixelShader", BASIC_PIXEL_SHADER, "ps_4_0");
+    shaders[InstancedVertexShader] = MakeShaderDesc("InstancedVertexShader", INSTANCED_VERTEX_SHADER, "vs_4_0");
+    shaders[PackedVertexShader] = MakeShaderDesc("PackedVertexShader", PACKED_VERTEX_SHADER, "vs_4_0");
+
+    D3DShaderCompiler compiler;
+    std::string errors;
+    if (!shaderCache.Load(GetShaderPackPath(), shaders, compiler, shaderCode, errors)) {
+        MessageBoxA(hwnd, errors.c_str(), "Shader Compilation Error", MB_OK | MB_ICONERROR);
         return false;
     }
 
+    return true;
+}
+
+bool DXRenderer::CreateBasicShaders() {
     // Create the vertex shader
-    hr = device->CreateVertexShader(
-        vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(),
+    const ShaderBytecode& vsCode = shaderCode[BasicVertexShader];
+    HRESULT hr = device->CreateVertexShader(
+        vsCode.data, vsCode.size,
         nullptr, vertexShader.GetAddressOf()
     );
 
@@ -294,7 +512,7 @@ bool DXRenderer::CreateBasicShaders() {
     // Create the input layout
     hr = device->CreateInputLayout(
         inputLayoutDesc, ARRAYSIZE(inputLayoutDesc),
-        vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(),
+        vsCode.data, vsCode.size,
         inputLayout.GetAddressOf()
     );
 
@@ -303,42 +521,85 @@ bool DXRenderer::CreateBasicShaders() {
         return false;
     }
 
-    // Define pixel shader code
-    const char* pixelShaderCode = R"(
-        struct PixelInput {
-            float4 position : SV_POSITION;
-            float4 color : COLOR;
-        };
-        
-        float4 main(PixelInput input) : SV_TARGET {
-            return input.color;
-        }
-    )";
+    // Create the pixel shader
+    const ShaderBytecode& psCode = shaderCode[BasicPixelShader];
+    hr = device->CreatePixelShader(
+        psCode.data, psCode.size,
+        nullptr, pixelShader.GetAddressOf()
+    );
+
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create pixel shader!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
 
-    // Compile the pixel shader
-    Microsoft::WRL::ComPtr<ID3DBlob> psBlob;
-    hr = D3DCompile(
-        pixelShaderCode, strlen(pixelShaderCode),
-        "PixelShader", nullptr, nullptr, "main", "ps_4_0",
-        D3DCOMPILE_ENABLE_STRICTNESS, 0,
-        psBlob.GetAddressOf(), errorBlob.GetAddressOf()
+    return true;
+}
+
+bool DXRenderer::CreateInstancedShaders() {
+    const ShaderBytecode& vsCode = shaderCode[InstancedVertexShader];
+    HRESULT hr = device->CreateVertexShader(
+        vsCode.data, vsCode.size,
+        nullptr, instancedVertexShader.GetAddressOf()
     );
 
     if (FAILED(hr)) {
-        if (errorBlob) {
-            MessageBoxA(hwnd, (char*)errorBlob->GetBufferPointer(), "Pixel Shader Compilation Error", MB_OK | MB_ICONERROR);
-        }
+        MessageBox(hwnd, L"Failed to create instanced vertex shader!", L"Error", MB_OK | MB_ICONERROR);
         return false;
     }
 
-    // Create the pixel shader
-    hr = device->CreatePixelShader(
-        psBlob->GetBufferPointer(), psBlob->GetBufferSize(),
-        nullptr, pixelShader.GetAddressOf()
+    // Mesh data in slot 0, one structure-of-arrays stream per instance attribute after it
+    D3D11_INPUT_ELEMENT_DESC inputLayoutDesc[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "INSTANCE", 0, DXGI_FORMAT_R32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE", 1, DXGI_FORMAT_R32_FLOAT, 2, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE", 2, DXGI_FORMAT_R32_FLOAT, 3, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE", 3, DXGI_FORMAT_R32_FLOAT, 4, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCECOLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 5, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+    };
+
+    hr = device->CreateInputLayout(
+        inputLayoutDesc, ARRAYSIZE(inputLayoutDesc),
+        vsCode.data, vsCode.size,
+        instancedInputLayout.GetAddressOf()
     );
 
     if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create pixel shader!", L"Error", MB_OK | MB_ICONERROR);
+        MessageBox(hwnd, L"Failed to create instanced input layout!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+
+    return true;
+}
+
+bool DXRenderer::CreatePackedShaders() {
+    const ShaderBytecode& vsCode = shaderCode[PackedVertexShader];
+    HRESULT hr = device->CreateVertexShader(
+        vsCode.data, vsCode.size,
+        nullptr, packedVertexShader.GetAddressOf()
+    );
+
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create packed vertex shader!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+
+    // PackedVertex: x, y, z, w as UNORM16, RGBA8 color, normal as two SNORM16
+    D3D11_INPUT_ELEMENT_DESC inputLayoutDesc[] = {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
+
+    hr = device->CreateInputLayout(
+        inputLayoutDesc, ARRAYSIZE(inputLayoutDesc),
+        vsCode.data, vsCode.size,
+        packedInputLayout.GetAddressOf()
+    );
+
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create packed input layout!", L"Error", MB_OK | MB_ICONERROR);
         return false;
     }
 
@@ -347,47 +608,278 @@ bool DXRenderer::CreateBasicShaders() {
 
 // Add new function to create constant buffers
 bool DXRenderer::CreateConstantBuffers() {
-    // Create matrix constant buffer
-    D3D11_BUFFER_DESC matrixBufferDesc;
-    matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-    matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    matrixBufferDesc.MiscFlags = 0;
-    matrixBufferDesc.StructureByteStride = 0;
-
-    HRESULT hr = device->CreateBuffer(&matrixBufferDesc, nullptr, matrixBuffer.GetAddressOf());
+    // Constant buffer offsetting needs a D3D11.1 context and driver support
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    constantOffsetting =
+        SUCCEEDED(deviceContext.As(&deviceContext1)) &&
+        SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+        options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+
+    if (constantOffsetting) {
+        // One ring for all constants, sub-allocated in 256-byte (16 constant) steps
+        if (!constantUploadBuffer.Initialize(device.Get(), deviceContext.Get(), CONSTANT_ARENA_SIZE, D3D11_BIND_CONSTANT_BUFFER) ||
+            !frameFence.Initialize(device.Get(), deviceContext.Get()) ||
+            !constantArena.Initialize(&constantUploadBuffer, &frameFence, 256)) {
+            MessageBox(hwnd, L"Failed to create constant upload arena!", L"Error", MB_OK | MB_ICONERROR);
+            return false;
+        }
+        return true;
+    }
+
+    // Fallback: one small dynamic buffer per slot, discarded on every update
+    D3D11_BUFFER_DESC constantBufferDesc;
+    constantBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    constantBufferDesc.ByteWidth = sizeof(FrameConstants);
+    constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    constantBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    constantBufferDesc.MiscFlags = 0;
+    constantBufferDesc.StructureByteStride = 0;
+
+    HRESULT hr = device->CreateBuffer(&constantBufferDesc, nullptr, frameConstantBuffer.GetAddressOf());
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create frame constant buffer!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+
+    constantBufferDesc.ByteWidth = sizeof(DrawConstants);
+    hr = device->CreateBuffer(&constantBufferDesc, nullptr, drawConstantBuffer.GetAddressOf());
     if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create matrix constant buffer!", L"Error", MB_OK | MB_ICONERROR);
+        MessageBox(hwnd, L"Failed to create draw constant buffer!", L"Error", MB_OK | MB_ICONERROR);
         return false;
     }
 
     return true;
 }
 
-// Add function to set matrices for rendering
-void DXRenderer::SetMatrices(const DirectX::XMMATRIX& world, const Camera* camera) {
+void DXRenderer::SetConstants(UINT slot, const void* data, size_t size, ID3D11Buffer* fallbackBuffer) {
+    if (constantOffsetting) {
+        // Append to the ring and bind a 16-constant window at the allocation
+        size_t offset = 0;
+        if (constantArena.Upload(data, size, offset)) {
+            ID3D11Buffer* buffer = constantUploadBuffer.GetBuffer();
+            UINT firstConstant = static_cast<UINT>(offset / 16);
+            UINT constantCount = 16;
+            deviceContext1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+        }
+        return;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = deviceContext->Map(fallbackBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (SUCCEEDED(hr)) {
+        memcpy(mappedResource.pData, data, size);
+        deviceContext->Unmap(fallbackBuffer, 0);
+        deviceContext->VSSetConstantBuffers(slot, 1, &fallbackBuffer);
+    }
+}
+
+void DXRenderer::SetCamera(const Camera* camera) {
+    // Transpose matrices for HLSL
+    FrameConstants constants;
+    constants.view = DirectX::XMMatrixTranspose(camera->GetViewMatrix());
+    constants.projection = DirectX::XMMatrixTranspose(camera->GetProjectionMatrix());
+    SetConstants(0, &constants, sizeof(constants), frameConstantBuffer.Get());
+}
+
+void DXRenderer::SetWorldMatrix(const DirectX::XMMATRIX& world) {
     // Store the world matrix
     worldMatrix = world;
 
-    // Map the constant buffer
+    DrawConstants constants;
+    constants.world = DirectX::XMMatrixTranspose(worldMatrix);
+    SetConstants(1, &constants, sizeof(constants), drawConstantBuffer.Get());
+}
+
+bool DXRenderer::UploadInstances(const FractalInstances& instances) {
+    UINT count = static_cast<UINT>(instances.count);
+
+    // Grow the buffer to fit; it's laid out as [x...][y...][z...][scale...][color...]
+    if (count > instanceCapacity || !instanceBuffer) {
+        instanceBuffer.Reset();
+        instanceCapacity = 0;
+
+        D3D11_BUFFER_DESC instanceBufferDesc = {};
+        instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        instanceBufferDesc.ByteWidth = (count > 0 ? count : 1) * 5 * sizeof(float);
+        instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        HRESULT hr = device->CreateBuffer(&instanceBufferDesc, nullptr, instanceBuffer.GetAddressOf());
+        if (FAILED(hr)) {
+            instanceCount = 0;
+            return false;
+        }
+        instanceCapacity = count > 0 ? count : 1;
+
+        // The handle stays the same but the buffer behind it changed
+        stateCache.instances = 0;
+    }
+
     D3D11_MAPPED_SUBRESOURCE mappedResource;
-    HRESULT hr = deviceContext->Map(matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-    if (SUCCEEDED(hr)) {
-        // Get a pointer to the constant buffer data
-        MatrixBufferType* dataPtr = (MatrixBufferType*)mappedResource.pData;
+    HRESULT hr = deviceContext->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(hr)) {
+        instanceCount = 0;
+        return false;
+    }
 
-        // Transpose matrices for HLSL
-        dataPtr->world = DirectX::XMMatrixTranspose(worldMatrix);
-        dataPtr->view = DirectX::XMMatrixTranspose(camera->GetViewMatrix());
-        dataPtr->projection = DirectX::XMMatrixTranspose(camera->GetProjectionMatrix());
+    // Each array goes to its own range, at the offsets DrawInstances binds
+    unsigned char* data = static_cast<unsigned char*>(mappedResource.pData);
+    size_t range = static_cast<size_t>(instanceCapacity) * sizeof(float);
+    size_t bytes = static_cast<size_t>(count) * sizeof(float);
+    if (count > 0) {
+        memcpy(data, instances.x.data(), bytes);
+        memcpy(data + range, instances.y.data(), bytes);
+        memcpy(data + 2 * range, instances.z.data(), bytes);
+        memcpy(data + 3 * range, instances.scale.data(), bytes);
+        memcpy(data + 4 * range, instances.color.data(), bytes);
+    }
+    deviceContext->Unmap(instanceBuffer.Get(), 0);
 
-        // Unmap the constant buffer
-        deviceContext->Unmap(matrixBuffer.Get(), 0);
+    instanceCount = count;
+    return true;
+}
 
-        // Set the constant buffer in the vertex shader
-        deviceContext->VSSetConstantBuffers(0, 1, matrixBuffer.GetAddressOf());
+bool DXRenderer::UploadMesh(const FractalMesh& mesh) {
+    static_assert(sizeof(MeshVertex) == sizeof(Vertex), "MeshVertex must match the basic input layout");
+    return UploadMeshBuffers(mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex), mesh.indices);
+}
+
+bool DXRenderer::UploadMesh(const std::vector<PackedVertex>& vertices, const std::vector<uint32_t>& indices) {
+    return UploadMeshBuffers(vertices.data(), vertices.size(), sizeof(PackedVertex), indices);
+}
+
+bool DXRenderer::UploadMeshBuffers(const void* vertices, size_t vertexCount, UINT stride,
+    const std::vector<uint32_t>& indices) {
+    meshIndexCount = 0;
+    meshVertexBuffer.Reset();
+    meshIndexBuffer.Reset();
+    if (vertexCount == 0 || indices.empty()) {
+        return false;
     }
+
+    // Built once per fractal change and drawn every frame, so immutable
+    D3D11_BUFFER_DESC vertexBufferDesc = {};
+    vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    vertexBufferDesc.ByteWidth = static_cast<UINT>(vertexCount * stride);
+    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA vertexData = {};
+    vertexData.pSysMem = vertices;
+
+    HRESULT hr = device->CreateBuffer(&vertexBufferDesc, &vertexData, meshVertexBuffer.GetAddressOf());
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    D3D11_BUFFER_DESC indexBufferDesc = {};
+    indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    indexBufferDesc.ByteWidth = static_cast<UINT>(indices.size() * sizeof(uint32_t));
+    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA indexData = {};
+    indexData.pSysMem = indices.data();
+
+    hr = device->CreateBuffer(&indexBufferDesc, &indexData, meshIndexBuffer.GetAddressOf());
+    if (FAILED(hr)) {
+        meshVertexBuffer.Reset();
+        return false;
+    }
+
+    // Register on first use, afterwards swap the buffers (and stride) behind the handles
+    if (meshVertexHandle == 0) {
+        meshVertexHandle = RegisterVertexBuffer(meshVertexBuffer.Get(), stride);
+        meshIndexHandle = RegisterIndexBuffer(meshIndexBuffer.Get(), DXGI_FORMAT_R32_UINT);
+    }
+    else {
+        vertexBuffers[meshVertexHandle].buffer = meshVertexBuffer;
+        vertexBuffers[meshVertexHandle].stride = stride;
+        indexBuffers[meshIndexHandle].buffer = meshIndexBuffer;
+        stateCache.Invalidate();
+    }
+
+    meshIndexCount = static_cast<UINT>(indices.size());
+    return true;
+}
+
+RenderHandle DXRenderer::RegisterPipeline(ID3D11VertexShader* vs, ID3D11PixelShader* ps,
+    ID3D11InputLayout* layout, D3D11_PRIMITIVE_TOPOLOGY topology) {
+    PipelineEntry entry;
+    entry.vertexShader = vs;
+    entry.pixelShader = ps;
+    entry.inputLayout = layout;
+    entry.topology = topology;
+    pipelines.push_back(entry);
+    return static_cast<RenderHandle>(pipelines.size() - 1);
+}
+
+RenderHandle DXRenderer::RegisterVertexBuffer(ID3D11Buffer* buffer, UINT stride) {
+    VertexBufferEntry entry;
+    entry.buffer = buffer;
+    entry.stride = stride;
+    vertexBuffers.push_back(entry);
+    return static_cast<RenderHandle>(vertexBuffers.size() - 1);
+}
+
+RenderHandle DXRenderer::RegisterIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format) {
+    IndexBufferEntry entry;
+    entry.buffer = buffer;
+    entry.format = format;
+    indexBuffers.push_back(entry);
+    return static_cast<RenderHandle>(indexBuffers.size() - 1);
+}
+
+void DXRenderer::ExecuteQueue() {
+    renderQueue.Sort();
+    renderQueue.Execute(*this, stateCache);
+    renderQueue.Clear();
+}
+
+void DXRenderer::SetPipeline(RenderHandle pipeline) {
+    const PipelineEntry& entry = pipelines[pipeline < pipelines.size() ? pipeline : 0];
+    deviceContext->VSSetShader(entry.vertexShader.Get(), nullptr, 0);
+    deviceContext->PSSetShader(entry.pixelShader.Get(), nullptr, 0);
+    deviceContext->IASetInputLayout(entry.inputLayout.Get());
+    if (entry.vertexShader) {
+        deviceContext->IASetPrimitiveTopology(entry.topology);
+    }
+}
+
+void DXRenderer::SetVertexBuffer(RenderHandle buffer) {
+    const VertexBufferEntry& entry = vertexBuffers[buffer < vertexBuffers.size() ? buffer : 0];
+    ID3D11Buffer* vBuffer = entry.buffer.Get();
+    UINT stride = entry.stride;
+    UINT offset = 0;
+    deviceContext->IASetVertexBuffers(0, 1, &vBuffer, &stride, &offset);
+}
+
+void DXRenderer::SetIndexBuffer(RenderHandle buffer) {
+    const IndexBufferEntry& entry = indexBuffers[buffer < indexBuffers.size() ? buffer : 0];
+    deviceContext->IASetIndexBuffer(entry.buffer.Get(), entry.buffer ? entry.format : DXGI_FORMAT_UNKNOWN, 0);
+}
+
+void DXRenderer::SetInstances(RenderHandle instances) {
+    if (instances != FRACTAL_INSTANCES || !instanceBuffer) {
+        return;
+    }
+
+    // Slots 1-5 all read the one instance buffer, each from its own array
+    UINT range = instanceCapacity * sizeof(float);
+    ID3D11Buffer* buffers[5] = { instanceBuffer.Get(), instanceBuffer.Get(), instanceBuffer.Get(), instanceBuffer.Get(), instanceBuffer.Get() };
+    UINT strides[5] = { sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(uint32_t) };
+    UINT offsets[5] = { 0, range, 2 * range, 3 * range, 4 * range };
+    deviceContext->IASetVertexBuffers(1, 5, buffers, strides, offsets);
+}
+
+void DXRenderer::SetDrawConstants(const void* data, size_t size) {
+    SetConstants(1, data, size, drawConstantBuffer.Get());
+}
+
+void DXRenderer::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) {
+    deviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void DXRenderer::DrawIndexedInstanced(uint32_t indexCount, uint32_t count, uint32_t startIndex, int32_t baseVertex) {
+    deviceContext->DrawIndexedInstanced(indexCount, count, startIndex, baseVertex, 0);
 }
 
 void DXRenderer::Shutdown() {
@@ -396,6 +888,29 @@ void DXRenderer::Shutdown() {
         deviceContext->ClearState();
 
     // Release all DirectX resources in reverse order
+    instanceBuffer.Reset();
+    packedInputLayout.Reset();
+    packedVertexShader.Reset();
+    instancedInputLayout.Reset();
+    instancedVertexShader.Reset();
+    instanceCapacity = 0;
+    meshIndexBuffer.Reset();
+    meshVertexBuffer.Reset();
+    meshVertexHandle = 0;
+    meshIndexHandle = 0;
+    meshIndexCount = 0;
+    renderQueue.Clear();
+    stateCache.Invalidate();
+    pipelines.clear();
+    vertexBuffers.clear();
+    indexBuffers.clear();
+    constantArena.Shutdown();
+    constantUploadBuffer.Shutdown();
+    frameFence.Shutdown();
+    frameConstantBuffer.Reset();
+    drawConstantBuffer.Reset();
+    deviceContext1.Reset();
+    instanceCount = 0;
     inputLayout.Reset();
     vertexShader.Reset();
     pixelShader.Reset();
@@ -496,25 +1011,36 @@ bool DXRenderer::ResizeBuffers(int newWidth, int newHeight) {
 }
 
 void DXRenderer::BeginFrame(float r, float g, float b, float a) {
+    // Reclaim constant memory from frames the GPU has finished
+    constantArena.BeginFrame();
+
     // Clear the render target and depth stencil
     float clearColor[4] = { r, g, b, a };
     deviceContext->ClearRenderTargetView(renderTargetView.Get(), clearColor);
     deviceContext->ClearDepthStencilView(depthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
-    // Set the blend state
-    float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    deviceContext->OMSetBlendState(blendState.Get(), blendFactor, 0xFFFFFFFF);
+    // Blend, depth and rasterizer state stay as Initialize set them, and shaders and
+    // buffers are bound by the queue only when they change, so nothing is rebound here
+    renderQueue.Clear();
+}
 
-    // Set shaders and input layout for this frame
-    deviceContext->VSSetShader(vertexShader.Get(), nullptr, 0);
-    deviceContext->PSSetShader(pixelShader.Get(), nullptr, 0);
-    deviceContext->IASetInputLayout(inputLayout.Get());
+bool DXRenderer::DrawBackdrop(const uint32_t* pixels, size_t imageWidth, size_t imageHeight, size_t pitch) {
+    if (!renderTargetView || imageWidth != static_cast<size_t>(width) || imageHeight != static_cast<size_t>(height)) {
+        return false;
+    }
 
-    // Set primitive topology
-    deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // Straight into the back buffer, which has the image's RGBA8 layout; the copy is
+    // queued ahead of the frame's draws, so they land on top of it
+    Microsoft::WRL::ComPtr<ID3D11Resource> backBuffer;
+    renderTargetView->GetResource(backBuffer.GetAddressOf());
+    deviceContext->UpdateSubresource(backBuffer.Get(), 0, nullptr, pixels, static_cast<UINT>(pitch), 0);
+    return true;
 }
 
 void DXRenderer::EndFrame() {
+    // Everything uploaded this frame is released once the GPU passes this point
+    constantArena.EndFrame();
+
     // Present the back buffer to the screen
     HRESULT hr = swapChain->Present(vsync ? 1 : 0, 0);
     if (FAILED(hr)) {
@@ -2,11 +2,19 @@
 
 #include <windows.h>
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <dxgi.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <wrl/client.h> // For ComPtr
+#include <vector>
 #include "Cube.h"
+#include "FractalGenerator.h"
+#include "FractalMesh.h"
+#include "VertexPacking.h"
+#include "D3DUpload.h"
+#include "RenderQueue.h"
+#include "ShaderCache.h"
 
 // Link the necessary libraries
 #pragma comment(lib, "d3d11.lib")
@@ -22,14 +30,21 @@ struct Vertex {
     DirectX::XMFLOAT4 Color;
 };
 
-// Constant buffer structure for matrices
-struct MatrixBufferType {
-    DirectX::XMMATRIX world;
+// Constants that change once per frame (register b0)
+struct FrameConstants {
     DirectX::XMMATRIX view;
     DirectX::XMMATRIX projection;
 };
 
-class DXRenderer {
+// Constants that change per draw (register b1)
+struct DrawConstants {
+    DirectX::XMMATRIX world;
+};
+
+// Size of the constant upload ring; 256 bytes per draw, so room for 4096 draws in flight
+constexpr size_t CONSTANT_ARENA_SIZE = 1 << 20;
+
+class DXRenderer : public RenderBackend {
 private:
     // DirectX device resources
     Microsoft::WRL::ComPtr<ID3D11Device> device;
@@ -45,8 +60,79 @@ private:
     Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
 
-    // Constant buffer for matrices
-    Microsoft::WRL::ComPtr<ID3D11Buffer> matrixBuffer;
+    // Instanced mesh pipeline: per-instance x, y, z, scale and color arrays are read
+    // straight from their ranges of one instance buffer through input slots 1-5
+    Microsoft::WRL::ComPtr<ID3D11VertexShader> instancedVertexShader;
+    Microsoft::WRL::ComPtr<ID3D11InputLayout> instancedInputLayout;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+    UINT instanceCapacity;
+    UINT instanceCount;
+
+    // Packed vertex pipeline: 16-bit positions, 8-bit color and an octahedral normal,
+    // dequantized by the world matrix and lit from the normal in the shader
+    Microsoft::WRL::ComPtr<ID3D11VertexShader> packedVertexShader;
+    Microsoft::WRL::ComPtr<ID3D11InputLayout> packedInputLayout;
+
+    // The fractal's merged exterior mesh, with 32-bit indices. Each upload replaces the
+    // buffers behind the same two handles.
+    Microsoft::WRL::ComPtr<ID3D11Buffer> meshVertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> meshIndexBuffer;
+    RenderHandle meshVertexHandle;
+    RenderHandle meshIndexHandle;
+    UINT meshIndexCount;
+
+    bool UploadMeshBuffers(const void* vertices, size_t vertexCount, UINT stride, const std::vector<uint32_t>& indices);
+
+    // Constants are sub-allocated from one ring buffer and bound by offset (D3D11.1).
+    // Without constant buffer offsetting they fall back to a discarded buffer per slot.
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext1> deviceContext1;
+    D3DUploadBuffer constantUploadBuffer;
+    D3DEventFence frameFence;
+    UploadArena constantArena;
+    bool constantOffsetting;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> frameConstantBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> drawConstantBuffer;
+
+    // Upload constants and bind them to a vertex shader slot
+    void SetConstants(UINT slot, const void* data, size_t size, ID3D11Buffer* fallbackBuffer);
+
+    // Resources that draw packets refer to by handle; entry 0 of each table is "none"
+    struct PipelineEntry {
+        Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
+        Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
+        Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+        D3D11_PRIMITIVE_TOPOLOGY topology;
+    };
+    struct VertexBufferEntry {
+        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+        UINT stride;
+    };
+    struct IndexBufferEntry {
+        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+        DXGI_FORMAT format;
+    };
+    std::vector<PipelineEntry> pipelines;
+    std::vector<VertexBufferEntry> vertexBuffers;
+    std::vector<IndexBufferEntry> indexBuffers;
+    RenderHandle basicPipeline;
+    RenderHandle instancedPipeline;
+    RenderHandle packedPipeline;
+
+    // Shader bytecode, indexed by ShaderProgram; mapped from the cache's pack during
+    // Initialize only
+    enum ShaderProgram {
+        BasicVertexShader,
+        BasicPixelShader,
+        InstancedVertexShader,
+        PackedVertexShader,
+        ShaderCount
+    };
+    ShaderCache shaderCache;
+    std::vector<ShaderBytecode> shaderCode;
+
+    // This frame's draw packets, and the bindings currently on the immediate context
+    RenderQueue renderQueue;
+    RenderStateCache stateCache;
 
     // World matrix for object transformation
     DirectX::XMMATRIX worldMatrix;
@@ -74,14 +160,79 @@ public:
     void BeginFrame(float r = 0.0f, float g = 0.0f, float b = 0.0f, float a = 1.0f);
     void EndFrame();
 
+    // Copy an RGBA8 image over the back buffer in place of the clear color, after
+    // BeginFrame; false unless it's the back buffer's size
+    bool DrawBackdrop(const uint32_t* pixels, size_t imageWidth, size_t imageHeight, size_t pitch);
+
+    // Load every shader's bytecode through the shader cache, before the Create*Shaders
+    bool CompileShaders();
+
     // Create and set up shaders and input layout
     bool CreateBasicShaders();
 
+    // Create the vertex shader and input layout for instanced drawing
+    bool CreateInstancedShaders();
+
+    // Create the vertex shader and input layout for PackedVertex meshes
+    bool CreatePackedShaders();
+
     // Create constant buffers
     bool CreateConstantBuffers();
 
-    // Set matrices for rendering
-    void SetMatrices(const DirectX::XMMATRIX& world, const Camera* camera);
+    // Copy fractal instances to the GPU, growing the instance buffer if needed
+    bool UploadInstances(const FractalInstances& instances);
+
+    UINT GetInstanceCount() const { return instanceCount; }
+
+    // Copy a merged fractal mesh to the GPU in place of the last one, as float vertices or
+    // packed ones (drawn with the packed pipeline, dequantized by the world matrix)
+    bool UploadMesh(const FractalMesh& mesh);
+    bool UploadMesh(const std::vector<PackedVertex>& vertices, const std::vector<uint32_t>& indices);
+
+    // Handles and index count of the uploaded mesh, for a plain draw
+    RenderHandle GetMeshVertexBuffer() const { return meshVertexHandle; }
+    RenderHandle GetMeshIndexBuffer() const { return meshIndexHandle; }
+    UINT GetMeshIndexCount() const { return meshIndexCount; }
+
+    // Handle of the uploaded fractal instances, for DrawPacket::instances
+    static const RenderHandle FRACTAL_INSTANCES = 1;
+
+    // Register resources for use in draw packets (the renderer keeps a reference)
+    RenderHandle RegisterPipeline(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader,
+        ID3D11InputLayout* inputLayout, D3D11_PRIMITIVE_TOPOLOGY topology);
+    RenderHandle RegisterVertexBuffer(ID3D11Buffer* buffer, UINT stride);
+    RenderHandle RegisterIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format);
+
+    // Built-in pipelines: per-vertex color, the same mesh placed per fractal instance, and
+    // packed vertices
+    RenderHandle GetBasicPipeline() const { return basicPipeline; }
+    RenderHandle GetInstancedPipeline() const { return instancedPipeline; }
+    RenderHandle GetPackedPipeline() const { return packedPipeline; }
+
+    // Draw packets are recorded into the queue's lists (one per recording thread) between
+    // BeginFrame and ExecuteQueue, which sorts them and replays them through the state cache
+    RenderQueue& GetRenderQueue() { return renderQueue; }
+    RenderCommandList& GetCommandList(size_t index = 0) { return renderQueue.GetList(index); }
+    void ExecuteQueue();
+
+    // RenderBackend: the replay target for the queue
+    void SetPipeline(RenderHandle pipeline) override;
+    void SetVertexBuffer(RenderHandle buffer) override;
+    void SetIndexBuffer(RenderHandle buffer) override;
+    void SetInstances(RenderHandle instances) override;
+    void SetDrawConstants(const void* data, size_t size) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) override;
+
+    // View and projection, once per frame after BeginFrame
+    void SetCamera(const Camera* camera);
+
+    // World matrix for the following draws
+    void SetWorldMatrix(const DirectX::XMMATRIX& world);
+
+    // Constant upload ring statistics
+    const UploadArenaStats& GetConstantUploadStats() const { return constantArena.GetStats(); }
+    bool IsUsingConstantOffsets() const { return constantOffsetting; }
 
     // Access device and context
     ID3D11Device* GetDevice() const { return device.Get(); }
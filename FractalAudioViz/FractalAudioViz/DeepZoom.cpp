@@ -0,0 +1,437 @@
+#include "DeepZoom.h"
+#include "EscapeTime.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "SimdLanes.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+    const double BAILOUT2 = 65536.0;
+
+    // Probe pixels per image edge the series is checked against
+    const int SERIES_PROBES = 5;
+
+    // The view as the kernels use it, derived once per Render: pixel (x, y) is
+    // (x0 + x * pixelSize, y0 - y * pixelSize) from the reference, and starts skipped
+    // iterations in at the series' value there
+    struct KernelParams {
+        const double* referenceX;
+        const double* referenceY;
+        double last;                // Index of the reference's last iteration
+        double bailout2;
+        double maxIterations;
+        double pixelSize;
+        double skipped;
+        double inverseRadius;       // Of the series' disc, which holds the view
+        double seriesX[3];          // A, B and C, scaled by the radius to its power
+        double seriesY[3];
+        bool rebase;
+    };
+
+    namespace ScalarKernels {
+        using namespace SimdLanes::ScalarDouble;
+#include "DeepZoomKernels.inl"
+    }
+
+#if FAV_X86
+    namespace SseKernels {
+        using namespace SimdLanes::SseDouble;
+#include "DeepZoomKernels.inl"
+    }
+
+// GCC reports the self-initialized _mm256_undefined_pd and _mm512_undefined_pd inside
+// the gathers and unmasked intrinsics as uninitialized once they are inlined into these
+// kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+FAV_BEGIN_TARGET_AVX2
+    namespace Avx2Kernels {
+        using namespace SimdLanes::Avx2Double;
+#include "DeepZoomKernels.inl"
+    }
+FAV_END_TARGET
+
+FAV_BEGIN_TARGET_AVX512
+    namespace Avx512Kernels {
+        using namespace SimdLanes::Avx512Double;
+#include "DeepZoomKernels.inl"
+    }
+FAV_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+    typedef uint64_t (*RowKernel)(const KernelParams&, double, double, size_t, double*, double*, uint64_t*);
+
+    // The double lanes need no 256-bit integer operations, but AVX without AVX2 has no
+    // gather, so it runs the SSE2 kernel
+    RowKernel SelectKernel(SimdLevel maxSimdLevel) {
+        SimdLevel level = ResolveSimdLevel(maxSimdLevel);
+#if FAV_X86
+        if (level >= SimdLevel::AVX512) return Avx512Kernels::PerturbRow;
+        if (level >= SimdLevel::AVX2) return Avx2Kernels::PerturbRow;
+        if (level >= SimdLevel::SSE2) return SseKernels::PerturbRow;
+#endif
+        (void)level;
+        return ScalarKernels::PerturbRow;
+    }
+
+    // Two's-complement fixed point: 32-bit limbs, least significant first, the last one
+    // the signed whole part and the rest the fraction. Every operand has the same length.
+    typedef std::vector<uint32_t> Fixed;
+
+    bool IsNegative(const Fixed& a) {
+        return (a.back() >> 31) != 0;
+    }
+
+    void Negate(Fixed& a) {
+        uint64_t carry = 1;
+        for (uint32_t& limb : a) {
+            uint64_t sum = static_cast<uint64_t>(~limb) + carry;
+            limb = static_cast<uint32_t>(sum);
+            carry = sum >> 32;
+        }
+    }
+
+    void Add(const Fixed& a, const Fixed& b, Fixed& out) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            uint64_t sum = static_cast<uint64_t>(a[i]) + b[i] + carry;
+            out[i] = static_cast<uint32_t>(sum);
+            carry = sum >> 32;
+        }
+    }
+
+    void Sub(const Fixed& a, const Fixed& b, Fixed& out) {
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            uint64_t difference = static_cast<uint64_t>(a[i]) - b[i] - borrow;
+            out[i] = static_cast<uint32_t>(difference);
+            borrow = (difference >> 32) & 1;
+        }
+    }
+
+    // Magnitudes multiplied limb by limb, keeping the limbs at the fraction's position;
+    // scratch is reused across calls
+    void Mul(const Fixed& a, const Fixed& b, Fixed& out, std::vector<uint32_t>& scratch) {
+        const size_t n = a.size();
+        const bool negative = IsNegative(a) != IsNegative(b);
+        Fixed x = a, y = b;
+        if (IsNegative(x)) Negate(x);
+        if (IsNegative(y)) Negate(y);
+
+        scratch.assign(2 * n, 0);
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < n; ++j) {
+                uint64_t t = static_cast<uint64_t>(x[i]) * y[j] + scratch[i + j] + carry;
+                scratch[i + j] = static_cast<uint32_t>(t);
+                carry = t >> 32;
+            }
+            scratch[i + n] = static_cast<uint32_t>(carry);
+        }
+        std::copy(scratch.begin() + (n - 1), scratch.begin() + (2 * n - 1), out.begin());
+        if (negative) Negate(out);
+    }
+
+    double ToDouble(const Fixed& a) {
+        Fixed magnitude = a;
+        const bool negative = IsNegative(a);
+        if (negative) Negate(magnitude);
+        double value = 0.0;
+        const int fraction = static_cast<int>(a.size()) - 1;
+        for (size_t i = 0; i < magnitude.size(); ++i) {
+            value += std::ldexp(static_cast<double>(magnitude[i]), 32 * (static_cast<int>(i) - fraction));
+        }
+        return negative ? -value : value;
+    }
+
+    // An optional sign, whole digits and fraction digits; the fraction is built from its
+    // last digit up, x = (x + d) / 10, so the only rounding is the last division's
+    bool Parse(const std::string& text, size_t fractionLimbs, Fixed& out) {
+        size_t position = 0;
+        bool negative = false;
+        if (position < text.size() && (text[position] == '-' || text[position] == '+')) {
+            negative = text[position++] == '-';
+        }
+        size_t point = std::min(text.find('.'), text.size());
+        size_t end = text.size();
+        if (point == position && end <= point + 1) {
+            return false;
+        }
+
+        uint32_t whole = 0;
+        for (size_t i = position; i < point; ++i) {
+            if (text[i] < '0' || text[i] > '9' || whole >= 100000) return false;
+            whole = whole * 10 + static_cast<uint32_t>(text[i] - '0');
+        }
+
+        Fixed value(fractionLimbs + 1, 0);
+        for (size_t i = end; i > point + 1; --i) {
+            char digit = text[i - 1];
+            if (digit < '0' || digit > '9') return false;
+            value.back() = static_cast<uint32_t>(digit - '0');
+            uint64_t remainder = 0;
+            for (size_t k = value.size(); k-- > 0;) {
+                uint64_t current = (remainder << 32) | value[k];
+                value[k] = static_cast<uint32_t>(current / 10);
+                remainder = current % 10;
+            }
+        }
+        value.back() = whole;
+        if (negative) Negate(value);
+        out.swap(value);
+        return true;
+    }
+
+    // Fraction limbs for pixels this size, with 64 bits to spare for the orbit's growth
+    // between them
+    size_t GetFractionLimbs(double pixelSize) {
+        double bits = -std::log2(pixelSize) + 64.0;
+        return std::max<size_t>(2, static_cast<size_t>(std::ceil(bits / 32.0)));
+    }
+
+    // Per-thread rows of iteration counts and radii, reused across rows and frames
+    struct RowScratch {
+        std::vector<double> iterations;
+        std::vector<double> radii;
+    };
+
+    RowScratch& GetRowScratch() {
+        thread_local RowScratch scratch;
+        return scratch;
+    }
+
+    // Complex helpers for the series, on (x, y) pairs
+    struct Complex {
+        double x;
+        double y;
+    };
+
+    Complex operator+(Complex a, Complex b) { return { a.x + b.x, a.y + b.y }; }
+    Complex operator-(Complex a, Complex b) { return { a.x - b.x, a.y - b.y }; }
+    Complex operator*(Complex a, Complex b) { return { a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x }; }
+    Complex operator*(double s, Complex a) { return { s * a.x, s * a.y }; }
+    double Norm(Complex a) { return a.x * a.x + a.y * a.y; }
+}
+
+const double DeepZoomRenderer::MAX_HEIGHT = 8.0;
+const double DeepZoomRenderer::MIN_HEIGHT = 1e-280;
+
+DeepZoomRenderer::DeepZoomRenderer() :
+    centerX("0"),
+    centerY("1"),
+    referenceLimbs(0),
+    referenceIterations(0),
+    referenceEscaped(false)
+{}
+
+bool DeepZoomRenderer::Initialize(const DeepZoomSettings& newSettings) {
+    settings = newSettings;
+    return Resize(newSettings.width, newSettings.height);
+}
+
+bool DeepZoomRenderer::Resize(size_t width, size_t height) {
+    if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE) {
+        return false;
+    }
+    settings.width = width;
+    settings.height = height;
+    pixels.assign(width * height, EscapeTimeRenderer::GetColor(-1.0f, 0.0f, 0.0f));
+    values.assign(width * height, -1.0f);
+    stats = DeepZoomStats();
+    return true;
+}
+
+bool DeepZoomRenderer::SetCenter(const std::string& x, const std::string& y) {
+    Fixed check;
+    if (!Parse(x, 1, check) || !Parse(y, 1, check)) {
+        return false;
+    }
+    centerX = x;
+    centerY = y;
+    referenceLimbs = 0;
+    return true;
+}
+
+int DeepZoomRenderer::GetMaxIterations(double viewHeight) const {
+    double decades = std::max(0.0, -std::log10(viewHeight));
+    return settings.baseIterations + static_cast<int>(settings.iterationsPerDecade * decades);
+}
+
+void DeepZoomRenderer::UpdateReference(double viewHeight, int maxIterations) {
+    const size_t limbs = GetFractionLimbs(viewHeight / static_cast<double>(settings.height));
+    if (referenceLimbs >= limbs && (referenceEscaped || referenceIterations >= maxIterations)) {
+        stats.referenceSeconds = 0.0;
+        return;
+    }
+
+    // Far enough for every view these limbs cover, so zooming in doesn't recompute it
+    // every frame for a few more iterations
+    const double start = FrameStats::NowSeconds();
+    const double deepest = std::ldexp(static_cast<double>(settings.height), 64 - 32 * static_cast<int>(limbs));
+    const int iterations = std::max(maxIterations, GetMaxIterations(deepest));
+
+    Fixed cx, cy;
+    Parse(centerX, limbs, cx);
+    Parse(centerY, limbs, cy);
+    Fixed zx(limbs + 1, 0), zy(limbs + 1, 0), x2(limbs + 1), y2(limbs + 1), xy(limbs + 1);
+    std::vector<uint32_t> scratch;
+
+    referenceX.assign(1, 0.0);
+    referenceY.assign(1, 0.0);
+    referenceEscaped = false;
+    for (int n = 0; n < iterations && !referenceEscaped; ++n) {
+        Mul(zx, zx, x2, scratch);
+        Mul(zy, zy, y2, scratch);
+        Mul(zx, zy, xy, scratch);
+        Sub(x2, y2, zx);
+        Add(zx, cx, zx);
+        Add(xy, xy, zy);
+        Add(zy, cy, zy);
+
+        double x = ToDouble(zx), y = ToDouble(zy);
+        referenceX.push_back(x);
+        referenceY.push_back(y);
+        referenceEscaped = x * x + y * y > BAILOUT2;
+    }
+    referenceLimbs = limbs;
+    referenceIterations = iterations;
+    stats.referenceSeconds = FrameStats::NowSeconds() - start;
+}
+
+void DeepZoomRenderer::Render(double viewHeight, JobSystem* jobs) {
+    const double start = FrameStats::NowSeconds();
+    viewHeight = std::min(std::max(viewHeight, MIN_HEIGHT), MAX_HEIGHT);
+    const int maxIterations = GetMaxIterations(viewHeight);
+    UpdateReference(viewHeight, maxIterations);
+
+    const size_t width = settings.width, height = settings.height;
+    const double pixelSize = viewHeight / static_cast<double>(height);
+    const double x0 = (0.5 - 0.5 * static_cast<double>(width)) * pixelSize;
+    const double y0 = (0.5 * static_cast<double>(height) - 0.5) * pixelSize;
+    const double radius = 0.5 * pixelSize * std::hypot(static_cast<double>(width), static_cast<double>(height));
+
+    KernelParams kernel;
+    kernel.referenceX = referenceX.data();
+    kernel.referenceY = referenceY.data();
+    kernel.last = static_cast<double>(referenceX.size() - 1);
+    kernel.bailout2 = BAILOUT2;
+    kernel.maxIterations = maxIterations;
+    kernel.pixelSize = pixelSize;
+    kernel.inverseRadius = 1.0 / radius;
+    kernel.rebase = settings.rebase;
+
+    // The series d = A u + B u^2 + C u^3 in u = dc / r, stepped with the reference:
+    // A' = 2ZA + r, B' = 2ZB + A^2, C' = 2ZC + 2AB. It stands in for the iterations while
+    // it matches every probe pixel iterated exactly to within the tolerance in plane
+    // position, |A| / r being how far d moves per unit of dc, and no probe escaped or
+    // needed a rebase.
+    const double seriesStart = FrameStats::NowSeconds();
+    Complex series[3] = {}, valid[3] = {};
+    size_t skipped = 0;
+    if (settings.series) {
+        Complex probeC[SERIES_PROBES * SERIES_PROBES], probeD[SERIES_PROBES * SERIES_PROBES] = {};
+        for (int j = 0; j < SERIES_PROBES; ++j) {
+            for (int i = 0; i < SERIES_PROBES; ++i) {
+                double px = static_cast<double>(i) * (width - 1) / (SERIES_PROBES - 1);
+                double py = static_cast<double>(j) * (height - 1) / (SERIES_PROBES - 1);
+                probeC[j * SERIES_PROBES + i] = { x0 + px * pixelSize, y0 - py * pixelSize };
+            }
+        }
+
+        const size_t limit = std::min(referenceX.size() - 1, static_cast<size_t>(maxIterations));
+        for (size_t n = 0; n + 1 < limit; ++n) {
+            const Complex z2 = 2.0 * Complex{ referenceX[n], referenceY[n] };
+            const Complex next{ referenceX[n + 1], referenceY[n + 1] };
+            Complex a = z2 * series[0] + Complex{ radius, 0.0 };
+            Complex b = z2 * series[1] + series[0] * series[0];
+            Complex c = z2 * series[2] + 2.0 * (series[0] * series[1]);
+            series[0] = a;
+            series[1] = b;
+            series[2] = c;
+
+            const double tolerance = settings.seriesTolerance * pixelSize * std::sqrt(Norm(a)) / radius;
+            bool ok = true;
+            for (int p = 0; p < SERIES_PROBES * SERIES_PROBES && ok; ++p) {
+                Complex& d = probeD[p];
+                d = (z2 + d) * d + probeC[p];
+                Complex z = next + d;
+                Complex u = kernel.inverseRadius * probeC[p];
+                Complex estimate = a * u + b * (u * u) + c * (u * u * u);
+                ok = Norm(z) <= BAILOUT2 && Norm(z) >= Norm(d) && Norm(estimate - d) <= tolerance * tolerance;
+            }
+            if (!ok) {
+                break;
+            }
+            std::copy(series, series + 3, valid);
+            skipped = n + 1;
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        kernel.seriesX[k] = valid[k].x;
+        kernel.seriesY[k] = valid[k].y;
+    }
+    kernel.skipped = static_cast<double>(skipped);
+    stats.seriesSeconds = FrameStats::NowSeconds() - seriesStart;
+
+    const RowKernel row = SelectKernel(settings.maxSimdLevel);
+    const float colorScale = settings.colorScale;
+    std::atomic<uint64_t> iterations(0), rebases(0);
+    auto renderRows = [&](size_t begin, size_t end) {
+        RowScratch& scratch = GetRowScratch();
+        scratch.iterations.resize(width);
+        scratch.radii.resize(width);
+        uint64_t rowIterations = 0, rowRebases = 0;
+        for (size_t y = begin; y < end; ++y) {
+            double dcy = y0 - static_cast<double>(y) * pixelSize;
+            rowIterations += row(kernel, dcy, x0, width, scratch.iterations.data(), scratch.radii.data(), &rowRebases);
+
+            // n + 1 - log2(log2 |z|), as the escape-time backdrop colors
+            for (size_t x = 0; x < width; ++x) {
+                double r2 = scratch.radii[x];
+                float value = r2 > BAILOUT2 ?
+                    static_cast<float>(scratch.iterations[x] + 1.0 - std::log2(0.5 * std::log2(r2))) : -1.0f;
+                values[y * width + x] = value;
+                pixels[y * width + x] = EscapeTimeRenderer::GetColor(value, colorScale, 0.0f);
+            }
+        }
+        iterations += rowIterations;
+        rebases += rowRebases;
+    };
+
+    ParallelForEach(height, jobs, settings.threadCount, [&renderRows](size_t y) {
+        renderRows(y, y + 1);
+    });
+
+    stats.referenceLength = referenceX.size();
+    stats.precisionBits = 32 * referenceLimbs;
+    stats.skipped = skipped;
+    stats.iterations = iterations;
+    stats.rebases = rebases;
+    stats.maxIterations = maxIterations;
+    stats.seconds = FrameStats::NowSeconds() - start;
+}
+
+size_t DeepZoomRenderer::GetLaneCount(SimdLevel level) {
+    switch (ResolveSimdLevel(level)) {
+    case SimdLevel::AVX512: return 8;
+    case SimdLevel::AVX2: return 4;
+    case SimdLevel::SSE2:
+    case SimdLevel::AVX: return 2;
+    default: return 1;
+    }
+}
+
+double DeepZoomRenderer::Zoom(double viewHeight, const BandEnergies& bands, double seconds,
+    const DeepZoomModulation& modulation) {
+    double rate = modulation.baseRate + modulation.levelRate * bands.GetMeanLevel(0.0, 1.0);
+    viewHeight *= std::pow(10.0, -rate * seconds);
+    return viewHeight < modulation.endHeight ? modulation.startHeight : viewHeight;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Filterbank.h"
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+struct DeepZoomSettings {
+    size_t width;               // Of the image, in pixels
+    size_t height;
+    int baseIterations;         // Iteration limit at a view height of 1
+    int iterationsPerDecade;    // Added for each factor of 10 zoomed in past that
+    double seriesTolerance;     // Series error allowed, in pixels of plane position
+    bool series;                // Skip the first iterations with a series approximation
+    bool rebase;                // Move pixels back to the start of the reference when they
+                                // get closer to 0 than to it; off shows the glitches
+    float colorScale;           // Palette cycles per iteration
+    unsigned threadCount;       // Without a job system, 0 = one per hardware thread
+    SimdLevel maxSimdLevel;
+
+    DeepZoomSettings() :
+        width(1280),
+        height(720),
+        baseIterations(1000),
+        iterationsPerDecade(200),
+        seriesTolerance(1e-3),
+        series(true),
+        rebase(true),
+        colorScale(0.02f),
+        threadCount(0),
+        maxSimdLevel(SimdLevel::AVX512)
+    {}
+};
+
+// How the music drives the zoom: the view shrinks by a number of decades per second that
+// grows with the mean level of all bands, and starts over past the deepest view
+struct DeepZoomModulation {
+    double baseRate;        // Decades per second in silence
+    double levelRate;       // Added at full level
+    double startHeight;     // View height zoomed out to after the deepest
+    double endHeight;       // Deepest view height
+
+    DeepZoomModulation() :
+        baseRate(0.05),
+        levelRate(1.0),
+        startHeight(3.0),
+        endHeight(1e-100)
+    {}
+};
+
+// What the last Render did
+struct DeepZoomStats {
+    size_t referenceLength;     // Iterations in the reference orbit
+    size_t precisionBits;       // Of its fraction
+    double referenceSeconds;    // Computing it; 0 when the last one was still good
+    size_t skipped;             // Iterations every pixel skipped by the series
+    double seriesSeconds;
+    uint64_t iterations;        // Summed over the pixels, less the skipped ones
+    uint64_t rebases;
+    int maxIterations;
+    double seconds;             // Wall time of the whole Render
+
+    DeepZoomStats() :
+        referenceLength(0), precisionBits(0), referenceSeconds(0.0), skipped(0), seriesSeconds(0.0), iterations(0),
+        rebases(0), maxIterations(0), seconds(0.0)
+    {}
+};
+
+// Renders the Mandelbrot set past where double precision runs out, around a view height
+// of 1e-13. One point, the view's center, is iterated in fixed point with as many bits as
+// the zoom needs; every pixel then iterates only its difference from that reference orbit,
+// which stays small enough for doubles, 1, 2, 4 or 8 pixels at a time (scalar, SSE2,
+// AVX2, AVX-512). A series in the pixel's offset stands in for the first iterations the
+// whole view agrees on, checked against probe pixels iterated exactly. A pixel whose orbit
+// comes closer to 0 than to the reference's loses its precision relative to it, so it
+// restarts from the beginning of the reference at its own position, which also lets it
+// run past the reference's end.
+//
+// Doubles hold the differences down to a view height of MIN_HEIGHT; deeper would take a
+// wider exponent.
+class DeepZoomRenderer {
+public:
+    // Shallowest and deepest view heights Render accepts
+    static const double MAX_HEIGHT;
+    static const double MIN_HEIGHT;
+
+    // Largest image edge Initialize accepts
+    static const size_t MAX_SIZE = 16384;
+
+private:
+    DeepZoomSettings settings;
+    std::vector<uint32_t> pixels;
+    std::vector<float> values;          // Smoothed escape counts, -1 inside
+
+    std::string centerX;                // Decimal, as given
+    std::string centerY;
+    std::vector<double> referenceX;     // The center's orbit, from z = 0
+    std::vector<double> referenceY;
+    size_t referenceLimbs;              // Fraction limbs it was computed with; 0 for none
+    int referenceIterations;            // Iteration limit it was computed to
+    bool referenceEscaped;
+
+    DeepZoomStats stats;
+
+    // Iterate the center to maxIterations with enough bits for this view height, unless
+    // the last reference already was
+    void UpdateReference(double viewHeight, int maxIterations);
+
+public:
+    DeepZoomRenderer();
+
+    // False if the width or height is 0 or over MAX_SIZE
+    bool Initialize(const DeepZoomSettings& settings);
+    bool Resize(size_t width, size_t height);
+
+    // Center of the view as decimal numbers, with as many digits as the zoom needs;
+    // false, and no change, if either doesn't parse. Starts at c = i, where the set
+    // looks alike at every depth.
+    bool SetCenter(const std::string& x, const std::string& y);
+
+    // Render the view of this height around the center, clamped to MIN_HEIGHT and
+    // MAX_HEIGHT. With a job system the rows are jobs on its threads.
+    void Render(double viewHeight, JobSystem* jobs = nullptr);
+
+    void SetSeries(bool enable) { settings.series = enable; }
+    void SetRebase(bool enable) { settings.rebase = enable; }
+
+    const uint32_t* GetPixels() const { return pixels.data(); }
+    const float* GetValues() const { return values.data(); }
+    size_t GetWidth() const { return settings.width; }
+    size_t GetHeight() const { return settings.height; }
+    size_t GetPitch() const { return settings.width * sizeof(uint32_t); }
+    const DeepZoomStats& GetStats() const { return stats; }
+    const DeepZoomSettings& GetSettings() const { return settings; }
+
+    // Iteration limit at a view height
+    int GetMaxIterations(double viewHeight) const;
+
+    // Pixels per kernel call at a level (after clamping it to the machine)
+    static size_t GetLaneCount(SimdLevel level);
+
+    // View height after this many seconds of zooming at the band levels
+    static double Zoom(double viewHeight, const BandEnergies& bands, double seconds,
+        const DeepZoomModulation& modulation = DeepZoomModulation());
+};
@@ -0,0 +1,107 @@
+// Perturbation kernels, written once over the double lanes of SimdLanes.h that the
+// including namespace uses. DeepZoom.cpp includes this once per instruction set, inside
+// that set's target region. Nothing here may include headers or call library math.
+
+// Iterate count pixels along a row, from pixel offset (x0, y) from the reference every
+// pixelSize, by their differences from the reference orbit: with the reference at Z and
+// the pixel at Z + d, d' = (2Z + d) d + dc. Each starts params.skipped iterations in, at
+// the series' d. Writes each pixel's iteration count and final |z|^2, and returns the
+// iterations run; rebases are added to the count given.
+inline uint64_t PerturbRow(const KernelParams& params, double y, double x0, size_t count, double* iterations,
+    double* radii, uint64_t* rebases) {
+    const Vec zero = Set(0.0);
+    const Vec one = Set(1.0);
+    const Vec bailout2 = Set(params.bailout2);
+    const Vec limit = Set(params.maxIterations);
+    const Vec last = Set(params.last);
+    const Vec skipped = Set(params.skipped);
+    const Vec offsets = Mul(Ramp(), Set(params.pixelSize));
+    const Vec dcy = Set(y);
+
+    uint64_t total = 0;
+    double counts[LANES];
+    double rebased[LANES];
+    double tail[LANES];
+    for (size_t i = 0; i < count; i += LANES) {
+        Vec dcx = Add(Set(x0 + params.pixelSize * static_cast<double>(i)), offsets);
+
+        // The series at u = dc / r: d = A u + B u^2 + C u^3
+        Vec ux = Mul(dcx, Set(params.inverseRadius));
+        Vec uy = Mul(dcy, Set(params.inverseRadius));
+        Vec u2x = Sub(Mul(ux, ux), Mul(uy, uy));
+        Vec u2y = Mul(Add(ux, ux), uy);
+        Vec u3x = Sub(Mul(u2x, ux), Mul(u2y, uy));
+        Vec u3y = MulAdd(u2x, uy, Mul(u2y, ux));
+        Vec dx = Sub(Mul(Set(params.seriesX[0]), ux), Mul(Set(params.seriesY[0]), uy));
+        Vec dy = MulAdd(Set(params.seriesX[0]), uy, Mul(Set(params.seriesY[0]), ux));
+        dx = Add(dx, Sub(Mul(Set(params.seriesX[1]), u2x), Mul(Set(params.seriesY[1]), u2y)));
+        dy = Add(dy, MulAdd(Set(params.seriesX[1]), u2y, Mul(Set(params.seriesY[1]), u2x)));
+        dx = Add(dx, Sub(Mul(Set(params.seriesX[2]), u3x), Mul(Set(params.seriesY[2]), u3y)));
+        dy = Add(dy, MulAdd(Set(params.seriesX[2]), u3y, Mul(Set(params.seriesY[2]), u3x)));
+
+        // m indexes the reference and n counts iterations; they part at a rebase.
+        // Finished lanes keep their state while the rest iterate.
+        Vec m = skipped;
+        Vec n = skipped;
+        Vec rebaseCount = zero;
+        Vec r2 = zero;
+        Mask active = Less(zero, one);
+        for (;;) {
+            Vec zx = Gather(params.referenceX, m);
+            Vec zy = Gather(params.referenceY, m);
+            Vec x = Add(zx, dx);
+            Vec yy = Add(zy, dy);
+            r2 = MulAdd(x, x, Mul(yy, yy));
+            active = And(active, And(Less(r2, bailout2), Less(n, limit)));
+            if (!Any(active)) {
+                break;
+            }
+
+            // Closer to 0 than to the reference, or at its end: carry on from its start,
+            // where Z = 0 and d is the whole z
+            Mask rebase = Equal(m, last);
+            if (params.rebase) {
+                rebase = Or(rebase, Less(r2, MulAdd(dx, dx, Mul(dy, dy))));
+            }
+            rebase = And(active, rebase);
+            dx = Select(rebase, x, dx);
+            dy = Select(rebase, yy, dy);
+            zx = Select(rebase, zero, zx);
+            zy = Select(rebase, zero, zy);
+            m = Select(rebase, zero, m);
+            rebaseCount = Add(rebaseCount, Select(rebase, one, zero));
+
+            Vec tx = Add(Add(zx, zx), dx);
+            Vec ty = Add(Add(zy, zy), dy);
+            Vec nextX = Add(Sub(Mul(tx, dx), Mul(ty, dy)), dcx);
+            Vec nextY = Add(MulAdd(tx, dy, Mul(ty, dx)), dcy);
+            dx = Select(active, nextX, dx);
+            dy = Select(active, nextY, dy);
+            Vec step = Select(active, one, zero);
+            m = Add(m, step);
+            n = Add(n, step);
+        }
+
+        size_t valid = count - i < LANES ? count - i : LANES;
+        Store(counts, n);
+        Store(rebased, rebaseCount);
+        for (size_t lane = 0; lane < valid; ++lane) {
+            total += static_cast<uint64_t>(counts[lane] - params.skipped);
+            *rebases += static_cast<uint64_t>(rebased[lane]);
+        }
+        if (valid == LANES) {
+            Store(iterations + i, n);
+            Store(radii + i, r2);
+        }
+        else {
+            for (size_t lane = 0; lane < valid; ++lane) {
+                iterations[i + lane] = counts[lane];
+            }
+            Store(tail, r2);
+            for (size_t lane = 0; lane < valid; ++lane) {
+                radii[i + lane] = tail[lane];
+            }
+        }
+    }
+    return total;
+}
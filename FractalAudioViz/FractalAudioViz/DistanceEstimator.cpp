@@ -0,0 +1,244 @@
+#include "DistanceEstimator.h"
+#include "SimdLanes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    // Kernels unrolled for these; anything else runs the general loop
+    const int SPECIALIZED_POWERS[] = { 2, 3, 4, 8 };
+    const int SPECIALIZED_ITERATIONS[] = { 8, 12, 16 };
+
+    // DistanceParams as the kernels use them, derived once per Evaluate
+    struct KernelParams {
+        DistanceFractal type;
+        int iterations;
+        int specializedPower;       // 0 for the general Mandelbulb kernel
+        int specializedIterations;  // 0 for a loop over iterations
+        float power;
+        float bailout2;
+        float foldLimit;
+        float minRadius2;
+        float fixedRadius2;
+        float scale;
+        float absScale;
+        float ifsOffset[3];         // x and y times (scale - 1), then half the z fold
+        float rotation[9];          // Row-major
+        bool rotate;
+        float inverseScalePower;    // scale^-iterations
+    };
+
+    // Row-major rotation about z by a, then about x by b
+    void RotationMatrix(double a, double b, double* m) {
+        double ca = std::cos(a), sa = std::sin(a), cb = std::cos(b), sb = std::sin(b);
+        const double rotation[9] = { ca, -sa, 0.0, cb * sa, cb * ca, -sb, sb * sa, sb * ca, cb };
+        std::copy(rotation, rotation + 9, m);
+    }
+
+    bool IsSpecializedIterations(int iterations) {
+        return std::find(std::begin(SPECIALIZED_ITERATIONS), std::end(SPECIALIZED_ITERATIONS), iterations) !=
+            std::end(SPECIALIZED_ITERATIONS);
+    }
+
+    int GetSpecializedPower(float power) {
+        for (int candidate : SPECIALIZED_POWERS) {
+            if (power == static_cast<float>(candidate)) return candidate;
+        }
+        return 0;
+    }
+
+    KernelParams MakeKernelParams(const DistanceParams& params) {
+        KernelParams kernel;
+        kernel.type = params.type;
+        kernel.iterations = std::max(params.iterations, 0);
+        kernel.specializedPower = params.specialize ? GetSpecializedPower(params.power) : 0;
+        kernel.specializedIterations = params.specialize && IsSpecializedIterations(kernel.iterations) ?
+            kernel.iterations : 0;
+        kernel.power = params.power;
+        kernel.bailout2 = params.bailout * params.bailout;
+        kernel.foldLimit = params.foldLimit;
+        kernel.minRadius2 = params.minRadius * params.minRadius;
+        kernel.fixedRadius2 = params.fixedRadius * params.fixedRadius;
+        kernel.scale = params.scale;
+        kernel.absScale = std::fabs(params.scale);
+        kernel.ifsOffset[0] = params.offset[0] * (params.scale - 1.0f);
+        kernel.ifsOffset[1] = params.offset[1] * (params.scale - 1.0f);
+        kernel.ifsOffset[2] = 0.5f * params.offset[2] * (params.scale - 1.0f);
+
+        double rotation[9];
+        RotationMatrix(params.rotation[0], params.rotation[1], rotation);
+        for (int i = 0; i < 9; ++i) kernel.rotation[i] = static_cast<float>(rotation[i]);
+        kernel.rotate = params.rotation[0] != 0.0f || params.rotation[1] != 0.0f;
+        kernel.inverseScalePower = static_cast<float>(std::pow(static_cast<double>(params.scale), -kernel.iterations));
+        return kernel;
+    }
+
+    namespace ScalarKernels {
+        using namespace SimdLanes::Scalar;
+#include "SimdMath.inl"
+#include "DistanceKernels.inl"
+    }
+
+#if FAV_X86
+    namespace SseKernels {
+        using namespace SimdLanes::Sse;
+#include "SimdMath.inl"
+#include "DistanceKernels.inl"
+    }
+
+FAV_BEGIN_TARGET_AVX2
+    namespace Avx2Kernels {
+        using namespace SimdLanes::Avx2;
+#include "SimdMath.inl"
+#include "DistanceKernels.inl"
+    }
+FAV_END_TARGET
+
+// GCC reports the self-initialized _mm512_undefined_ps inside the unmasked intrinsics as
+// uninitialized once they are inlined into these kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+FAV_BEGIN_TARGET_AVX512
+    namespace Avx512Kernels {
+        using namespace SimdLanes::Avx512;
+#include "SimdMath.inl"
+#include "DistanceKernels.inl"
+    }
+FAV_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+}
+
+void DistanceEstimator::Evaluate(const DistanceParams& params, const float* x, const float* y, const float* z,
+    size_t count, float* distance, SimdLevel maxSimdLevel) {
+    if (count == 0) {
+        return;
+    }
+    const KernelParams kernel = MakeKernelParams(params);
+
+    // AVX without AVX2 has no 256-bit integer operations for the exponent handling, so
+    // it runs the SSE2 kernels
+    SimdLevel level = ResolveSimdLevel(maxSimdLevel);
+#if FAV_X86
+    if (level >= SimdLevel::AVX512) {
+        Avx512Kernels::Evaluate(kernel, x, y, z, count, distance);
+        return;
+    }
+    if (level >= SimdLevel::AVX2) {
+        Avx2Kernels::Evaluate(kernel, x, y, z, count, distance);
+        return;
+    }
+    if (level >= SimdLevel::SSE2) {
+        SseKernels::Evaluate(kernel, x, y, z, count, distance);
+        return;
+    }
+#endif
+    ScalarKernels::Evaluate(kernel, x, y, z, count, distance);
+}
+
+double DistanceEstimator::EvaluateReference(const DistanceParams& params, double x, double y, double z) {
+    const double cx = x, cy = y, cz = z;
+    const int iterations = std::max(params.iterations, 0);
+
+    if (params.type == DistanceFractal::Mandelbox) {
+        const double limit = params.foldLimit, scale = params.scale;
+        const double minRadius2 = static_cast<double>(params.minRadius) * params.minRadius;
+        const double fixedRadius2 = static_cast<double>(params.fixedRadius) * params.fixedRadius;
+        double dr = 1.0;
+        for (int i = 0; i < iterations; ++i) {
+            x = std::min(std::max(x, -limit), limit) * 2.0 - x;
+            y = std::min(std::max(y, -limit), limit) * 2.0 - y;
+            z = std::min(std::max(z, -limit), limit) * 2.0 - z;
+            double r2 = x * x + y * y + z * z;
+            double factor = 1.0;
+            if (r2 < minRadius2) factor = fixedRadius2 / minRadius2;
+            else if (r2 < fixedRadius2) factor = fixedRadius2 / r2;
+            x = x * factor * scale + cx;
+            y = y * factor * scale + cy;
+            z = z * factor * scale + cz;
+            dr = dr * factor * std::fabs(scale) + 1.0;
+        }
+        return std::sqrt(x * x + y * y + z * z) / dr;
+    }
+
+    if (params.type == DistanceFractal::KaleidoscopicIFS) {
+        const double scale = params.scale;
+        const double offsetX = params.offset[0] * (scale - 1.0), offsetY = params.offset[1] * (scale - 1.0);
+        const double foldZ = 0.5 * params.offset[2] * (scale - 1.0);
+        double m[9];
+        RotationMatrix(params.rotation[0], params.rotation[1], m);
+        for (int i = 0; i < iterations; ++i) {
+            x = std::fabs(x);
+            y = std::fabs(y);
+            z = std::fabs(z);
+            if (x < y) std::swap(x, y);
+            if (x < z) std::swap(x, z);
+            if (y < z) std::swap(y, z);
+            double rx = m[0] * x + m[1] * y + m[2] * z;
+            double ry = m[3] * x + m[4] * y + m[5] * z;
+            double rz = m[6] * x + m[7] * y + m[8] * z;
+            x = rx * scale - offsetX;
+            y = ry * scale - offsetY;
+            z = foldZ - std::fabs(rz * scale - foldZ);
+        }
+        double box = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+        return (box - 1.0) * std::pow(scale, -iterations);
+    }
+
+    const double power = params.power;
+    const double bailout2 = static_cast<double>(params.bailout) * params.bailout;
+    double dr = 1.0;
+    double r2 = x * x + y * y + z * z;
+    for (int i = 0; i < iterations && r2 < bailout2; ++i) {
+        double r = std::sqrt(r2);
+        double theta = std::atan2(std::sqrt(x * x + z * z), y) * power;
+        double phi = std::atan2(x, z) * power;
+        double rPowerLess1 = std::pow(r, power - 1.0);
+        double rPower = rPowerLess1 * r;
+        x = rPower * std::sin(theta) * std::sin(phi) + cx;
+        y = rPower * std::cos(theta) + cy;
+        z = rPower * std::sin(theta) * std::cos(phi) + cz;
+        dr = power * rPowerLess1 * dr + 1.0;
+        r2 = x * x + y * y + z * z;
+    }
+    double r = std::sqrt(r2);
+    return 0.5 * std::log(r) * r / dr;
+}
+
+bool DistanceEstimator::IsSpecialized(const DistanceParams& params) {
+    KernelParams kernel = MakeKernelParams(params);
+    return kernel.specializedIterations != 0 &&
+        (params.type != DistanceFractal::Mandelbulb || kernel.specializedPower != 0);
+}
+
+size_t DistanceEstimator::GetLaneCount(SimdLevel level) {
+    switch (ResolveSimdLevel(level)) {
+    case SimdLevel::AVX512: return 16;
+    case SimdLevel::AVX2: return 8;
+    case SimdLevel::SSE2:
+    case SimdLevel::AVX: return 4;
+    default: return 1;
+    }
+}
+
+DistanceParams DistanceEstimator::Modulate(const DistanceParams& base, const BandEnergies& bands,
+    const DistanceModulation& modulation) {
+    const float bass = bands.GetMeanLevel(0.0, 0.125);
+    const float mids = bands.GetMeanLevel(0.125, 0.5);
+    const float treble = bands.GetMeanLevel(0.5, 1.0);
+
+    DistanceParams params = base;
+    params.power += modulation.powerDepth * bass;
+    params.scale += (params.scale < 0.0f ? -modulation.scaleDepth : modulation.scaleDepth) * bass;
+    params.foldLimit += modulation.foldDepth * mids;
+    for (float& angle : params.rotation) angle += modulation.rotationDepth * mids;
+    for (float& offset : params.offset) offset += modulation.offsetDepth * treble;
+    return params;
+}
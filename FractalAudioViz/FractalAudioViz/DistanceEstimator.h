@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Filterbank.h"
+#include "SimdSupport.h"
+#include <cstddef>
+
+enum class DistanceFractal {
+    Mandelbulb,       // Spherical-coordinate power of the point, plus c
+    Mandelbox,        // Box fold, sphere fold, scale, plus c
+    KaleidoscopicIFS  // Octahedral fold and sort, rotation, scale about an offset (Menger at rest)
+};
+
+struct DistanceParams {
+    DistanceFractal type;
+    int iterations;
+    bool specialize;      // Use a fixed-power, fixed-iteration kernel when one matches
+    float power;          // Mandelbulb exponent
+    float bailout;        // Mandelbulb escape radius
+    float scale;          // Mandelbox (negative folds inward) and IFS
+    float minRadius;      // Mandelbox sphere fold: points inside are scaled by (fixed / min)^2
+    float fixedRadius;    // ... and points between the radii are inverted in this sphere
+    float foldLimit;      // Mandelbox box fold half size
+    float offset[3];      // IFS fold center, in units of the attractor's half size
+    float rotation[2];    // IFS, radians about z then x, applied each iteration
+
+    explicit DistanceParams(DistanceFractal fractal = DistanceFractal::Mandelbulb) :
+        type(fractal),
+        iterations(12),
+        specialize(true),
+        power(8.0f),
+        bailout(4.0f),
+        scale(fractal == DistanceFractal::KaleidoscopicIFS ? 3.0f : 2.0f),
+        minRadius(0.5f),
+        fixedRadius(1.0f),
+        foldLimit(1.0f),
+        offset{ 1.0f, 1.0f, 1.0f },
+        rotation{ 0.0f, 0.0f }
+    {}
+};
+
+// How far each parameter moves at full band level: the bass is the lowest eighth of the
+// bands (as for the cube's pulse), the mids up to half, the treble the rest
+struct DistanceModulation {
+    float powerDepth;     // Added to the Mandelbulb power by the bass
+    float scaleDepth;     // Added to the Mandelbox and IFS scale (away from zero) by the bass
+    float foldDepth;      // Added to the Mandelbox fold limit by the mids
+    float rotationDepth;  // Added to both IFS rotations by the mids
+    float offsetDepth;    // Added to the IFS offset by the treble
+
+    DistanceModulation() :
+        powerDepth(2.0f),
+        scaleDepth(0.25f),
+        foldDepth(0.2f),
+        rotationDepth(0.3f),
+        offsetDepth(0.15f)
+    {}
+};
+
+// Distance estimators for 3D fractals, for ray marching and surface extraction. Points go
+// in as separate x, y, z arrays and are evaluated 1, 4, 8 or 16 at a time (scalar, SSE2,
+// AVX2, AVX-512); every level runs the same operations in the same order, and AVX2 and
+// AVX-512 fuse the multiply-adds, so they round slightly differently. The transcendental
+// functions are polynomial approximations shared by all levels. Integer Mandelbulb powers
+// 2, 3, 4 and 8 use complex powers instead of trigonometry, and 8, 12 or 16 iterations get
+// unrolled kernels.
+class DistanceEstimator {
+public:
+    // Distances may be negative inside the Mandelbulb and the IFS. The output may not
+    // overlap the inputs.
+    static void Evaluate(const DistanceParams& params, const float* x, const float* y, const float* z, size_t count,
+        float* distance, SimdLevel maxSimdLevel = SimdLevel::AVX512);
+
+    // The same estimate in double precision with the standard library's functions, the
+    // reference the kernels are checked against
+    static double EvaluateReference(const DistanceParams& params, double x, double y, double z);
+
+    // True if Evaluate uses a specialized kernel for these parameters
+    static bool IsSpecialized(const DistanceParams& params);
+
+    // Points per kernel call at a level (after clamping it to the machine)
+    static size_t GetLaneCount(SimdLevel level);
+
+    // Parameters for this frame from the base ones and the band levels
+    static DistanceParams Modulate(const DistanceParams& base, const BandEnergies& bands,
+        const DistanceModulation& modulation = DistanceModulation());
+};
@@ -0,0 +1,262 @@
+// Distance estimator kernels, written once over the lanes of SimdLanes.h that the
+// including namespace uses, after SimdMath.inl. DistanceEstimator.cpp includes this once
+// per instruction set, inside that set's target region, so each level runs this same
+// sequence of operations; only MulAdd rounds differently, fused on the FMA levels. Nothing
+// here may include headers or call library math.
+
+// v^N by squaring
+template <int N>
+inline Vec IntegerPower(Vec v) {
+    Vec half = IntegerPower<N / 2>(v);
+    return N % 2 ? Mul(Mul(half, half), v) : Mul(half, half);
+}
+
+template <>
+inline Vec IntegerPower<1>(Vec v) {
+    return v;
+}
+
+template <>
+inline Vec IntegerPower<0>(Vec) {
+    return Set(1.0f);
+}
+
+// (re + i im)^N by squaring
+template <int N>
+inline void ComplexPower(Vec& re, Vec& im) {
+    Vec baseRe = re, baseIm = im;
+    ComplexPower<N / 2>(re, im);
+    Vec squaredRe = Sub(Mul(re, re), Mul(im, im));
+    Vec squaredIm = Mul(Mul(re, im), Set(2.0f));
+    if (N % 2) {
+        re = Sub(Mul(squaredRe, baseRe), Mul(squaredIm, baseIm));
+        im = Add(Mul(squaredRe, baseIm), Mul(squaredIm, baseRe));
+    }
+    else {
+        re = squaredRe;
+        im = squaredIm;
+    }
+}
+
+template <>
+inline void ComplexPower<1>(Vec&, Vec&) {}
+
+template <>
+inline void ComplexPower<0>(Vec& re, Vec& im) {
+    re = Set(1.0f);
+    im = Set(0.0f);
+}
+
+// Mandelbulb with theta = atan2(rho, y) and phi = atan2(x, z), rho = |(x, z)|. A fixed
+// integer Power raises e^(i theta) and e^(i phi) as unit complex numbers (y + i rho) / r
+// and (z + i x) / rho; Power 0 takes params.power through Atan2, Exp, Log and SinCos.
+// Lanes past the bailout keep their values while the others iterate.
+template <int Power, int Iterations>
+void Mandelbulb(const KernelParams& params, const float* px, const float* py, const float* pz, float* out) {
+    const int iterations = Iterations > 0 ? Iterations : params.iterations;
+    const Vec cx = Load(px), cy = Load(py), cz = Load(pz);
+    const Vec bailout2 = Set(params.bailout2);
+    const Vec tiny = Set(1e-30f);
+
+    Vec x = cx, y = cy, z = cz;
+    Vec dr = Set(1.0f);
+    Vec r2 = Add(Add(Mul(x, x), Mul(y, y)), Mul(z, z));
+    for (int i = 0; i < iterations; ++i) {
+        Mask active = Less(r2, bailout2);
+        if (!Any(active)) break;
+
+        Vec r = Sqrt(r2);
+        Vec rho = Sqrt(Add(Mul(x, x), Mul(z, z)));
+        Vec sinTheta, cosTheta, sinPhi, cosPhi, rPower, rPowerLess1, power;
+        if (Power > 0) {
+            cosTheta = Div(y, Max(r, tiny));
+            sinTheta = Div(rho, Max(r, tiny));
+            cosPhi = Div(z, Max(rho, tiny));
+            sinPhi = Div(x, Max(rho, tiny));
+            ComplexPower<Power>(cosTheta, sinTheta);
+            ComplexPower<Power>(cosPhi, sinPhi);
+            rPowerLess1 = IntegerPower<Power - 1>(r);
+            power = Set(static_cast<float>(Power));
+        }
+        else {
+            power = Set(params.power);
+            SinCos(Mul(Atan2(rho, y), power), sinTheta, cosTheta);
+            SinCos(Mul(Atan2(x, z), power), sinPhi, cosPhi);
+            rPowerLess1 = Exp(Mul(Sub(power, Set(1.0f)), Log(r)));
+        }
+        rPower = Mul(rPowerLess1, r);
+
+        Vec sinThetaR = Mul(sinTheta, rPower);
+        Vec nx = Add(Mul(sinThetaR, sinPhi), cx);
+        Vec ny = Add(Mul(cosTheta, rPower), cy);
+        Vec nz = Add(Mul(sinThetaR, cosPhi), cz);
+        Vec ndr = Add(Mul(Mul(rPowerLess1, power), dr), Set(1.0f));
+
+        x = Select(active, nx, x);
+        y = Select(active, ny, y);
+        z = Select(active, nz, z);
+        dr = Select(active, ndr, dr);
+        r2 = Select(active, Add(Add(Mul(nx, nx), Mul(ny, ny)), Mul(nz, nz)), r2);
+    }
+
+    Vec r = Sqrt(r2);
+    Store(out, Div(Mul(Mul(Log(r), r), Set(0.5f)), dr));
+}
+
+// Mandelbox: fold into the box, fold through the spheres, scale and add c. The sphere
+// fold factor is fixed^2 / max(r^2, min^2), at least 1, which covers all three cases.
+template <int Iterations>
+void Mandelbox(const KernelParams& params, const float* px, const float* py, const float* pz, float* out) {
+    const int iterations = Iterations > 0 ? Iterations : params.iterations;
+    const Vec cx = Load(px), cy = Load(py), cz = Load(pz);
+    const Vec limit = Set(params.foldLimit), negativeLimit = Set(-params.foldLimit);
+    const Vec minRadius2 = Set(params.minRadius2), fixedRadius2 = Set(params.fixedRadius2);
+    const Vec scale = Set(params.scale), absScale = Set(params.absScale);
+    const Vec one = Set(1.0f), two = Set(2.0f);
+
+    Vec x = cx, y = cy, z = cz;
+    Vec dr = one;
+    Vec r2 = Set(0.0f);
+    for (int i = 0; i < iterations; ++i) {
+        x = Sub(Mul(Min(Max(x, negativeLimit), limit), two), x);
+        y = Sub(Mul(Min(Max(y, negativeLimit), limit), two), y);
+        z = Sub(Mul(Min(Max(z, negativeLimit), limit), two), z);
+
+        r2 = Add(Add(Mul(x, x), Mul(y, y)), Mul(z, z));
+        Vec factor = Max(Div(fixedRadius2, Max(r2, minRadius2)), one);
+        x = Add(Mul(Mul(x, factor), scale), cx);
+        y = Add(Mul(Mul(y, factor), scale), cy);
+        z = Add(Mul(Mul(z, factor), scale), cz);
+        dr = Add(Mul(Mul(dr, factor), absScale), one);
+    }
+
+    r2 = Add(Add(Mul(x, x), Mul(y, y)), Mul(z, z));
+    Store(out, Div(Sqrt(r2), dr));
+}
+
+// Kaleidoscopic IFS: fold into the octant, sort to x >= y >= z, rotate, scale about the
+// offset and fold z back below it. The final point's box distance shrinks by the scale
+// per iteration.
+template <int Iterations>
+void KaleidoscopicIfs(const KernelParams& params, const float* px, const float* py, const float* pz, float* out) {
+    const int iterations = Iterations > 0 ? Iterations : params.iterations;
+    const Vec scale = Set(params.scale);
+    const Vec offsetX = Set(params.ifsOffset[0]), offsetY = Set(params.ifsOffset[1]);
+    const Vec foldZ = Set(params.ifsOffset[2]);
+    const float* m = params.rotation;
+
+    Vec x = Load(px), y = Load(py), z = Load(pz);
+    for (int i = 0; i < iterations; ++i) {
+        x = Abs(x);
+        y = Abs(y);
+        z = Abs(z);
+        Vec high = Max(x, y), low = Min(x, y);
+        x = high;
+        y = low;
+        high = Max(x, z);
+        low = Min(x, z);
+        x = high;
+        z = low;
+        high = Max(y, z);
+        low = Min(y, z);
+        y = high;
+        z = low;
+
+        if (params.rotate) {
+            Vec rx = Add(Add(Mul(x, Set(m[0])), Mul(y, Set(m[1]))), Mul(z, Set(m[2])));
+            Vec ry = Add(Add(Mul(x, Set(m[3])), Mul(y, Set(m[4]))), Mul(z, Set(m[5])));
+            Vec rz = Add(Add(Mul(x, Set(m[6])), Mul(y, Set(m[7]))), Mul(z, Set(m[8])));
+            x = rx;
+            y = ry;
+            z = rz;
+        }
+
+        x = Sub(Mul(x, scale), offsetX);
+        y = Sub(Mul(y, scale), offsetY);
+        z = Sub(foldZ, Abs(Sub(Mul(z, scale), foldZ)));
+    }
+
+    Vec box = Max(Max(Abs(x), Abs(y)), Abs(z));
+    Store(out, Mul(Sub(box, Set(1.0f)), Set(params.inverseScalePower)));
+}
+
+typedef void (*VectorKernel)(const KernelParams&, const float*, const float*, const float*, float*);
+typedef void (*Kernel)(const KernelParams&, const float*, const float*, const float*, size_t, float*);
+
+// Whole vectors, then the tail padded with zeros
+template <VectorKernel kernel>
+void Run(const KernelParams& params, const float* x, const float* y, const float* z, size_t count, float* out) {
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        kernel(params, x + i, y + i, z + i, out + i);
+    }
+    if (i < count) {
+        float tail[4][LANES] = {};
+        for (size_t k = 0; i + k < count; ++k) {
+            tail[0][k] = x[i + k];
+            tail[1][k] = y[i + k];
+            tail[2][k] = z[i + k];
+        }
+        kernel(params, tail[0], tail[1], tail[2], tail[3]);
+        for (size_t k = 0; i + k < count; ++k) {
+            out[i + k] = tail[3][k];
+        }
+    }
+}
+
+template <int Power>
+Kernel SelectMandelbulb(int iterations) {
+    switch (iterations) {
+    case 8: return Run<Mandelbulb<Power, 8>>;
+    case 12: return Run<Mandelbulb<Power, 12>>;
+    case 16: return Run<Mandelbulb<Power, 16>>;
+    default: return Run<Mandelbulb<Power, 0>>;
+    }
+}
+
+template <template <int> class Fractal>
+Kernel SelectFixed(int iterations) {
+    switch (iterations) {
+    case 8: return Run<Fractal<8>::Evaluate>;
+    case 12: return Run<Fractal<12>::Evaluate>;
+    case 16: return Run<Fractal<16>::Evaluate>;
+    default: return Run<Fractal<0>::Evaluate>;
+    }
+}
+
+template <int Iterations>
+struct MandelboxKernel {
+    static void Evaluate(const KernelParams& params, const float* x, const float* y, const float* z, float* out) {
+        Mandelbox<Iterations>(params, x, y, z, out);
+    }
+};
+
+template <int Iterations>
+struct IfsKernel {
+    static void Evaluate(const KernelParams& params, const float* x, const float* y, const float* z, float* out) {
+        KaleidoscopicIfs<Iterations>(params, x, y, z, out);
+    }
+};
+
+// params.specializedPower and specializedIterations are 0 when no kernel matches
+void Evaluate(const KernelParams& params, const float* x, const float* y, const float* z, size_t count, float* out) {
+    Kernel kernel;
+    switch (params.type) {
+    case DistanceFractal::Mandelbox:
+        kernel = SelectFixed<MandelboxKernel>(params.specializedIterations);
+        break;
+    case DistanceFractal::KaleidoscopicIFS:
+        kernel = SelectFixed<IfsKernel>(params.specializedIterations);
+        break;
+    default:
+        switch (params.specializedPower) {
+        case 2: kernel = SelectMandelbulb<2>(params.specializedIterations); break;
+        case 3: kernel = SelectMandelbulb<3>(params.specializedIterations); break;
+        case 4: kernel = SelectMandelbulb<4>(params.specializedIterations); break;
+        case 8: kernel = SelectMandelbulb<8>(params.specializedIterations); break;
+        default: kernel = SelectMandelbulb<0>(params.specializedIterations); break;
+        }
+        break;
+    }
+    kernel(params, x, y, z, count, out);
+}
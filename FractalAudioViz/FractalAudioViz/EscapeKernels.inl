@@ -0,0 +1,89 @@
+// Escape-time kernels, written once over the lanes of SimdLanes.h that the including
+// namespace uses, after SimdMath.inl. EscapeTime.cpp includes this once per instruction
+// set, inside that set's target region. Nothing here may include headers or call
+// library math.
+
+// Smoothed escape counts of count pixels along a row of the plane at height y, from
+// column x0 every step columns; -1 for those still inside after the last iteration.
+// Columns are whole numbers, exact in a float, so a pixel's plane position doesn't
+// depend on the step it was reached with. Returns the iterations run by those pixels.
+inline uint64_t EscapeRow(const KernelParams& params, float y, float x0, float step, size_t count, float* out) {
+    const Vec zero = Set(0.0f);
+    const Vec one = Set(1.0f);
+    const Vec bailout2 = Set(params.bailout2);
+    const Vec pixelSize = Set(params.pixelSize);
+    const Vec left = Set(params.left);
+    const Vec offsets = Mul(Ramp(), Set(step));
+
+    uint64_t iterations = 0;
+    float counts[LANES];
+    float tail[LANES];
+    for (size_t i = 0; i < count; i += LANES) {
+        Vec px = MulAdd(Add(Set(x0 + step * static_cast<float>(i)), offsets), pixelSize, left);
+        Vec py = Set(y);
+
+        Vec zx, zy, cx, cy;
+        Mask active;
+        if (params.julia) {
+            zx = px;
+            zy = py;
+            cx = Set(params.juliaX);
+            cy = Set(params.juliaY);
+            active = Less(zero, one);
+        }
+        else {
+            // Start at z = c, one iteration in. Points in the main cardioid or the period-2
+            // bulb never escape, so they don't iterate.
+            zx = px;
+            zy = py;
+            cx = px;
+            cy = py;
+            Vec y2 = Mul(py, py);
+            Vec qx = Sub(px, Set(0.25f));
+            Vec q = MulAdd(qx, qx, y2);
+            Vec cardioid = Sub(Mul(q, Add(q, qx)), Mul(y2, Set(0.25f)));
+            Vec bx = Add(px, one);
+            Vec bulb = Sub(MulAdd(bx, bx, y2), Set(0.0625f));
+            active = Less(zero, Min(cardioid, bulb));
+        }
+
+        // Escaped lanes keep their z, and their count, while the rest iterate
+        Vec x2 = Mul(zx, zx);
+        Vec y2 = Mul(zy, zy);
+        Vec n = params.julia ? zero : one;
+        for (int iteration = 0; iteration < params.maxIterations; ++iteration) {
+            active = And(active, Less(Add(x2, y2), bailout2));
+            if (!Any(active)) {
+                break;
+            }
+            Vec nextY = MulAdd(Add(zx, zx), zy, cy);
+            Vec nextX = Add(Sub(x2, y2), cx);
+            zx = Select(active, nextX, zx);
+            zy = Select(active, nextY, zy);
+            x2 = Mul(zx, zx);
+            y2 = Mul(zy, zy);
+            n = Add(n, Select(active, one, zero));
+        }
+
+        // n + 1 - log2(log2 |z|), continuous across the bands of equal n
+        Vec r2 = Add(x2, y2);
+        Vec smooth = Sub(Add(n, one), Mul(Log(Mul(Log(r2), Set(0.72134752f))), Set(1.44269504f)));
+        Vec value = Select(Less(r2, bailout2), Set(-1.0f), smooth);
+
+        size_t valid = count - i < LANES ? count - i : LANES;
+        Store(counts, n);
+        for (size_t lane = 0; lane < valid; ++lane) {
+            iterations += static_cast<uint64_t>(counts[lane]);
+        }
+        if (valid == LANES) {
+            Store(out + i, value);
+        }
+        else {
+            Store(tail, value);
+            for (size_t lane = 0; lane < valid; ++lane) {
+                out[i + lane] = tail[lane];
+            }
+        }
+    }
+    return iterations;
+}
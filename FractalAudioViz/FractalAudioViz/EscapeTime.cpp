@@ -0,0 +1,382 @@
+#include "EscapeTime.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "SimdLanes.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+    // EscapeParams as the kernels use them, derived once per Render: the plane position
+    // of pixel (x, y) is (left + x * pixelSize, top - y * pixelSize)
+    struct KernelParams {
+        float left;
+        float top;
+        float pixelSize;
+        float juliaX;
+        float juliaY;
+        float bailout2;
+        int maxIterations;
+        bool julia;
+    };
+
+    KernelParams MakeKernelParams(const EscapeParams& params, size_t width, size_t height) {
+        KernelParams kernel;
+        kernel.pixelSize = params.viewHeight / static_cast<float>(height);
+        kernel.left = params.centerX - 0.5f * kernel.pixelSize * static_cast<float>(width);
+        kernel.top = params.centerY + 0.5f * kernel.pixelSize * static_cast<float>(height);
+        kernel.juliaX = params.juliaX;
+        kernel.juliaY = params.juliaY;
+        kernel.bailout2 = params.bailout * params.bailout;
+        kernel.maxIterations = std::max(params.maxIterations, 0);
+        kernel.julia = params.type == EscapeFractal::Julia;
+        return kernel;
+    }
+
+    namespace ScalarKernels {
+        using namespace SimdLanes::Scalar;
+#include "SimdMath.inl"
+#include "EscapeKernels.inl"
+    }
+
+#if FAV_X86
+    namespace SseKernels {
+        using namespace SimdLanes::Sse;
+#include "SimdMath.inl"
+#include "EscapeKernels.inl"
+    }
+
+FAV_BEGIN_TARGET_AVX2
+    namespace Avx2Kernels {
+        using namespace SimdLanes::Avx2;
+#include "SimdMath.inl"
+#include "EscapeKernels.inl"
+    }
+FAV_END_TARGET
+
+// GCC reports the self-initialized _mm512_undefined_ps inside the unmasked intrinsics as
+// uninitialized once they are inlined into these kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+FAV_BEGIN_TARGET_AVX512
+    namespace Avx512Kernels {
+        using namespace SimdLanes::Avx512;
+#include "SimdMath.inl"
+#include "EscapeKernels.inl"
+    }
+FAV_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+    typedef uint64_t (*RowKernel)(const KernelParams&, float, float, float, size_t, float*);
+
+    // AVX without AVX2 has no 256-bit integer operations for the logarithm's exponent, so
+    // it runs the SSE2 kernel
+    RowKernel SelectKernel(SimdLevel maxSimdLevel) {
+        SimdLevel level = ResolveSimdLevel(maxSimdLevel);
+#if FAV_X86
+        if (level >= SimdLevel::AVX512) return Avx512Kernels::EscapeRow;
+        if (level >= SimdLevel::AVX2) return Avx2Kernels::EscapeRow;
+        if (level >= SimdLevel::SSE2) return SseKernels::EscapeRow;
+#endif
+        (void)level;
+        return ScalarKernels::EscapeRow;
+    }
+
+    // A cosine palette, 0.5 + 0.5 cos(2 pi (t + phase)) per channel with the phases
+    // spread so the hue turns once per cycle
+    const size_t PALETTE_SIZE = 1024;
+    const uint32_t INSIDE_COLOR = 0xFF000000u;
+
+    struct Palette {
+        uint32_t colors[PALETTE_SIZE];
+
+        Palette() {
+            const double phases[3] = { 0.0, 0.1, 0.2 };
+            for (size_t i = 0; i < PALETTE_SIZE; ++i) {
+                double t = static_cast<double>(i) / PALETTE_SIZE;
+                uint32_t color = INSIDE_COLOR;
+                for (int channel = 0; channel < 3; ++channel) {
+                    double level = 0.5 + 0.5 * std::cos(6.283185307179586 * (t + phases[channel]));
+                    color |= static_cast<uint32_t>(level * 255.0 + 0.5) << (8 * channel);
+                }
+                colors[i] = color;
+            }
+        }
+    };
+
+    const Palette& GetPalette() {
+        static const Palette palette;
+        return palette;
+    }
+
+    // Palette entry for an escaped value. The renderer and GetColor both come through
+    // here, so they round the same way at entry boundaries.
+    inline size_t GetPaletteIndex(float value, float colorScale, float colorOffset) {
+        float t = (value * colorScale + colorOffset) * PALETTE_SIZE;
+        return static_cast<size_t>(static_cast<int64_t>(std::floor(t))) & (PALETTE_SIZE - 1);
+    }
+
+    // Per-thread row of escape values, reused across tiles and frames
+    std::vector<float>& GetRowScratch() {
+        thread_local std::vector<float> row;
+        return row;
+    }
+
+    bool SameParams(const EscapeParams& a, const EscapeParams& b) {
+        return a.type == b.type && a.centerX == b.centerX && a.centerY == b.centerY && a.viewHeight == b.viewHeight &&
+            a.juliaX == b.juliaX && a.juliaY == b.juliaY && a.maxIterations == b.maxIterations &&
+            a.bailout == b.bailout && a.colorScale == b.colorScale && a.colorOffset == b.colorOffset;
+    }
+
+    // Pixels a pass computes over the image: every stride-th in each direction, less
+    // those on twice the stride's grid when refining
+    size_t PassPixels(size_t width, size_t height, size_t stride, bool refine) {
+        size_t count = ((width + stride - 1) / stride) * ((height + stride - 1) / stride);
+        if (refine) {
+            size_t coarse = 2 * stride;
+            count -= ((width + coarse - 1) / coarse) * ((height + coarse - 1) / coarse);
+        }
+        return count;
+    }
+}
+
+EscapeTimeRenderer::EscapeTimeRenderer() :
+    secondsPerPixel(0.0)
+{}
+
+bool EscapeTimeRenderer::Initialize(const EscapeSettings& newSettings) {
+    if (newSettings.tileSize == 0) {
+        return false;
+    }
+    settings = newSettings;
+    settings.tileSize = (settings.tileSize + COARSEST_STRIDE - 1) / COARSEST_STRIDE * COARSEST_STRIDE;
+    secondsPerPixel = 0.0;
+    return Resize(newSettings.width, newSettings.height);
+}
+
+bool EscapeTimeRenderer::Resize(size_t width, size_t height) {
+    if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE) {
+        return false;
+    }
+
+    settings.width = width;
+    settings.height = height;
+    pixels.assign(width * height, INSIDE_COLOR);
+
+    // Tiles start on the coarsest grid, so every pass's grid lines up across them
+    tiles.clear();
+    const size_t edge = settings.tileSize;
+    for (size_t y = 0; y < height; y += edge) {
+        for (size_t x = 0; x < width; x += edge) {
+            Tile tile = {};
+            tile.x = x;
+            tile.y = y;
+            tile.width = std::min(edge, width - x);
+            tile.height = std::min(edge, height - y);
+            tiles.push_back(tile);
+        }
+    }
+
+    // Refined from the middle out, where the eye is
+    auto distance = [width, height](const Tile& tile) {
+        double dx = tile.x + 0.5 * tile.width - 0.5 * width;
+        double dy = tile.y + 0.5 * tile.height - 0.5 * height;
+        return dx * dx + dy * dy;
+    };
+    std::stable_sort(tiles.begin(), tiles.end(), [&distance](const Tile& a, const Tile& b) {
+        return distance(a) < distance(b);
+    });
+
+    stats = EscapeStats();
+    stats.tiles = tiles.size();
+    return true;
+}
+
+void EscapeTimeRenderer::Invalidate() {
+    for (Tile& tile : tiles) {
+        tile.stride = 0;
+    }
+}
+
+void EscapeTimeRenderer::RunPass(const EscapeParams& params, size_t startStride, JobSystem* jobs, unsigned threads) {
+    const KernelParams kernel = MakeKernelParams(params, settings.width, settings.height);
+    const RowKernel row = SelectKernel(settings.maxSimdLevel);
+    const uint32_t* palette = GetPalette().colors;
+    const float colorScale = params.colorScale;
+    const float colorOffset = params.colorOffset;
+    const size_t imageWidth = settings.width;
+    uint32_t* image = pixels.data();
+
+    auto renderTile = [&](Tile& tile) {
+        double start = FrameStats::NowSeconds();
+        std::vector<float>& values = GetRowScratch();
+        values.resize(tile.width);
+        tile.pixels = 0;
+        tile.iterations = 0;
+
+        // Rows and columns on the old grid already have its pixels
+        const bool refine = tile.stride != 0;
+        const size_t stride = refine ? tile.stride / 2 : startStride;
+        const size_t right = tile.x + tile.width;
+        const size_t bottom = tile.y + tile.height;
+        for (size_t y = tile.y; y < bottom; y += stride) {
+            bool coarseRow = refine && y % (2 * stride) == 0;
+            size_t first = coarseRow ? stride : 0;
+            size_t step = coarseRow ? 2 * stride : stride;
+            if (first >= tile.width) {
+                continue;
+            }
+            size_t count = (tile.width - first + step - 1) / step;
+            float planeY = kernel.top - static_cast<float>(y) * kernel.pixelSize;
+            tile.iterations += row(kernel, planeY, static_cast<float>(tile.x + first), static_cast<float>(step), count,
+                values.data());
+            tile.pixels += count;
+
+            // Each computed pixel colors the block below and right of it, up to the next
+            // computed one
+            size_t blockBottom = std::min(y + stride, bottom);
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t color = INSIDE_COLOR;
+                if (values[i] >= 0.0f) {
+                    color = palette[GetPaletteIndex(values[i], colorScale, colorOffset)];
+                }
+                size_t x = tile.x + first + i * step;
+                size_t blockRight = std::min(x + stride, right);
+                for (size_t by = y; by < blockBottom; ++by) {
+                    std::fill(image + by * imageWidth + x, image + by * imageWidth + blockRight, color);
+                }
+            }
+        }
+        tile.stride = stride;
+        tile.seconds = FrameStats::NowSeconds() - start;
+    };
+
+    ParallelForEach(work.size(), jobs, threads, [this, &renderTile](size_t i) {
+        renderTile(tiles[work[i]]);
+    });
+
+    ++stats.passes;
+    for (size_t index : work) {
+        stats.pixelsComputed += tiles[index].pixels;
+        stats.iterations += tiles[index].iterations;
+    }
+}
+
+bool EscapeTimeRenderer::Render(const EscapeParams& params, JobSystem* jobs) {
+    const double start = FrameStats::NowSeconds();
+    const double budget = settings.budgetSeconds;
+    stats.passes = 0;
+    stats.pixelsComputed = 0;
+    stats.iterations = 0;
+
+    unsigned threads = settings.threadCount;
+    if (jobs) threads = static_cast<unsigned>(jobs->GetThreadCount());
+    else if (threads == 0) threads = std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+
+    if (!SameParams(params, renderedParams)) {
+        Invalidate();
+    }
+    renderedParams = params;
+
+    // Starting over, every tile at the finest spacing the budget is predicted to cover
+    // in one pass, or the coarsest regardless
+    if (!tiles.empty() && tiles[0].stride == 0) {
+        size_t stride = 1;
+        if (budget > 0.0) {
+            while (stride < COARSEST_STRIDE && (secondsPerPixel <= 0.0 ||
+                PassPixels(settings.width, settings.height, stride, false) * secondsPerPixel > budget)) {
+                stride *= 2;
+            }
+        }
+        work.resize(tiles.size());
+        for (size_t i = 0; i < work.size(); ++i) {
+            work[i] = i;
+        }
+        RunPass(params, stride, jobs, threads);
+        secondsPerPixel = (FrameStats::NowSeconds() - start) / std::max<size_t>(1, stats.pixelsComputed);
+    }
+
+    // Then refine the coarsest tiles, middle first, as many as their last pass predicts
+    // will fit across the threads; at least one if nothing ran yet
+    size_t coarsest = 1;
+    for (;;) {
+        coarsest = 1;
+        for (const Tile& tile : tiles) {
+            coarsest = std::max(coarsest, tile.stride);
+        }
+        if (coarsest == 1) {
+            break;
+        }
+
+        work.clear();
+        double remaining = (budget - (FrameStats::NowSeconds() - start)) * threads;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            const Tile& tile = tiles[i];
+            if (tile.stride != coarsest) continue;
+            if (budget > 0.0) {
+                size_t next = PassPixels(tile.width, tile.height, coarsest / 2, true);
+                remaining -= tile.seconds / std::max<size_t>(1, tile.pixels) * next;
+                if (remaining < 0.0 && (stats.passes > 0 || !work.empty())) break;
+            }
+            work.push_back(i);
+        }
+        if (work.empty()) {
+            break;
+        }
+        RunPass(params, 0, jobs, threads);
+    }
+
+    stats.stride = coarsest;
+    stats.seconds = FrameStats::NowSeconds() - start;
+    return stats.passes > 0;
+}
+
+void EscapeTimeRenderer::EvaluateRow(const EscapeParams& params, size_t width, size_t height, size_t x, size_t y,
+    size_t step, size_t count, float* values, SimdLevel maxSimdLevel) {
+    if (count == 0 || width == 0 || height == 0) {
+        return;
+    }
+    const KernelParams kernel = MakeKernelParams(params, width, height);
+    float planeY = kernel.top - static_cast<float>(y) * kernel.pixelSize;
+    SelectKernel(maxSimdLevel)(kernel, planeY, static_cast<float>(x), static_cast<float>(step), count, values);
+}
+
+size_t EscapeTimeRenderer::GetLaneCount(SimdLevel level) {
+    switch (ResolveSimdLevel(level)) {
+    case SimdLevel::AVX512: return 16;
+    case SimdLevel::AVX2: return 8;
+    case SimdLevel::SSE2:
+    case SimdLevel::AVX: return 4;
+    default: return 1;
+    }
+}
+
+uint32_t EscapeTimeRenderer::GetColor(float value, float colorScale, float colorOffset) {
+    if (value < 0.0f) {
+        return INSIDE_COLOR;
+    }
+    return GetPalette().colors[GetPaletteIndex(value, colorScale, colorOffset)];
+}
+
+EscapeParams EscapeTimeRenderer::Modulate(const EscapeParams& base, const BandEnergies& bands,
+    const EscapeModulation& modulation) {
+    const float bass = bands.GetMeanLevel(0.0, 0.125);
+    const float mids = bands.GetMeanLevel(0.125, 0.5);
+    const float treble = bands.GetMeanLevel(0.5, 1.0);
+
+    EscapeParams params = base;
+    params.viewHeight *= 1.0f - modulation.zoomDepth * bass;
+    float angle = modulation.rotationDepth * mids;
+    float c = std::cos(angle), s = std::sin(angle);
+    params.juliaX = base.juliaX * c - base.juliaY * s;
+    params.juliaY = base.juliaX * s + base.juliaY * c;
+    params.colorOffset += modulation.colorDepth * treble;
+    return params;
+}
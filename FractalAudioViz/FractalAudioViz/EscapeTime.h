@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Filterbank.h"
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+enum class EscapeFractal {
+    Mandelbrot,  // z^2 + c from z = 0, c the pixel
+    Julia        // z^2 + c from z the pixel, c fixed
+};
+
+struct EscapeParams {
+    EscapeFractal type;
+    float centerX;        // View center on the complex plane
+    float centerY;
+    float viewHeight;     // Height of the view on the plane; the width follows the aspect
+    float juliaX;         // Julia c
+    float juliaY;
+    int maxIterations;
+    float bailout;        // Escape radius; large radii color more smoothly
+    float colorScale;     // Palette cycles per iteration
+    float colorOffset;    // Palette position at iteration 0, in cycles
+
+    explicit EscapeParams(EscapeFractal fractal = EscapeFractal::Mandelbrot) :
+        type(fractal),
+        centerX(fractal == EscapeFractal::Julia ? 0.0f : -0.5f),
+        centerY(0.0f),
+        viewHeight(fractal == EscapeFractal::Julia ? 2.0f : 2.5f),
+        juliaX(-0.8f),
+        juliaY(0.156f),
+        maxIterations(256),
+        bailout(256.0f),
+        colorScale(0.02f),
+        colorOffset(0.0f)
+    {}
+};
+
+// How far each parameter moves at full band level, with the bands split as for the
+// distance estimators: the bass is the lowest eighth, the mids up to half, the treble the rest
+struct EscapeModulation {
+    float zoomDepth;      // Fraction of the view height the bass zooms in by
+    float rotationDepth;  // Radians the mids turn Julia c about the origin
+    float colorDepth;     // Palette cycles the treble shifts the colors by
+
+    EscapeModulation() :
+        zoomDepth(0.2f),
+        rotationDepth(0.25f),
+        colorDepth(0.5f)
+    {}
+};
+
+struct EscapeSettings {
+    size_t width;           // Of the image, in pixels
+    size_t height;
+    size_t tileSize;        // Pixels per tile edge, rounded up to a multiple of COARSEST_STRIDE; at 128
+                            // a tile's output fits in L2 and its coarsest rows fill 16 lanes
+    double budgetSeconds;   // Per Render; 0 computes every pixel every time
+    unsigned threadCount;   // Without a job system, 0 = one per hardware thread
+    SimdLevel maxSimdLevel;
+
+    EscapeSettings() :
+        width(1280),
+        height(720),
+        tileSize(128),
+        budgetSeconds(0.0),
+        threadCount(0),
+        maxSimdLevel(SimdLevel::AVX512)
+    {}
+};
+
+// What the last Render did
+struct EscapeStats {
+    size_t tiles;
+    size_t passes;          // Passes run, each over all tiles or some of them
+    size_t pixelsComputed;  // Escape times computed; the rest of the image was kept or filled
+    size_t stride;          // Pixels between computed ones in the image now; 1 when complete
+    uint64_t iterations;    // Summed over the computed pixels
+    double seconds;         // Wall time of the whole Render
+
+    EscapeStats() : tiles(0), passes(0), pixelsComputed(0), stride(0), iterations(0), seconds(0.0) {}
+};
+
+// Renders Mandelbrot and Julia sets into an RGBA8 image (red in the low byte, as the
+// back buffer's R8G8B8A8 layout) for a full-window backdrop. The image is split into
+// tiles small enough to stay in cache, rendered in parallel; along each tile row 1, 4, 8
+// or 16 pixels iterate together (scalar, SSE2, AVX2, AVX-512), each lane frozen once it
+// escapes, and the group stops when none is left. Colors come from the smoothed escape
+// count through a cyclic palette, with points that never escape black.
+//
+// With a budget, a Render that can't afford every pixel computes every 8th (or 4th or
+// 2nd) in each direction and fills the blocks between, then refines tiles by halving
+// their spacing, from the middle of the image out, while the time lasts; the next Render
+// with the same parameters carries on where it stopped. A pixel has the same color
+// whatever the spacing it was computed at.
+class EscapeTimeRenderer {
+public:
+    // Coarsest spacing between computed pixels
+    static const size_t COARSEST_STRIDE = 8;
+
+    // Largest image edge Initialize accepts
+    static const size_t MAX_SIZE = 16384;
+
+private:
+    struct Tile {
+        size_t x;
+        size_t y;
+        size_t width;
+        size_t height;
+        size_t stride;          // Spacing computed for the rendered parameters; 0 for none yet
+        size_t pixels;          // Computed in the last pass
+        uint64_t iterations;
+        double seconds;         // Work time of the last pass, to predict the next
+    };
+
+    EscapeSettings settings;
+    std::vector<uint32_t> pixels;
+    std::vector<Tile> tiles;      // Nearest the middle of the image first
+    std::vector<size_t> work;     // Tiles in the next pass
+    EscapeParams renderedParams;  // Of the image as it stands
+    double secondsPerPixel;       // Wall time over the last whole-image pass, to pick the next one's spacing
+    EscapeStats stats;
+
+    // Halve the spacing of each tile in the work list, or start it at this spacing if it
+    // has none: compute the pixels on the new grid that aren't on the old one and fill
+    // the blocks they stand for
+    void RunPass(const EscapeParams& params, size_t startStride, JobSystem* jobs, unsigned threads);
+
+public:
+    EscapeTimeRenderer();
+
+    // False if the width or height is 0 or over MAX_SIZE, or the tile size is 0
+    bool Initialize(const EscapeSettings& settings);
+
+    // New image size; the next Render starts over
+    bool Resize(size_t width, size_t height);
+
+    // Render this frame's parameters within the budget; true if the image changed. Every
+    // Render with work left runs at least one pass, even over the budget. With a job
+    // system the tiles are jobs on its threads.
+    bool Render(const EscapeParams& params, JobSystem* jobs = nullptr);
+
+    // Make the next Render start over
+    void Invalidate();
+
+    void SetBudget(double seconds) { settings.budgetSeconds = seconds; }
+
+    const uint32_t* GetPixels() const { return pixels.data(); }
+    size_t GetWidth() const { return settings.width; }
+    size_t GetHeight() const { return settings.height; }
+    size_t GetPitch() const { return settings.width * sizeof(uint32_t); }
+    const EscapeStats& GetStats() const { return stats; }
+    const EscapeSettings& GetSettings() const { return settings; }
+
+    // Smoothed escape count of each pixel in a row, or -1 for those that never escape:
+    // count pixels from column x with the given step, on row y. For checking the levels
+    // against each other.
+    static void EvaluateRow(const EscapeParams& params, size_t width, size_t height, size_t x, size_t y, size_t step,
+        size_t count, float* values, SimdLevel maxSimdLevel = SimdLevel::AVX512);
+
+    // Pixels per kernel call at a level (after clamping it to the machine)
+    static size_t GetLaneCount(SimdLevel level);
+
+    // Palette color of a smoothed escape count, black for -1 (inside); colorScale and
+    // colorOffset in palette cycles, as EscapeParams'
+    static uint32_t GetColor(float value, float colorScale, float colorOffset);
+
+    // Parameters for this frame from the base ones and the band levels
+    static EscapeParams Modulate(const EscapeParams& base, const BandEnergies& bands,
+        const EscapeModulation& modulation = EscapeModulation());
+};
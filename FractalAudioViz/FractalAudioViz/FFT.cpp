@@ -0,0 +1,339 @@
+#include "FFT.h"
+#include <cmath>
+
+namespace {
+    const double PI = 3.14159265358979323846;
+
+    // First stage when log2(N/2) is odd: radix-2 butterflies with a unit twiddle
+    void Radix2FirstStage(float* re, float* im, size_t n) {
+        for (size_t b = 0; b < n; b += 2) {
+            float ar = re[b], ai = im[b];
+            float br = re[b + 1], bi = im[b + 1];
+            re[b] = ar + br; im[b] = ai + bi;
+            re[b + 1] = ar - br; im[b + 1] = ai - bi;
+        }
+    }
+
+    // Fused first two stages (spans 1 and 2), whose twiddles are just 1 and -i
+    void Radix4FirstStage(float* re, float* im, size_t n) {
+        for (size_t b = 0; b < n; b += 4) {
+            float a1r = re[b] + re[b + 1], a1i = im[b] + im[b + 1];
+            float b1r = re[b] - re[b + 1], b1i = im[b] - im[b + 1];
+            float c1r = re[b + 2] + re[b + 3], c1i = im[b + 2] + im[b + 3];
+            float d1r = re[b + 2] - re[b + 3], d1i = im[b + 2] - im[b + 3];
+
+            re[b] = a1r + c1r; im[b] = a1i + c1i;
+            re[b + 2] = a1r - c1r; im[b + 2] = a1i - c1i;
+
+            // b1 +/- (-i * d1)
+            re[b + 1] = b1r + d1i; im[b + 1] = b1i - d1r;
+            re[b + 3] = b1r - d1i; im[b + 3] = b1i + d1r;
+        }
+    }
+
+    // Two fused radix-2 DIT stages with spans s and 2s. For each group of four
+    // quarter-blocks (x0..x3) the first stage combines (x0,x1) and (x2,x3) with
+    // W_2s^j, the second (x0,x2) with W_4s^j and (x1,x3) with W_4s^(j+s) = -i W_4s^j.
+    void FusedStageScalar(float* re, float* im, size_t n, size_t s, const float* twRe, const float* twIm) {
+        const float* w1r = twRe + s;
+        const float* w1i = twIm + s;
+        const float* w2r = twRe + 2 * s;
+        const float* w2i = twIm + 2 * s;
+
+        for (size_t b = 0; b < n; b += 4 * s) {
+            float* r0 = re + b; float* r1 = r0 + s; float* r2 = r1 + s; float* r3 = r2 + s;
+            float* i0 = im + b; float* i1 = i0 + s; float* i2 = i1 + s; float* i3 = i2 + s;
+
+            for (size_t j = 0; j < s; ++j) {
+                float t1r = w1r[j] * r1[j] - w1i[j] * i1[j];
+                float t1i = w1r[j] * i1[j] + w1i[j] * r1[j];
+                float a1r = r0[j] + t1r, a1i = i0[j] + t1i;
+                float b1r = r0[j] - t1r, b1i = i0[j] - t1i;
+
+                float t2r = w1r[j] * r3[j] - w1i[j] * i3[j];
+                float t2i = w1r[j] * i3[j] + w1i[j] * r3[j];
+                float c1r = r2[j] + t2r, c1i = i2[j] + t2i;
+                float d1r = r2[j] - t2r, d1i = i2[j] - t2i;
+
+                float t3r = w2r[j] * c1r - w2i[j] * c1i;
+                float t3i = w2r[j] * c1i + w2i[j] * c1r;
+                float ur = w2r[j] * d1r - w2i[j] * d1i;
+                float ui = w2r[j] * d1i + w2i[j] * d1r;
+
+                r0[j] = a1r + t3r; i0[j] = a1i + t3i;
+                r2[j] = a1r - t3r; i2[j] = a1i - t3i;
+                r1[j] = b1r + ui; i1[j] = b1i - ur;
+                r3[j] = b1r - ui; i3[j] = b1i + ur;
+            }
+        }
+    }
+
+#if FAV_X86
+    // SSE2 version of FusedStageScalar, four butterflies per iteration (s >= 4)
+    void FusedStageSSE2(float* re, float* im, size_t n, size_t s, const float* twRe, const float* twIm) {
+        const float* w1r = twRe + s;
+        const float* w1i = twIm + s;
+        const float* w2r = twRe + 2 * s;
+        const float* w2i = twIm + 2 * s;
+
+        for (size_t b = 0; b < n; b += 4 * s) {
+            float* r0 = re + b; float* r1 = r0 + s; float* r2 = r1 + s; float* r3 = r2 + s;
+            float* i0 = im + b; float* i1 = i0 + s; float* i2 = i1 + s; float* i3 = i2 + s;
+
+            for (size_t j = 0; j < s; j += 4) {
+                __m128 wr1 = _mm_loadu_ps(w1r + j), wi1 = _mm_loadu_ps(w1i + j);
+                __m128 wr2 = _mm_loadu_ps(w2r + j), wi2 = _mm_loadu_ps(w2i + j);
+                __m128 x0r = _mm_loadu_ps(r0 + j), x0i = _mm_loadu_ps(i0 + j);
+                __m128 x1r = _mm_loadu_ps(r1 + j), x1i = _mm_loadu_ps(i1 + j);
+                __m128 x2r = _mm_loadu_ps(r2 + j), x2i = _mm_loadu_ps(i2 + j);
+                __m128 x3r = _mm_loadu_ps(r3 + j), x3i = _mm_loadu_ps(i3 + j);
+
+                __m128 t1r = _mm_sub_ps(_mm_mul_ps(wr1, x1r), _mm_mul_ps(wi1, x1i));
+                __m128 t1i = _mm_add_ps(_mm_mul_ps(wr1, x1i), _mm_mul_ps(wi1, x1r));
+                __m128 a1r = _mm_add_ps(x0r, t1r), a1i = _mm_add_ps(x0i, t1i);
+                __m128 b1r = _mm_sub_ps(x0r, t1r), b1i = _mm_sub_ps(x0i, t1i);
+
+                __m128 t2r = _mm_sub_ps(_mm_mul_ps(wr1, x3r), _mm_mul_ps(wi1, x3i));
+                __m128 t2i = _mm_add_ps(_mm_mul_ps(wr1, x3i), _mm_mul_ps(wi1, x3r));
+                __m128 c1r = _mm_add_ps(x2r, t2r), c1i = _mm_add_ps(x2i, t2i);
+                __m128 d1r = _mm_sub_ps(x2r, t2r), d1i = _mm_sub_ps(x2i, t2i);
+
+                __m128 t3r = _mm_sub_ps(_mm_mul_ps(wr2, c1r), _mm_mul_ps(wi2, c1i));
+                __m128 t3i = _mm_add_ps(_mm_mul_ps(wr2, c1i), _mm_mul_ps(wi2, c1r));
+                __m128 ur = _mm_sub_ps(_mm_mul_ps(wr2, d1r), _mm_mul_ps(wi2, d1i));
+                __m128 ui = _mm_add_ps(_mm_mul_ps(wr2, d1i), _mm_mul_ps(wi2, d1r));
+
+                _mm_storeu_ps(r0 + j, _mm_add_ps(a1r, t3r)); _mm_storeu_ps(i0 + j, _mm_add_ps(a1i, t3i));
+                _mm_storeu_ps(r2 + j, _mm_sub_ps(a1r, t3r)); _mm_storeu_ps(i2 + j, _mm_sub_ps(a1i, t3i));
+                _mm_storeu_ps(r1 + j, _mm_add_ps(b1r, ui)); _mm_storeu_ps(i1 + j, _mm_sub_ps(b1i, ur));
+                _mm_storeu_ps(r3 + j, _mm_sub_ps(b1r, ui)); _mm_storeu_ps(i3 + j, _mm_add_ps(b1i, ur));
+            }
+        }
+    }
+
+    // AVX version of FusedStageScalar, eight butterflies per iteration (s >= 8)
+    FAV_TARGET_AVX void FusedStageAVX(float* re, float* im, size_t n, size_t s, const float* twRe, const float* twIm) {
+        const float* w1r = twRe + s;
+        const float* w1i = twIm + s;
+        const float* w2r = twRe + 2 * s;
+        const float* w2i = twIm + 2 * s;
+
+        for (size_t b = 0; b < n; b += 4 * s) {
+            float* r0 = re + b; float* r1 = r0 + s; float* r2 = r1 + s; float* r3 = r2 + s;
+            float* i0 = im + b; float* i1 = i0 + s; float* i2 = i1 + s; float* i3 = i2 + s;
+
+            for (size_t j = 0; j < s; j += 8) {
+                __m256 wr1 = _mm256_loadu_ps(w1r + j), wi1 = _mm256_loadu_ps(w1i + j);
+                __m256 wr2 = _mm256_loadu_ps(w2r + j), wi2 = _mm256_loadu_ps(w2i + j);
+                __m256 x0r = _mm256_loadu_ps(r0 + j), x0i = _mm256_loadu_ps(i0 + j);
+                __m256 x1r = _mm256_loadu_ps(r1 + j), x1i = _mm256_loadu_ps(i1 + j);
+                __m256 x2r = _mm256_loadu_ps(r2 + j), x2i = _mm256_loadu_ps(i2 + j);
+                __m256 x3r = _mm256_loadu_ps(r3 + j), x3i = _mm256_loadu_ps(i3 + j);
+
+                __m256 t1r = _mm256_sub_ps(_mm256_mul_ps(wr1, x1r), _mm256_mul_ps(wi1, x1i));
+                __m256 t1i = _mm256_add_ps(_mm256_mul_ps(wr1, x1i), _mm256_mul_ps(wi1, x1r));
+                __m256 a1r = _mm256_add_ps(x0r, t1r), a1i = _mm256_add_ps(x0i, t1i);
+                __m256 b1r = _mm256_sub_ps(x0r, t1r), b1i = _mm256_sub_ps(x0i, t1i);
+
+                __m256 t2r = _mm256_sub_ps(_mm256_mul_ps(wr1, x3r), _mm256_mul_ps(wi1, x3i));
+                __m256 t2i = _mm256_add_ps(_mm256_mul_ps(wr1, x3i), _mm256_mul_ps(wi1, x3r));
+                __m256 c1r = _mm256_add_ps(x2r, t2r), c1i = _mm256_add_ps(x2i, t2i);
+                __m256 d1r = _mm256_sub_ps(x2r, t2r), d1i = _mm256_sub_ps(x2i, t2i);
+
+                __m256 t3r = _mm256_sub_ps(_mm256_mul_ps(wr2, c1r), _mm256_mul_ps(wi2, c1i));
+                __m256 t3i = _mm256_add_ps(_mm256_mul_ps(wr2, c1i), _mm256_mul_ps(wi2, c1r));
+                __m256 ur = _mm256_sub_ps(_mm256_mul_ps(wr2, d1r), _mm256_mul_ps(wi2, d1i));
+                __m256 ui = _mm256_add_ps(_mm256_mul_ps(wr2, d1i), _mm256_mul_ps(wi2, d1r));
+
+                _mm256_storeu_ps(r0 + j, _mm256_add_ps(a1r, t3r)); _mm256_storeu_ps(i0 + j, _mm256_add_ps(a1i, t3i));
+                _mm256_storeu_ps(r2 + j, _mm256_sub_ps(a1r, t3r)); _mm256_storeu_ps(i2 + j, _mm256_sub_ps(a1i, t3i));
+                _mm256_storeu_ps(r1 + j, _mm256_add_ps(b1r, ui)); _mm256_storeu_ps(i1 + j, _mm256_sub_ps(b1i, ur));
+                _mm256_storeu_ps(r3 + j, _mm256_sub_ps(b1r, ui)); _mm256_storeu_ps(i3 + j, _mm256_add_ps(b1i, ur));
+            }
+        }
+    }
+
+    // SSE2 split step for bins [1, half), four bins per iteration; returns the first bin left over
+    size_t SplitForwardSSE2(const float* re, const float* im, size_t half,
+        const float* wRe, const float* wIm, float* outRe, float* outIm) {
+        const __m128 halfScale = _mm_set1_ps(0.5f);
+        size_t k = 1;
+
+        for (; k + 4 <= half; k += 4) {
+            // Z[k..k+3] and conj(Z[half-k-3..half-k]) reversed to line up with k
+            __m128 zr = _mm_loadu_ps(re + k), zi = _mm_loadu_ps(im + k);
+            __m128 cr = _mm_loadu_ps(re + half - k - 3), ci = _mm_loadu_ps(im + half - k - 3);
+            cr = _mm_shuffle_ps(cr, cr, _MM_SHUFFLE(0, 1, 2, 3));
+            ci = _mm_shuffle_ps(ci, ci, _MM_SHUFFLE(0, 1, 2, 3));
+
+            // E = (Z + conj Z') / 2, O = (Z - conj Z') / 2i
+            __m128 er = _mm_mul_ps(halfScale, _mm_add_ps(zr, cr));
+            __m128 ei = _mm_mul_ps(halfScale, _mm_sub_ps(zi, ci));
+            __m128 oR = _mm_mul_ps(halfScale, _mm_add_ps(zi, ci));
+            __m128 oI = _mm_mul_ps(halfScale, _mm_sub_ps(cr, zr));
+
+            __m128 wr = _mm_loadu_ps(wRe + k), wi = _mm_loadu_ps(wIm + k);
+            _mm_storeu_ps(outRe + k, _mm_add_ps(er, _mm_sub_ps(_mm_mul_ps(wr, oR), _mm_mul_ps(wi, oI))));
+            _mm_storeu_ps(outIm + k, _mm_add_ps(ei, _mm_add_ps(_mm_mul_ps(wr, oI), _mm_mul_ps(wi, oR))));
+        }
+
+        return k;
+    }
+#endif
+
+    size_t Log2(size_t n) {
+        size_t bits = 0;
+        while ((static_cast<size_t>(1) << bits) < n) ++bits;
+        return bits;
+    }
+}
+
+FFTPlan::FFTPlan() :
+    size(0),
+    half(0),
+    simdLevel(SimdLevel::Scalar)
+{}
+
+bool FFTPlan::Initialize(size_t fftSize, SimdLevel maxLevel) {
+    if (fftSize < 16 || (fftSize & (fftSize - 1)) != 0) {
+        return false;
+    }
+
+    size = fftSize;
+    half = fftSize / 2;
+    simdLevel = ResolveSimdLevel(maxLevel);
+
+    // Bit reversal table for the complex transform
+    size_t bits = Log2(half);
+    bitReverse.resize(half);
+    for (size_t i = 0; i < half; ++i) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse[i] = static_cast<uint32_t>(reversed);
+    }
+
+    // Per-stage twiddles, computed in double precision
+    stageTwiddleRe.assign(half, 0.0f);
+    stageTwiddleIm.assign(half, 0.0f);
+    for (size_t s = 1; s < half; s *= 2) {
+        for (size_t j = 0; j < s; ++j) {
+            double angle = -PI * static_cast<double>(j) / static_cast<double>(s);
+            stageTwiddleRe[s + j] = static_cast<float>(std::cos(angle));
+            stageTwiddleIm[s + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    splitTwiddleRe.resize(half);
+    splitTwiddleIm.resize(half);
+    for (size_t k = 0; k < half; ++k) {
+        double angle = -2.0 * PI * static_cast<double>(k) / static_cast<double>(size);
+        splitTwiddleRe[k] = static_cast<float>(std::cos(angle));
+        splitTwiddleIm[k] = static_cast<float>(std::sin(angle));
+    }
+
+    workRe.assign(half, 0.0f);
+    workIm.assign(half, 0.0f);
+    return true;
+}
+
+void FFTPlan::TransformComplex() {
+    float* re = workRe.data();
+    float* im = workIm.data();
+    const float* twRe = stageTwiddleRe.data();
+    const float* twIm = stageTwiddleIm.data();
+
+    // Peel off a radix-2 stage if needed so the rest pairs up
+    size_t span;
+    if (Log2(half) & 1) {
+        Radix2FirstStage(re, im, half);
+        span = 2;
+    }
+    else {
+        Radix4FirstStage(re, im, half);
+        span = 4;
+    }
+
+    for (; span < half; span *= 4) {
+#if FAV_X86
+        if (simdLevel >= SimdLevel::AVX && span >= 8) {
+            FusedStageAVX(re, im, half, span, twRe, twIm);
+            continue;
+        }
+        if (simdLevel >= SimdLevel::SSE2 && span >= 4) {
+            FusedStageSSE2(re, im, half, span, twRe, twIm);
+            continue;
+        }
+#endif
+        FusedStageScalar(re, im, half, span, twRe, twIm);
+    }
+}
+
+void FFTPlan::ForwardReal(const float* input, float* outRe, float* outIm) {
+    // Pack even/odd samples as complex points, in bit-reversed order
+    const uint32_t* reverse = bitReverse.data();
+    for (size_t n = 0; n < half; ++n) {
+        workRe[reverse[n]] = input[2 * n];
+        workIm[reverse[n]] = input[2 * n + 1];
+    }
+
+    TransformComplex();
+
+    const float* re = workRe.data();
+    const float* im = workIm.data();
+
+    // DC and Nyquist are purely real
+    outRe[0] = re[0] + im[0];
+    outIm[0] = 0.0f;
+    outRe[half] = re[0] - im[0];
+    outIm[half] = 0.0f;
+
+    // Separate the spectra of the even and odd samples and recombine
+    size_t k = 1;
+#if FAV_X86
+    if (simdLevel >= SimdLevel::SSE2) {
+        k = SplitForwardSSE2(re, im, half, splitTwiddleRe.data(), splitTwiddleIm.data(), outRe, outIm);
+    }
+#endif
+    for (; k < half; ++k) {
+        float zr = re[k], zi = im[k];
+        float cr = re[half - k], ci = -im[half - k];
+
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float oR = 0.5f * (zi - ci), oI = -0.5f * (zr - cr);
+
+        float wr = splitTwiddleRe[k], wi = splitTwiddleIm[k];
+        outRe[k] = er + wr * oR - wi * oI;
+        outIm[k] = ei + wr * oI + wi * oR;
+    }
+}
+
+void FFTPlan::InverseReal(const float* inRe, const float* inIm, float* output) {
+    // Undo the split step, conjugating so the forward transform computes the inverse
+    const uint32_t* reverse = bitReverse.data();
+    for (size_t k = 0; k < half; ++k) {
+        float xr = inRe[k], xi = inIm[k];
+        float cr = inRe[half - k], ci = -inIm[half - k];
+
+        float er = 0.5f * (xr + cr), ei = 0.5f * (xi + ci);
+        float dr = 0.5f * (xr - cr), di = 0.5f * (xi - ci);
+
+        // O = D * conj(W), Z = E + iO
+        float wr = splitTwiddleRe[k], wi = splitTwiddleIm[k];
+        float oR = dr * wr + di * wi;
+        float oI = di * wr - dr * wi;
+
+        workRe[reverse[k]] = er - oI;
+        workIm[reverse[k]] = -(ei + oR);
+    }
+
+    TransformComplex();
+
+    // Conjugate back, scale and unpack even/odd samples
+    const float scale = 1.0f / static_cast<float>(half);
+    for (size_t n = 0; n < half; ++n) {
+        output[2 * n] = workRe[n] * scale;
+        output[2 * n + 1] = -workIm[n] * scale;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Precomputed plan for a real-input FFT of a fixed power-of-two size.
+//
+// A real transform of N samples is computed as a complex transform of N/2 points
+// (even samples in the real part, odd samples in the imaginary part) followed by a
+// split step that separates the two spectra. The complex transform works on separate
+// real/imaginary arrays and fuses pairs of radix-2 stages into radix-2^2 butterflies,
+// which vectorize across SSE/AVX lanes without any shuffles.
+//
+// A plan owns its scratch memory, so use one plan per thread.
+class FFTPlan {
+private:
+    size_t size;       // Real input length N
+    size_t half;       // Complex transform length N/2
+    SimdLevel simdLevel;
+
+    // Bit-reversal permutation of the N/2 complex points
+    std::vector<uint32_t> bitReverse;
+
+    // Stage twiddles: for a stage of span s, entries [s, 2s) hold W_2s^j, j < s
+    std::vector<float> stageTwiddleRe;
+    std::vector<float> stageTwiddleIm;
+
+    // Split-step twiddles W_N^k, k < N/2
+    std::vector<float> splitTwiddleRe;
+    std::vector<float> splitTwiddleIm;
+
+    // Complex work buffers
+    std::vector<float> workRe;
+    std::vector<float> workIm;
+
+    void TransformComplex();
+
+public:
+    FFTPlan();
+
+    // size must be a power of two and at least 16. maxLevel caps the instruction
+    // set used (for benchmarking); the best supported level is used by default.
+    bool Initialize(size_t size, SimdLevel maxLevel = SimdLevel::AVX512);
+
+    size_t GetSize() const { return size; }
+    size_t GetBinCount() const { return half + 1; }
+    SimdLevel GetSimdLevel() const { return simdLevel; }
+
+    // input: GetSize() samples. outRe/outIm: GetBinCount() bins each (unnormalized)
+    void ForwardReal(const float* input, float* outRe, float* outIm);
+
+    // Inverse of ForwardReal, scaled so InverseReal(ForwardReal(x)) == x
+    void InverseReal(const float* inRe, const float* inIm, float* output);
+};
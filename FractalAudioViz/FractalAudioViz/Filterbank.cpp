@@ -0,0 +1,236 @@
+#include "Filterbank.h"
+#include <cmath>
+
+namespace {
+    const double PI = 3.14159265358979323846;
+
+    // Frequency <-> perceptual scale conversions
+    double HzToMel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+    double MelToHz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+    // Traunmueller's Bark approximation
+    double HzToBark(double hz) { return 26.81 * hz / (1960.0 + hz) - 0.53; }
+    double BarkToHz(double bark) { return 1960.0 * (bark + 0.53) / (26.28 - bark); }
+
+    double ToScale(BandScale scale, double hz) {
+        switch (scale) {
+        case BandScale::Mel: return HzToMel(hz);
+        case BandScale::Bark: return HzToBark(hz);
+        default: return std::log(hz);
+        }
+    }
+
+    double FromScale(BandScale scale, double value) {
+        switch (scale) {
+        case BandScale::Mel: return MelToHz(value);
+        case BandScale::Bark: return BarkToHz(value);
+        default: return std::exp(value);
+        }
+    }
+
+    // Sum of weight * magnitude^2 over one run
+    float DotSquaredScalar(const float* weights, const float* magnitude, size_t length) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < length; ++i) {
+            sum += weights[i] * magnitude[i] * magnitude[i];
+        }
+        return sum;
+    }
+
+#if FAV_X86
+    float DotSquaredSSE2(const float* weights, const float* magnitude, size_t length) {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (size_t i = 0; i < length; i += 8) {
+            __m128 m0 = _mm_loadu_ps(magnitude + i);
+            __m128 m1 = _mm_loadu_ps(magnitude + i + 4);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(weights + i), _mm_mul_ps(m0, m0)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(weights + i + 4), _mm_mul_ps(m1, m1)));
+        }
+        __m128 sum = _mm_add_ps(sum0, sum1);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+
+    FAV_TARGET_AVX2 float DotSquaredAVX2(const float* weights, const float* magnitude, size_t length) {
+        __m256 sum = _mm256_setzero_ps();
+        for (size_t i = 0; i < length; i += 8) {
+            __m256 m = _mm256_loadu_ps(magnitude + i);
+            sum = _mm256_fmadd_ps(_mm256_loadu_ps(weights + i), _mm256_mul_ps(m, m), sum);
+        }
+        __m128 low = _mm256_castps256_ps128(sum);
+        __m128 high = _mm256_extractf128_ps(sum, 1);
+        __m128 total = _mm_add_ps(low, high);
+        total = _mm_add_ps(total, _mm_movehl_ps(total, total));
+        total = _mm_add_ss(total, _mm_shuffle_ps(total, total, 1));
+        return _mm_cvtss_f32(total);
+    }
+#endif
+}
+
+Filterbank::Filterbank() :
+    simdLevel(SimdLevel::Scalar),
+    binCount(0),
+    nonZeroWeights(0)
+{}
+
+bool Filterbank::Initialize(const FilterbankSettings& filterSettings) {
+    const FilterbankSettings& s = filterSettings;
+    if (s.bandCount == 0 || s.fftSize < 2 * RUN_ALIGNMENT || s.sampleRate <= 0 ||
+        s.minFrequency <= 0.0f || s.maxFrequency <= s.minFrequency) {
+        return false;
+    }
+
+    settings = filterSettings;
+    simdLevel = ResolveSimdLevel(settings.maxSimdLevel);
+    binCount = settings.fftSize / 2 + 1;
+
+    const double binHz = static_cast<double>(settings.sampleRate) / settings.fftSize;
+    const double nyquist = settings.sampleRate * 0.5;
+    const double maxHz = settings.maxFrequency < nyquist ? settings.maxFrequency : nyquist;
+    const size_t bands = settings.bandCount;
+
+    runs.clear();
+    weights.clear();
+    centers.assign(bands, 0.0f);
+    nonZeroWeights = 0;
+
+    // Scratch for one band's dense weights before compaction
+    std::vector<double> bandWeights(binCount);
+
+    for (size_t band = 0; band < bands; ++band) {
+        double lowHz, centerHz, highHz;
+        bool hannShape = false;
+
+        if (settings.scale == BandScale::ConstantQ) {
+            // Geometric centers with Q set by the band spacing; the Hann shape spans
+            // twice the bandwidth so its half-power width is about center / Q
+            double octaves = std::log2(maxHz / settings.minFrequency);
+            double binsPerOctave = bands / octaves;
+            double q = 1.0 / (std::pow(2.0, 1.0 / binsPerOctave) - 1.0);
+            centerHz = settings.minFrequency * std::pow(2.0, (band + 0.5) / binsPerOctave);
+            lowHz = centerHz - centerHz / q;
+            highHz = centerHz + centerHz / q;
+            hannShape = true;
+        }
+        else {
+            // Triangles whose edges are the neighbouring band centers
+            double minScale = ToScale(settings.scale, settings.minFrequency);
+            double maxScale = ToScale(settings.scale, maxHz);
+            double step = (maxScale - minScale) / (bands + 1);
+            lowHz = FromScale(settings.scale, minScale + step * band);
+            centerHz = FromScale(settings.scale, minScale + step * (band + 1));
+            highHz = FromScale(settings.scale, minScale + step * (band + 2));
+        }
+        centers[band] = static_cast<float>(centerHz);
+
+        // Evaluate the filter shape on every bin it touches
+        size_t first = binCount;
+        size_t last = 0;
+        double total = 0.0;
+        for (size_t bin = 0; bin < binCount; ++bin) {
+            double hz = bin * binHz;
+            double w = 0.0;
+            if (hz > lowHz && hz < highHz) {
+                if (hannShape) {
+                    double x = (hz - lowHz) / (highHz - lowHz);
+                    w = 0.5 - 0.5 * std::cos(2.0 * PI * x);
+                }
+                else if (hz <= centerHz) {
+                    w = (hz - lowHz) / (centerHz - lowHz);
+                }
+                else {
+                    w = (highHz - hz) / (highHz - centerHz);
+                }
+            }
+            bandWeights[bin] = w;
+            if (w > 0.0) {
+                if (bin < first) first = bin;
+                last = bin;
+                total += w;
+            }
+        }
+
+        // Bands narrower than a bin would be empty; give them the nearest bin
+        if (total <= 0.0) {
+            size_t nearest = static_cast<size_t>(centerHz / binHz + 0.5);
+            if (nearest >= binCount) nearest = binCount - 1;
+            bandWeights[nearest] = 1.0;
+            first = last = nearest;
+            total = 1.0;
+        }
+
+        // Pad the run to the SIMD width, shifting it left if it would run off the end
+        size_t length = last - first + 1;
+        size_t padded = (length + RUN_ALIGNMENT - 1) / RUN_ALIGNMENT * RUN_ALIGNMENT;
+        if (padded > binCount) {
+            return false;
+        }
+        size_t start = first;
+        if (start + padded > binCount) start = binCount - padded;
+
+        BandRun run;
+        run.firstBin = static_cast<uint32_t>(start);
+        run.length = static_cast<uint32_t>(padded);
+        run.weightOffset = static_cast<uint32_t>(weights.size());
+        runs.push_back(run);
+
+        // Normalize to unit area so every band reports mean power
+        for (size_t i = 0; i < padded; ++i) {
+            size_t bin = start + i;
+            float w = (bin >= first && bin <= last) ? static_cast<float>(bandWeights[bin] / total) : 0.0f;
+            weights.push_back(w);
+            if (w != 0.0f) ++nonZeroWeights;
+        }
+    }
+
+    return true;
+}
+
+void Filterbank::PrepareOutput(BandEnergies& out) const {
+    out.power.assign(runs.size(), 0.0f);
+    out.decibels.assign(runs.size(), settings.floorDb);
+    out.centerFrequency = centers;
+    out.floorDb = settings.floorDb;
+    out.frame = 0;
+}
+
+void Filterbank::Apply(const float* magnitude, BandEnergies& out) const {
+    const float floorPower = std::pow(10.0f, settings.floorDb / 10.0f);
+    const float* w = weights.data();
+    const size_t bands = runs.size();
+
+    for (size_t band = 0; band < bands; ++band) {
+        const BandRun& run = runs[band];
+        const float* bandWeights = w + run.weightOffset;
+        const float* bins = magnitude + run.firstBin;
+
+        float power;
+#if FAV_X86
+        if (simdLevel >= SimdLevel::AVX2) {
+            power = DotSquaredAVX2(bandWeights, bins, run.length);
+        }
+        else if (simdLevel >= SimdLevel::SSE2) {
+            power = DotSquaredSSE2(bandWeights, bins, run.length);
+        }
+        else
+#endif
+        {
+            power = DotSquaredScalar(bandWeights, bins, run.length);
+        }
+
+        out.power[band] = power;
+        out.decibels[band] = 10.0f * std::log10(power > floorPower ? power : floorPower);
+    }
+}
+
+void Filterbank::BuildDenseMatrix(std::vector<float>& matrix) const {
+    matrix.assign(runs.size() * binCount, 0.0f);
+    for (size_t band = 0; band < runs.size(); ++band) {
+        const BandRun& run = runs[band];
+        for (size_t i = 0; i < run.length; ++i) {
+            matrix[band * binCount + run.firstBin + i] = weights[run.weightOffset + i];
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Perceptual band layouts
+enum class BandScale {
+    Mel,       // Triangular filters evenly spaced on the mel scale
+    Bark,      // Triangular filters evenly spaced on the Bark scale
+    Log,       // Triangular filters evenly spaced in log frequency
+    ConstantQ  // Hann-shaped filters with a constant center/bandwidth ratio
+};
+
+struct FilterbankSettings {
+    BandScale scale;
+    size_t bandCount;     // 32..256 for the visual mappings
+    float minFrequency;
+    float maxFrequency;
+    int sampleRate;
+    size_t fftSize;       // Must match the STFT feeding the filterbank
+    float floorDb;        // Band levels are clamped to this
+    SimdLevel maxSimdLevel;
+
+    FilterbankSettings() :
+        scale(BandScale::Mel),
+        bandCount(64),
+        minFrequency(30.0f),
+        maxFrequency(16000.0f),
+        sampleRate(48000),
+        fftSize(4096),
+        floorDb(-90.0f),
+        maxSimdLevel(SimdLevel::AVX512)
+    {}
+};
+
+// Band energies for one analysis frame. Allocated once, then rewritten every hop
+// and handed to the scene.
+struct BandEnergies {
+    std::vector<float> power;            // Weighted mean power per band
+    std::vector<float> decibels;         // 10 log10(power), clamped to floorDb
+    std::vector<float> centerFrequency;  // Hz
+    float floorDb;
+    uint64_t frame;                      // STFT frame these were computed from
+
+    BandEnergies() : floorDb(-90.0f), frame(0) {}
+
+    size_t GetBandCount() const { return power.size(); }
+
+    // Band level mapped to 0..1 (floorDb..0 dB), convenient for visual parameters
+    float GetLevel(size_t band) const {
+        float level = 1.0f - decibels[band] / floorDb;
+        return level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+    }
+
+    // Mean level over a range of bands, given as fractions of the band count (0 if empty)
+    float GetMeanLevel(double first, double end) const {
+        size_t count = GetBandCount();
+        size_t from = static_cast<size_t>(count * first);
+        size_t to = static_cast<size_t>(count * end);
+        if (to <= from) to = from + 1;
+        if (to > count) return 0.0f;
+        float sum = 0.0f;
+        for (size_t band = from; band < to; ++band) {
+            sum += GetLevel(band);
+        }
+        return sum / static_cast<float>(to - from);
+    }
+};
+
+// Sparse filterbank over STFT magnitudes. Each band's weights are compiled into one
+// contiguous run of bins, padded to a multiple of 8 so the dot products need no
+// remainder handling, and all runs share a single weight array.
+class Filterbank {
+private:
+    // Runs are padded to this many bins (one AVX register)
+    static const size_t RUN_ALIGNMENT = 8;
+
+    struct BandRun {
+        uint32_t firstBin;
+        uint32_t length;        // Padded length
+        uint32_t weightOffset;  // Into weights
+    };
+
+    FilterbankSettings settings;
+    SimdLevel simdLevel;
+    size_t binCount;
+    std::vector<BandRun> runs;
+    std::vector<float> weights;
+    std::vector<float> centers;
+    size_t nonZeroWeights;
+
+public:
+    Filterbank();
+
+    bool Initialize(const FilterbankSettings& settings);
+
+    // Resize out for this filterbank (allocates; call once up front)
+    void PrepareOutput(BandEnergies& out) const;
+
+    // magnitude: binCount STFT magnitudes. out must have been prepared.
+    void Apply(const float* magnitude, BandEnergies& out) const;
+
+    // Expand the sparse weights into a dense bandCount x binCount matrix (row-major)
+    void BuildDenseMatrix(std::vector<float>& matrix) const;
+
+    size_t GetBandCount() const { return runs.size(); }
+    size_t GetBinCount() const { return binCount; }
+    size_t GetStoredWeightCount() const { return weights.size(); }
+    size_t GetNonZeroWeightCount() const { return nonZeroWeights; }
+    SimdLevel GetSimdLevel() const { return simdLevel; }
+    const FilterbankSettings& GetSettings() const { return settings; }
+};
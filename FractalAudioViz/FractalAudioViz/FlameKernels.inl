@@ -0,0 +1,137 @@
+// Chaos-game and tone-mapping kernels, written once over the lanes of SimdLanes.h that
+// the including namespace uses, after SimdMath.inl. FractalFlame.cpp includes this once
+// per instruction set, inside that set's target region. Nothing here may include headers
+// or call library math.
+
+// Run one slice's walkers, a lane each from its seed, for iterations steps past the first
+// few, adding each point that lands in the image to the histogram. Returns those plotted.
+inline uint64_t ChaosGame(const KernelParams& params, const uint32_t* seeds, uint64_t iterations,
+    FlameRenderer::Bin* histogram) {
+    const Vec zero = Set(0.0f);
+    const Vec one = Set(1.0f);
+    const Vec two = Set(2.0f);
+    const Vec half = Set(0.5f);
+    const Vec far = Set(1e10f);
+    const Vec tiny = Set(1e-10f);
+    const Vec left = Set(params.left);
+    const Vec top = Set(params.top);
+    const Vec pixelsPerUnit = Set(params.pixelsPerUnit);
+    const float width = static_cast<float>(params.width);
+    const float height = static_cast<float>(params.height);
+    const int last = params.transformCount - 1;
+
+    Random random = LoadRandom(seeds);
+    Vec x = Sub(Mul(NextRandom(random), two), one);
+    Vec y = Sub(Mul(NextRandom(random), two), one);
+    Vec color = NextRandom(random);
+
+    uint64_t plotted = 0;
+    float px[LANES];
+    float py[LANES];
+    float pc[LANES];
+    for (uint64_t i = 0; i < iterations + FLAME_FUSE; ++i) {
+        // Each lane's transform by where its draw falls among the cumulative weights,
+        // from the last down so the first that fits wins
+        Vec pick = NextRandom(random);
+        Vec m[6], w[FLAME_VARIATION_COUNT];
+        for (int k = 0; k < 6; ++k) m[k] = Set(params.affine[last][k]);
+        for (size_t v = 0; v < FLAME_VARIATION_COUNT; ++v) w[v] = Set(params.variations[last][v]);
+        Vec target = Set(params.color[last]);
+        for (int t = last - 1; t >= 0; --t) {
+            Mask chosen = Less(pick, Set(params.cumulative[t]));
+            for (int k = 0; k < 6; ++k) m[k] = Select(chosen, Set(params.affine[t][k]), m[k]);
+            for (size_t v = 0; v < FLAME_VARIATION_COUNT; ++v) {
+                if (params.uses[v]) w[v] = Select(chosen, Set(params.variations[t][v]), w[v]);
+            }
+            target = Select(chosen, Set(params.color[t]), target);
+        }
+
+        Vec tx = MulAdd(m[0], x, MulAdd(m[1], y, m[2]));
+        Vec ty = MulAdd(m[3], x, MulAdd(m[4], y, m[5]));
+        Vec r2 = Add(MulAdd(tx, tx, Mul(ty, ty)), tiny);
+
+        // The variations in use, in FlameVariation order
+        Vec nx = zero, ny = zero;
+        if (params.uses[0]) {
+            nx = MulAdd(w[0], tx, nx);
+            ny = MulAdd(w[0], ty, ny);
+        }
+        if (params.uses[1]) {
+            Vec sx, cx, sy, cy;
+            SinCos(tx, sx, cx);
+            SinCos(ty, sy, cy);
+            nx = MulAdd(w[1], sx, nx);
+            ny = MulAdd(w[1], sy, ny);
+        }
+        if (params.uses[2]) {
+            Vec scale = Div(w[2], r2);
+            nx = MulAdd(scale, tx, nx);
+            ny = MulAdd(scale, ty, ny);
+        }
+        if (params.uses[3]) {
+            Vec s, c;
+            SinCos(r2, s, c);
+            nx = MulAdd(w[3], Sub(Mul(tx, s), Mul(ty, c)), nx);
+            ny = MulAdd(w[3], MulAdd(tx, c, Mul(ty, s)), ny);
+        }
+        if (params.uses[4] || params.uses[5]) {
+            Vec r = Sqrt(r2);
+            if (params.uses[4]) {
+                Vec scale = Div(w[4], r);
+                nx = MulAdd(scale, Mul(Sub(tx, ty), Add(tx, ty)), nx);
+                ny = MulAdd(scale, Mul(Add(tx, tx), ty), ny);
+            }
+            if (params.uses[5]) {
+                nx = MulAdd(w[5], Mul(Atan2(tx, ty), Set(0.318309886f)), nx);
+                ny = MulAdd(w[5], Sub(r, one), ny);
+            }
+        }
+
+        // A lane thrown far out, or to NaN, starts over somewhere in the unit square
+        Mask finite = Less(Max(Abs(nx), Abs(ny)), far);
+        x = Select(finite, nx, Sub(Mul(NextRandom(random), two), one));
+        y = Select(finite, ny, Sub(Mul(NextRandom(random), two), one));
+        color = Mul(Add(color, target), half);
+        if (i < FLAME_FUSE) {
+            continue;
+        }
+
+        // The histogram is scattered to a lane at a time; its pixels are far apart
+        Store(px, Mul(Sub(x, left), pixelsPerUnit));
+        Store(py, Mul(Sub(top, y), pixelsPerUnit));
+        Store(pc, Mul(color, Set(static_cast<float>(FLAME_PALETTE_SIZE - 1))));
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            if (px[lane] >= 0.0f && px[lane] < width && py[lane] >= 0.0f && py[lane] < height) {
+                FlameRenderer::Bin& bin = histogram[static_cast<size_t>(py[lane]) * params.width +
+                    static_cast<size_t>(px[lane])];
+                const float* rgb = params.palette + 3 * static_cast<size_t>(pc[lane] + 0.5f);
+                bin.red += rgb[0];
+                bin.green += rgb[1];
+                bin.blue += rgb[2];
+                bin.count += 1.0f;
+                ++plotted;
+            }
+        }
+    }
+    return plotted;
+}
+
+// Tone-map count pixels, a whole number of vectors, from the merged planes: alpha is
+// the brightness times log(1 + hits * densityScale), up to 1, raised to 1 / gamma, and
+// scales the pixel's mean color. Channels are written as 0-255 floats for packing.
+inline void ToneMap(const float* density, const float* red, const float* green, const float* blue, size_t count,
+    float densityScale, float brightness, float inverseGamma, float* outRed, float* outGreen, float* outBlue) {
+    const Vec zero = Set(0.0f);
+    const Vec one = Set(1.0f);
+    const Vec full = Set(255.0f);
+    const Vec smallest = Set(1e-30f);
+    for (size_t i = 0; i < count; i += LANES) {
+        Vec hits = Load(density + i);
+        Vec alpha = Min(Mul(Set(brightness), Log(MulAdd(hits, Set(densityScale), one))), one);
+        Vec gammaAlpha = Exp(Mul(Log(Max(alpha, smallest)), Set(inverseGamma)));
+        Vec scale = Select(Less(zero, hits), Div(Mul(gammaAlpha, full), Max(hits, one)), zero);
+        Store(outRed + i, Min(Mul(Load(red + i), scale), full));
+        Store(outGreen + i, Min(Mul(Load(green + i), scale), full));
+        Store(outBlue + i, Min(Mul(Load(blue + i), scale), full));
+    }
+}
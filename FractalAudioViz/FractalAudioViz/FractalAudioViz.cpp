@@ -10,8 +10,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     _In_ int       nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
 
     // Initialize our custom window with game loop
-    return InitWindow(hInstance, nCmdShow) ? 0 : 1;
+    return InitWindow(hInstance, nCmdShow, lpCmdLine) ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "FractalFlame.h"
+#include "EscapeTime.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "SimdLanes.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+    // Steps each walker takes to reach the attractor before it plots
+    const uint64_t FLAME_FUSE = 20;
+
+    // Entries in the color table the walkers' palette positions index
+    const size_t FLAME_PALETTE_SIZE = 256;
+
+    // Pixels per job when merging and tone mapping, a whole number of vectors at every level
+    const size_t CHUNK_PIXELS = 16384;
+
+    // FlameParams as the kernels use them, derived once per Render: the transforms'
+    // weights as cumulative fractions, and the view as pixel (x, y) =
+    // ((x - left), (top - y)) * pixelsPerUnit
+    struct KernelParams {
+        int transformCount;
+        float cumulative[FlameParams::MAX_TRANSFORMS];
+        float affine[FlameParams::MAX_TRANSFORMS][6];
+        float variations[FlameParams::MAX_TRANSFORMS][FLAME_VARIATION_COUNT];
+        float color[FlameParams::MAX_TRANSFORMS];
+        bool uses[FLAME_VARIATION_COUNT];           // By any transform
+        float left;
+        float top;
+        float pixelsPerUnit;
+        size_t width;
+        size_t height;
+        const float* palette;                       // FLAME_PALETTE_SIZE RGB triples, 0-1
+    };
+
+    KernelParams MakeKernelParams(const FlameParams& params, size_t width, size_t height, const float* palette) {
+        KernelParams kernel = {};
+        const size_t count = std::min(std::max<size_t>(params.transformCount, 1), FlameParams::MAX_TRANSFORMS);
+        kernel.transformCount = static_cast<int>(count);
+
+        float total = 0.0f;
+        for (size_t t = 0; t < count; ++t) total += std::max(params.transforms[t].weight, 0.0f);
+        float sum = 0.0f;
+        for (size_t t = 0; t < count; ++t) {
+            const FlameTransform& transform = params.transforms[t];
+            sum += std::max(transform.weight, 0.0f);
+            kernel.cumulative[t] = total > 0.0f ? sum / total : static_cast<float>(t + 1) / count;
+            std::copy(transform.affine, transform.affine + 6, kernel.affine[t]);
+            for (size_t v = 0; v < FLAME_VARIATION_COUNT; ++v) {
+                kernel.variations[t][v] = transform.variations[v];
+                kernel.uses[v] = kernel.uses[v] || transform.variations[v] != 0.0f;
+            }
+            kernel.color[t] = std::min(std::max(transform.color, 0.0f), 1.0f);
+        }
+
+        kernel.pixelsPerUnit = static_cast<float>(height) / params.viewHeight;
+        kernel.left = params.centerX - 0.5f * static_cast<float>(width) / kernel.pixelsPerUnit;
+        kernel.top = params.centerY + 0.5f * static_cast<float>(height) / kernel.pixelsPerUnit;
+        kernel.width = width;
+        kernel.height = height;
+        kernel.palette = palette;
+        return kernel;
+    }
+
+    namespace ScalarKernels {
+        using namespace SimdLanes::Scalar;
+#include "SimdMath.inl"
+#include "FlameKernels.inl"
+    }
+
+#if FAV_X86
+    namespace SseKernels {
+        using namespace SimdLanes::Sse;
+#include "SimdMath.inl"
+#include "FlameKernels.inl"
+    }
+
+FAV_BEGIN_TARGET_AVX2
+    namespace Avx2Kernels {
+        using namespace SimdLanes::Avx2;
+#include "SimdMath.inl"
+#include "FlameKernels.inl"
+    }
+FAV_END_TARGET
+
+// GCC reports the self-initialized _mm512_undefined_ps inside the unmasked intrinsics as
+// uninitialized once they are inlined into these kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+FAV_BEGIN_TARGET_AVX512
+    namespace Avx512Kernels {
+        using namespace SimdLanes::Avx512;
+#include "SimdMath.inl"
+#include "FlameKernels.inl"
+    }
+FAV_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+    struct Kernels {
+        uint64_t (*chaosGame)(const KernelParams&, const uint32_t*, uint64_t, FlameRenderer::Bin*);
+        void (*toneMap)(const float*, const float*, const float*, const float*, size_t, float, float, float, float*,
+            float*, float*);
+        size_t lanes;
+    };
+
+    // AVX without AVX2 has no 256-bit integer operations for the generators, so it runs
+    // the SSE2 kernels
+    Kernels SelectKernels(SimdLevel maxSimdLevel) {
+        SimdLevel level = ResolveSimdLevel(maxSimdLevel);
+#if FAV_X86
+        if (level >= SimdLevel::AVX512) return { Avx512Kernels::ChaosGame, Avx512Kernels::ToneMap, 16 };
+        if (level >= SimdLevel::AVX2) return { Avx2Kernels::ChaosGame, Avx2Kernels::ToneMap, 8 };
+        if (level >= SimdLevel::SSE2) return { SseKernels::ChaosGame, SseKernels::ToneMap, 4 };
+#endif
+        (void)level;
+        return { ScalarKernels::ChaosGame, ScalarKernels::ToneMap, 1 };
+    }
+
+    // The escape-time backdrop's palette over one cycle, as RGB from 0 to 1
+    struct FlamePalette {
+        float colors[3 * FLAME_PALETTE_SIZE];
+
+        FlamePalette() {
+            for (size_t i = 0; i < FLAME_PALETTE_SIZE; ++i) {
+                uint32_t color = EscapeTimeRenderer::GetColor(static_cast<float>(i) / FLAME_PALETTE_SIZE, 1.0f, 0.0f);
+                for (int channel = 0; channel < 3; ++channel) {
+                    colors[3 * i + channel] = static_cast<float>((color >> (8 * channel)) & 0xFF) / 255.0f;
+                }
+            }
+        }
+    };
+
+    const FlamePalette& GetPalette() {
+        static const FlamePalette palette;
+        return palette;
+    }
+
+    // Distinct, nonzero generator states from the seed, the slice and the lane
+    // (lowbias32, a 32-bit integer hash)
+    uint32_t SeedHash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x != 0 ? x : 1;
+    }
+
+    // Per-thread tone-mapped channels of a chunk, reused across chunks and frames
+    std::vector<float>& GetToneScratch() {
+        thread_local std::vector<float> channels;
+        return channels;
+    }
+
+    size_t PaddedSize(size_t pixels) {
+        return (pixels + CHUNK_PIXELS - 1) / CHUNK_PIXELS * CHUNK_PIXELS;
+    }
+}
+
+FlameParams::FlameParams() :
+    transformCount(3),
+    centerX(0.0f),
+    centerY(0.0f),
+    viewHeight(3.0f),
+    brightness(0.3f),
+    gamma(2.2f)
+{
+    const float affine[3][6] = {
+        { 0.56f, -0.42f, 0.1f, 0.42f, 0.56f, 0.0f },
+        { 0.5f, 0.0f, 0.5f, 0.0f, 0.5f, 0.5f },
+        { -0.3f, 0.6f, -0.5f, -0.6f, -0.3f, 0.3f },
+    };
+    const float blend[3][2] = { { 0.6f, 0.4f }, { 0.5f, 0.5f }, { 0.3f, 0.7f } };
+    const FlameVariation second[3] = { FlameVariation::Spherical, FlameVariation::Swirl, FlameVariation::Sinusoidal };
+    for (size_t t = 0; t < 3; ++t) {
+        FlameTransform& transform = transforms[t];
+        std::copy(affine[t], affine[t] + 6, transform.affine);
+        transform.variations[static_cast<size_t>(FlameVariation::Linear)] = blend[t][0];
+        transform.variations[static_cast<size_t>(second[t])] = blend[t][1];
+        transform.color = 0.5f * t;
+    }
+}
+
+bool FlameRenderer::Initialize(const FlameSettings& newSettings) {
+    settings = newSettings;
+    return Resize(newSettings.width, newSettings.height);
+}
+
+bool FlameRenderer::Resize(size_t width, size_t height) {
+    if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE) {
+        return false;
+    }
+    settings.width = width;
+    settings.height = height;
+    pixels.assign(width * height, 0xFF000000u);
+
+    // The private histograms are sized by the threads that fill them
+    slices.clear();
+    const size_t padded = PaddedSize(width * height);
+    density.assign(padded, 0.0f);
+    red.assign(padded, 0.0f);
+    green.assign(padded, 0.0f);
+    blue.assign(padded, 0.0f);
+    stats = FlameStats();
+    return true;
+}
+
+void FlameRenderer::Render(const FlameParams& params, JobSystem* jobs) {
+    const double start = FrameStats::NowSeconds();
+    const size_t width = settings.width, height = settings.height, pixelCount = width * height;
+    const Kernels kernels = SelectKernels(settings.maxSimdLevel);
+    const KernelParams kernel = MakeKernelParams(params, width, height, GetPalette().colors);
+
+    unsigned threads = settings.threadCount;
+    if (jobs) threads = static_cast<unsigned>(jobs->GetThreadCount());
+    else if (threads == 0) threads = std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+
+    // A slice per thread, its histogram cleared on the thread that fills it so its pages
+    // land near it
+    slices.resize(threads);
+    const uint64_t walkers = static_cast<uint64_t>(threads) * kernels.lanes;
+    const uint64_t steps = (settings.points + walkers - 1) / walkers;
+    std::vector<uint64_t> plotted(threads, 0);
+    ParallelForEach(threads, jobs, threads, [&](size_t s) {
+        std::vector<Bin>& histogram = slices[s];
+        histogram.assign(pixelCount, Bin());
+        uint32_t seeds[16];
+        for (size_t lane = 0; lane < kernels.lanes; ++lane) {
+            seeds[lane] = SeedHash(settings.seed * 0x9E3779B9u + static_cast<uint32_t>(s * 16 + lane));
+        }
+        plotted[s] = kernels.chaosGame(kernel, seeds, steps, histogram.data());
+    });
+    const double merged = FrameStats::NowSeconds();
+    stats.iterateSeconds = merged - start;
+
+    // Each job sums its range of pixels across every slice, so no two write the same one
+    const size_t chunks = PaddedSize(pixelCount) / CHUNK_PIXELS;
+    ParallelForEach(chunks, jobs, threads, [&](size_t chunk) {
+        const size_t begin = chunk * CHUNK_PIXELS, end = std::min(begin + CHUNK_PIXELS, pixelCount);
+        for (size_t i = begin; i < end; ++i) {
+            Bin sum = slices[0][i];
+            for (size_t s = 1; s < slices.size(); ++s) {
+                const Bin& bin = slices[s][i];
+                sum.red += bin.red;
+                sum.green += bin.green;
+                sum.blue += bin.blue;
+                sum.count += bin.count;
+            }
+            density[i] = sum.count;
+            red[i] = sum.red;
+            green[i] = sum.green;
+            blue[i] = sum.blue;
+        }
+    });
+    const double toned = FrameStats::NowSeconds();
+    stats.mergeSeconds = toned - merged;
+
+    // Hits scaled so the mean over the image is 1, whatever the point count
+    stats.plotted = 0;
+    for (uint64_t count : plotted) stats.plotted += count;
+    const float densityScale = static_cast<float>(static_cast<double>(pixelCount) / std::max<uint64_t>(1, stats.plotted));
+    const float inverseGamma = 1.0f / std::max(params.gamma, 0.01f);
+    ParallelForEach(chunks, jobs, threads, [&](size_t chunk) {
+        const size_t begin = chunk * CHUNK_PIXELS, end = std::min(begin + CHUNK_PIXELS, pixelCount);
+        std::vector<float>& channels = GetToneScratch();
+        channels.resize(3 * CHUNK_PIXELS);
+        float* r = channels.data();
+        float* g = r + CHUNK_PIXELS;
+        float* b = g + CHUNK_PIXELS;
+        kernels.toneMap(density.data() + begin, red.data() + begin, green.data() + begin, blue.data() + begin,
+            CHUNK_PIXELS, densityScale, params.brightness, inverseGamma, r, g, b);
+        for (size_t i = begin; i < end; ++i) {
+            size_t k = i - begin;
+            pixels[i] = 0xFF000000u | static_cast<uint32_t>(r[k] + 0.5f) | static_cast<uint32_t>(g[k] + 0.5f) << 8 |
+                static_cast<uint32_t>(b[k] + 0.5f) << 16;
+        }
+    });
+
+    stats.slices = threads;
+    stats.points = steps * walkers;
+    stats.toneSeconds = FrameStats::NowSeconds() - toned;
+    stats.seconds = FrameStats::NowSeconds() - start;
+    stats.histogramBytes = GetHistogramBytes(width, height, threads);
+}
+
+size_t FlameRenderer::GetLaneCount(SimdLevel level) {
+    return SelectKernels(level).lanes;
+}
+
+size_t FlameRenderer::GetHistogramBytes(size_t width, size_t height, size_t threads) {
+    return width * height * sizeof(Bin) * threads + PaddedSize(width * height) * 4 * sizeof(float);
+}
+
+FlameParams FlameRenderer::Modulate(const FlameParams& base, const BandEnergies& bands,
+    const FlameModulation& modulation) {
+    const float bass = bands.GetMeanLevel(0.0, 0.125);
+    const float mids = bands.GetMeanLevel(0.125, 0.5);
+    const float treble = bands.GetMeanLevel(0.5, 1.0);
+    const struct {
+        FlameVariation variation;
+        float amount;
+    } moves[] = {
+        { FlameVariation::Spherical, modulation.sphericalDepth * bass },
+        { FlameVariation::Swirl, modulation.swirlDepth * mids },
+        { FlameVariation::Sinusoidal, modulation.sinusoidalDepth * treble },
+    };
+
+    FlameParams params = base;
+    for (size_t t = 0; t < params.transformCount && t < FlameParams::MAX_TRANSFORMS; ++t) {
+        for (const auto& move : moves) {
+            float& weight = params.transforms[t].variations[static_cast<size_t>(move.variation)];
+            if (weight != 0.0f) weight += move.amount;
+        }
+    }
+    return params;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Filterbank.h"
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// The nonlinear functions a transform blends after its affine map
+enum class FlameVariation {
+    Linear,      // (x, y)
+    Sinusoidal,  // (sin x, sin y)
+    Spherical,   // (x, y) / r^2
+    Swirl,       // Turned by r^2
+    Horseshoe,   // ((x - y)(x + y), 2xy) / r
+    Polar,       // (angle / pi, r - 1)
+    Count
+};
+
+const size_t FLAME_VARIATION_COUNT = static_cast<size_t>(FlameVariation::Count);
+
+struct FlameTransform {
+    float weight;                               // Relative chance of being picked
+    float affine[6];                            // x' = a x + b y + c, y' = d x + e y + f
+    float variations[FLAME_VARIATION_COUNT];    // Blend of the variations, by FlameVariation
+    float color;                                // Palette position the point's color moves halfway to
+
+    FlameTransform() : weight(1.0f), affine{ 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }, variations{ 1.0f }, color(0.0f) {}
+};
+
+struct FlameParams {
+    static const size_t MAX_TRANSFORMS = 8;
+
+    FlameTransform transforms[MAX_TRANSFORMS];
+    size_t transformCount;
+    float centerX;        // View center on the plane
+    float centerY;
+    float viewHeight;     // The width follows the aspect
+    float brightness;     // Alpha per unit of log density
+    float gamma;
+
+    // Three transforms: a turning spherical contraction, a swirled one toward the corner
+    // and a sinusoidal fold
+    FlameParams();
+};
+
+// How far the variation weights move at full band level, with the bands split as for
+// the distance estimators: the bass is the lowest eighth, the mids up to half, the
+// treble the rest. Each is added to every transform that already uses the variation.
+struct FlameModulation {
+    float sphericalDepth;   // By the bass
+    float swirlDepth;       // By the mids
+    float sinusoidalDepth;  // By the treble
+
+    FlameModulation() :
+        sphericalDepth(0.6f),
+        swirlDepth(0.8f),
+        sinusoidalDepth(0.5f)
+    {}
+};
+
+struct FlameSettings {
+    size_t width;           // Of the image and its histograms, in pixels
+    size_t height;
+    uint64_t points;        // Iterated per Render, split evenly across the threads
+    unsigned threadCount;   // Without a job system, 0 = one per hardware thread
+    uint32_t seed;          // Of every thread's generators; the same seed, points and
+                            // thread count give the same image
+    SimdLevel maxSimdLevel;
+
+    FlameSettings() :
+        width(1280),
+        height(720),
+        points(4000000),
+        threadCount(0),
+        seed(1),
+        maxSimdLevel(SimdLevel::AVX512)
+    {}
+};
+
+// What the last Render did
+struct FlameStats {
+    size_t slices;              // Private histograms, one per thread
+    uint64_t points;            // Iterated, past each walker's first few
+    uint64_t plotted;           // Of those, the ones that landed in the image
+    double iterateSeconds;      // Wall time of the chaos game, clearing the histograms included
+    double mergeSeconds;
+    double toneSeconds;
+    double seconds;             // Wall time of the whole Render
+    size_t histogramBytes;      // Private histograms and the merged one
+
+    FlameStats() :
+        slices(0), points(0), plotted(0), iterateSeconds(0.0), mergeSeconds(0.0), toneSeconds(0.0), seconds(0.0),
+        histogramBytes(0)
+    {}
+};
+
+// Renders fractal flames by the chaos game: points hop between randomly picked
+// transforms and land on the attractor, and the image is the log of how often each pixel
+// was hit. Each thread runs 1, 4, 8 or 16 points at a time (scalar, SSE2, AVX2, AVX-512),
+// each lane with its own generator, into a histogram of its own, so the threads never
+// share a cache line while plotting. The histograms are then summed in parallel, each
+// thread taking a range of pixels across all of them, into planes of density and color
+// that the tone mapping reads a vector at a time.
+class FlameRenderer {
+public:
+    // Largest image edge Initialize accepts
+    static const size_t MAX_SIZE = 8192;
+
+    // A private histogram's pixel: summed palette color and hits
+    struct Bin {
+        float red;
+        float green;
+        float blue;
+        float count;
+    };
+
+private:
+    FlameSettings settings;
+    std::vector<uint32_t> pixels;
+    std::vector<std::vector<Bin>> slices;   // One per thread
+    std::vector<float> density;             // Merged, padded to a whole number of vectors
+    std::vector<float> red;
+    std::vector<float> green;
+    std::vector<float> blue;
+    FlameStats stats;
+
+public:
+    // False if the width or height is 0 or over MAX_SIZE
+    bool Initialize(const FlameSettings& settings);
+    bool Resize(size_t width, size_t height);
+
+    // Iterate settings.points points of this frame's flame and tone-map them. With a job
+    // system there is a histogram per thread of it and the slices are its jobs.
+    void Render(const FlameParams& params, JobSystem* jobs = nullptr);
+
+    void SetPoints(uint64_t points) { settings.points = points; }
+
+    const uint32_t* GetPixels() const { return pixels.data(); }
+    size_t GetWidth() const { return settings.width; }
+    size_t GetHeight() const { return settings.height; }
+    size_t GetPitch() const { return settings.width * sizeof(uint32_t); }
+    const FlameStats& GetStats() const { return stats; }
+    const FlameSettings& GetSettings() const { return settings; }
+
+    // Merged hits per pixel, row by row
+    const float* GetDensity() const { return density.data(); }
+
+    // Pixels per kernel call at a level (after clamping it to the machine)
+    static size_t GetLaneCount(SimdLevel level);
+
+    // Histogram memory for an image of this size rendered on this many threads
+    static size_t GetHistogramBytes(size_t width, size_t height, size_t threads);
+
+    // Parameters for this frame from the base ones and the band levels
+    static FlameParams Modulate(const FlameParams& base, const BandEnergies& bands,
+        const FlameModulation& modulation = FlameModulation());
+};
@@ -0,0 +1,184 @@
+#include "FractalGenerator.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+    FractalChildTable BuildChildTable(FractalType type) {
+        FractalChildTable table = {};
+        if (type == FractalType::Sierpinski) {
+            // Octants whose coordinate signs multiply to -1: the corners of a tetrahedron
+            const float corners[4][3] = { { -1, -1, -1 }, { 1, 1, -1 }, { 1, -1, 1 }, { -1, 1, 1 } };
+            table.childScale = 0.5f;
+            for (size_t c = 0; c < 4; ++c) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    table.offset[c][axis] = 0.5f * corners[c][axis];
+                }
+            }
+            table.count = 4;
+            return table;
+        }
+
+        // Menger: the 3x3x3 grid minus the center and the six face centers
+        table.childScale = 1.0f / 3.0f;
+        for (int i = -1; i <= 1; ++i) {
+            for (int j = -1; j <= 1; ++j) {
+                for (int k = -1; k <= 1; ++k) {
+                    int zeros = (i == 0) + (j == 0) + (k == 0);
+                    if (zeros >= 2) continue;
+                    table.offset[table.count][0] = 2.0f / 3.0f * i;
+                    table.offset[table.count][1] = 2.0f / 3.0f * j;
+                    table.offset[table.count][2] = 2.0f / 3.0f * k;
+                    ++table.count;
+                }
+            }
+        }
+        return table;
+    }
+
+    uint32_t PackColor(float r, float g, float b) {
+        uint32_t ri = static_cast<uint32_t>(r * 255.0f + 0.5f);
+        uint32_t gi = static_cast<uint32_t>(g * 255.0f + 0.5f);
+        uint32_t bi = static_cast<uint32_t>(b * 255.0f + 0.5f);
+        return ri | (gi << 8) | (bi << 16) | (0xFFu << 24);
+    }
+
+    // Color follows position within the root cube
+    uint32_t InstanceColor(float x, float y, float z, float centerX, float centerY, float centerZ, float colorScale) {
+        float r = 0.5f + (x - centerX) * colorScale;
+        float g = 0.5f + (y - centerY) * colorScale;
+        float b = 0.5f + (z - centerZ) * colorScale;
+        return PackColor(0.3f + 0.7f * r, 0.3f + 0.7f * g, 0.3f + 0.7f * b);
+    }
+
+    // Writes the leaves of one subtree, depth first, into consecutive slots
+    class SubtreeWriter {
+    private:
+        const FractalChildTable& table;
+        FractalInstances& out;
+        float centerX, centerY, centerZ;
+        float colorScale;
+
+        void Leaf(size_t index, float x, float y, float z, float half) {
+            out.x[index] = x;
+            out.y[index] = y;
+            out.z[index] = z;
+            out.scale[index] = half;
+            out.color[index] = InstanceColor(x, y, z, centerX, centerY, centerZ, colorScale);
+        }
+
+    public:
+        SubtreeWriter(const FractalChildTable& childTable, FractalInstances& instances, const FractalSettings& settings) :
+            table(childTable),
+            out(instances),
+            centerX(settings.centerX),
+            centerY(settings.centerY),
+            centerZ(settings.centerZ),
+            colorScale(0.5f / settings.halfExtent)
+        {}
+
+        void Emit(float x, float y, float z, float half, int depth, size_t& index) {
+            if (depth == 0) {
+                Leaf(index++, x, y, z, half);
+                return;
+            }
+
+            float childHalf = half * table.childScale;
+            if (depth == 1) {
+                // Last level written in one flat loop rather than another call per child
+                for (size_t c = 0; c < table.count; ++c) {
+                    Leaf(index++, x + table.offset[c][0] * half, y + table.offset[c][1] * half,
+                        z + table.offset[c][2] * half, childHalf);
+                }
+                return;
+            }
+
+            for (size_t c = 0; c < table.count; ++c) {
+                Emit(x + table.offset[c][0] * half, y + table.offset[c][1] * half,
+                    z + table.offset[c][2] * half, childHalf, depth - 1, index);
+            }
+        }
+    };
+
+    size_t IntegerPower(size_t base, int exponent) {
+        size_t result = 1;
+        for (int i = 0; i < exponent; ++i) result *= base;
+        return result;
+    }
+}
+
+void FractalInstances::Resize(size_t instanceCount) {
+    x.resize(instanceCount);
+    y.resize(instanceCount);
+    z.resize(instanceCount);
+    scale.resize(instanceCount);
+    color.resize(instanceCount);
+    count = instanceCount;
+}
+
+FractalChildTable FractalGenerator::GetChildTable(FractalType type) {
+    return BuildChildTable(type);
+}
+
+uint32_t FractalGenerator::GetColor(const FractalSettings& settings, float x, float y, float z) {
+    return InstanceColor(x, y, z, settings.centerX, settings.centerY, settings.centerZ, 0.5f / settings.halfExtent);
+}
+
+size_t FractalGenerator::GetBranchFactor(FractalType type) {
+    return type == FractalType::Sierpinski ? 4 : 20;
+}
+
+size_t FractalGenerator::GetInstanceCount(FractalType type, int depth) {
+    if (depth < 0) return 0;
+
+    size_t branch = GetBranchFactor(type);
+    size_t count = 1;
+    for (int i = 0; i < depth; ++i) {
+        count *= branch;
+        if (count > MAX_INSTANCES) return 0;
+    }
+    return count;
+}
+
+bool FractalGenerator::Generate(const FractalSettings& settings, FractalInstances& instances, JobSystem* jobs) {
+    size_t total = GetInstanceCount(settings.type, settings.depth);
+    if (total == 0 || settings.halfExtent <= 0.0f) {
+        return false;
+    }
+
+    const FractalChildTable table = BuildChildTable(settings.type);
+    instances.Resize(total);
+
+    unsigned threads = jobs ? static_cast<unsigned>(jobs->GetThreadCount()) : settings.threadCount;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Split deep enough for a few subtrees per thread, so uneven scheduling evens out
+    int splitLevel = 0;
+    size_t subtreeCount = 1;
+    while (splitLevel < settings.depth && subtreeCount < 4 * static_cast<size_t>(threads)) {
+        subtreeCount *= table.count;
+        ++splitLevel;
+    }
+    const size_t leavesPerSubtree = IntegerPower(table.count, settings.depth - splitLevel);
+
+    ParallelForEach(subtreeCount, jobs, threads, [&](size_t subtree) {
+        // Walk the subtree index's base-N digits down to its root cube
+        float x = settings.centerX;
+        float y = settings.centerY;
+        float z = settings.centerZ;
+        float half = settings.halfExtent;
+        size_t divisor = subtreeCount;
+        for (int level = 0; level < splitLevel; ++level) {
+            divisor /= table.count;
+            size_t child = (subtree / divisor) % table.count;
+            x += table.offset[child][0] * half;
+            y += table.offset[child][1] * half;
+            z += table.offset[child][2] * half;
+            half *= table.childScale;
+        }
+
+        size_t index = subtree * leavesPerSubtree;
+        SubtreeWriter(table, instances, settings).Emit(x, y, z, half, settings.depth - splitLevel, index);
+    });
+    return true;
+}
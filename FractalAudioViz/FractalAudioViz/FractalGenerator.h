@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Cube-based recursive fractals
+enum class FractalType {
+    MengerSponge,  // 20 of 27 sub-cubes kept per level
+    Sierpinski     // 4 alternating octants kept per level (a tetrahedron built from cubes)
+};
+
+struct FractalSettings {
+    FractalType type;
+    int depth;            // Recursion levels; 0 = the root cube alone
+    float centerX;
+    float centerY;
+    float centerZ;
+    float halfExtent;     // Half the root cube's edge length
+    unsigned threadCount; // Worker threads, 0 = one per hardware thread
+
+    FractalSettings() :
+        type(FractalType::MengerSponge),
+        depth(3),
+        centerX(0.0f),
+        centerY(0.0f),
+        centerZ(0.0f),
+        halfExtent(1.0f),
+        threadCount(0)
+    {}
+};
+
+// Per-instance data in structure-of-arrays form, one entry per leaf cube. Each array
+// uploads as is into its own range of the GPU instance buffer.
+struct FractalInstances {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> scale;     // Half extent, matching the -1..1 unit cube mesh
+    std::vector<uint32_t> color;  // R8G8B8A8, red in the low byte
+    size_t count;
+
+    FractalInstances() : count(0) {}
+
+    // Size the arrays for count instances (keeps capacity when shrinking)
+    void Resize(size_t instanceCount);
+};
+
+// Where a cube's children go, offsets in units of the parent's half extent
+struct FractalChildTable {
+    size_t count;
+    float childScale;
+    float offset[20][3];
+};
+
+// Builds fractal instance lists. The tree is split into equal subtrees at a fixed level and
+// each subtree writes straight into its own precomputed range of the output, so threads
+// never share cache lines and the result is identical for any thread count.
+class FractalGenerator {
+public:
+    // Upper bound on a single generation (3.2M, a depth 5 Menger sponge)
+    static const size_t MAX_INSTANCES = 3200000;
+
+    // Leaf count for a fractal of this type and depth (0 if it overflows MAX_INSTANCES)
+    static size_t GetInstanceCount(FractalType type, int depth);
+
+    // Children per level
+    static size_t GetBranchFactor(FractalType type);
+
+    // Child placement per level, and the color of a leaf cube centered at x, y, z; shared
+    // with FractalLod so both produce the same cubes
+    static FractalChildTable GetChildTable(FractalType type);
+    static uint32_t GetColor(const FractalSettings& settings, float x, float y, float z);
+
+    // Fill instances for settings; false if the depth is out of range. With a job system
+    // the subtrees are jobs on its threads and threadCount is ignored.
+    static bool Generate(const FractalSettings& settings, FractalInstances& instances, JobSystem* jobs = nullptr);
+};
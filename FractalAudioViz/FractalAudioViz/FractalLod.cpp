@@ -0,0 +1,217 @@
+#include "FractalLod.h"
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Distance from a cube's center to its corners, in half extents
+    const float CORNER_DISTANCE = 1.7320508f;
+
+    // Splits between clock reads while a time budget is running
+    const size_t CLOCK_STRIDE = 8;
+}
+
+FractalLod::FractalLod() :
+    table(),
+    pixelScale(0.0f),
+    leafCount(0)
+{}
+
+bool FractalLod::Initialize(const FractalSettings& fractalSettings, const FractalLodSettings& lodSettings) {
+    if (fractalSettings.depth < 0 || fractalSettings.halfExtent <= 0.0f) {
+        return false;
+    }
+
+    fractal = fractalSettings;
+    settings = lodSettings;
+    table = FractalGenerator::GetChildTable(fractal.type);
+    SetViewport(settings.fieldOfView, settings.viewportHeight);
+
+    Node root;
+    root.x = fractal.centerX;
+    root.y = fractal.centerY;
+    root.z = fractal.centerZ;
+    root.half = fractal.halfExtent;
+    root.firstChild = -1;
+    root.depth = 0;
+    nodes.assign(1, root);
+    freeBlocks.clear();
+    leafCount = 1;
+
+    stats = FractalLodStats();
+    EmitInstances();
+    stats.nodes = 1;
+    stats.instances = 1;
+    return true;
+}
+
+void FractalLod::SetViewport(float fieldOfView, float viewportHeight) {
+    settings.fieldOfView = fieldOfView;
+    settings.viewportHeight = viewportHeight;
+
+    // A cube of edge 2 * half at distance d covers 2 * half / d of the view's 2 * tan(fov / 2)
+    pixelScale = viewportHeight / std::tan(0.5f * fieldOfView);
+}
+
+float FractalLod::ProjectedPixels(const Node& node, const float eye[3]) const {
+    float dx = node.x - eye[0];
+    float dy = node.y - eye[1];
+    float dz = node.z - eye[2];
+
+    // Nearest point of the cube's bounding sphere; inside it, the cube fills the view
+    float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - node.half * CORNER_DISTANCE;
+    if (distance <= node.half * 1e-3f) {
+        return 1e30f;
+    }
+    return node.half * pixelScale / distance;
+}
+
+bool FractalLod::MergeAndCollect(int32_t index, const float eye[3], float mergePixels) {
+    const Node& node = nodes[index];
+    if (node.firstChild < 0) {
+        AddCandidate(index, eye);
+        return true;
+    }
+
+    // Children first, so a whole subtree that fell away collapses in one pass
+    int32_t first = node.firstChild;
+    bool leafChildren = true;
+    for (size_t c = 0; c < table.count; ++c) {
+        leafChildren &= MergeAndCollect(first + static_cast<int32_t>(c), eye, mergePixels);
+    }
+    if (!leafChildren || ProjectedPixels(nodes[index], eye) >= mergePixels) {
+        return false;
+    }
+
+    // The children may have been queued for splitting; they can't be any more
+    while (!candidates.empty() && candidates.back().second >= first &&
+        candidates.back().second < first + static_cast<int32_t>(table.count)) {
+        candidates.pop_back();
+    }
+    freeBlocks.push_back(first);
+    nodes[index].firstChild = -1;
+    leafCount -= table.count - 1;
+    ++stats.merges;
+    return true;
+}
+
+void FractalLod::AddCandidate(int32_t index, const float eye[3]) {
+    const Node& node = nodes[index];
+    if (node.depth >= fractal.depth) {
+        return;
+    }
+    float pixels = ProjectedPixels(node, eye);
+    if (pixels > settings.detailPixels) {
+        candidates.push_back(std::make_pair(pixels, index));
+    }
+}
+
+void FractalLod::Split(int32_t index) {
+    // Reuse a merged block, or grow the table (which may move the nodes)
+    int32_t first;
+    if (!freeBlocks.empty()) {
+        first = freeBlocks.back();
+        freeBlocks.pop_back();
+    }
+    else {
+        first = static_cast<int32_t>(nodes.size());
+        nodes.resize(nodes.size() + table.count);
+    }
+
+    // Same arithmetic as FractalGenerator, so fully refined subtrees match it exactly
+    Node parent = nodes[index];
+    float childHalf = parent.half * table.childScale;
+    for (size_t c = 0; c < table.count; ++c) {
+        Node& child = nodes[first + c];
+        child.x = parent.x + table.offset[c][0] * parent.half;
+        child.y = parent.y + table.offset[c][1] * parent.half;
+        child.z = parent.z + table.offset[c][2] * parent.half;
+        child.half = childHalf;
+        child.firstChild = -1;
+        child.depth = parent.depth + 1;
+    }
+    nodes[index].firstChild = first;
+    leafCount += table.count - 1;
+    ++stats.splits;
+}
+
+bool FractalLod::Update(const float eye[3]) {
+    double start = FrameStats::NowSeconds();
+    stats.splits = 0;
+    stats.merges = 0;
+    stats.pending = 0;
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    // One pass over the tree merges everything that has fallen under the lower threshold
+    // and queues the leaves that want splitting
+    candidates.clear();
+    MergeAndCollect(0, eye, settings.detailPixels * settings.mergeFraction);
+
+    // Then split the biggest first, queueing children that want splitting too, until
+    // nothing does or the budget runs out
+    std::make_heap(candidates.begin(), candidates.end());
+    double splitStart = FrameStats::NowSeconds();
+    while (!candidates.empty()) {
+        bool timeUp = settings.budgetSeconds > 0.0 && stats.splits % CLOCK_STRIDE == 0 &&
+            FrameStats::NowSeconds() - splitStart > settings.budgetSeconds;
+        bool splitsUp = settings.maxSplitsPerUpdate > 0 && stats.splits >= settings.maxSplitsPerUpdate;
+        bool full = leafCount + table.count - 1 > settings.maxInstances;
+        if (timeUp || splitsUp || full) {
+            break;
+        }
+
+        std::pop_heap(candidates.begin(), candidates.end());
+        int32_t index = candidates.back().second;
+        candidates.pop_back();
+        Split(index);
+
+        int32_t first = nodes[index].firstChild;
+        for (size_t c = 0; c < table.count; ++c) {
+            size_t before = candidates.size();
+            AddCandidate(first + static_cast<int32_t>(c), eye);
+            if (candidates.size() > before) {
+                std::push_heap(candidates.begin(), candidates.end());
+            }
+        }
+    }
+    stats.pending = candidates.size();
+
+    bool changed = stats.splits > 0 || stats.merges > 0;
+    if (changed) {
+        EmitInstances();
+    }
+
+    stats.nodes = nodes.size() - freeBlocks.size() * table.count;
+    stats.instances = leafCount;
+    stats.updateSeconds = FrameStats::NowSeconds() - start;
+    return changed;
+}
+
+void FractalLod::EmitLeaves(int32_t index, size_t& written) {
+    const Node& node = nodes[index];
+    if (node.firstChild >= 0) {
+        for (size_t c = 0; c < table.count; ++c) {
+            EmitLeaves(node.firstChild + static_cast<int32_t>(c), written);
+        }
+        return;
+    }
+
+    instances.x[written] = node.x;
+    instances.y[written] = node.y;
+    instances.z[written] = node.z;
+    instances.scale[written] = node.half;
+    instances.color[written] = FractalGenerator::GetColor(fractal, node.x, node.y, node.z);
+    stats.deepest = std::max(stats.deepest, static_cast<int>(node.depth));
+    ++written;
+}
+
+void FractalLod::EmitInstances() {
+    // Depth first in child order, the order FractalGenerator writes in
+    instances.Resize(leafCount);
+    stats.deepest = 0;
+    size_t written = 0;
+    EmitLeaves(0, written);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "FractalGenerator.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct FractalLodSettings {
+    float detailPixels;         // Split a cube while it covers more than this many pixels
+    float mergeFraction;        // Merge children back once their parent is under detailPixels times this
+    float fieldOfView;          // Vertical, radians, as the Camera's
+    float viewportHeight;       // Pixels
+    double budgetSeconds;       // Splitting time per Update, 0 = no limit
+    size_t maxSplitsPerUpdate;  // 0 = no limit; with no time limit this keeps runs repeatable
+    size_t maxInstances;
+
+    FractalLodSettings() :
+        detailPixels(32.0f),
+        mergeFraction(0.5f),
+        fieldOfView(0.785398163f),
+        viewportHeight(600.0f),
+        budgetSeconds(0.0005),
+        maxSplitsPerUpdate(0),
+        maxInstances(FractalGenerator::MAX_INSTANCES)
+    {}
+};
+
+// What the last Update did
+struct FractalLodStats {
+    size_t nodes;          // In the tree, leaves included
+    size_t instances;      // Leaves
+    size_t splits;
+    size_t merges;
+    size_t pending;        // Leaves that still want splitting when the budget ran out
+    int deepest;           // Deepest leaf's recursion level
+    double updateSeconds;  // Including re-emitting the instances
+
+    FractalLodStats() : nodes(0), instances(0), splits(0), merges(0), pending(0), deepest(0), updateSeconds(0.0) {}
+};
+
+// A fractal whose recursion depth varies per subtree with the camera. Starting from the
+// root cube, each Update splits the leaves that cover the most pixels from the camera's
+// position first, up to the settings' depth and as many as fit in the time budget, so
+// detail streams in over a few frames rather than stalling one. Subtrees whose parent
+// has shrunk under the merge threshold collapse back into the parent. Fully refined, the
+// instances are the same, in the same order, as FractalGenerator's at that depth.
+class FractalLod {
+private:
+    // Children of a node sit together in one block of the table's count
+    struct Node {
+        float x, y, z, half;
+        int32_t firstChild;  // -1 for a leaf
+        int32_t depth;
+    };
+
+    FractalSettings fractal;
+    FractalLodSettings settings;
+    FractalChildTable table;
+    float pixelScale;  // Pixels covered per unit of half extent over distance
+
+    std::vector<Node> nodes;  // [0] is the root
+    std::vector<int32_t> freeBlocks;
+    std::vector<std::pair<float, int32_t>> candidates;  // Heap of leaves to split, biggest on screen first
+    size_t leafCount;
+
+    FractalInstances instances;
+    FractalLodStats stats;
+
+    float ProjectedPixels(const Node& node, const float eye[3]) const;
+    bool MergeAndCollect(int32_t index, const float eye[3], float mergePixels);
+    void AddCandidate(int32_t index, const float eye[3]);
+    void Split(int32_t index);
+    void EmitInstances();
+    void EmitLeaves(int32_t index, size_t& written);
+
+public:
+    FractalLod();
+
+    // Start over from the root cube; fractal.depth is the deepest any subtree may go
+    bool Initialize(const FractalSettings& fractalSettings, const FractalLodSettings& lodSettings);
+
+    // Refine and merge for a camera at eye, in the fractal's own space; true if the
+    // instances changed
+    bool Update(const float eye[3]);
+
+    // Field of view or viewport changes take effect on the next Update
+    void SetViewport(float fieldOfView, float viewportHeight);
+
+    const FractalInstances& GetInstances() const { return instances; }
+    const FractalLodStats& GetStats() const { return stats; }
+};
@@ -0,0 +1,318 @@
+#include "FractalMesh.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace {
+    // Brightness per face direction (-x, +x, -y, +y, -z, +z), so faces read without lighting
+    const float FACE_SHADE[6] = { 0.65f, 0.85f, 0.5f, 1.0f, 0.6f, 0.75f };
+
+    // Everything the chunks share
+    struct GridContext {
+        FractalType type;
+        size_t resolution;
+        size_t chunkSize;
+        size_t chunksPerAxis;
+        bool mergeFaces;
+        bool normals;
+        float origin[3];     // Low corner of the grid
+        float cellEdge;
+        float center[3];
+        float colorScale;
+        std::vector<uint32_t> digitMask;  // Per coordinate: the sponge's levels where its digit is 1
+
+        // Same test as IsOccupied, from the precomputed digits: no two coordinates may be
+        // in the middle third at the same level (sponge), or their bits must cancel
+        // (tetrahedron)
+        bool Occupied(size_t i, size_t j, size_t k) const {
+            if (type == FractalType::Sierpinski) {
+                return (i ^ j ^ k) == 0;
+            }
+            uint32_t a = digitMask[i], b = digitMask[j], c = digitMask[k];
+            return ((a & b) | (b & c) | (a & c)) == 0;
+        }
+    };
+
+    struct ChunkMesh {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<float> normals;
+        std::vector<uint8_t> occupancy;  // With a one-cell border from the neighbors
+        std::vector<uint8_t> mask;
+        size_t cubes;
+        size_t exposedFaces;
+        size_t quads;
+    };
+
+    class ChunkBuilder {
+    private:
+        const GridContext& grid;
+        ChunkMesh& out;
+        size_t base[3];
+        size_t extent[3];
+
+        uint8_t& Cell(size_t x, size_t y, size_t z) {
+            // Border coordinates are -1 and extent, stored shifted by one
+            return out.occupancy[((z + 1) * (extent[1] + 2) + (y + 1)) * (extent[0] + 2) + (x + 1)];
+        }
+
+        void VertexAt(const size_t coordinate[3], float shade) {
+            MeshVertex vertex;
+            vertex.x = grid.origin[0] + grid.cellEdge * static_cast<float>(coordinate[0]);
+            vertex.y = grid.origin[1] + grid.cellEdge * static_cast<float>(coordinate[1]);
+            vertex.z = grid.origin[2] + grid.cellEdge * static_cast<float>(coordinate[2]);
+
+            // The instances' color gradient, linear so it's the same across merged quads
+            vertex.r = shade * (0.3f + 0.7f * (0.5f + (vertex.x - grid.center[0]) * grid.colorScale));
+            vertex.g = shade * (0.3f + 0.7f * (0.5f + (vertex.y - grid.center[1]) * grid.colorScale));
+            vertex.b = shade * (0.3f + 0.7f * (0.5f + (vertex.z - grid.center[2]) * grid.colorScale));
+            vertex.a = 1.0f;
+            out.vertices.push_back(vertex);
+        }
+
+        // A w by h quad on the plane at slice (a cell boundary along axis), clockwise seen
+        // from outside the cube it belongs to
+        void Quad(int axis, int side, size_t slice, size_t a, size_t b, size_t w, size_t h) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+            size_t corners[4][3];
+            const size_t spanU[4] = { a, a + w, a + w, a };
+            const size_t spanV[4] = { b, b, b + h, b + h };
+            for (int c = 0; c < 4; ++c) {
+                corners[c][axis] = base[axis] + slice;
+                corners[c][u] = base[u] + spanU[c];
+                corners[c][v] = base[v] + spanV[c];
+            }
+
+            uint32_t first = static_cast<uint32_t>(out.vertices.size());
+            float shade = grid.normals ? 1.0f : FACE_SHADE[axis * 2 + (side > 0 ? 1 : 0)];
+            for (int c = 0; c < 4; ++c) {
+                VertexAt(corners[c], shade);
+            }
+            if (grid.normals) {
+                float normal[3] = { 0.0f, 0.0f, 0.0f };
+                normal[axis] = static_cast<float>(side);
+                for (int c = 0; c < 4; ++c) {
+                    out.normals.insert(out.normals.end(), normal, normal + 3);
+                }
+            }
+
+            // u x v is +axis, so corners 0-1-2 wind toward +axis; reverse for -axis faces
+            const uint32_t positive[6] = { 0, 1, 2, 0, 2, 3 };
+            const uint32_t negative[6] = { 0, 3, 2, 0, 2, 1 };
+            const uint32_t* order = side > 0 ? positive : negative;
+            for (int i = 0; i < 6; ++i) {
+                out.indices.push_back(first + order[i]);
+            }
+            ++out.quads;
+        }
+
+        // Faces of one direction, slice by slice, merged into rectangles if asked
+        void Faces(int axis, int side) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+            size_t width = extent[u];
+            size_t height = extent[v];
+            out.mask.assign(width * height, 0);
+
+            for (size_t s = 0; s < extent[axis]; ++s) {
+                for (size_t b = 0; b < height; ++b) {
+                    for (size_t a = 0; a < width; ++a) {
+                        size_t p[3];
+                        p[axis] = s;
+                        p[u] = a;
+                        p[v] = b;
+                        size_t q[3] = { p[0], p[1], p[2] };
+                        q[axis] += side;  // May wrap to the border at -1, which Cell shifts
+                        uint8_t exposed = Cell(p[0], p[1], p[2]) && !Cell(q[0], q[1], q[2]);
+                        out.mask[b * width + a] = exposed;
+                        out.exposedFaces += exposed;
+                    }
+                }
+
+                size_t plane = side > 0 ? s + 1 : s;
+                for (size_t b = 0; b < height; ++b) {
+                    for (size_t a = 0; a < width; ++a) {
+                        if (!out.mask[b * width + a]) continue;
+
+                        size_t w = 1;
+                        size_t h = 1;
+                        if (grid.mergeFaces) {
+                            while (a + w < width && out.mask[b * width + a + w]) ++w;
+                            for (; b + h < height; ++h) {
+                                const uint8_t* row = &out.mask[(b + h) * width + a];
+                                if (std::find(row, row + w, 0) != row + w) break;
+                            }
+                        }
+                        for (size_t y = b; y < b + h; ++y) {
+                            std::fill(&out.mask[y * width + a], &out.mask[y * width + a] + w, 0);
+                        }
+                        Quad(axis, side, plane, a, b, w, h);
+                    }
+                }
+            }
+        }
+
+    public:
+        ChunkBuilder(const GridContext& context, ChunkMesh& chunk, size_t index) :
+            grid(context),
+            out(chunk)
+        {
+            size_t chunkCoordinate[3] = {
+                index % grid.chunksPerAxis,
+                (index / grid.chunksPerAxis) % grid.chunksPerAxis,
+                index / (grid.chunksPerAxis * grid.chunksPerAxis)
+            };
+            for (int axis = 0; axis < 3; ++axis) {
+                base[axis] = chunkCoordinate[axis] * grid.chunkSize;
+                extent[axis] = std::min(grid.chunkSize, grid.resolution - base[axis]);
+            }
+        }
+
+        void Build() {
+            out.vertices.clear();
+            out.indices.clear();
+            out.normals.clear();
+            out.cubes = 0;
+            out.exposedFaces = 0;
+            out.quads = 0;
+
+            // Occupancy of the chunk and its border; outside the grid is empty
+            out.occupancy.assign((extent[0] + 2) * (extent[1] + 2) * (extent[2] + 2), 0);
+            for (size_t z = 0; z < extent[2] + 2; ++z) {
+                for (size_t y = 0; y < extent[1] + 2; ++y) {
+                    for (size_t x = 0; x < extent[0] + 2; ++x) {
+                        size_t gx = base[0] + x, gy = base[1] + y, gz = base[2] + z;
+                        if (gx == 0 || gy == 0 || gz == 0) continue;
+                        --gx; --gy; --gz;
+                        if (gx >= grid.resolution || gy >= grid.resolution || gz >= grid.resolution) continue;
+
+                        bool occupied = grid.Occupied(gx, gy, gz);
+                        out.occupancy[(z * (extent[1] + 2) + y) * (extent[0] + 2) + x] = occupied;
+                        bool interior = x >= 1 && y >= 1 && z >= 1 && x <= extent[0] && y <= extent[1] && z <= extent[2];
+                        out.cubes += occupied && interior;
+                    }
+                }
+            }
+            if (out.cubes == 0) {
+                return;
+            }
+
+            for (int axis = 0; axis < 3; ++axis) {
+                Faces(axis, -1);
+                Faces(axis, 1);
+            }
+        }
+    };
+}
+
+size_t FractalMeshBuilder::GetResolution(FractalType type, int depth) {
+    if (depth < 0) return 0;
+
+    size_t base = type == FractalType::Sierpinski ? 2 : 3;
+    size_t resolution = 1;
+    for (int i = 0; i < depth; ++i) {
+        resolution *= base;
+        if (resolution > MAX_RESOLUTION) return 0;
+    }
+    return resolution;
+}
+
+bool FractalMeshBuilder::IsOccupied(FractalType type, int depth, size_t i, size_t j, size_t k) {
+    for (int level = 0; level < depth; ++level) {
+        if (type == FractalType::Sierpinski) {
+            if (((i ^ j ^ k) & 1) != 0) return false;
+            i >>= 1; j >>= 1; k >>= 1;
+        }
+        else {
+            int middle = (i % 3 == 1) + (j % 3 == 1) + (k % 3 == 1);
+            if (middle >= 2) return false;
+            i /= 3; j /= 3; k /= 3;
+        }
+    }
+    return true;
+}
+
+bool FractalMeshBuilder::Build(const FractalSettings& fractal, const FractalMeshSettings& settings, FractalMesh& mesh,
+    FractalMeshStats* stats, JobSystem* jobs) {
+    double start = FrameStats::NowSeconds();
+    size_t resolution = GetResolution(fractal.type, fractal.depth);
+    if (resolution == 0 || fractal.halfExtent <= 0.0f) {
+        return false;
+    }
+
+    GridContext grid;
+    grid.type = fractal.type;
+    grid.resolution = resolution;
+    grid.chunkSize = std::max<size_t>(1, settings.chunkSize);
+    grid.chunksPerAxis = (resolution + grid.chunkSize - 1) / grid.chunkSize;
+    grid.mergeFaces = settings.mergeFaces;
+    grid.normals = settings.normals;
+    grid.origin[0] = fractal.centerX - fractal.halfExtent;
+    grid.origin[1] = fractal.centerY - fractal.halfExtent;
+    grid.origin[2] = fractal.centerZ - fractal.halfExtent;
+    grid.cellEdge = 2.0f * fractal.halfExtent / static_cast<float>(resolution);
+    grid.center[0] = fractal.centerX;
+    grid.center[1] = fractal.centerY;
+    grid.center[2] = fractal.centerZ;
+    grid.colorScale = 0.5f / fractal.halfExtent;
+
+    if (fractal.type == FractalType::MengerSponge) {
+        grid.digitMask.resize(resolution);
+        for (size_t i = 0; i < resolution; ++i) {
+            uint32_t mask = 0;
+            size_t value = i;
+            for (int level = 0; level < fractal.depth; ++level, value /= 3) {
+                if (value % 3 == 1) mask |= 1u << level;
+            }
+            grid.digitMask[i] = mask;
+        }
+    }
+
+    const size_t chunkCount = grid.chunksPerAxis * grid.chunksPerAxis * grid.chunksPerAxis;
+    std::vector<ChunkMesh> chunks(chunkCount);
+
+    ParallelForEach(chunkCount, jobs, settings.threadCount, [&](size_t chunk) {
+        ChunkBuilder(grid, chunks[chunk], chunk).Build();
+    });
+
+    // Concatenate in chunk order, rebasing each chunk's indices
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    FractalMeshStats totals;
+    for (const ChunkMesh& chunk : chunks) {
+        vertexCount += chunk.vertices.size();
+        indexCount += chunk.indices.size();
+        totals.cubes += chunk.cubes;
+        totals.exposedFaces += chunk.exposedFaces;
+        totals.quads += chunk.quads;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    mesh.indices.resize(indexCount);
+    mesh.normals.resize(settings.normals ? vertexCount * 3 : 0);
+    size_t vertexOffset = 0;
+    size_t indexOffset = 0;
+    for (const ChunkMesh& chunk : chunks) {
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), mesh.vertices.begin() + vertexOffset);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + vertexOffset * 3);
+        uint32_t rebase = static_cast<uint32_t>(vertexOffset);
+        for (size_t i = 0; i < chunk.indices.size(); ++i) {
+            mesh.indices[indexOffset + i] = chunk.indices[i] + rebase;
+        }
+        vertexOffset += chunk.vertices.size();
+        indexOffset += chunk.indices.size();
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        mesh.origin[axis] = grid.origin[axis];
+    }
+    mesh.cellEdge = grid.cellEdge;
+
+    if (stats) {
+        totals.resolution = resolution;
+        totals.chunks = chunkCount;
+        totals.buildSeconds = FrameStats::NowSeconds() - start;
+        *stats = totals;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "FractalGenerator.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+struct FractalMeshSettings {
+    bool mergeFaces;      // Greedy-merge coplanar faces into larger quads
+    bool normals;         // Fill FractalMesh::normals and leave shading to the shader
+    size_t chunkSize;     // Cells per chunk edge; chunks build in parallel
+    unsigned threadCount; // Without a job system, 0 = one per hardware thread
+
+    FractalMeshSettings() :
+        mergeFaces(true),
+        normals(false),
+        chunkSize(32),
+        threadCount(0)
+    {}
+};
+
+// Position and color, laid out like the renderer's Vertex so it uploads as is
+struct MeshVertex {
+    float x, y, z;
+    float r, g, b, a;
+};
+
+// One mesh for the whole fractal; 32-bit indices, since a deep sponge has millions of
+// vertices. FractalMeshBuilder puts every vertex on the cell grid, at origin plus a whole
+// number of cellEdge; an isosurface's vertices lie on the grid's edges, between those.
+struct FractalMesh {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> normals;  // Outward x, y, z per vertex, if asked for
+    float origin[3];
+    float cellEdge;
+
+    FractalMesh() : origin(), cellEdge(0.0f) {}
+};
+
+struct FractalMeshStats {
+    size_t resolution;     // Cells per grid edge
+    size_t chunks;
+    size_t cubes;          // Occupied cells
+    size_t exposedFaces;   // Cube faces with no neighbor on the other side
+    size_t quads;          // After merging (exposedFaces without it)
+    double buildSeconds;
+
+    FractalMeshStats() : resolution(0), chunks(0), cubes(0), exposedFaces(0), quads(0), buildSeconds(0.0) {}
+
+    // Triangles for every face of every cube, as instanced cubes draw
+    size_t GetCubeTriangles() const { return cubes * 12; }
+    size_t GetTriangles() const { return quads * 2; }
+};
+
+// Turns a fractal into a single mesh of its exterior. The fractal's leaves at its depth
+// form a regular grid of cells (3^depth per edge for the sponge, 2^depth for the
+// tetrahedron) whose occupancy follows from the cell coordinates' digits, so neighbors are
+// looked up directly rather than searched for. Only faces between an occupied and an
+// empty cell are kept, then merged greedily into the largest rectangles per slice. The
+// grid is split into chunks built independently; their meshes are concatenated in chunk
+// order, so the result doesn't depend on the thread count.
+class FractalMeshBuilder {
+public:
+    // Largest grid edge Build accepts (the sponge at depth 6, the tetrahedron at depth 10)
+    static const size_t MAX_RESOLUTION = 1024;
+
+    static size_t GetResolution(FractalType type, int depth);
+
+    // Whether cell (i, j, k) of the grid at this depth holds a leaf cube
+    static bool IsOccupied(FractalType type, int depth, size_t i, size_t j, size_t k);
+
+    // Build the mesh; false if the depth is out of range. With a job system the chunks
+    // are jobs on its threads and threadCount is ignored.
+    static bool Build(const FractalSettings& fractal, const FractalMeshSettings& settings, FractalMesh& mesh,
+        FractalMeshStats* stats = nullptr, JobSystem* jobs = nullptr);
+};
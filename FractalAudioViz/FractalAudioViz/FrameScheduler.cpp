@@ -0,0 +1,152 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace {
+    // Presents further apart than this many periods are a stall, not a run of missed
+    // vblanks, and the phase restarts from them instead of being pulled toward them
+    const double MAX_TRACKED_PERIODS = 4.0;
+}
+
+FrameScheduler::FrameScheduler() {
+    Reset(FrameSchedulerSettings());
+}
+
+void FrameScheduler::Reset(const FrameSchedulerSettings& schedulerSettings) {
+    settings = schedulerSettings;
+    settings.historyFrames = std::max<size_t>(1, settings.historyFrames);
+    period = settings.refreshSeconds;
+    vblank = 0.0;
+    presented = false;
+    presentTime = 0.0;
+    workHistory.assign(settings.historyFrames, 0.0);
+    workScratch.assign(settings.historyFrames, 0.0);
+    workCount = 0;
+    workEstimate = 0.0;
+    workStart = 0.0;
+    inputTime = 0.0;
+    audioTime = -1.0;
+    submitTime = 0.0;
+    plannedPresent = 0.0;
+    stats = FrameSchedulerStats();
+}
+
+double FrameScheduler::GetNextVblank(double readySeconds) const {
+    if (!presented) {
+        return readySeconds;
+    }
+    const double periods = std::max(1.0, std::ceil((readySeconds - vblank) / period));
+    return vblank + periods * period;
+}
+
+double FrameScheduler::GetPredictedPresent(double startSeconds) const {
+    return GetNextVblank(startSeconds + workEstimate);
+}
+
+double FrameScheduler::GetStartTime(double nowSeconds) const {
+    // Work that doesn't fit in a period, as while a spike is among the recent frames,
+    // starts straight away: waiting would only give up vblanks
+    const double need = workEstimate + settings.marginSeconds;
+    if (!presented || workCount == 0 || need >= period) {
+        return nowSeconds;
+    }
+    // Aimed at the first vblank the usual work can make from now. The margin is planned
+    // in but not needed to make it, so a start that wakes up a little late still aims at
+    // the same one.
+    return std::max(GetPredictedPresent(nowSeconds) - need, nowSeconds);
+}
+
+void FrameScheduler::BeginWork(double wallSeconds) {
+    if (presented) {
+        stats.waitSeconds += std::max(0.0, wallSeconds - presentTime);
+    }
+    workStart = wallSeconds;
+    inputTime = wallSeconds;
+    submitTime = wallSeconds;
+    plannedPresent = GetPredictedPresent(wallSeconds);
+}
+
+void FrameScheduler::EndFrame(double presentSeconds) {
+    // The work estimate, from this frame's start to submit among the recent ones
+    workHistory[workCount % workHistory.size()] = std::max(0.0, submitTime - workStart);
+    ++workCount;
+    const size_t count = std::min(workCount, workHistory.size());
+    std::copy(workHistory.begin(), workHistory.begin() + count, workScratch.begin());
+    const size_t rank = std::min(count - 1, static_cast<size_t>(settings.workPercentile * count));
+    std::nth_element(workScratch.begin(), workScratch.begin() + rank, workScratch.begin() + count);
+    workEstimate = workScratch[rank];
+
+    // The vblank this present landed on pulls the phase and period toward it
+    if (!presented) {
+        presented = true;
+        vblank = presentSeconds;
+    }
+    else {
+        const double periods = std::max(1.0, std::floor((presentSeconds - vblank) / period + 0.5));
+        if (periods > MAX_TRACKED_PERIODS) {
+            vblank = presentSeconds;
+        }
+        else {
+            const double predicted = vblank + periods * period;
+            const double error = presentSeconds - predicted;
+            period += settings.periodGain * error / periods;
+            vblank = predicted + settings.phaseGain * error;
+        }
+    }
+
+    presentTime = presentSeconds;
+    ++stats.frames;
+    if (presentSeconds > plannedPresent + 0.5 * period) {
+        ++stats.missedFrames;
+    }
+    stats.inputToPresent.Record(static_cast<uint64_t>(std::max(0.0, presentSeconds - inputTime) * 1e9));
+    if (audioTime >= 0.0) {
+        stats.audioToPresent.Record(static_cast<uint64_t>(std::max(0.0, presentSeconds - audioTime) * 1e9));
+    }
+}
+
+bool FrameScheduler::WriteCsv(std::FILE* file) const {
+    if (!file) {
+        return false;
+    }
+
+    const LatencyHistogram* histograms[] = { &stats.inputToPresent, &stats.audioToPresent };
+    const char* names[] = { "input_to_present", "audio_to_present" };
+    std::fprintf(file, "latency,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+    for (int i = 0; i < 2; ++i) {
+        const LatencyHistogram& h = *histograms[i];
+        std::fprintf(file, "%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n", names[i], static_cast<unsigned long long>(h.GetCount()),
+            h.GetMean() * 1e-6, h.GetPercentile(0.50) * 1e-6, h.GetPercentile(0.95) * 1e-6,
+            h.GetPercentile(0.99) * 1e-6, h.GetMax() * 1e-6);
+    }
+
+    std::fprintf(file, "\nmissed_frames,%llu\n", static_cast<unsigned long long>(stats.missedFrames));
+    return std::ferror(file) == 0;
+}
+
+void FrameScheduler::WaitUntil(double wallSeconds, double spinSeconds) {
+    for (;;) {
+        const double remaining = wallSeconds - FrameStats::Now() * 1e-9;
+        if (remaining <= 0.0) {
+            return;
+        }
+        if (remaining > spinSeconds) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining - spinSeconds));
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+SimulatedPresentClock::SimulatedPresentClock(double clockRefreshSeconds, double clockFirstVblank) :
+    refreshSeconds(clockRefreshSeconds),
+    firstVblank(clockFirstVblank)
+{}
+
+double SimulatedPresentClock::Present(double readySeconds) const {
+    const double periods = std::max(0.0, std::ceil((readySeconds - firstVblank) / refreshSeconds));
+    return firstVblank + periods * refreshSeconds;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "FrameStats.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+struct FrameSchedulerSettings {
+    double refreshSeconds;      // Nominal display period; the measured one replaces it
+    size_t historyFrames;       // Recent frames' work the start time is planned from
+    double workPercentile;      // Of that work, the share of frames planned to make it
+    double marginSeconds;       // Left over for GPU work after submit and wake-up error
+    double periodGain;          // How far each present pulls the period estimate, 0 to 1
+    double phaseGain;           // And the vblank phase estimate
+
+    FrameSchedulerSettings() :
+        refreshSeconds(1.0 / 60.0),
+        historyFrames(120),
+        workPercentile(0.95),
+        marginSeconds(0.003),
+        periodGain(0.02),
+        phaseGain(0.1)
+    {}
+};
+
+struct FrameSchedulerStats {
+    uint64_t frames;
+    uint64_t missedFrames;      // Presented a vblank or more later than planned
+    double waitSeconds;         // Held back in total
+    LatencyHistogram inputToPresent;    // Nanoseconds from pumping input to its present
+    LatencyHistogram audioToPresent;    // From the audio snapshot shown to its present
+
+    FrameSchedulerStats() : frames(0), missedFrames(0), waitSeconds(0.0) {}
+};
+
+// Holds each frame back to the latest start that still makes the next vblank, so input
+// and audio are sampled as close to the present that shows them as the frame's work
+// allows, instead of right after the previous present returns. The next vblank is
+// predicted from the presents seen, its period and phase tracked against the nominal
+// refresh, and the time a frame needs from a percentile of recent frames' work from
+// start to submit. Nothing here touches a device: times are seconds on the steady clock,
+// and SimulatedPresentClock stands in for the display where there is none.
+class FrameScheduler {
+private:
+    FrameSchedulerSettings settings;
+    double period;
+    double vblank;              // Estimated time of the last present's vblank
+    bool presented;
+    double presentTime;         // When the last present returned
+
+    std::vector<double> workHistory;    // Ring of start-to-submit times
+    std::vector<double> workScratch;
+    size_t workCount;
+    double workEstimate;        // workPercentile of workHistory
+
+    // The frame in flight
+    double workStart;
+    double inputTime;
+    double audioTime;           // Kept across frames that take in no new audio
+    double submitTime;
+    double plannedPresent;
+    FrameSchedulerStats stats;
+
+    // The first vblank at or after readySeconds, at least one after the last present
+    double GetNextVblank(double readySeconds) const;
+
+public:
+    FrameScheduler();
+
+    void Reset(const FrameSchedulerSettings& schedulerSettings);
+
+    // When the next frame should start: early enough that its usual work lands before
+    // the first vblank it can still make, and never before nowSeconds. Before any
+    // present has been seen, or while the usual work takes a period or more, nowSeconds.
+    double GetStartTime(double nowSeconds) const;
+
+    // The vblank a frame starting at startSeconds is planned to be shown at, if its work
+    // takes the usual time
+    double GetPredictedPresent(double startSeconds) const;
+
+    // The frame's work began, its input was pumped, the audio it shows was taken in and
+    // its draws were submitted
+    void BeginWork(double wallSeconds);
+    void MarkInput(double wallSeconds) { inputTime = wallSeconds; }
+    void MarkAudio(double wallSeconds) { audioTime = wallSeconds; }
+    void MarkSubmit(double wallSeconds) { submitTime = wallSeconds; }
+
+    // The frame was presented: with vsync and one frame queued, when Present returned
+    void EndFrame(double presentSeconds);
+
+    double GetPeriod() const { return period; }
+    double GetWorkEstimate() const { return workEstimate; }
+    const FrameSchedulerStats& GetStats() const { return stats; }
+
+    // Latency percentiles and missed frames as CSV, in FrameStats' layout
+    bool WriteCsv(std::FILE* file) const;
+
+    // Sleeps, then spins out the last spinSeconds, until wallSeconds on the steady clock
+    static void WaitUntil(double wallSeconds, double spinSeconds = 0.002);
+};
+
+// A vsynced display: a frame whose GPU work is done by readySeconds is scanned out at
+// the first vblank after it
+class SimulatedPresentClock {
+private:
+    double refreshSeconds;
+    double firstVblank;
+
+public:
+    SimulatedPresentClock(double clockRefreshSeconds, double clockFirstVblank = 0.0);
+
+    double Present(double readySeconds) const;
+};
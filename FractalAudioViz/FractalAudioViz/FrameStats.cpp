@@ -0,0 +1,208 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cstring>
+
+const char* GetFramePhaseName(FramePhase phase) {
+    switch (phase) {
+    case FramePhase::MessagePump: return "message_pump";
+    case FramePhase::Update: return "update";
+    case FramePhase::AudioAnalysis: return "audio_analysis";
+    case FramePhase::SceneBuild: return "scene_build";
+    case FramePhase::Submit: return "submit";
+    case FramePhase::Present: return "present";
+    case FramePhase::Wait: return "wait";
+    case FramePhase::Frame: return "frame";
+    default: return "unknown";
+    }
+}
+
+LatencyHistogram::LatencyHistogram() {
+    counts.assign((MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT, 0);
+    Reset();
+}
+
+void LatencyHistogram::Reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    totalCount = 0;
+    minValue = UINT64_MAX;
+    maxValue = 0;
+    sum = 0.0;
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < 2 * SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+
+    const uint64_t limit = (1ull << MAX_VALUE_BITS) - 1;
+    if (value > limit) value = limit;
+
+    // Keep the top SUB_BUCKET_BITS + 1 bits: the shift picks the power of two
+    int topBit = 63;
+    while (!(value >> topBit)) --topBit;
+    int shift = topBit - SUB_BUCKET_BITS;
+    return static_cast<size_t>(shift) * SUB_BUCKET_COUNT + static_cast<size_t>(value >> shift);
+}
+
+uint64_t LatencyHistogram::GetBucketHighest(size_t index) {
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    size_t shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t mantissa = index - shift * SUB_BUCKET_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+    ++counts[GetBucketIndex(value)];
+    ++totalCount;
+    if (value < minValue) minValue = value;
+    if (value > maxValue) maxValue = value;
+    sum += static_cast<double>(value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    totalCount += other.totalCount;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    sum += other.sum;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const {
+    if (totalCount == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(totalCount) + 0.5);
+    if (target < 1) target = 1;
+    if (target > totalCount) target = totalCount;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= target) {
+            // Never report past the largest value actually seen
+            return std::min(GetBucketHighest(i), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+FrameStats::FrameStats() :
+    frameStart(0),
+    inFrame(false),
+    writeIndex(0),
+    readIndex(0),
+    droppedFrames(0),
+    maxCatchUp(0)
+{
+    ring.resize(RING_SIZE);
+    std::memset(phaseTotals, 0, sizeof(phaseTotals));
+    std::memset(catchUpCounts, 0, sizeof(catchUpCounts));
+}
+
+void FrameStats::BeginFrame() {
+    std::memset(phaseTotals, 0, sizeof(phaseTotals));
+    frameStart = Now();
+    inFrame = true;
+}
+
+void FrameStats::EndFrame(uint32_t catchUpIterations) {
+    if (!inFrame) {
+        return;
+    }
+    inFrame = false;
+    phaseTotals[static_cast<int>(FramePhase::Frame)] = Now() - frameStart;
+
+    // Drop the frame (and count it) rather than block if the collector has fallen behind
+    uint64_t write = writeIndex.load(std::memory_order_relaxed);
+    if (write - readIndex.load(std::memory_order_acquire) >= RING_SIZE) {
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    FrameRecord& record = ring[write % RING_SIZE];
+    std::memcpy(record.phaseNanoseconds, phaseTotals, sizeof(phaseTotals));
+    record.catchUpIterations = catchUpIterations;
+    writeIndex.store(write + 1, std::memory_order_release);
+}
+
+size_t FrameStats::Collect() {
+    uint64_t read = readIndex.load(std::memory_order_relaxed);
+    uint64_t write = writeIndex.load(std::memory_order_acquire);
+
+    for (uint64_t i = read; i < write; ++i) {
+        const FrameRecord& record = ring[i % RING_SIZE];
+        for (int phase = 0; phase < static_cast<int>(FramePhase::Count); ++phase) {
+            // Phases that didn't run this frame stay out of their histograms
+            if (record.phaseNanoseconds[phase] > 0 || phase == static_cast<int>(FramePhase::Frame)) {
+                histograms[phase].Record(record.phaseNanoseconds[phase]);
+            }
+        }
+
+        uint32_t iterations = record.catchUpIterations;
+        ++catchUpCounts[std::min(iterations, MAX_CATCH_UP_BUCKET)];
+        maxCatchUp = std::max(maxCatchUp, iterations);
+    }
+
+    readIndex.store(write, std::memory_order_release);
+    return static_cast<size_t>(write - read);
+}
+
+void FrameStats::Reset() {
+    Collect();
+    for (LatencyHistogram& histogram : histograms) {
+        histogram.Reset();
+    }
+    std::memset(catchUpCounts, 0, sizeof(catchUpCounts));
+    maxCatchUp = 0;
+    droppedFrames.store(0, std::memory_order_relaxed);
+}
+
+uint64_t FrameStats::GetCatchUpCount(uint32_t iterations) const {
+    return iterations <= MAX_CATCH_UP_BUCKET ? catchUpCounts[iterations] : 0;
+}
+
+bool FrameStats::WriteCsv(std::FILE* file) const {
+    if (!file) {
+        return false;
+    }
+
+    std::fprintf(file, "phase,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+    for (int phase = 0; phase < static_cast<int>(FramePhase::Count); ++phase) {
+        const LatencyHistogram& h = histograms[phase];
+        std::fprintf(file, "%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+            GetFramePhaseName(static_cast<FramePhase>(phase)), static_cast<unsigned long long>(h.GetCount()),
+            h.GetMean() * 1e-6, h.GetPercentile(0.50) * 1e-6, h.GetPercentile(0.95) * 1e-6,
+            h.GetPercentile(0.99) * 1e-6, h.GetMax() * 1e-6);
+    }
+
+    // Updates run per frame by the fixed-timestep loop; the last row collects 16 and up
+    std::fprintf(file, "\ncatch_up_iterations,frames\n");
+    for (uint32_t i = 0; i <= MAX_CATCH_UP_BUCKET; ++i) {
+        std::fprintf(file, "%u%s,%llu\n", i, i == MAX_CATCH_UP_BUCKET ? "+" : "",
+            static_cast<unsigned long long>(catchUpCounts[i]));
+    }
+
+    std::fprintf(file, "\ndropped_frames,%llu\n", static_cast<unsigned long long>(GetDroppedFrames()));
+    return std::ferror(file) == 0;
+}
+
+bool FrameStats::WriteCsv(const char* path) const {
+    std::FILE* file = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "w") != 0) file = nullptr;
+#else
+    file = std::fopen(path, "w");
+#endif
+    if (!file) {
+        return false;
+    }
+
+    bool ok = WriteCsv(file);
+    return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Parts of a frame that are timed. Phases may nest: Update contains AudioAnalysis and
+// part of SceneBuild, and Frame covers everything. Wait is the frame held back for a
+// later start by the frame scheduler.
+enum class FramePhase {
+    MessagePump,
+    Update,
+    AudioAnalysis,
+    SceneBuild,
+    Submit,
+    Present,
+    Wait,
+    Frame,
+    Count
+};
+
+const char* GetFramePhaseName(FramePhase phase);
+
+// Log-linear histogram of nanosecond durations in the style of HdrHistogram: values
+// below 128 ns are exact, above that each power of two is split into 64 buckets, so any
+// recorded value is reported to within 1.6%. Covers up to 2^40 ns (about 18 minutes).
+class LatencyHistogram {
+private:
+    static const int SUB_BUCKET_BITS = 6;
+    static const size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 40;
+
+    std::vector<uint64_t> counts;
+    uint64_t totalCount;
+    uint64_t minValue;
+    uint64_t maxValue;
+    double sum;
+
+    static size_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketHighest(size_t index);
+
+public:
+    LatencyHistogram();
+
+    void Reset();
+    void Record(uint64_t value);
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t GetCount() const { return totalCount; }
+    uint64_t GetMin() const { return totalCount ? minValue : 0; }
+    uint64_t GetMax() const { return maxValue; }  // Exact, not bucketed
+    double GetMean() const { return totalCount ? sum / static_cast<double>(totalCount) : 0.0; }
+
+    // Smallest bucket value at or below which the given fraction (0..1) of samples fall
+    uint64_t GetPercentile(double fraction) const;
+};
+
+// One frame's phase totals, as handed from the timed thread to the collector
+struct FrameRecord {
+    uint64_t phaseNanoseconds[static_cast<int>(FramePhase::Count)];
+    uint32_t catchUpIterations;
+};
+
+// Frame-phase timing. The thread running the frame loop brackets phases with PhaseScope
+// and calls BeginFrame/EndFrame; each finished frame goes into a lock-free single-producer
+// ring. Collect drains the ring into histograms and may run on any one other thread (or
+// the same one). Nothing allocates after construction.
+class FrameStats {
+private:
+    static const size_t RING_SIZE = 1024;  // Frames buffered between Collect calls
+
+    // Producer side (the frame thread)
+    uint64_t frameStart;
+    uint64_t phaseTotals[static_cast<int>(FramePhase::Count)];
+    bool inFrame;
+
+    // Single-producer single-consumer ring of finished frames
+    std::vector<FrameRecord> ring;
+    alignas(64) std::atomic<uint64_t> writeIndex;
+    alignas(64) std::atomic<uint64_t> readIndex;
+    std::atomic<uint64_t> droppedFrames;
+
+    // Consumer side
+    LatencyHistogram histograms[static_cast<int>(FramePhase::Count)];
+    static const uint32_t MAX_CATCH_UP_BUCKET = 16;
+    uint64_t catchUpCounts[MAX_CATCH_UP_BUCKET + 1];
+    uint32_t maxCatchUp;
+
+public:
+    FrameStats();
+
+    // Monotonic time in nanoseconds
+    static uint64_t Now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Same clock in seconds, for code that reports its timings in seconds
+    static double NowSeconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Producer: frame bracket and phase accumulation
+    void BeginFrame();
+    void AddPhaseTime(FramePhase phase, uint64_t nanoseconds) { phaseTotals[static_cast<int>(phase)] += nanoseconds; }
+    void EndFrame(uint32_t catchUpIterations);
+
+    // Consumer: move finished frames into the histograms; returns how many were taken
+    size_t Collect();
+    void Reset();
+
+    const LatencyHistogram& GetHistogram(FramePhase phase) const { return histograms[static_cast<int>(phase)]; }
+    uint64_t GetCatchUpCount(uint32_t iterations) const;  // Frames that ran this many updates
+    uint32_t GetMaxCatchUp() const { return maxCatchUp; }
+    uint64_t GetDroppedFrames() const { return droppedFrames.load(std::memory_order_relaxed); }
+
+    // Per-phase percentiles, then the catch-up distribution, as CSV (after Collect)
+    bool WriteCsv(std::FILE* file) const;
+    bool WriteCsv(const char* path) const;
+};
+
+// Adds the time between construction and destruction to a phase of the current frame
+class PhaseScope {
+private:
+    FrameStats& stats;
+    FramePhase phase;
+    uint64_t start;
+
+public:
+    PhaseScope(FrameStats& frameStats, FramePhase framePhase) :
+        stats(frameStats), phase(framePhase), start(FrameStats::Now()) {}
+
+    ~PhaseScope() { stats.AddPhaseTime(phase, FrameStats::Now() - start); }
+
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+};
@@ -0,0 +1,484 @@
+#include "InstanceCuller.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Bounds of unused child slots: every plane puts them far outside, without infinities
+    // that could turn into NaNs against a zero plane coefficient
+    const float EMPTY_MIN = 1e30f;
+    const float EMPTY_MAX = -1e30f;
+
+    // Morton codes use 10 bits per axis, sorted 10 bits per radix pass
+    const int MORTON_BITS = 10;
+    const size_t RADIX_BUCKETS = 1 << MORTON_BITS;
+
+    // Planes in the form the tests use: a, b, c, d, then |a| + |b| + |c| for the reach of
+    // an instance cube of half extent 1
+    struct CullPlane {
+        float a, b, c, d, reach;
+    };
+
+    // Spread the low 10 bits of v so there are two zero bits between each
+    uint32_t SpreadBits(uint32_t v) {
+        v &= 0x3FF;
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    uint32_t Quantize(float value, float minimum, float scale) {
+        float q = (value - minimum) * scale;
+        if (q < 0.0f) q = 0.0f;
+        if (q > 1023.0f) q = 1023.0f;
+        return static_cast<uint32_t>(q);
+    }
+
+    // Classify four child boxes, one plane at a time: the corner furthest along the normal
+    // decides "outside", the nearest one "inside". Returns the boxes not outside.
+    uint32_t TestBoxesScalar(const float* minX, const float* minY, const float* minZ,
+        const float* maxX, const float* maxY, const float* maxZ,
+        const CullPlane* planes, uint32_t& inside) {
+        uint32_t outsideMask = 0;
+        uint32_t insideMask = 0xF;
+        for (int p = 0; p < Frustum::PlaneCount; ++p) {
+            const CullPlane& plane = planes[p];
+            for (int i = 0; i < 4; ++i) {
+                float fx = plane.a >= 0.0f ? maxX[i] : minX[i];
+                float fy = plane.b >= 0.0f ? maxY[i] : minY[i];
+                float fz = plane.c >= 0.0f ? maxZ[i] : minZ[i];
+                float nx = plane.a >= 0.0f ? minX[i] : maxX[i];
+                float ny = plane.b >= 0.0f ? minY[i] : maxY[i];
+                float nz = plane.c >= 0.0f ? minZ[i] : maxZ[i];
+                float farthest = plane.a * fx + plane.b * fy + plane.c * fz + plane.d;
+                float nearest = plane.a * nx + plane.b * ny + plane.c * nz + plane.d;
+                if (farthest < 0.0f) outsideMask |= 1u << i;
+                if (!(nearest >= 0.0f)) insideMask &= ~(1u << i);
+            }
+        }
+        inside = insideMask & ~outsideMask;
+        return ~outsideMask & 0xF;
+    }
+
+    size_t TestInstancesScalar(const float* x, const float* y, const float* z, const float* scale,
+        const CullPlane* planes, uint32_t first, uint32_t end, uint32_t* visible) {
+        size_t written = 0;
+        for (uint32_t i = first; i < end; ++i) {
+            bool outside = false;
+            for (int p = 0; p < Frustum::PlaneCount; ++p) {
+                const CullPlane& plane = planes[p];
+                float distance = plane.a * x[i] + plane.b * y[i] + plane.c * z[i] + plane.d;
+                outside |= distance + scale[i] * plane.reach < 0.0f;
+            }
+            if (!outside) visible[written++] = i;
+        }
+        return written;
+    }
+
+#if FAV_X86
+    // Same as the scalar test with the four boxes in the lanes of a register, in the same
+    // operation order, so the classification matches bit for bit
+    uint32_t TestBoxesSSE(const float* minX, const float* minY, const float* minZ,
+        const float* maxX, const float* maxY, const float* maxZ,
+        const CullPlane* planes, uint32_t& inside) {
+        __m128 lowX = _mm_loadu_ps(minX), lowY = _mm_loadu_ps(minY), lowZ = _mm_loadu_ps(minZ);
+        __m128 highX = _mm_loadu_ps(maxX), highY = _mm_loadu_ps(maxY), highZ = _mm_loadu_ps(maxZ);
+        __m128 zero = _mm_setzero_ps();
+        __m128 outside = _mm_setzero_ps();
+        __m128 allInside = _mm_cmpeq_ps(zero, zero);
+
+        for (int p = 0; p < Frustum::PlaneCount; ++p) {
+            const CullPlane& plane = planes[p];
+            __m128 a = _mm_set1_ps(plane.a), b = _mm_set1_ps(plane.b);
+            __m128 c = _mm_set1_ps(plane.c), d = _mm_set1_ps(plane.d);
+            __m128 fx = plane.a >= 0.0f ? highX : lowX, nx = plane.a >= 0.0f ? lowX : highX;
+            __m128 fy = plane.b >= 0.0f ? highY : lowY, ny = plane.b >= 0.0f ? lowY : highY;
+            __m128 fz = plane.c >= 0.0f ? highZ : lowZ, nz = plane.c >= 0.0f ? lowZ : highZ;
+
+            __m128 farthest = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, fx), _mm_mul_ps(b, fy)),
+                _mm_mul_ps(c, fz)), d);
+            __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, nx), _mm_mul_ps(b, ny)),
+                _mm_mul_ps(c, nz)), d);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(farthest, zero));
+            allInside = _mm_and_ps(allInside, _mm_cmpge_ps(nearest, zero));
+        }
+
+        uint32_t outsideMask = static_cast<uint32_t>(_mm_movemask_ps(outside));
+        inside = static_cast<uint32_t>(_mm_movemask_ps(allInside)) & ~outsideMask;
+        return ~outsideMask & 0xF;
+    }
+
+    size_t TestInstancesSSE(const float* x, const float* y, const float* z, const float* scale,
+        const CullPlane* planes, uint32_t first, uint32_t end, uint32_t* visible) {
+        size_t written = 0;
+        __m128 zero = _mm_setzero_ps();
+        uint32_t i = first;
+        for (; i + 4 <= end; i += 4) {
+            __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+            __m128 radius = _mm_loadu_ps(scale + i);
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < Frustum::PlaneCount; ++p) {
+                const CullPlane& plane = planes[p];
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(plane.a), px), _mm_mul_ps(_mm_set1_ps(plane.b), py)),
+                    _mm_mul_ps(_mm_set1_ps(plane.c), pz)), _mm_set1_ps(plane.d));
+                distance = _mm_add_ps(distance, _mm_mul_ps(radius, _mm_set1_ps(plane.reach)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+            }
+
+            uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xF;
+            while (mask) {
+                uint32_t lane = 0;
+                while (!(mask & (1u << lane))) ++lane;
+                visible[written++] = i + lane;
+                mask &= mask - 1;
+            }
+        }
+        return written + TestInstancesScalar(x, y, z, scale, planes, i, end, visible + written);
+    }
+
+    FAV_TARGET_AVX size_t TestInstancesAVX(const float* x, const float* y, const float* z, const float* scale,
+        const CullPlane* planes, uint32_t first, uint32_t end, uint32_t* visible) {
+        size_t written = 0;
+        __m256 zero = _mm256_setzero_ps();
+        uint32_t i = first;
+        for (; i + 8 <= end; i += 8) {
+            __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+            __m256 radius = _mm256_loadu_ps(scale + i);
+            __m256 outside = _mm256_setzero_ps();
+            for (int p = 0; p < Frustum::PlaneCount; ++p) {
+                const CullPlane& plane = planes[p];
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(plane.a), px), _mm256_mul_ps(_mm256_set1_ps(plane.b), py)),
+                    _mm256_mul_ps(_mm256_set1_ps(plane.c), pz)), _mm256_set1_ps(plane.d));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(radius, _mm256_set1_ps(plane.reach)));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+            }
+
+            uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+            while (mask) {
+                uint32_t lane = 0;
+                while (!(mask & (1u << lane))) ++lane;
+                visible[written++] = i + lane;
+                mask &= mask - 1;
+            }
+        }
+        return written + TestInstancesSSE(x, y, z, scale, planes, i, end, visible + written);
+    }
+#endif
+}
+
+Frustum Frustum::FromMatrix(const float matrix[16]) {
+    // Row-vector clip = v * M, so each clip coordinate is v dotted with a column
+    const float* m = matrix;
+    float column[4][4];
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            column[c][r] = m[r * 4 + c];
+        }
+    }
+
+    Frustum frustum;
+    for (int i = 0; i < 4; ++i) {
+        frustum.planes[Left][i] = column[3][i] + column[0][i];
+        frustum.planes[Right][i] = column[3][i] - column[0][i];
+        frustum.planes[Bottom][i] = column[3][i] + column[1][i];
+        frustum.planes[Top][i] = column[3][i] - column[1][i];
+        frustum.planes[Near][i] = column[2][i];
+        frustum.planes[Far][i] = column[3][i] - column[2][i];
+    }
+
+    // Unit normals, so distances are in the space's own units
+    for (int p = 0; p < PlaneCount; ++p) {
+        float* plane = frustum.planes[p];
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (int i = 0; i < 4; ++i) plane[i] /= length;
+        }
+    }
+    return frustum;
+}
+
+InstanceCuller::InstanceCuller() :
+    visibleCount(0),
+    simdLevel(SimdLevel::Scalar)
+{}
+
+void InstanceCuller::SortInstances(const FractalInstances& instances) {
+    size_t count = instances.count;
+
+    // Quantize centers within their bounding box
+    float lo[3] = { instances.x[0], instances.y[0], instances.z[0] };
+    float hi[3] = { lo[0], lo[1], lo[2] };
+    for (size_t i = 1; i < count; ++i) {
+        lo[0] = std::min(lo[0], instances.x[i]); hi[0] = std::max(hi[0], instances.x[i]);
+        lo[1] = std::min(lo[1], instances.y[i]); hi[1] = std::max(hi[1], instances.y[i]);
+        lo[2] = std::min(lo[2], instances.z[i]); hi[2] = std::max(hi[2], instances.z[i]);
+    }
+    float scale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = hi[axis] - lo[axis];
+        scale[axis] = extent > 0.0f ? 1023.0f / extent : 0.0f;
+    }
+
+    // Key: the 30-bit code above the instance index, so equal codes keep generation order
+    keys.resize(count);
+    keyScratch.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t code = SpreadBits(Quantize(instances.x[i], lo[0], scale[0])) |
+            (SpreadBits(Quantize(instances.y[i], lo[1], scale[1])) << 1) |
+            (SpreadBits(Quantize(instances.z[i], lo[2], scale[2])) << 2);
+        keys[i] = (static_cast<uint64_t>(code) << 32) | static_cast<uint64_t>(i);
+    }
+
+    // LSD radix sort on the code, 10 bits a pass
+    uint64_t* source = keys.data();
+    uint64_t* target = keyScratch.data();
+    size_t histogram[RADIX_BUCKETS];
+    for (int pass = 0; pass < 3; ++pass) {
+        int shift = 32 + pass * MORTON_BITS;
+        std::fill(histogram, histogram + RADIX_BUCKETS, static_cast<size_t>(0));
+        for (size_t i = 0; i < count; ++i) {
+            ++histogram[(source[i] >> shift) & (RADIX_BUCKETS - 1)];
+        }
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            target[histogram[(source[i] >> shift) & (RADIX_BUCKETS - 1)]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+
+    sorted.Resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t index = static_cast<size_t>(source[i] & 0xFFFFFFFFu);
+        sorted.x[i] = instances.x[index];
+        sorted.y[i] = instances.y[index];
+        sorted.z[i] = instances.z[index];
+        sorted.scale[i] = instances.scale[index];
+        sorted.color[i] = instances.color[index];
+    }
+}
+
+void InstanceCuller::BuildTree() {
+    size_t count = sorted.count;
+    size_t leafCount = (count + LEAF_SIZE - 1) / LEAF_SIZE;
+
+    // Node count over all levels, so the vector is sized once
+    size_t nodeCount = 0;
+    for (size_t level = leafCount; ; ) {
+        level = (level + BRANCH - 1) / BRANCH;
+        nodeCount += level;
+        if (level <= 1) break;
+    }
+    nodes.resize(nodeCount);
+
+    // Bottom level: consecutive leaves under each node
+    size_t levelStart = 0;
+    size_t levelCount = (leafCount + BRANCH - 1) / BRANCH;
+    for (size_t n = 0; n < levelCount; ++n) {
+        Node& node = nodes[n];
+        node.childCount = 0;
+        for (size_t slot = 0; slot < BRANCH; ++slot) {
+            size_t leaf = n * BRANCH + slot;
+            if (leaf >= leafCount) {
+                node.minX[slot] = node.minY[slot] = node.minZ[slot] = EMPTY_MIN;
+                node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = EMPTY_MAX;
+                node.child[slot] = 0;
+                node.first[slot] = node.end[slot] = 0;
+                continue;
+            }
+
+            uint32_t first = static_cast<uint32_t>(leaf * LEAF_SIZE);
+            uint32_t end = static_cast<uint32_t>(std::min(count, (leaf + 1) * LEAF_SIZE));
+            float lo[3] = { EMPTY_MIN, EMPTY_MIN, EMPTY_MIN };
+            float hi[3] = { EMPTY_MAX, EMPTY_MAX, EMPTY_MAX };
+            for (uint32_t i = first; i < end; ++i) {
+                float s = sorted.scale[i];
+                lo[0] = std::min(lo[0], sorted.x[i] - s); hi[0] = std::max(hi[0], sorted.x[i] + s);
+                lo[1] = std::min(lo[1], sorted.y[i] - s); hi[1] = std::max(hi[1], sorted.y[i] + s);
+                lo[2] = std::min(lo[2], sorted.z[i] - s); hi[2] = std::max(hi[2], sorted.z[i] + s);
+            }
+            node.minX[slot] = lo[0]; node.minY[slot] = lo[1]; node.minZ[slot] = lo[2];
+            node.maxX[slot] = hi[0]; node.maxY[slot] = hi[1]; node.maxZ[slot] = hi[2];
+            node.child[slot] = LEAF_FLAG | static_cast<uint32_t>(leaf);
+            node.first[slot] = first;
+            node.end[slot] = end;
+            ++node.childCount;
+        }
+    }
+
+    // Each level above groups consecutive nodes of the one below, until a single root
+    while (levelCount > 1) {
+        size_t childStart = levelStart;
+        size_t childCount = levelCount;
+        levelStart += levelCount;
+        levelCount = (childCount + BRANCH - 1) / BRANCH;
+
+        for (size_t n = 0; n < levelCount; ++n) {
+            Node& node = nodes[levelStart + n];
+            node.childCount = 0;
+            for (size_t slot = 0; slot < BRANCH; ++slot) {
+                size_t index = n * BRANCH + slot;
+                if (index >= childCount) {
+                    node.minX[slot] = node.minY[slot] = node.minZ[slot] = EMPTY_MIN;
+                    node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = EMPTY_MAX;
+                    node.child[slot] = 0;
+                    node.first[slot] = node.end[slot] = 0;
+                    continue;
+                }
+
+                const Node& child = nodes[childStart + index];
+                node.minX[slot] = *std::min_element(child.minX, child.minX + child.childCount);
+                node.minY[slot] = *std::min_element(child.minY, child.minY + child.childCount);
+                node.minZ[slot] = *std::min_element(child.minZ, child.minZ + child.childCount);
+                node.maxX[slot] = *std::max_element(child.maxX, child.maxX + child.childCount);
+                node.maxY[slot] = *std::max_element(child.maxY, child.maxY + child.childCount);
+                node.maxZ[slot] = *std::max_element(child.maxZ, child.maxZ + child.childCount);
+                node.child[slot] = static_cast<uint32_t>(childStart + index);
+                node.first[slot] = child.first[0];
+                node.end[slot] = child.end[child.childCount - 1];
+                ++node.childCount;
+            }
+        }
+    }
+}
+
+void InstanceCuller::Build(const FractalInstances& instances, SimdLevel maxSimdLevel) {
+    simdLevel = ResolveSimdLevel(maxSimdLevel);
+    visibleCount = 0;
+    stats = CullStats();
+
+    if (instances.count == 0) {
+        sorted.Resize(0);
+        nodes.clear();
+        return;
+    }
+
+    SortInstances(instances);
+    BuildTree();
+    visible.resize(sorted.count);
+}
+
+void InstanceCuller::AcceptRange(uint32_t first, uint32_t end) {
+    for (uint32_t i = first; i < end; ++i) {
+        visible[visibleCount++] = i;
+    }
+}
+
+uint32_t InstanceCuller::TestBoxes(const Node& node, const float* planes, uint32_t& inside) const {
+    const CullPlane* cullPlanes = reinterpret_cast<const CullPlane*>(planes);
+#if FAV_X86
+    if (simdLevel >= SimdLevel::SSE2) {
+        return TestBoxesSSE(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, cullPlanes, inside);
+    }
+#endif
+    return TestBoxesScalar(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, cullPlanes, inside);
+}
+
+void InstanceCuller::TestInstances(const float* planes, uint32_t first, uint32_t end) {
+    const CullPlane* cullPlanes = reinterpret_cast<const CullPlane*>(planes);
+    uint32_t* out = &visible[visibleCount];
+    stats.instancesTested += end - first;
+#if FAV_X86
+    if (simdLevel >= SimdLevel::AVX) {
+        visibleCount += TestInstancesAVX(sorted.x.data(), sorted.y.data(), sorted.z.data(), sorted.scale.data(),
+            cullPlanes, first, end, out);
+        return;
+    }
+    if (simdLevel >= SimdLevel::SSE2) {
+        visibleCount += TestInstancesSSE(sorted.x.data(), sorted.y.data(), sorted.z.data(), sorted.scale.data(),
+            cullPlanes, first, end, out);
+        return;
+    }
+#endif
+    visibleCount += TestInstancesScalar(sorted.x.data(), sorted.y.data(), sorted.z.data(), sorted.scale.data(),
+        cullPlanes, first, end, out);
+}
+
+size_t InstanceCuller::Cull(const Frustum& frustum) {
+    visibleCount = 0;
+    stats = CullStats();
+    if (nodes.empty()) {
+        return 0;
+    }
+
+    // Planes plus each one's reach, laid out as CullPlane
+    CullPlane planes[Frustum::PlaneCount];
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+        const float* plane = frustum.planes[p];
+        planes[p].a = plane[0];
+        planes[p].b = plane[1];
+        planes[p].c = plane[2];
+        planes[p].d = plane[3];
+        planes[p].reach = std::fabs(plane[0]) + std::fabs(plane[1]) + std::fabs(plane[2]);
+    }
+    const float* cullPlanes = &planes[0].a;
+
+    // Depth first with the children in order, so the output stays ascending. The stack
+    // holds nodes to visit or take whole, next one on top; the tree is at most 16 levels.
+    uint32_t stack[16 * BRANCH];
+    size_t depth = 0;
+    stack[depth++] = static_cast<uint32_t>(nodes.size() - 1);
+
+    while (depth > 0) {
+        uint32_t entry = stack[--depth];
+        const Node& node = nodes[entry & ~ACCEPT_FLAG];
+        if (entry & ACCEPT_FLAG) {
+            AcceptRange(node.first[0], node.end[node.childCount - 1]);
+            continue;
+        }
+        ++stats.nodesVisited;
+
+        uint32_t inside = 0;
+        uint32_t valid = (1u << node.childCount) - 1;
+        uint32_t touching = TestBoxes(node, cullPlanes, inside) & valid;
+        inside &= valid;
+        for (uint32_t slot = 0; slot < node.childCount; ++slot) {
+            if (!(touching & (1u << slot))) ++stats.boxesCulled;
+            else if (inside & (1u << slot)) ++stats.boxesAccepted;
+        }
+
+        if (node.child[0] & LEAF_FLAG) {
+            // Leaves: whole runs, or their instances tested, in order
+            for (uint32_t slot = 0; slot < node.childCount; ++slot) {
+                if (!(touching & (1u << slot))) continue;
+                if (inside & (1u << slot)) {
+                    AcceptRange(node.first[slot], node.end[slot]);
+                }
+                else {
+                    TestInstances(cullPlanes, node.first[slot], node.end[slot]);
+                }
+            }
+        }
+        else {
+            // Child nodes, pushed last first so they come off in order
+            for (uint32_t slot = node.childCount; slot > 0; --slot) {
+                if (!(touching & (1u << (slot - 1)))) continue;
+                uint32_t flag = (inside & (1u << (slot - 1))) ? ACCEPT_FLAG : 0;
+                stack[depth++] = node.child[slot - 1] | flag;
+            }
+        }
+    }
+
+    stats.visible = static_cast<uint32_t>(visibleCount);
+    stats.culled = static_cast<uint32_t>(sorted.count - visibleCount);
+    return visibleCount;
+}
+
+void InstanceCuller::GatherVisible(FractalInstances& out) const {
+    out.Resize(visibleCount);
+    for (size_t i = 0; i < visibleCount; ++i) {
+        uint32_t index = visible[i];
+        out.x[i] = sorted.x[index];
+        out.y[i] = sorted.y[index];
+        out.z[i] = sorted.z[index];
+        out.scale[i] = sorted.scale[index];
+        out.color[i] = sorted.color[index];
+    }
+}
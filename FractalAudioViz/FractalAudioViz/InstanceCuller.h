@@ -0,0 +1,98 @@
+#pragma once
+
+#include "FractalGenerator.h"
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Six planes (a, b, c, d) with normals pointing inwards; a point is inside when
+// a*x + b*y + c*z + d >= 0 for all of them
+struct Frustum {
+    enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+    float planes[PlaneCount][4];
+
+    // Extract the planes from a row-vector world * view * projection matrix (D3D clip
+    // space, 0 <= z <= w), so they come out in the space the matrix transforms from
+    static Frustum FromMatrix(const float matrix[16]);
+};
+
+// What one Cull did
+struct CullStats {
+    uint32_t nodesVisited;     // Tree nodes whose children were tested
+    uint32_t boxesCulled;      // Child boxes entirely outside, skipped with their subtrees
+    uint32_t boxesAccepted;    // Child boxes entirely inside, taken whole without testing
+    uint32_t instancesTested;  // Instances tested one by one in straddling leaves
+    uint32_t visible;
+    uint32_t culled;
+
+    CullStats() : nodesVisited(0), boxesCulled(0), boxesAccepted(0), instancesTested(0), visible(0), culled(0) {}
+};
+
+// Frustum culling for fractal instances. Build copies the instances in Morton order of
+// their centers and groups them, LEAF_SIZE at a time, under a 4-wide bounding volume
+// tree, so every node covers one contiguous run of instances. Cull tests a node's four
+// child boxes against the planes at once; a box that is entirely inside adds its whole
+// run without going further, and straddling leaves test their instances 8 (AVX) or 4
+// (SSE) at a time. The output is a compacted list of indices into the sorted copy, in
+// ascending order, and is the same at every SIMD level.
+class InstanceCuller {
+public:
+    static const size_t LEAF_SIZE = 16;
+    static const size_t BRANCH = 4;
+
+private:
+    // Child bounds in SoA form for the 4-wide test. A child is either another node or a
+    // leaf; unused slots have empty bounds and are never counted.
+    struct Node {
+        float minX[BRANCH], minY[BRANCH], minZ[BRANCH];
+        float maxX[BRANCH], maxY[BRANCH], maxZ[BRANCH];
+        uint32_t child[BRANCH];  // Node index, or LEAF_FLAG | leaf index
+        uint32_t first[BRANCH];  // Instance run under each child
+        uint32_t end[BRANCH];
+        uint32_t childCount;
+    };
+
+    static const uint32_t LEAF_FLAG = 0x80000000u;
+    static const uint32_t ACCEPT_FLAG = 0x80000000u;  // On the traversal stack: take the node's whole run
+
+    FractalInstances sorted;
+    std::vector<Node> nodes;  // Root last
+    std::vector<uint32_t> visible;
+    size_t visibleCount;
+    CullStats stats;
+    SimdLevel simdLevel;
+
+    // Scratch for the Morton sort, kept between builds
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> keyScratch;
+
+    void SortInstances(const FractalInstances& instances);
+    void BuildTree();
+
+    // Planes here are PlaneCount x (a, b, c, d, |a| + |b| + |c|)
+    void AcceptRange(uint32_t first, uint32_t end);
+    uint32_t TestBoxes(const Node& node, const float* planes, uint32_t& inside) const;
+    void TestInstances(const float* planes, uint32_t first, uint32_t end);
+
+public:
+    InstanceCuller();
+
+    // Sort and build the tree for a new set of instances (when the fractal changes).
+    // Allocates only when the set is bigger than any before.
+    void Build(const FractalInstances& instances, SimdLevel maxSimdLevel = SimdLevel::AVX512);
+
+    // Collect the instances that intersect the frustum; returns how many
+    size_t Cull(const Frustum& frustum);
+
+    // The instances in Morton order, which the visible indices refer to
+    const FractalInstances& GetSortedInstances() const { return sorted; }
+    const uint32_t* GetVisible() const { return visible.data(); }
+    size_t GetVisibleCount() const { return visibleCount; }
+    const CullStats& GetStats() const { return stats; }
+    size_t GetNodeCount() const { return nodes.size(); }
+    SimdLevel GetSimdLevel() const { return simdLevel; }
+
+    // Copy the visible instances into out, ready to upload
+    void GatherVisible(FractalInstances& out) const;
+};
@@ -0,0 +1,528 @@
+#include "Isosurface.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Brightness per normal direction (-x, +x, -y, +y, -z, +z), as for the merged mesh's faces
+    const float FACE_SHADE[6] = { 0.65f, 0.85f, 0.5f, 1.0f, 0.6f, 0.75f };
+
+    // Samples within this many cell edges of the surface can move its vertices
+    const float NEAR_SURFACE = 2.0f;
+
+    const uint64_t INTERIOR = ~0ull;
+    const uint32_t NO_VERTEX = ~0u;
+
+    // Cell corners are numbered by their offset bits: x in bit 0, y in bit 1, z in bit 2.
+    // Edges run along x (0-3), y (4-7) and z (8-11), each from its low corner.
+    const int EDGE_CORNERS[12][2] = {
+        { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+        { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+        { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+    };
+
+    // Each face's corners in order around it
+    const int FACE_CORNERS[6][4] = {
+        { 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+        { 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+        { 0, 1, 3, 2 }, { 4, 5, 7, 6 }
+    };
+
+    int EdgeBetween(int a, int b) {
+        for (int edge = 0; edge < 12; ++edge) {
+            if ((EDGE_CORNERS[edge][0] == a && EDGE_CORNERS[edge][1] == b) ||
+                (EDGE_CORNERS[edge][0] == b && EDGE_CORNERS[edge][1] == a)) {
+                return edge;
+            }
+        }
+        return -1;
+    }
+
+    // Triangles per corner case, as edge numbers. Rather than the classic hand-written
+    // table, each case is derived from its faces: on every face the crossings are paired
+    // into segments (a face with two inside corners diagonally opposite cuts each of them
+    // off), the segments chain into loops around the cell, and each loop is fanned. A face
+    // is paired from its own four corners alone, so the two cells sharing it agree and
+    // the surface has no cracks. Loops are wound so the cross product of a triangle's
+    // first two edges points from inside to outside, as Cube's do.
+    struct CaseTable {
+        static const int MAX_TRIANGLES = 12;
+        uint8_t triangleCount[256];
+        int8_t edges[256][MAX_TRIANGLES * 3];
+
+        CaseTable() {
+            for (int config = 0; config < 256; ++config) {
+                Build(config);
+            }
+        }
+
+        void Build(int config) {
+            triangleCount[config] = 0;
+            auto inside = [config](int corner) { return (config >> corner & 1) != 0; };
+
+            // Each crossed edge ends two segments, one on each face it borders
+            int neighbor[12][2];
+            int neighborCount[12] = {};
+            for (int face = 0; face < 6; ++face) {
+                const int* c = FACE_CORNERS[face];
+                int crossed[4];
+                int crossings = 0;
+                for (int i = 0; i < 4; ++i) {
+                    if (inside(c[i]) != inside(c[(i + 1) % 4])) crossed[crossings++] = i;
+                }
+
+                int pairs[2][2];
+                int pairCount = 0;
+                if (crossings == 2) {
+                    pairs[0][0] = EdgeBetween(c[crossed[0]], c[(crossed[0] + 1) % 4]);
+                    pairs[0][1] = EdgeBetween(c[crossed[1]], c[(crossed[1] + 1) % 4]);
+                    pairCount = 1;
+                }
+                else if (crossings == 4) {
+                    for (int i = 0; i < 4; ++i) {
+                        if (!inside(c[i])) continue;
+                        pairs[pairCount][0] = EdgeBetween(c[(i + 3) % 4], c[i]);
+                        pairs[pairCount][1] = EdgeBetween(c[i], c[(i + 1) % 4]);
+                        ++pairCount;
+                    }
+                }
+                for (int p = 0; p < pairCount; ++p) {
+                    int a = pairs[p][0], b = pairs[p][1];
+                    neighbor[a][neighborCount[a]++] = b;
+                    neighbor[b][neighborCount[b]++] = a;
+                }
+            }
+
+            bool visited[12] = {};
+            for (int start = 0; start < 12; ++start) {
+                if (neighborCount[start] != 2 || visited[start]) continue;
+
+                int loop[12];
+                int length = 0;
+                int previous = -1;
+                int current = start;
+                do {
+                    visited[current] = true;
+                    loop[length++] = current;
+                    int next = neighbor[current][0] != previous ? neighbor[current][0] : neighbor[current][1];
+                    previous = current;
+                    current = next;
+                } while (current != start && length < 12);
+
+                // The loop's normal through the edge midpoints (Newell), against the sum of
+                // its edges' inside-to-outside directions
+                float normal[3] = { 0.0f, 0.0f, 0.0f };
+                float outward[3] = { 0.0f, 0.0f, 0.0f };
+                for (int i = 0; i < length; ++i) {
+                    float p[3], q[3];
+                    Midpoint(loop[i], p);
+                    Midpoint(loop[(i + 1) % length], q);
+                    normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+                    normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+                    normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+
+                    int low = EDGE_CORNERS[loop[i]][0], high = EDGE_CORNERS[loop[i]][1];
+                    float direction = inside(low) ? 1.0f : -1.0f;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        outward[axis] += direction * static_cast<float>((high >> axis & 1) - (low >> axis & 1));
+                    }
+                }
+                if (normal[0] * outward[0] + normal[1] * outward[1] + normal[2] * outward[2] < 0.0f) {
+                    std::reverse(loop, loop + length);
+                }
+
+                for (int i = 1; i + 1 < length && triangleCount[config] < MAX_TRIANGLES; ++i) {
+                    int8_t* triangle = &edges[config][triangleCount[config]++ * 3];
+                    triangle[0] = static_cast<int8_t>(loop[0]);
+                    triangle[1] = static_cast<int8_t>(loop[i]);
+                    triangle[2] = static_cast<int8_t>(loop[i + 1]);
+                }
+            }
+        }
+
+        static void Midpoint(int edge, float point[3]) {
+            int a = EDGE_CORNERS[edge][0], b = EDGE_CORNERS[edge][1];
+            for (int axis = 0; axis < 3; ++axis) {
+                point[axis] = 0.5f * static_cast<float>((a >> axis & 1) + (b >> axis & 1));
+            }
+        }
+    };
+
+    const CaseTable& GetCaseTable() {
+        static const CaseTable table;
+        return table;
+    }
+
+    // Per-thread buffers, reused across chunks and updates
+    struct Scratch {
+        std::vector<float> x, y, z;
+        std::vector<float> field;
+        std::vector<uint8_t> inside;
+        std::vector<uint32_t> edgeVertex;  // Per edge of the chunk's grid: its vertex, if made yet
+    };
+
+    Scratch& GetScratch() {
+        thread_local Scratch scratch;
+        return scratch;
+    }
+
+    bool SameParams(const DistanceParams& a, const DistanceParams& b) {
+        return a.type == b.type && a.iterations == b.iterations && a.specialize == b.specialize &&
+            a.power == b.power && a.bailout == b.bailout && a.scale == b.scale && a.minRadius == b.minRadius &&
+            a.fixedRadius == b.fixedRadius && a.foldLimit == b.foldLimit && a.offset[0] == b.offset[0] &&
+            a.offset[1] == b.offset[1] && a.offset[2] == b.offset[2] && a.rotation[0] == b.rotation[0] &&
+            a.rotation[1] == b.rotation[1];
+    }
+}
+
+IsosurfaceMesher::IsosurfaceMesher() :
+    chunksPerAxis(0),
+    origin(),
+    cellEdge(0.0f),
+    sampled(false)
+{}
+
+bool IsosurfaceMesher::Initialize(const IsosurfaceSettings& newSettings) {
+    if (newSettings.resolution == 0 || newSettings.resolution > MAX_RESOLUTION || newSettings.chunkSize == 0 ||
+        !(newSettings.halfExtent > 0.0f)) {
+        return false;
+    }
+
+    settings = newSettings;
+    chunksPerAxis = (settings.resolution + settings.chunkSize - 1) / settings.chunkSize;
+    cellEdge = 2.0f * settings.halfExtent / static_cast<float>(settings.resolution);
+    for (int axis = 0; axis < 3; ++axis) {
+        origin[axis] = settings.center[axis] - settings.halfExtent;
+        mesh.origin[axis] = origin[axis];
+    }
+    mesh.cellEdge = cellEdge;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.normals.clear();
+
+    chunks.clear();
+    chunks.resize(chunksPerAxis * chunksPerAxis * chunksPerAxis);
+    for (size_t index = 0; index < chunks.size(); ++index) {
+        Chunk& chunk = chunks[index];
+        size_t chunkCoordinate[3] = {
+            index % chunksPerAxis,
+            (index / chunksPerAxis) % chunksPerAxis,
+            index / (chunksPerAxis * chunksPerAxis)
+        };
+        for (int axis = 0; axis < 3; ++axis) {
+            chunk.base[axis] = chunkCoordinate[axis] * settings.chunkSize;
+            chunk.extent[axis] = std::min(settings.chunkSize, settings.resolution - chunk.base[axis]);
+        }
+        chunk.meshed = false;
+        chunk.remeshed = false;
+        chunk.sampleSeconds = 0.0;
+        chunk.meshSeconds = 0.0;
+    }
+
+    sampled = false;
+    stats = IsosurfaceStats();
+    stats.chunks = chunks.size();
+    return true;
+}
+
+void IsosurfaceMesher::Invalidate() {
+    for (Chunk& chunk : chunks) {
+        chunk.meshed = false;
+    }
+    sampled = false;
+}
+
+bool IsosurfaceMesher::UpdateChunk(Chunk& chunk, const DistanceParams& params) const {
+    double start = FrameStats::NowSeconds();
+    Scratch& scratch = GetScratch();
+
+    // Every corner of the chunk's cells plus a one-sample border; a sample's position
+    // follows from its index on the whole grid alone, so neighbors sample shared points
+    // identically
+    const size_t nx = chunk.extent[0] + 3, ny = chunk.extent[1] + 3, nz = chunk.extent[2] + 3;
+    const size_t count = nx * ny * nz;
+    scratch.x.resize(count);
+    scratch.y.resize(count);
+    scratch.z.resize(count);
+    scratch.field.resize(count);
+    for (size_t k = 0, s = 0; k < nz; ++k) {
+        float z = origin[2] + cellEdge * static_cast<float>(static_cast<ptrdiff_t>(chunk.base[2] + k) - 1);
+        for (size_t j = 0; j < ny; ++j) {
+            float y = origin[1] + cellEdge * static_cast<float>(static_cast<ptrdiff_t>(chunk.base[1] + j) - 1);
+            for (size_t i = 0; i < nx; ++i, ++s) {
+                scratch.x[s] = origin[0] + cellEdge * static_cast<float>(static_cast<ptrdiff_t>(chunk.base[0] + i) - 1);
+                scratch.y[s] = y;
+                scratch.z[s] = z;
+            }
+        }
+    }
+    DistanceEstimator::Evaluate(params, scratch.x.data(), scratch.y.data(), scratch.z.data(), count,
+        scratch.field.data(), settings.maxSimdLevel);
+    const float iso = settings.isoLevel * cellEdge;
+    for (float& value : scratch.field) {
+        value -= iso;
+    }
+
+    // Only the cell corners decide the triangles; the border only tilts normals
+    bool changed = !chunk.meshed;
+    const float band = NEAR_SURFACE * cellEdge;
+    const float tolerance = settings.remeshTolerance * cellEdge;
+    for (size_t k = 1; k + 1 < nz && !changed; ++k) {
+        for (size_t j = 1; j + 1 < ny && !changed; ++j) {
+            size_t s = (k * ny + j) * nx + 1;
+            for (size_t i = 1; i + 1 < nx; ++i, ++s) {
+                float before = chunk.field[s], after = scratch.field[s];
+                bool near = std::fabs(before) < band || std::fabs(after) < band;
+                if ((before < 0.0f) != (after < 0.0f) || (near && std::fabs(after - before) > tolerance)) {
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    chunk.sampleSeconds = FrameStats::NowSeconds() - start;
+    chunk.remeshed = changed;
+    chunk.meshSeconds = 0.0;
+    if (changed) {
+        // The old field becomes this thread's next scratch
+        chunk.field.swap(scratch.field);
+        MeshChunk(chunk);
+        chunk.meshed = true;
+    }
+    return changed;
+}
+
+void IsosurfaceMesher::MeshChunk(Chunk& chunk) const {
+    double start = FrameStats::NowSeconds();
+    const CaseTable& table = GetCaseTable();
+    Scratch& scratch = GetScratch();
+
+    chunk.vertices.clear();
+    chunk.normals.clear();
+    chunk.indices.clear();
+    chunk.seamKeys.clear();
+
+    const size_t nx = chunk.extent[0] + 3, ny = chunk.extent[1] + 3;
+    const size_t cx = chunk.extent[0] + 1, cy = chunk.extent[1] + 1, cz = chunk.extent[2] + 1;
+    const size_t gridPoints = settings.resolution + 1;
+    const float* field = chunk.field.data();
+    const float colorScale = 0.5f / settings.halfExtent;
+    scratch.edgeVertex.assign(cx * cy * cz * 3, NO_VERTEX);
+    scratch.inside.resize(chunk.field.size());
+    for (size_t s = 0; s < chunk.field.size(); ++s) {
+        scratch.inside[s] = field[s] < 0.0f;
+    }
+
+    // Sample index of cell corner (i, j, k), past the border
+    auto sample = [nx, ny](size_t i, size_t j, size_t k) { return ((k + 1) * ny + (j + 1)) * nx + (i + 1); };
+
+    // Central difference at a corner, pointing away from the inside
+    auto gradient = [&](size_t s, float g[3]) {
+        g[0] = field[s + 1] - field[s - 1];
+        g[1] = field[s + nx] - field[s - nx];
+        g[2] = field[s + nx * ny] - field[s - nx * ny];
+    };
+
+    // The vertex where the surface crosses the edge along axis from corner (i, j, k), made
+    // once and shared by the four cells around the edge
+    auto vertexOn = [&](size_t i, size_t j, size_t k, int axis) {
+        size_t edge = ((k * cy + j) * cx + i) * 3 + axis;
+        if (scratch.edgeVertex[edge] != NO_VERTEX) {
+            return scratch.edgeVertex[edge];
+        }
+
+        size_t low[3] = { i, j, k };
+        size_t high[3] = { i, j, k };
+        ++high[axis];
+        size_t s0 = sample(low[0], low[1], low[2]);
+        size_t s1 = sample(high[0], high[1], high[2]);
+        float v0 = field[s0], v1 = field[s1];
+        float t = v0 / (v0 - v1);
+
+        float position[3];
+        for (int a = 0; a < 3; ++a) {
+            position[a] = origin[a] + cellEdge * static_cast<float>(chunk.base[a] + low[a]);
+        }
+        position[axis] += t * cellEdge;
+
+        float g0[3], g1[3], normal[3];
+        gradient(s0, g0);
+        gradient(s1, g1);
+        for (int a = 0; a < 3; ++a) {
+            normal[a] = g0[a] + t * (g1[a] - g0[a]);
+        }
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length > 0.0f) {
+            for (float& n : normal) n /= length;
+        }
+        else {
+            normal[0] = normal[1] = normal[2] = 0.0f;
+            normal[axis] = v0 < 0.0f ? 1.0f : -1.0f;
+        }
+
+        // Without normals, blend the face shades by how much the normal faces each way
+        float shade = 1.0f;
+        if (!settings.normals) {
+            shade = 0.0f;
+            for (int a = 0; a < 3; ++a) {
+                shade += normal[a] * normal[a] * FACE_SHADE[a * 2 + (normal[a] > 0.0f ? 1 : 0)];
+            }
+        }
+
+        // The merged mesh's color gradient across the sampled cube
+        MeshVertex vertex;
+        vertex.x = position[0];
+        vertex.y = position[1];
+        vertex.z = position[2];
+        vertex.r = shade * (0.3f + 0.7f * (0.5f + (position[0] - settings.center[0]) * colorScale));
+        vertex.g = shade * (0.3f + 0.7f * (0.5f + (position[1] - settings.center[1]) * colorScale));
+        vertex.b = shade * (0.3f + 0.7f * (0.5f + (position[2] - settings.center[2]) * colorScale));
+        vertex.a = 1.0f;
+        chunk.vertices.push_back(vertex);
+        if (settings.normals) {
+            chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+        }
+
+        // Edges on the chunk's faces are also made by the neighbors there
+        bool seam = false;
+        for (int a = 0; a < 3; ++a) {
+            if (a == axis) continue;
+            size_t g = chunk.base[a] + low[a];
+            seam |= (low[a] == 0 && g > 0) || (low[a] == chunk.extent[a] && g < settings.resolution);
+        }
+        uint64_t key = INTERIOR;
+        if (seam) {
+            uint64_t gx = chunk.base[0] + low[0], gy = chunk.base[1] + low[1], gz = chunk.base[2] + low[2];
+            key = ((gz * gridPoints + gy) * gridPoints + gx) * 3 + axis;
+        }
+        chunk.seamKeys.push_back(key);
+
+        uint32_t index = static_cast<uint32_t>(chunk.vertices.size() - 1);
+        scratch.edgeVertex[edge] = index;
+        return index;
+    };
+
+    const uint8_t* inside = scratch.inside.data();
+    const size_t plane = nx * ny;
+    for (size_t k = 0; k < chunk.extent[2]; ++k) {
+        for (size_t j = 0; j < chunk.extent[1]; ++j) {
+            const uint8_t* corner = &inside[sample(0, j, k)];
+            for (size_t i = 0; i < chunk.extent[0]; ++i, ++corner) {
+                int config = corner[0] | corner[1] << 1 | corner[nx] << 2 | corner[nx + 1] << 3 |
+                    corner[plane] << 4 | corner[plane + 1] << 5 | corner[plane + nx] << 6 | corner[plane + nx + 1] << 7;
+                if (config == 0 || config == 255) continue;
+
+                const int8_t* edges = table.edges[config];
+                for (int e = 0; e < table.triangleCount[config] * 3; ++e) {
+                    int low = EDGE_CORNERS[edges[e]][0];
+                    int axis = edges[e] / 4;
+                    chunk.indices.push_back(vertexOn(i + (low & 1), j + (low >> 1 & 1), k + (low >> 2 & 1), axis));
+                }
+            }
+        }
+    }
+
+    chunk.meshSeconds = FrameStats::NowSeconds() - start;
+}
+
+void IsosurfaceMesher::Assemble() {
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    size_t seamCount = 0;
+    for (const Chunk& chunk : chunks) {
+        vertexCount += chunk.vertices.size();
+        indexCount += chunk.indices.size();
+        seamCount += std::count_if(chunk.seamKeys.begin(), chunk.seamKeys.end(),
+            [](uint64_t key) { return key != INTERIOR; });
+    }
+
+    mesh.vertices.clear();
+    mesh.normals.clear();
+    mesh.indices.resize(indexCount);
+    mesh.vertices.reserve(vertexCount);
+    mesh.normals.reserve(settings.normals ? vertexCount * 3 : 0);
+    seams.clear();
+    seams.reserve(seamCount);
+
+    // Concatenate in chunk order; a seam vertex is kept from the first chunk to make it
+    // and later ones point at that
+    size_t welded = 0;
+    size_t indexOffset = 0;
+    for (const Chunk& chunk : chunks) {
+        remap.resize(chunk.vertices.size());
+        for (size_t v = 0; v < chunk.vertices.size(); ++v) {
+            uint32_t index = static_cast<uint32_t>(mesh.vertices.size());
+            if (chunk.seamKeys[v] != INTERIOR) {
+                auto inserted = seams.emplace(chunk.seamKeys[v], index);
+                if (!inserted.second) {
+                    remap[v] = inserted.first->second;
+                    ++welded;
+                    continue;
+                }
+            }
+            remap[v] = index;
+            mesh.vertices.push_back(chunk.vertices[v]);
+            if (settings.normals) {
+                mesh.normals.insert(mesh.normals.end(), &chunk.normals[v * 3], &chunk.normals[v * 3] + 3);
+            }
+        }
+        for (size_t i = 0; i < chunk.indices.size(); ++i) {
+            mesh.indices[indexOffset + i] = remap[chunk.indices[i]];
+        }
+        indexOffset += chunk.indices.size();
+    }
+
+    stats.vertices = mesh.vertices.size();
+    stats.triangles = mesh.indices.size() / 3;
+    stats.seamVertices = welded;
+}
+
+bool IsosurfaceMesher::Update(const DistanceParams& params, JobSystem* jobs) {
+    double start = FrameStats::NowSeconds();
+    GetCaseTable();
+    const size_t chunkCount = chunks.size();
+
+    if (sampled && SameParams(params, sampledParams)) {
+        stats.remeshed = 0;
+        stats.meshedTriangles = 0;
+        stats.sampleSeconds = 0.0;
+        stats.meshSeconds = 0.0;
+        stats.assembleSeconds = 0.0;
+        stats.updateSeconds = FrameStats::NowSeconds() - start;
+        return false;
+    }
+    sampledParams = params;
+    sampled = true;
+
+    ParallelForEach(chunkCount, jobs, settings.threadCount, [this, &params](size_t chunk) {
+        UpdateChunk(chunks[chunk], params);
+    });
+
+    stats.chunks = chunkCount;
+    stats.surfaceChunks = 0;
+    stats.remeshed = 0;
+    stats.meshedTriangles = 0;
+    stats.sampleSeconds = 0.0;
+    stats.meshSeconds = 0.0;
+    stats.assembleSeconds = 0.0;
+    for (const Chunk& chunk : chunks) {
+        stats.surfaceChunks += !chunk.indices.empty();
+        stats.sampleSeconds += chunk.sampleSeconds;
+        stats.meshSeconds += chunk.meshSeconds;
+        if (chunk.remeshed) {
+            ++stats.remeshed;
+            stats.meshedTriangles += chunk.indices.size() / 3;
+        }
+    }
+
+    bool changed = stats.remeshed > 0;
+    if (changed) {
+        double assembleStart = FrameStats::NowSeconds();
+        Assemble();
+        stats.assembleSeconds = FrameStats::NowSeconds() - assembleStart;
+    }
+    stats.updateSeconds = FrameStats::NowSeconds() - start;
+    return changed;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "DistanceEstimator.h"
+#include "FractalMesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+
+struct IsosurfaceSettings {
+    float center[3];        // Sampled cube; the surface should lie inside it to close
+    float halfExtent;
+    size_t resolution;      // Cells per edge of the sampled cube
+    size_t chunkSize;       // Cells per chunk edge; chunks sample and mesh in parallel
+    float isoLevel;         // Surface where the distance is this many cell edges (the Mandelbox's
+                            // estimate is never negative, so it needs a positive level)
+    float remeshTolerance;  // Cell edges a sample near the surface may move before its chunk re-meshes
+    bool normals;           // Fill FractalMesh::normals and leave shading to the shader
+    unsigned threadCount;   // Without a job system, 0 = one per hardware thread
+    SimdLevel maxSimdLevel;
+
+    IsosurfaceSettings() :
+        center{ 0.0f, 0.0f, 0.0f },
+        halfExtent(1.25f),
+        resolution(64),
+        chunkSize(16),
+        isoLevel(0.0f),
+        remeshTolerance(0.05f),
+        normals(false),
+        threadCount(0),
+        maxSimdLevel(SimdLevel::AVX512)
+    {}
+};
+
+// What the last Update did
+struct IsosurfaceStats {
+    size_t chunks;
+    size_t surfaceChunks;   // Chunks the surface passes through
+    size_t remeshed;        // Chunks meshed again this update
+    size_t triangles;       // In the whole mesh
+    size_t vertices;
+    size_t meshedTriangles; // In the chunks meshed this update
+    size_t seamVertices;    // Shared with a neighboring chunk and welded
+    double sampleSeconds;   // Work time summed over threads: distance field, change test
+    double meshSeconds;     // Work time summed over threads: cases, vertices, normals
+    double assembleSeconds;
+    double updateSeconds;   // Wall time of the whole Update
+
+    IsosurfaceStats() : chunks(0), surfaceChunks(0), remeshed(0), triangles(0), vertices(0), meshedTriangles(0),
+        seamVertices(0), sampleSeconds(0.0), meshSeconds(0.0), assembleSeconds(0.0), updateSeconds(0.0) {}
+};
+
+// Meshes a fractal's distance field into triangles with marching cubes, in chunks. The
+// field is sampled on a regular grid; each cell whose corners straddle the iso level gets
+// triangles between crossing points on its edges, and each crossing becomes one vertex
+// shared by every cell around its edge. Chunks mesh independently and their seam vertices,
+// computed identically on both sides, are welded when the chunks are joined, so the
+// result is one watertight mesh in FractalMesh's layout for DXRenderer::UploadMesh.
+//
+// Every Update resamples the field with new parameters, but a chunk keeps its triangles
+// unless a sample changed side of the surface or one near it moved more than the
+// tolerance since the chunk was last meshed, so music that moves part of the fractal
+// re-meshes only that part. Parameters equal to the last Update's skip even the sampling.
+class IsosurfaceMesher {
+public:
+    // Largest grid edge Initialize accepts
+    static const size_t MAX_RESOLUTION = 1024;
+
+private:
+    struct Chunk {
+        std::vector<float> field;       // Distance less the iso level at each sample, with a one-sample
+                                        // border for gradients, when last meshed
+        std::vector<MeshVertex> vertices;
+        std::vector<float> normals;
+        std::vector<uint32_t> indices;
+        std::vector<uint64_t> seamKeys; // Per vertex: its edge on the whole grid, or ~0 inside the chunk
+        size_t base[3];                 // First cell on the whole grid
+        size_t extent[3];               // Cells; short at the grid's far faces
+        bool meshed;
+        bool remeshed;                  // In the last Update
+        double sampleSeconds;
+        double meshSeconds;
+    };
+
+    IsosurfaceSettings settings;
+    size_t chunksPerAxis;
+    float origin[3];
+    float cellEdge;
+    std::vector<Chunk> chunks;
+    DistanceParams sampledParams;   // Of the last Update; the same again needs no sampling
+    bool sampled;
+    FractalMesh mesh;
+    IsosurfaceStats stats;
+    std::unordered_map<uint64_t, uint32_t> seams;  // Grid edge to its welded vertex, while assembling
+    std::vector<uint32_t> remap;
+
+    // Sample the chunk and re-mesh it if it moved; true if it did
+    bool UpdateChunk(Chunk& chunk, const DistanceParams& params) const;
+    void MeshChunk(Chunk& chunk) const;
+    void Assemble();
+
+public:
+    IsosurfaceMesher();
+
+    // False if the resolution or chunk size is 0, the resolution is over MAX_RESOLUTION
+    // or the extent isn't positive
+    bool Initialize(const IsosurfaceSettings& settings);
+
+    // Resample with this frame's parameters and re-mesh what moved; true if the mesh
+    // changed. With a job system the chunks are jobs on its threads.
+    bool Update(const DistanceParams& params, JobSystem* jobs = nullptr);
+
+    // Make the next Update re-mesh every chunk
+    void Invalidate();
+
+    const FractalMesh& GetMesh() const { return mesh; }
+    const IsosurfaceStats& GetStats() const { return stats; }
+    const IsosurfaceSettings& GetSettings() const { return settings; }
+    float GetCellEdge() const { return cellEdge; }
+};
@@ -0,0 +1,378 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // Worker slot of the calling thread, set for the initializing thread and each worker
+    thread_local void* currentWorker = nullptr;
+    thread_local JobSystem* currentSystem = nullptr;
+
+    // Failed steal rounds before an idle worker goes to sleep
+    const int SPIN_ROUNDS = 64;
+
+    const int64_t DEQUE_MASK = static_cast<int64_t>(JobSystem::MAX_JOBS_PER_THREAD - 1);
+}
+
+JobSystem::JobDeque::JobDeque() :
+    buffer(new std::atomic<Job*>[MAX_JOBS_PER_THREAD]),
+    top(0),
+    bottom(0)
+{
+    for (size_t i = 0; i < MAX_JOBS_PER_THREAD; ++i) {
+        buffer[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool JobSystem::JobDeque::Push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= static_cast<int64_t>(MAX_JOBS_PER_THREAD)) {
+        return false;
+    }
+
+    buffer[b & DEQUE_MASK].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobSystem::JobDeque::Pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = buffer[b & DEQUE_MASK].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last one: race any thief for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobSystem::JobDeque::Steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+
+    Job* job = buffer[t & DEQUE_MASK].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::Worker::Worker() :
+    system(nullptr),
+    index(0),
+    jobs(MAX_JOBS_PER_THREAD),
+    allocated(0),
+    random(0),
+    executed(0),
+    stolen(0),
+    inlined(0)
+{
+    // Pool slots start out finished, so the first pass over the pool never waits
+    for (Job& job : jobs) {
+        job.unfinished.store(-1, std::memory_order_relaxed);
+        job.continuationCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+JobSystem::JobSystem() :
+    stopping(false),
+    queuedJobs(0),
+    sleepingWorkers(0)
+{}
+
+JobSystem::~JobSystem() {
+    Shutdown();
+}
+
+bool JobSystem::Initialize(unsigned workerCount) {
+    Shutdown();
+
+    if (workerCount == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    // Every deque and job pool is allocated before any thread starts
+    workers.resize(workerCount + 1);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].reset(new Worker());
+        workers[i]->system = this;
+        workers[i]->index = i;
+        workers[i]->random = 0x9E3779B9u * static_cast<uint32_t>(i + 1);
+    }
+
+    currentWorker = workers[0].get();
+    currentSystem = this;
+
+    stopping.store(false);
+    queuedJobs.store(0);
+    for (size_t i = 1; i < workers.size(); ++i) {
+        threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+    return true;
+}
+
+void JobSystem::Shutdown() {
+    if (workers.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    if (currentSystem == this) {
+        currentWorker = nullptr;
+        currentSystem = nullptr;
+    }
+    workers.clear();
+}
+
+JobSystem::Worker* JobSystem::GetCurrentWorker() const {
+    return currentSystem == this ? static_cast<Worker*>(currentWorker) : nullptr;
+}
+
+JobSystem* JobSystem::GetJobSystem() {
+    return currentSystem;
+}
+
+Job* JobSystem::AllocateJob() {
+    Worker* worker = GetCurrentWorker();
+
+    // Next finished slot in the ring. Long-lived parents (a frame's root, a parallel
+    // for's upper splits) stay put while the short-lived jobs around them recycle.
+    for (size_t attempt = 0; attempt < MAX_JOBS_PER_THREAD; ++attempt) {
+        Job* job = &worker->jobs[worker->allocated++ & (MAX_JOBS_PER_THREAD - 1)];
+        if (IsFinished(job)) {
+            return job;
+        }
+    }
+
+    // Every slot is in use: help out until the oldest one is done
+    Job* job = &worker->jobs[worker->allocated++ & (MAX_JOBS_PER_THREAD - 1)];
+    Wait(job);
+    return job;
+}
+
+Job* JobSystem::CreateJob(JobFunction function, const void* data, size_t size) {
+    return CreateChildJob(nullptr, function, data, size);
+}
+
+Job* JobSystem::CreateChildJob(Job* parent, JobFunction function, const void* data, size_t size) {
+    if (parent) {
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Job* job = AllocateJob();
+    job->function = function;
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    job->continuationCount.store(0, std::memory_order_relaxed);
+    if (data && size > 0) {
+        std::memcpy(job->payload, data, std::min(size, Job::PAYLOAD_SIZE));
+    }
+    return job;
+}
+
+bool JobSystem::AddContinuation(Job* ancestor, Job* continuation) {
+    // Only the creating thread adds, so the slot is ours; the release publishes it to
+    // whichever thread ends up finishing the ancestor
+    int32_t slot = ancestor->continuationCount.load(std::memory_order_relaxed);
+    if (slot >= static_cast<int32_t>(Job::MAX_CONTINUATIONS)) {
+        return false;
+    }
+    ancestor->continuations[slot] = continuation;
+    ancestor->continuationCount.store(slot + 1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::Run(Job* job) {
+    // Counted before it's visible, so the count never runs behind the deques and a
+    // worker about to sleep either sees the job or is already waiting when we notify
+    queuedJobs.fetch_add(1);
+
+    Worker* worker = GetCurrentWorker();
+    if (!worker->deque.Push(job)) {
+        queuedJobs.fetch_sub(1);
+        worker->inlined.fetch_add(1, std::memory_order_relaxed);
+        Execute(job);
+        return;
+    }
+
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+Job* JobSystem::GetJob(Worker& worker) {
+    Job* job = worker.deque.Pop();
+    if (job) {
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    // Try every other thread once, starting at a random one
+    size_t count = workers.size();
+    if (count < 2) {
+        return nullptr;
+    }
+    worker.random ^= worker.random << 13;
+    worker.random ^= worker.random >> 17;
+    worker.random ^= worker.random << 5;
+    size_t start = worker.random % count;
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (victim == worker.index) continue;
+
+        job = workers[victim]->deque.Steal();
+        if (job) {
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            worker.stolen.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::Execute(Job* job) {
+    job->function(job, job->payload);
+    GetCurrentWorker()->executed.fetch_add(1, std::memory_order_relaxed);
+    Finish(job);
+}
+
+void JobSystem::Finish(Job* job) {
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    // Only the final decrement gets here, after every continuation was added. At 0 the
+    // slot isn't free yet, so copy what's needed before the release marks it finished:
+    // from then on its creator may reuse it.
+    Job* parent = job->parent;
+    int32_t continuationCount = job->continuationCount.load(std::memory_order_acquire);
+    Job* continuations[Job::MAX_CONTINUATIONS];
+    for (int32_t i = 0; i < continuationCount; ++i) {
+        continuations[i] = job->continuations[i];
+    }
+    job->unfinished.store(-1, std::memory_order_release);
+
+    for (int32_t i = 0; i < continuationCount; ++i) {
+        Run(continuations[i]);
+    }
+    if (parent) {
+        Finish(parent);
+    }
+}
+
+void JobSystem::Wait(const Job* job) {
+    Worker* worker = GetCurrentWorker();
+    while (!IsFinished(job)) {
+        Job* next = GetJob(*worker);
+        if (next) {
+            Execute(next);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::WorkerLoop(size_t index) {
+    Worker& worker = *workers[index];
+    currentWorker = &worker;
+    currentSystem = this;
+
+    int idleRounds = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        Job* job = GetJob(worker);
+        if (job) {
+            Execute(job);
+            idleRounds = 0;
+            continue;
+        }
+
+        if (++idleRounds < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        while (queuedJobs.load() <= 0 && !stopping.load()) {
+            wake.wait(lock);
+        }
+        sleepingWorkers.fetch_sub(1);
+        idleRounds = 0;
+    }
+
+    currentWorker = nullptr;
+    currentSystem = nullptr;
+}
+
+JobSystemStats JobSystem::GetStats() const {
+    JobSystemStats stats = {};
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        stats.executed += worker->executed.load(std::memory_order_relaxed);
+        stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+        stats.inlined += worker->inlined.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void JobSystem::ResetStats() {
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        worker->executed.store(0, std::memory_order_relaxed);
+        worker->stolen.store(0, std::memory_order_relaxed);
+        worker->inlined.store(0, std::memory_order_relaxed);
+    }
+}
+
+void RunOnThreads(size_t count, unsigned threadCount, void (*function)(const void* context, size_t index),
+    const void* context) {
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    threadCount = static_cast<unsigned>(std::min<size_t>(std::max(1u, threadCount), std::max<size_t>(count, 1)));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (;;) {
+            size_t i = next.fetch_add(1);
+            if (i >= count) break;
+            function(context, i);
+        }
+    };
+
+    // The calling thread works too
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threadCount; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
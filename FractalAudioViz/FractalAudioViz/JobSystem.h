@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct Job;
+typedef void (*JobFunction)(Job* job, void* data);
+
+// A unit of work: a function, an inline payload for its arguments, the parent waiting on
+// it, and jobs to start once it (and all of its children) have finished. Jobs come from
+// a per-thread ring that reuses finished slots, so each thread should have fewer than
+// JobSystem::MAX_JOBS_PER_THREAD jobs alive at once. Two cache lines each.
+struct Job {
+    static const size_t MAX_CONTINUATIONS = 4;
+    static const size_t PAYLOAD_SIZE = 72;
+
+    JobFunction function;
+    Job* parent;
+    std::atomic<int32_t> unfinished;         // 1 for itself plus one per unfinished child; -1 once finished
+    std::atomic<int32_t> continuationCount;
+    Job* continuations[MAX_CONTINUATIONS];
+    unsigned char payload[PAYLOAD_SIZE];     // Pointer aligned
+};
+
+struct JobSystemStats {
+    uint64_t executed;  // Jobs run, including on the thread that waits
+    uint64_t stolen;    // Of those, taken from another thread's deque
+    uint64_t inlined;   // Run on the spot because the creator's deque was full
+};
+
+// Work-stealing scheduler. Each thread (the one that called Initialize, plus workers)
+// pushes and pops jobs at the bottom of its own lock-free deque; idle threads steal from
+// the top of a random other one, so big jobs split near the root migrate first. Idle
+// workers spin briefly, then sleep until something is queued.
+//
+// Jobs may only be created, run and waited on from the initializing thread or from
+// inside jobs. Nothing allocates after Initialize.
+class JobSystem {
+public:
+    static const size_t MAX_JOBS_PER_THREAD = 4096;  // Power of two
+
+private:
+    // Chase-Lev deque of fixed capacity
+    class JobDeque {
+    private:
+        std::unique_ptr<std::atomic<Job*>[]> buffer;
+        std::atomic<int64_t> top;
+        std::atomic<int64_t> bottom;
+
+    public:
+        JobDeque();
+        bool Push(Job* job);   // Owner only; false when full
+        Job* Pop();            // Owner only, newest first
+        Job* Steal();          // Any thread, oldest first
+    };
+
+    struct Worker {
+        JobSystem* system;
+        size_t index;
+        JobDeque deque;
+        std::vector<Job> jobs;
+        size_t allocated;
+        uint32_t random;
+        std::atomic<uint64_t> executed;
+        std::atomic<uint64_t> stolen;
+        std::atomic<uint64_t> inlined;
+
+        Worker();
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;  // [0] is the initializing thread
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+
+    // Sleep/wake for idle workers
+    std::atomic<int64_t> queuedJobs;
+    std::atomic<int32_t> sleepingWorkers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    Worker* GetCurrentWorker() const;
+    Job* AllocateJob();
+    Job* GetJob(Worker& worker);
+    void Execute(Job* job);
+    void Finish(Job* job);
+    void WorkerLoop(size_t index);
+
+    template <typename Fn>
+    static void InvokeCallable(Job*, void* data) {
+        (*static_cast<Fn*>(data))();
+    }
+
+    // Payload layouts for ParallelFor: the root owns the callable, splits point back at it
+    template <typename Fn>
+    struct ParallelForRoot {
+        Fn fn;
+        size_t begin;
+        size_t end;
+        size_t grain;
+    };
+
+    template <typename Fn>
+    struct ParallelForSplit {
+        const Fn* fn;
+        size_t begin;
+        size_t end;
+        size_t grain;
+    };
+
+    // Halve the range, handing the upper half to a child each time, until it's one grain
+    template <typename Fn>
+    static void RunRange(JobSystem* system, Job* job, const Fn& fn, size_t begin, size_t end, size_t grain) {
+        while (end - begin > grain) {
+            size_t middle = begin + (end - begin) / 2;
+            ParallelForSplit<Fn> split = { &fn, middle, end, grain };
+            system->Run(system->CreateChildJob(job, &ParallelForSplitJob<Fn>, &split, sizeof(split)));
+            end = middle;
+        }
+        if (begin < end) {
+            fn(begin, end);
+        }
+    }
+
+    template <typename Fn>
+    static void ParallelForSplitJob(Job* job, void* data) {
+        ParallelForSplit<Fn>* split = static_cast<ParallelForSplit<Fn>*>(data);
+        RunRange(GetJobSystem(), job, *split->fn, split->begin, split->end, split->grain);
+    }
+
+    template <typename Fn>
+    static void ParallelForRootJob(Job* job, void* data) {
+        ParallelForRoot<Fn>* root = static_cast<ParallelForRoot<Fn>*>(data);
+        RunRange(GetJobSystem(), job, root->fn, root->begin, root->end, root->grain);
+    }
+
+    static JobSystem* GetJobSystem();
+
+public:
+    JobSystem();
+    ~JobSystem();
+
+    // Start workerCount extra threads (0 = one fewer than the hardware threads). The
+    // calling thread becomes worker 0 and works whenever it waits.
+    bool Initialize(unsigned workerCount = 0);
+    void Shutdown();
+
+    // Threads that run jobs, including the initializing one
+    size_t GetThreadCount() const { return workers.size(); }
+
+    // Create a job copying size bytes of payload; the function gets the copy
+    Job* CreateJob(JobFunction function, const void* data = nullptr, size_t size = 0);
+
+    // Same, as a child: the parent isn't finished until this job is
+    Job* CreateChildJob(Job* parent, JobFunction function, const void* data = nullptr, size_t size = 0);
+
+    // Jobs from a callable, copied into the payload; it has to be small and trivially
+    // copyable (capture pointers and references, not containers)
+    template <typename Fn>
+    Job* CreateJob(const Fn& fn) {
+        return CreateChildJob(nullptr, fn);
+    }
+
+    template <typename Fn>
+    Job* CreateChildJob(Job* parent, const Fn& fn) {
+        static_assert(sizeof(Fn) <= Job::PAYLOAD_SIZE, "Job callable captures too much");
+        static_assert(alignof(Fn) <= alignof(void*), "Job callable is over-aligned");
+        static_assert(std::is_trivially_copyable<Fn>::value, "Job callable must be trivially copyable");
+        Job* job = CreateChildJob(parent, &InvokeCallable<Fn>, nullptr, 0);
+        new (job->payload) Fn(fn);
+        return job;
+    }
+
+    // Start continuation once ancestor and all its children have finished. Call from the
+    // thread that created both, before either is run (ancestor's children may already be
+    // running); false if ancestor has no continuation slots left.
+    bool AddContinuation(Job* ancestor, Job* continuation);
+
+    // Queue a job on the calling thread's deque
+    void Run(Job* job);
+
+    // Run jobs (this thread's first, then stolen ones) until the job has finished
+    void Wait(const Job* job);
+
+    static bool IsFinished(const Job* job) { return job->unfinished.load(std::memory_order_acquire) < 0; }
+
+    // Job calling fn(begin, end) over [0, count) in chunks of about grain, split
+    // recursively so idle threads steal large halves first. Run and Wait it, or use it
+    // as a dependency; fn is copied into the job.
+    template <typename Fn>
+    Job* CreateParallelFor(Job* parent, size_t count, size_t grain, const Fn& fn) {
+        static_assert(sizeof(ParallelForRoot<Fn>) <= Job::PAYLOAD_SIZE, "ParallelFor callable captures too much");
+        static_assert(alignof(Fn) <= alignof(void*), "ParallelFor callable is over-aligned");
+        static_assert(std::is_trivially_copyable<Fn>::value, "ParallelFor callable must be trivially copyable");
+        ParallelForRoot<Fn> root = { fn, 0, count, grain > 0 ? grain : 1 };
+        return CreateChildJob(parent, &ParallelForRootJob<Fn>, &root, sizeof(root));
+    }
+
+    // Blocking parallel for
+    template <typename Fn>
+    void ParallelFor(size_t count, size_t grain, const Fn& fn) {
+        Job* job = CreateParallelFor(nullptr, count, grain, fn);
+        Run(job);
+        Wait(job);
+    }
+
+    JobSystemStats GetStats() const;
+    void ResetStats();
+};
+
+// fn(i) for every i below count on threadCount threads (0 = one per hardware thread),
+// the calling thread among them, pulling indices off a shared counter. For callers that
+// run without a job system; starts and joins its threads every call.
+void RunOnThreads(size_t count, unsigned threadCount, void (*function)(const void* context, size_t index),
+    const void* context);
+
+// fn(i) for every i below count: as a ParallelFor when there's a job system, otherwise
+// on threadCount threads through RunOnThreads
+template <typename Fn>
+void ParallelForEach(size_t count, JobSystem* jobs, unsigned threadCount, const Fn& fn) {
+    if (jobs) {
+        jobs->ParallelFor(count, 1, [&fn](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                fn(i);
+            }
+        });
+        return;
+    }
+
+    RunOnThreads(count, threadCount, [](const void* context, size_t index) {
+        (*static_cast<const Fn*>(context))(index);
+    }, &fn);
+}
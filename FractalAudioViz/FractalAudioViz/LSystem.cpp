@@ -0,0 +1,405 @@
+#include "LSystem.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+    // Symbols per rewriting and scanning job
+    const size_t CHUNK_SYMBOLS = 65536;
+
+    // Deepest bracket level the turtle is split at
+    const size_t MAX_SPLIT_DEPTH = 16;
+
+    // Bracket levels given their own segment length and width; deeper ones use the last
+    const size_t MAX_SCALED_DEPTH = 64;
+
+    unsigned GetThreads(const LSystemSettings& settings, JobSystem* jobs) {
+        unsigned threads = settings.threadCount;
+        if (jobs) threads = static_cast<unsigned>(jobs->GetThreadCount());
+        else if (threads == 0) threads = std::thread::hardware_concurrency();
+        return std::max(1u, threads);
+    }
+
+    // Position, then heading, left and up, and the bracket depth
+    struct Turtle {
+        float position[3];
+        float heading[3];
+        float left[3];
+        float up[3];
+        size_t depth;
+    };
+
+    // The settings as the turtle uses them, derived once per Generate
+    struct TurtleParams {
+        float cosine;
+        float sine;
+        float length[MAX_SCALED_DEPTH];     // Per bracket depth
+        float width[MAX_SCALED_DEPTH];
+        uint32_t color[MAX_SCALED_DEPTH];
+    };
+
+    TurtleParams MakeTurtleParams(const LSystemSettings& settings) {
+        TurtleParams params;
+        const double radians = settings.angle * 3.14159265358979323846 / 180.0;
+        params.cosine = static_cast<float>(std::cos(radians));
+        params.sine = static_cast<float>(std::sin(radians));
+
+        // Bark at the trunk to leaves six brackets out
+        const float bark[3] = { 101.0f, 67.0f, 33.0f }, leaf[3] = { 70.0f, 160.0f, 50.0f };
+        double length = settings.length * std::pow(static_cast<double>(settings.generationScale),
+            std::max(settings.generations, 0));
+        double width = settings.width;
+        for (size_t depth = 0; depth < MAX_SCALED_DEPTH; ++depth) {
+            params.length[depth] = static_cast<float>(length);
+            params.width[depth] = static_cast<float>(width);
+            length *= settings.branchScale;
+            width *= settings.branchScale;
+
+            float t = std::min(1.0f, depth / 6.0f);
+            uint32_t color = 0xFF000000u;
+            for (int channel = 0; channel < 3; ++channel) {
+                color |= static_cast<uint32_t>(bark[channel] + (leaf[channel] - bark[channel]) * t + 0.5f) << (8 * channel);
+            }
+            params.color[depth] = color;
+        }
+        return params;
+    }
+
+    Turtle StartTurtle() {
+        // Up the y axis, with left along -x and up along z
+        Turtle turtle = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, 0 };
+        return turtle;
+    }
+
+    // a and b turned by the angle in their plane, a toward b
+    void Turn(float* a, float* b, float cosine, float sine) {
+        for (int i = 0; i < 3; ++i) {
+            float x = a[i], y = b[i];
+            a[i] = x * cosine + y * sine;
+            b[i] = y * cosine - x * sine;
+        }
+    }
+
+    // One symbol; a drawn segment is written to world and color at index, which moves on
+    void Step(const TurtleParams& params, char symbol, Turtle& turtle, std::vector<Turtle>& stack, float* world,
+        uint32_t* color, size_t& index) {
+        const size_t level = std::min(turtle.depth, MAX_SCALED_DEPTH - 1);
+        switch (symbol) {
+        case 'F': {
+            const float half = 0.5f * params.length[level], width = params.width[level];
+            float* m = world + 16 * index;
+            for (int i = 0; i < 3; ++i) {
+                m[i] = turtle.left[i] * width;
+                m[4 + i] = turtle.heading[i] * half;
+                m[8 + i] = turtle.up[i] * width;
+                m[12 + i] = turtle.position[i] + turtle.heading[i] * half;
+                turtle.position[i] += turtle.heading[i] * 2.0f * half;
+            }
+            m[3] = m[7] = m[11] = 0.0f;
+            m[15] = 1.0f;
+            color[index++] = params.color[level];
+            break;
+        }
+        case 'f':
+            for (int i = 0; i < 3; ++i) turtle.position[i] += turtle.heading[i] * params.length[level];
+            break;
+        case '+': Turn(turtle.heading, turtle.left, params.cosine, params.sine); break;
+        case '-': Turn(turtle.heading, turtle.left, params.cosine, -params.sine); break;
+        case '&': Turn(turtle.heading, turtle.up, params.cosine, -params.sine); break;
+        case '^': Turn(turtle.heading, turtle.up, params.cosine, params.sine); break;
+        case '\\': Turn(turtle.left, turtle.up, params.cosine, params.sine); break;
+        case '/': Turn(turtle.left, turtle.up, params.cosine, -params.sine); break;
+        case '|': Turn(turtle.heading, turtle.left, -1.0f, 0.0f); break;
+        case '[':
+            stack.push_back(turtle);
+            ++turtle.depth;
+            break;
+        case ']':
+            if (!stack.empty()) {
+                turtle = stack.back();
+                stack.pop_back();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Per-thread turtle stack, reused across branches and calls
+    std::vector<Turtle>& GetStack() {
+        thread_local std::vector<Turtle> stack;
+        return stack;
+    }
+
+    // What the scan of one chunk found, relative to the depth it starts at
+    struct ChunkScan {
+        long long net;          // Opened less closed
+        long long lowest;       // Lowest depth reached
+        size_t draws;
+        size_t startDepth;      // Absolute, once the chunks before are summed
+        size_t opens[MAX_SPLIT_DEPTH + 1];   // Brackets opening each absolute depth
+        size_t firstUnit;       // Index of the first unit opening in this chunk
+        size_t firstClose;
+    };
+
+    // A branch read on its own: its bracket, the matching one, the state before it and
+    // where its segments go
+    struct Unit {
+        size_t begin;
+        size_t end;
+        size_t draws;
+        size_t offset;
+        Turtle start;
+    };
+}
+
+LSystemGenerator::LSystemGenerator() :
+    current(0),
+    length(0)
+{}
+
+bool LSystemGenerator::Rewrite(const LSystemSettings& settings, JobSystem* jobs) {
+    const double start = FrameStats::NowSeconds();
+    const unsigned threads = GetThreads(settings, jobs);
+    stats = LSystemStats();
+
+    size_t lengths[256];
+    const char* replacements[256] = {};
+    for (size_t i = 0; i < 256; ++i) lengths[i] = 1;
+    for (const LSystemRule& rule : settings.rules) {
+        unsigned char symbol = static_cast<unsigned char>(rule.symbol);
+        lengths[symbol] = rule.replacement.size();
+        replacements[symbol] = rule.replacement.data();
+    }
+
+    current = 0;
+    length = settings.axiom.size();
+    if (buffers[0].size() < length) buffers[0].resize(length);
+    std::copy(settings.axiom.begin(), settings.axiom.end(), buffers[0].begin());
+
+    for (int generation = 0; generation < settings.generations; ++generation) {
+        // Each chunk's output length, then where it starts
+        const char* source = buffers[current].data();
+        const size_t chunks = (length + CHUNK_SYMBOLS - 1) / CHUNK_SYMBOLS;
+        chunkOffsets.assign(chunks + 1, 0);
+        ParallelForEach(chunks, jobs, threads, [&](size_t chunk) {
+            const size_t begin = chunk * CHUNK_SYMBOLS, end = std::min(begin + CHUNK_SYMBOLS, length);
+            size_t sum = 0;
+            for (size_t i = begin; i < end; ++i) sum += lengths[static_cast<unsigned char>(source[i])];
+            chunkOffsets[chunk + 1] = sum;
+        });
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            chunkOffsets[chunk + 1] += chunkOffsets[chunk];
+        }
+        const size_t total = chunkOffsets[chunks];
+        if (total > MAX_SYMBOLS) {
+            length = 0;
+            stats.rewriteSeconds = FrameStats::NowSeconds() - start;
+            return false;
+        }
+
+        // The other buffer only grows, so after the first call it rarely allocates
+        std::vector<char>& target = buffers[1 - current];
+        if (target.size() < total) target.resize(total);
+        char* output = target.data();
+        ParallelForEach(chunks, jobs, threads, [&](size_t chunk) {
+            const size_t begin = chunk * CHUNK_SYMBOLS, end = std::min(begin + CHUNK_SYMBOLS, length);
+            char* out = output + chunkOffsets[chunk];
+            for (size_t i = begin; i < end; ++i) {
+                unsigned char symbol = static_cast<unsigned char>(source[i]);
+                if (replacements[symbol]) {
+                    out = std::copy(replacements[symbol], replacements[symbol] + lengths[symbol], out);
+                }
+                else {
+                    *out++ = source[i];
+                }
+            }
+        });
+
+        current = 1 - current;
+        length = total;
+        stats.rewrittenSymbols += total;
+    }
+
+    stats.symbols = length;
+    stats.rewriteSeconds = FrameStats::NowSeconds() - start;
+    return true;
+}
+
+bool LSystemGenerator::Generate(const LSystemSettings& settings, LSystemInstances& instances, JobSystem* jobs) {
+    if (!Rewrite(settings, jobs)) {
+        instances.count = 0;
+        instances.world.clear();
+        instances.color.clear();
+        return false;
+    }
+
+    const double start = FrameStats::NowSeconds();
+    const unsigned threads = GetThreads(settings, jobs);
+    const TurtleParams params = MakeTurtleParams(settings);
+    const char* symbols = buffers[current].data();
+    const size_t chunks = (length + CHUNK_SYMBOLS - 1) / CHUNK_SYMBOLS;
+
+    // Each chunk's bracket balance and segments, then its starting depth
+    std::vector<ChunkScan> scans(chunks);
+    ParallelForEach(chunks, jobs, threads, [&](size_t chunk) {
+        const size_t begin = chunk * CHUNK_SYMBOLS, end = std::min(begin + CHUNK_SYMBOLS, length);
+        ChunkScan& scan = scans[chunk];
+        scan.net = 0;
+        scan.lowest = 0;
+        scan.draws = 0;
+        for (size_t i = begin; i < end; ++i) {
+            char symbol = symbols[i];
+            scan.net += symbol == '[';
+            scan.net -= symbol == ']';
+            scan.lowest = std::min(scan.lowest, scan.net);
+            scan.draws += symbol == 'F';
+        }
+    });
+    size_t draws = 0;
+    long long depth = 0;
+    bool balanced = true;
+    for (ChunkScan& scan : scans) {
+        balanced = balanced && depth + scan.lowest >= 0;
+        scan.startDepth = static_cast<size_t>(std::max(depth, 0LL));
+        depth += scan.net;
+        draws += scan.draws;
+    }
+    balanced = balanced && depth == 0;
+
+    // Brackets opening each depth, to split at the shallowest with a few per thread
+    ParallelForEach(balanced ? chunks : 0, jobs, threads, [&](size_t chunk) {
+        const size_t begin = chunk * CHUNK_SYMBOLS, end = std::min(begin + CHUNK_SYMBOLS, length);
+        ChunkScan& scan = scans[chunk];
+        std::fill(scan.opens, scan.opens + MAX_SPLIT_DEPTH + 1, 0);
+        size_t level = scan.startDepth;
+        for (size_t i = begin; i < end; ++i) {
+            if (symbols[i] == '[') {
+                ++level;
+                if (level <= MAX_SPLIT_DEPTH) ++scan.opens[level];
+            }
+            else if (symbols[i] == ']') {
+                --level;
+            }
+        }
+    });
+    size_t splitDepth = 0, best = 0;
+    for (size_t level = 1; balanced && level <= MAX_SPLIT_DEPTH; ++level) {
+        size_t count = 0;
+        for (const ChunkScan& scan : scans) count += scan.opens[level];
+        if (count > best) {
+            best = count;
+            splitDepth = level;
+        }
+        if (count >= 8 * static_cast<size_t>(threads)) {
+            break;
+        }
+    }
+
+    // The units are the brackets opening the split depth; they don't nest, so the k-th
+    // closing back out of it matches the k-th opening
+    std::vector<Unit> units(best);
+    size_t unitCount = 0;
+    for (ChunkScan& scan : scans) {
+        scan.firstUnit = unitCount;
+        scan.firstClose = unitCount;
+        if (splitDepth > 0) unitCount += scan.opens[splitDepth];
+    }
+    for (size_t chunk = 1; chunk < chunks && splitDepth > 0; ++chunk) {
+        // Closes before a chunk are the opens before it less those still open at its start
+        scans[chunk].firstClose = scans[chunk].firstUnit - (scans[chunk].startDepth >= splitDepth ? 1 : 0);
+    }
+    ParallelForEach(splitDepth > 0 ? chunks : 0, jobs, threads, [&](size_t chunk) {
+        const size_t begin = chunk * CHUNK_SYMBOLS, end = std::min(begin + CHUNK_SYMBOLS, length);
+        const ChunkScan& scan = scans[chunk];
+        size_t level = scan.startDepth, open = scan.firstUnit, close = scan.firstClose;
+        for (size_t i = begin; i < end; ++i) {
+            if (symbols[i] == '[') {
+                if (++level == splitDepth) units[open++].begin = i;
+            }
+            else if (symbols[i] == ']') {
+                if (level-- == splitDepth) units[close++].end = i;
+            }
+        }
+    });
+    ParallelForEach(units.size(), jobs, threads, [&](size_t u) {
+        Unit& unit = units[u];
+        unit.draws = static_cast<size_t>(std::count(symbols + unit.begin, symbols + unit.end, 'F'));
+    });
+
+    instances.count = draws;
+    instances.world.resize(16 * draws);
+    instances.color.resize(draws);
+    float* world = instances.world.data();
+    uint32_t* color = instances.color.data();
+
+    // The spine: everything outside the units, on this thread, noting the state and the
+    // first segment index at each unit as it steps over it
+    size_t spineSymbols = 0;
+    {
+        Turtle turtle = StartTurtle();
+        std::vector<Turtle>& stack = GetStack();
+        stack.clear();
+        size_t index = 0, next = 0;
+        for (size_t i = 0; i < length; ++i) {
+            if (next < units.size() && i == units[next].begin) {
+                units[next].start = turtle;
+                units[next].offset = index;
+                index += units[next].draws;
+                i = units[next++].end;
+                continue;
+            }
+            Step(params, symbols[i], turtle, stack, world, color, index);
+            ++spineSymbols;
+        }
+    }
+
+    // Then the units, each from its own state into its own range
+    ParallelForEach(units.size(), jobs, threads, [&](size_t u) {
+        const Unit& unit = units[u];
+        Turtle turtle = unit.start;
+        std::vector<Turtle>& stack = GetStack();
+        stack.clear();
+        size_t index = unit.offset;
+        for (size_t i = unit.begin; i <= unit.end; ++i) {
+            Step(params, symbols[i], turtle, stack, world, color, index);
+        }
+    });
+
+    stats.units = units.size();
+    stats.spineSymbols = spineSymbols;
+    stats.splitDepth = splitDepth;
+    stats.interpretSeconds = FrameStats::NowSeconds() - start;
+    stats.peakBytes = buffers[0].capacity() + buffers[1].capacity() + chunkOffsets.capacity() * sizeof(size_t) +
+        scans.capacity() * sizeof(ChunkScan) + units.capacity() * sizeof(Unit) +
+        instances.world.capacity() * sizeof(float) + instances.color.capacity() * sizeof(uint32_t);
+    return true;
+}
+
+void LSystemGenerator::InterpretSerial(const LSystemSettings& settings, const char* symbols, size_t count,
+    LSystemInstances& instances) {
+    const TurtleParams params = MakeTurtleParams(settings);
+    instances.count = static_cast<size_t>(std::count(symbols, symbols + count, 'F'));
+    instances.world.resize(16 * instances.count);
+    instances.color.resize(instances.count);
+
+    Turtle turtle = StartTurtle();
+    std::vector<Turtle> stack;
+    size_t index = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Step(params, symbols[i], turtle, stack, instances.world.data(), instances.color.data(), index);
+    }
+}
+
+LSystemSettings LSystemGenerator::Modulate(const LSystemSettings& base, const BandEnergies& bands,
+    const LSystemModulation& modulation) {
+    const float bass = bands.GetMeanLevel(0.0, 0.125);
+    const float mids = bands.GetMeanLevel(0.125, 0.5);
+
+    LSystemSettings settings = base;
+    settings.angle += modulation.angleDepth * mids;
+    settings.length *= 1.0f + modulation.lengthDepth * bass;
+    return settings;
+}
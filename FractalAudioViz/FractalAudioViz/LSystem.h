@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Filterbank.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// One deterministic production: every symbol in a generation is replaced at once
+struct LSystemRule {
+    char symbol;
+    std::string replacement;
+};
+
+// A bracketed 3D L-system read by a turtle (Prusinkiewicz and Lindenmayer's symbols):
+// F draws a segment forward and f moves without drawing; + and - turn about the up axis,
+// & and ^ pitch about the left axis, \ and / roll about the heading, | turns around;
+// [ and ] push and pop the turtle. Anything else only takes part in rewriting.
+struct LSystemSettings {
+    std::string axiom;
+    std::vector<LSystemRule> rules;     // At most one per symbol; the last wins
+    int generations;
+    float angle;                        // Degrees per turn
+    float length;                       // Of a segment in the axiom
+    float generationScale;              // Segment length per generation, so a tree whose
+                                        // segments double keeps its size at 0.5
+    float width;                        // Half thickness of a trunk segment
+    float branchScale;                  // Length and thickness per bracket level
+    unsigned threadCount;               // Without a job system, 0 = one per hardware thread
+
+    // A 3D tree: each bud grows a segment and four buds, three of them on branches, and
+    // every segment doubles
+    LSystemSettings() :
+        axiom("X"),
+        rules{ { 'X', "F[&+X][&-X]/[^X]FX" }, { 'F', "FF" } },
+        generations(6),
+        angle(25.0f),
+        length(1.0f),
+        generationScale(0.5f),
+        width(0.08f),
+        branchScale(0.8f),
+        threadCount(0)
+    {}
+};
+
+// How far the shape moves at full band level, with the bands split as for the distance
+// estimators
+struct LSystemModulation {
+    float angleDepth;       // Degrees the mids open the branches by
+    float lengthDepth;      // Fraction the bass stretches the segments by
+
+    LSystemModulation() :
+        angleDepth(10.0f),
+        lengthDepth(0.25f)
+    {}
+};
+
+// One world matrix per drawn segment, in Cube's terms: 16 floats, row-major for row
+// vectors as an XMMATRIX stores them, scale * rotation * translation of the -1..1 unit
+// cube mesh. The cube's y axis runs along the segment.
+struct LSystemInstances {
+    std::vector<float> world;
+    std::vector<uint32_t> color;        // R8G8B8A8, red in the low byte; bark to leaves by depth
+    size_t count;
+
+    LSystemInstances() : count(0) {}
+};
+
+// What the last Generate did
+struct LSystemStats {
+    size_t symbols;                 // In the last generation
+    size_t units;                   // Branches interpreted on their own
+    size_t spineSymbols;            // Outside them, read by one thread first
+    size_t splitDepth;              // Bracket depth the units open at
+    double rewriteSeconds;
+    double interpretSeconds;
+    size_t peakBytes;               // Symbol buffers, split tables and instances
+    uint64_t rewrittenSymbols;      // Written over all generations
+
+    LSystemStats() :
+        symbols(0), units(0), spineSymbols(0), splitDepth(0), rewriteSeconds(0.0), interpretSeconds(0.0),
+        peakBytes(0), rewrittenSymbols(0)
+    {}
+};
+
+// Rewrites an L-system and interprets it into segment instances, in parallel at both
+// steps. Each generation is rewritten in chunks: a first pass sums the lengths of each
+// chunk's replacements, a prefix sum over the chunks places them, and a second pass writes
+// every chunk into its place in one buffer sized exactly, alternating between two
+// buffers kept across generations and calls. The turtle is then split at brackets, which
+// restore its state: the branches opening at a depth with a few per thread each start
+// from the state at their bracket, found by one thread reading only what lies outside
+// them, and are read in parallel into their own ranges of the instances, placed by a
+// prefix sum over their drawn segments. The result is the same for any thread count.
+class LSystemGenerator {
+public:
+    // Longest generation Generate writes
+    static const size_t MAX_SYMBOLS = size_t(1) << 28;
+
+private:
+    std::vector<char> buffers[2];   // The last generation is in current
+    size_t current;
+    size_t length;
+    std::vector<size_t> chunkOffsets;
+    LSystemStats stats;
+
+public:
+    LSystemGenerator();
+
+    // Rewrite and interpret; false, with the instances empty, if a generation would pass
+    // MAX_SYMBOLS. With a job system the chunks and branches are its jobs.
+    bool Generate(const LSystemSettings& settings, LSystemInstances& instances, JobSystem* jobs = nullptr);
+
+    // Only rewrite, for the symbols alone
+    bool Rewrite(const LSystemSettings& settings, JobSystem* jobs = nullptr);
+
+    // The last generation rewritten
+    const char* GetSymbols() const { return buffers[current].data(); }
+    size_t GetSymbolCount() const { return length; }
+
+    const LSystemStats& GetStats() const { return stats; }
+
+    // Interpret one symbol at a time on one thread, for checking the parallel result
+    static void InterpretSerial(const LSystemSettings& settings, const char* symbols, size_t count,
+        LSystemInstances& instances);
+
+    // Settings for this frame from the base ones and the band levels
+    static LSystemSettings Modulate(const LSystemSettings& base, const BandEnergies& bands,
+        const LSystemModulation& modulation = LSystemModulation());
+};
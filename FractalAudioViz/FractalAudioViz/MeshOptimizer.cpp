@@ -0,0 +1,403 @@
+#include "MeshOptimizer.h"
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+    const uint32_t NO_VERTEX = ~0u;
+
+    // FIFO post-transform cache: each miss stamps the vertex with the running miss count,
+    // and a vertex is still cached while fewer than size misses came after it
+    class FifoCache {
+    private:
+        std::vector<uint32_t> stamps;
+        uint32_t time;
+        uint32_t size;
+
+    public:
+        FifoCache(size_t vertexCount, size_t cacheSize) :
+            stamps(vertexCount, 0),
+            time(static_cast<uint32_t>(cacheSize) + 1),
+            size(static_cast<uint32_t>(cacheSize))
+        {}
+
+        // True on a miss
+        bool Touch(uint32_t vertex) {
+            if (time - stamps[vertex] <= size) {
+                return false;
+            }
+            stamps[vertex] = time++;
+            return true;
+        }
+
+        // Misses for one triangle
+        unsigned Touch(const uint32_t* triangle) {
+            return Touch(triangle[0]) + Touch(triangle[1]) + Touch(triangle[2]);
+        }
+
+        void Flush() {
+            time += size + 1;
+        }
+    };
+
+    uint32_t HashVertex(const unsigned char* bytes, size_t stride) {
+        // FNV-1a over 32-bit words, then the tail bytes, then a final mix
+        uint32_t hash = 2166136261u;
+        size_t i = 0;
+        for (; i + 4 <= stride; i += 4) {
+            uint32_t word;
+            std::memcpy(&word, bytes + i, 4);
+            hash = (hash ^ word) * 16777619u;
+        }
+        for (; i < stride; ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        hash ^= hash >> 15;
+        hash *= 0x2C1B3C6Du;
+        hash ^= hash >> 12;
+        return hash;
+    }
+
+    struct Cluster {
+        size_t first;   // Triangle range in the cache-ordered buffer
+        size_t end;
+        float sortKey;
+    };
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    size_t cacheSize) {
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<uint8_t> seen(vertexCount, 0);
+    for (size_t i = 0; i < stats.triangles * 3; ++i) {
+        stats.transformed += cache.Touch(indices[i]);
+        if (!seen[indices[i]]) {
+            seen[indices[i]] = 1;
+            ++stats.vertices;
+        }
+    }
+    return stats;
+}
+
+size_t MeshOptimizer::GenerateWeldRemap(const void* vertices, size_t vertexCount, size_t stride, uint32_t* remap) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+
+    // Open addressing on the vertex bytes, at most half full
+    size_t tableSize = 16;
+    while (tableSize < vertexCount * 2) tableSize *= 2;
+    std::vector<uint32_t> table(tableSize, NO_VERTEX);
+
+    size_t unique = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const unsigned char* vertex = bytes + v * stride;
+        size_t slot = HashVertex(vertex, stride) & (tableSize - 1);
+        for (;;) {
+            uint32_t existing = table[slot];
+            if (existing == NO_VERTEX) {
+                table[slot] = static_cast<uint32_t>(v);
+                remap[v] = static_cast<uint32_t>(unique++);
+                break;
+            }
+            if (std::memcmp(bytes + existing * stride, vertex, stride) == 0) {
+                remap[v] = remap[existing];
+                break;
+            }
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+    return unique;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    size_t vertexCount, size_t cacheSize) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles around each vertex, and how many of them are still to be emitted
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        ++live[indices[i]];
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // Cache times as Tipsify keeps them: a vertex is cached while time - stamp <= cacheSize
+    const uint32_t size = static_cast<uint32_t>(cacheSize);
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    uint32_t time = size + 1;
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    size_t scan = 0;
+    size_t written = 0;
+
+    uint32_t fan = indices[0];
+    while (fan != NO_VERTEX) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) continue;
+            emitted[triangle] = 1;
+
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = indices[triangle * 3 + k];
+                destination[written++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - stamps[v] > size) {
+                    stamps[v] = time++;
+                }
+            }
+        }
+
+        // Next fan: the candidate that will still be cached after its own triangles, and
+        // has been in the cache longest
+        uint32_t next = NO_VERTEX;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int64_t priority = 0;
+            if (time - stamps[v] + 2 * live[v] <= size) {
+                priority = time - stamps[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        // Dead end: back up through recently used vertices, then scan for any left
+        if (next == NO_VERTEX) {
+            while (!deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) {
+                    next = v;
+                    break;
+                }
+            }
+        }
+        if (next == NO_VERTEX) {
+            while (scan < vertexCount && live[scan] == 0) ++scan;
+            if (scan < vertexCount) next = static_cast<uint32_t>(scan);
+        }
+        fan = next;
+    }
+}
+
+size_t MeshOptimizer::OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const float* positions, size_t positionStride, size_t vertexCount, size_t cacheSize, float threshold) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return 0;
+    }
+    const unsigned char* positionBytes = reinterpret_cast<const unsigned char*>(positions);
+
+    // Hard boundaries: where the cache order starts over anyway (all three vertices miss)
+    std::vector<size_t> hard;
+    {
+        FifoCache cache(vertexCount, cacheSize);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (cache.Touch(indices + t * 3) == 3) hard.push_back(t);
+        }
+        hard.push_back(triangleCount);
+    }
+
+    // Soft boundaries: split each hard run wherever the part so far misses no more than
+    // threshold times the whole run does, so reordering the pieces costs little cache
+    std::vector<Cluster> clusters;
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        size_t runStart = hard[h], runEnd = hard[h + 1];
+
+        cache.Flush();
+        size_t runMisses = 0;
+        for (size_t t = runStart; t < runEnd; ++t) runMisses += cache.Touch(indices + t * 3);
+        double limit = threshold * static_cast<double>(runMisses) / (runEnd - runStart);
+
+        cache.Flush();
+        size_t clusterStart = runStart;
+        size_t misses = 0;
+        for (size_t t = runStart; t < runEnd; ++t) {
+            misses += cache.Touch(indices + t * 3);
+            if (t + 1 < runEnd && misses <= limit * (t - clusterStart + 1)) {
+                Cluster cluster = { clusterStart, t + 1, 0.0f };
+                clusters.push_back(cluster);
+                cache.Flush();
+                clusterStart = t + 1;
+                misses = 0;
+            }
+        }
+        Cluster cluster = { clusterStart, runEnd, 0.0f };
+        clusters.push_back(cluster);
+    }
+
+    // Area-weighted centroid and normal of each cluster and of the mesh. Clusters facing
+    // away from the mesh's center are on its outside and occlude the rest; they go first.
+    std::vector<float> centroids(clusters.size() * 3);
+    std::vector<float> normals(clusters.size() * 3);
+    double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        double centroid[3] = { 0.0, 0.0, 0.0 };
+        double normal[3] = { 0.0, 0.0, 0.0 };
+        double area = 0.0;
+        for (size_t t = clusters[c].first; t < clusters[c].end; ++t) {
+            const float* p0 = reinterpret_cast<const float*>(positionBytes + indices[t * 3] * positionStride);
+            const float* p1 = reinterpret_cast<const float*>(positionBytes + indices[t * 3 + 1] * positionStride);
+            const float* p2 = reinterpret_cast<const float*>(positionBytes + indices[t * 3 + 2] * positionStride);
+            double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            double triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int axis = 0; axis < 3; ++axis) {
+                centroid[axis] += triangleArea * (p0[axis] + p1[axis] + p2[axis]) / 3.0;
+                normal[axis] += n[axis];
+            }
+            area += triangleArea;
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            meshCentroid[axis] += centroid[axis];
+            centroids[c * 3 + axis] = static_cast<float>(area > 0.0 ? centroid[axis] / area : 0.0);
+        }
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int axis = 0; axis < 3; ++axis) {
+            normals[c * 3 + axis] = static_cast<float>(length > 0.0 ? normal[axis] / length : 0.0);
+        }
+        meshArea += area;
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        meshCentroid[axis] = meshArea > 0.0 ? meshCentroid[axis] / meshArea : 0.0;
+    }
+
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        float key = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            key += (centroids[c * 3 + axis] - static_cast<float>(meshCentroid[axis])) * normals[c * 3 + axis];
+        }
+        clusters[c].sortKey = key;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    size_t written = 0;
+    for (const Cluster& cluster : clusters) {
+        size_t count = (cluster.end - cluster.first) * 3;
+        std::memcpy(destination + written, indices + cluster.first * 3, count * sizeof(uint32_t));
+        written += count;
+    }
+    return clusters.size();
+}
+
+size_t MeshOptimizer::GenerateFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* remap) {
+    std::fill(remap, remap + vertexCount, NO_VERTEX);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (remap[indices[i]] == NO_VERTEX) {
+            remap[indices[i]] = next++;
+        }
+    }
+    return next;
+}
+
+void MeshOptimizer::RemapIndices(uint32_t* indices, size_t indexCount, const uint32_t* remap) {
+    for (size_t i = 0; i < indexCount; ++i) {
+        indices[i] = remap[indices[i]];
+    }
+}
+
+void MeshOptimizer::RemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t stride,
+    const uint32_t* remap) {
+    unsigned char* out = static_cast<unsigned char*>(destination);
+    const unsigned char* in = static_cast<const unsigned char*>(vertices);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] != NO_VERTEX) {
+            std::memcpy(out + remap[v] * stride, in + v * stride, stride);
+        }
+    }
+}
+
+void MeshOptimizer::Optimize(FractalMesh& mesh, const MeshOptimizerSettings& settings, MeshOptimizerStats* stats) {
+    MeshOptimizerStats result;
+    result.verticesBefore = mesh.vertices.size();
+    const bool hasNormals = mesh.normals.size() == mesh.vertices.size() * 3 && !mesh.normals.empty();
+    std::vector<uint32_t> remap(mesh.vertices.size());
+
+    // Apply a remap to the vertices and their normals, keeping count of them
+    auto remapVertices = [&](size_t count) {
+        const size_t before = mesh.vertices.size();
+        std::vector<MeshVertex> vertices(count);
+        RemapVertices(vertices.data(), mesh.vertices.data(), before, sizeof(MeshVertex), remap.data());
+        mesh.vertices.swap(vertices);
+        if (hasNormals) {
+            std::vector<float> normals(count * 3);
+            RemapVertices(normals.data(), mesh.normals.data(), before, 3 * sizeof(float), remap.data());
+            mesh.normals.swap(normals);
+        }
+        RemapIndices(mesh.indices.data(), mesh.indices.size(), remap.data());
+        remap.resize(count);
+    };
+
+    double start = FrameStats::NowSeconds();
+    if (settings.weld && !mesh.vertices.empty()) {
+        // Welded vertices must agree on their normals as well
+        size_t unique;
+        if (hasNormals) {
+            const size_t stride = sizeof(MeshVertex) + 3 * sizeof(float);
+            std::vector<unsigned char> keys(mesh.vertices.size() * stride);
+            for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+                std::memcpy(&keys[v * stride], &mesh.vertices[v], sizeof(MeshVertex));
+                std::memcpy(&keys[v * stride + sizeof(MeshVertex)], &mesh.normals[v * 3], 3 * sizeof(float));
+            }
+            unique = GenerateWeldRemap(keys.data(), mesh.vertices.size(), stride, remap.data());
+        }
+        else {
+            unique = GenerateWeldRemap(mesh.vertices.data(), mesh.vertices.size(), sizeof(MeshVertex), remap.data());
+        }
+        remapVertices(unique);
+    }
+    double welded = FrameStats::NowSeconds();
+
+    std::vector<uint32_t> ordered(mesh.indices.size());
+    OptimizeVertexCache(ordered.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), settings.cacheSize);
+    double cached = FrameStats::NowSeconds();
+
+    if (!mesh.vertices.empty()) {
+        result.clusters = OptimizeOverdraw(mesh.indices.data(), ordered.data(), ordered.size(), &mesh.vertices[0].x,
+            sizeof(MeshVertex), mesh.vertices.size(), settings.cacheSize, settings.overdrawThreshold);
+    }
+    double sorted = FrameStats::NowSeconds();
+
+    remap.resize(mesh.vertices.size());
+    size_t used = GenerateFetchRemap(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), remap.data());
+    remapVertices(used);
+    double fetched = FrameStats::NowSeconds();
+
+    if (stats) {
+        result.verticesAfter = mesh.vertices.size();
+        result.weldSeconds = welded - start;
+        result.cacheSeconds = cached - welded;
+        result.overdrawSeconds = sorted - cached;
+        result.fetchSeconds = fetched - sorted;
+        *stats = result;
+    }
+}
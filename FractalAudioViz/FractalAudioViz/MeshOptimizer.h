@@ -0,0 +1,84 @@
+#pragma once
+
+#include "FractalMesh.h"
+#include <cstddef>
+#include <cstdint>
+
+struct MeshOptimizerSettings {
+    bool weld;               // Share byte-identical vertices first, so there is reuse to exploit
+    size_t cacheSize;        // Post-transform cache entries the order is tuned for
+    float overdrawThreshold; // Clusters may cost this much more in cache misses than the cache order
+
+    MeshOptimizerSettings() :
+        weld(true),
+        cacheSize(16),
+        overdrawThreshold(1.05f)
+    {}
+};
+
+// Post-transform cache behaviour of an index buffer under a FIFO cache
+struct VertexCacheStats {
+    size_t triangles;
+    size_t vertices;     // Distinct vertices referenced
+    size_t transformed;  // Cache misses
+
+    VertexCacheStats() : triangles(0), vertices(0), transformed(0) {}
+
+    // Average cache miss ratio: vertex shader runs per triangle (0.5 at best, 3 at worst)
+    double GetACMR() const { return triangles ? static_cast<double>(transformed) / triangles : 0.0; }
+
+    // Average transform to vertex ratio: runs per distinct vertex (1 at best)
+    double GetATVR() const { return vertices ? static_cast<double>(transformed) / vertices : 0.0; }
+};
+
+struct MeshOptimizerStats {
+    size_t verticesBefore;
+    size_t verticesAfter;
+    size_t clusters;          // Overdraw ordering units
+    double weldSeconds;
+    double cacheSeconds;
+    double overdrawSeconds;
+    double fetchSeconds;
+
+    MeshOptimizerStats() : verticesBefore(0), verticesAfter(0), clusters(0), weldSeconds(0.0), cacheSeconds(0.0),
+        overdrawSeconds(0.0), fetchSeconds(0.0) {}
+};
+
+// Reorders generated meshes for the GPU before upload, in three passes:
+//  - triangles for the post-transform cache (Tipsify: fan around a vertex, then move to
+//    the best candidate still in the cache, linear time),
+//  - clusters of that order front to back on the mesh's outside, so early-Z rejects
+//    more of what's behind, splitting clusters only where it costs little cache,
+//  - vertices by first use, so fetches walk the vertex buffer forward.
+// Index arrays are 32-bit; destination and source must not overlap.
+class MeshOptimizer {
+public:
+    static VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+        size_t cacheSize);
+
+    // remap[v] is the new index of vertex v, shared by byte-identical vertices and numbered
+    // by first occurrence; returns the number of distinct vertices
+    static size_t GenerateWeldRemap(const void* vertices, size_t vertexCount, size_t stride, uint32_t* remap);
+
+    static void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+        size_t vertexCount, size_t cacheSize);
+
+    // positions: x, y, z floats at the start of each positionStride-byte vertex. Returns the
+    // number of clusters.
+    static size_t OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+        const float* positions, size_t positionStride, size_t vertexCount, size_t cacheSize, float threshold);
+
+    // remap[v] is v's position in first-use order, or ~0u if no triangle uses it; returns the
+    // number of vertices used
+    static size_t GenerateFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* remap);
+
+    // Apply a remap to indices in place, or to vertices (vertices mapped to ~0u are dropped;
+    // several mapped to one index must be identical)
+    static void RemapIndices(uint32_t* indices, size_t indexCount, const uint32_t* remap);
+    static void RemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t stride,
+        const uint32_t* remap);
+
+    // All passes on a fractal mesh, normals included
+    static void Optimize(FractalMesh& mesh, const MeshOptimizerSettings& settings = MeshOptimizerSettings(),
+        MeshOptimizerStats* stats = nullptr);
+};
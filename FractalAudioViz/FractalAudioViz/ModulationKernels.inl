@@ -0,0 +1,49 @@
+// Modulation matrix kernels, written once over the lanes of SimdLanes.h that the including
+// namespace uses. ModulationMatrix.cpp includes this once per instruction set, inside that
+// set's target region. Nothing here may include headers or call library math.
+
+// Maps, shapes, scales and smooths count routes, a whole number of registers of them
+inline void EvaluateRoutes(const RouteTables& routes, size_t count) {
+    const Vec zero = Set(0.0f);
+    const Vec one = Set(1.0f);
+    for (size_t i = 0; i < count; i += LANES) {
+        Vec x = Mul(Add(Load(routes.inputs + i), Load(routes.offsets + i)), Load(routes.scales + i));
+        x = Min(Max(x, zero), one);
+        Vec y = MulAdd(Load(routes.curve[3] + i), x, Load(routes.curve[2] + i));
+        y = MulAdd(y, x, Load(routes.curve[1] + i));
+        y = MulAdd(y, x, Load(routes.curve[0] + i));
+        y = Mul(y, Load(routes.vias + i));
+
+        // Toward the new value at the attack rate while rising, the release rate while falling
+        Vec previous = Load(routes.values + i);
+        Vec rate = Select(Less(previous, y), Load(routes.attackRates + i), Load(routes.releaseRates + i));
+        Store(routes.values + i, MulAdd(Sub(y, previous), rate, previous));
+    }
+}
+
+// Sweeps the segments in order, carrying the summed intercept and slope of the lines
+// marked at each and clearing the marks, and writes base plus the line, clamped, into each
+// segment's targets. Whole registers are stored, so up to LANES - 1 past a segment's end:
+// the next segment overwrites them, and the tables are padded past the last.
+inline void SweepTargets(const TargetTables& targets, size_t segmentCount) {
+    const Vec ramp = Ramp();
+    double intercept = 0.0, slope = 0.0;
+    for (size_t k = 0; k < segmentCount; ++k) {
+        intercept += targets.lineDeltas[2 * k];
+        slope += targets.lineDeltas[2 * k + 1];
+        targets.lineDeltas[2 * k] = 0.0;
+        targets.lineDeltas[2 * k + 1] = 0.0;
+
+        const size_t first = targets.segmentStarts[k];
+        const size_t count = targets.segmentStarts[k + 1] - first;
+        const Vec a = Set(static_cast<float>(intercept + slope * static_cast<double>(first)));
+        const Vec b = Set(static_cast<float>(slope));
+        for (size_t i = 0; i < count; i += LANES) {
+            const size_t t = first + i;
+            Vec value = Add(Load(targets.bases + t), MulAdd(b, Add(ramp, Set(static_cast<float>(i))), a));
+            Store(targets.values + t, Min(Max(value, Load(targets.minimums + t)), Load(targets.maximums + t)));
+        }
+    }
+    targets.lineDeltas[2 * segmentCount] = 0.0;
+    targets.lineDeltas[2 * segmentCount + 1] = 0.0;
+}
@@ -0,0 +1,322 @@
+#include "ModulationMatrix.h"
+#include "SimdLanes.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Route and target tables are padded to a whole number of the widest registers
+    const size_t PAD_LANES = 16;
+
+    // Sources after the bands, in ModulationSource order from Level
+    const size_t EXTRA_SOURCES = 5;
+
+    size_t PadCount(size_t count) {
+        return (count + PAD_LANES - 1) / PAD_LANES * PAD_LANES;
+    }
+
+    // The route tables as the kernels read them
+    struct RouteTables {
+        const float* inputs;
+        const float* vias;
+        const float* offsets;
+        const float* scales;
+        const float* curve[4];
+        const float* attackRates;
+        const float* releaseRates;
+        float* values;
+    };
+
+    // The target tables as the kernels read them
+    struct TargetTables {
+        const uint32_t* segmentStarts;
+        double* lineDeltas;
+        const float* bases;
+        const float* minimums;
+        const float* maximums;
+        float* values;
+    };
+
+    namespace ScalarKernels {
+        using namespace SimdLanes::Scalar;
+#include "ModulationKernels.inl"
+    }
+
+#if FAV_X86
+    namespace SseKernels {
+        using namespace SimdLanes::Sse;
+#include "ModulationKernels.inl"
+    }
+
+FAV_BEGIN_TARGET_AVX2
+    namespace Avx2Kernels {
+        using namespace SimdLanes::Avx2;
+#include "ModulationKernels.inl"
+    }
+FAV_END_TARGET
+
+// GCC reports the self-initialized _mm512_undefined_ps inside the unmasked intrinsics as
+// uninitialized once they are inlined into these kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+FAV_BEGIN_TARGET_AVX512
+    namespace Avx512Kernels {
+        using namespace SimdLanes::Avx512;
+#include "ModulationKernels.inl"
+    }
+FAV_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+    struct Kernels {
+        void (*evaluateRoutes)(const RouteTables&, size_t);
+        void (*sweepTargets)(const TargetTables&, size_t);
+    };
+
+    // AVX without AVX2 runs the SSE2 kernels, as the other kernel sets do
+    Kernels SelectKernels(SimdLevel level) {
+        Kernels kernels = { ScalarKernels::EvaluateRoutes, ScalarKernels::SweepTargets };
+#if FAV_X86
+        if (level >= SimdLevel::AVX512) {
+            kernels = { Avx512Kernels::EvaluateRoutes, Avx512Kernels::SweepTargets };
+        }
+        else if (level >= SimdLevel::AVX2) {
+            kernels = { Avx2Kernels::EvaluateRoutes, Avx2Kernels::SweepTargets };
+        }
+        else if (level >= SimdLevel::SSE2) {
+            kernels = { SseKernels::EvaluateRoutes, SseKernels::SweepTargets };
+        }
+#endif
+        (void)level;
+        return kernels;
+    }
+
+    // Each curve as c0 + c1 x + c2 x^2 + c3 x^3, so every route runs the same operations
+    void GetCurveCoefficients(ModulationCurve curve, float coefficients[4]) {
+        static const float TABLE[][4] = {
+            { 0.0f, 1.0f, 0.0f, 0.0f },     // Linear
+            { 1.0f, -1.0f, 0.0f, 0.0f },    // Invert
+            { 0.0f, 0.0f, 1.0f, 0.0f },     // Square
+            { 0.0f, 0.0f, 0.0f, 1.0f },     // Cube
+            { 0.0f, 0.0f, 3.0f, -2.0f },    // SmoothStep
+            { 1.0f, -3.0f, 3.0f, -1.0f },   // Decay
+        };
+        size_t index = static_cast<size_t>(curve);
+        if (index >= sizeof(TABLE) / sizeof(TABLE[0])) index = 0;
+        std::copy(TABLE[index], TABLE[index] + 4, coefficients);
+    }
+
+    // Share of the gap to the target a smoother closes in one update
+    float GetSmoothingRate(float seconds, float deltaTime) {
+        return seconds > 0.0f ? 1.0f - std::exp(-deltaTime / seconds) : 1.0f;
+    }
+}
+
+uint32_t ModulationPatch::AddTargets(const ModulationTarget& target, uint32_t count) {
+    uint32_t first = static_cast<uint32_t>(targets.size());
+    targets.insert(targets.end(), count, target);
+    return first;
+}
+
+ModulationMatrix::ModulationMatrix() :
+    routeCount(0),
+    segmentStarts(1, 0),
+    lineDeltas(2, 0.0),
+    targetCount(0),
+    bandCount(0),
+    smoothingDelta(-1.0f),
+    simdLevel(SimdLevel::Scalar)
+{}
+
+uint32_t ModulationMatrix::GetSourceSlot(ModulationSource source, uint32_t index) const {
+    if (source == ModulationSource::Band) {
+        return index;
+    }
+    return static_cast<uint32_t>(bandCount + static_cast<size_t>(source) - static_cast<size_t>(ModulationSource::Level));
+}
+
+bool ModulationMatrix::Compile(const ModulationPatch& patch, size_t bands, SimdLevel maxSimdLevel) {
+    for (const ModulationRoute& route : patch.routes) {
+        if ((route.source == ModulationSource::Band && route.sourceIndex >= bands) ||
+            (route.via == ModulationSource::Band && route.viaIndex >= bands) ||
+            static_cast<uint64_t>(route.target) + route.targetCount > patch.targets.size()) {
+            return false;
+        }
+    }
+
+    bandCount = bands;
+    simdLevel = ResolveSimdLevel(maxSimdLevel);
+    sources.assign(bandCount + EXTRA_SOURCES, 0.0f);
+    sources[GetSourceSlot(ModulationSource::Constant, 0)] = 1.0f;
+    smoothingDelta = -1.0f;
+
+    // Routes in target order, so their marks walk the targets front to back; padding
+    // routes read the constant through a zero scale and curve and add nowhere
+    std::vector<size_t> order(patch.routes.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&patch](size_t a, size_t b) {
+        return patch.routes[a].target < patch.routes[b].target;
+    });
+
+    routeCount = patch.routes.size();
+    const size_t paddedRoutes = PadCount(routeCount);
+    const uint32_t constant = GetSourceSlot(ModulationSource::Constant, 0);
+    sourceSlots.assign(paddedRoutes, constant);
+    viaSlots.assign(paddedRoutes, constant);
+    inputOffsets.assign(paddedRoutes, 0.0f);
+    inputScales.assign(paddedRoutes, 0.0f);
+    for (int c = 0; c < 4; ++c) curveCoefficients[c].assign(paddedRoutes, 0.0f);
+    attackTimes.assign(paddedRoutes, 0.0f);
+    releaseTimes.assign(paddedRoutes, 0.0f);
+    attackRates.assign(paddedRoutes, 1.0f);
+    releaseRates.assign(paddedRoutes, 1.0f);
+    routeInputs.assign(paddedRoutes, 0.0f);
+    routeVias.assign(paddedRoutes, 0.0f);
+    routeValues.assign(paddedRoutes, 0.0f);
+    spanFirst.resize(routeCount);
+    spanEnd.resize(routeCount);
+
+    // Where any route's run starts or stops cuts the targets into segments, each with one
+    // line summed from every route across it
+    targetCount = patch.targets.size();
+    segmentStarts.assign(1, 0);
+    segmentStarts.push_back(static_cast<uint32_t>(targetCount));
+    for (const ModulationRoute& route : patch.routes) {
+        segmentStarts.push_back(route.target);
+        segmentStarts.push_back(route.target + route.targetCount);
+    }
+    std::sort(segmentStarts.begin(), segmentStarts.end());
+    segmentStarts.erase(std::unique(segmentStarts.begin(), segmentStarts.end()), segmentStarts.end());
+    auto segment = [this](uint32_t target) {
+        return static_cast<uint32_t>(std::lower_bound(segmentStarts.begin(), segmentStarts.end(), target) - segmentStarts.begin());
+    };
+    spanIntercept.resize(routeCount);
+    spanSlope.resize(routeCount);
+
+    for (size_t i = 0; i < routeCount; ++i) {
+        const ModulationRoute& route = patch.routes[order[i]];
+        sourceSlots[i] = GetSourceSlot(route.source, route.sourceIndex);
+        viaSlots[i] = GetSourceSlot(route.via, route.viaIndex);
+        float range = route.inputMax - route.inputMin;
+        inputOffsets[i] = -route.inputMin;
+        inputScales[i] = range != 0.0f ? 1.0f / range : 0.0f;
+        float coefficients[4];
+        GetCurveCoefficients(route.curve, coefficients);
+        for (int c = 0; c < 4; ++c) curveCoefficients[c][i] = coefficients[c];
+        attackTimes[i] = std::max(route.attackSeconds, 0.0f);
+        releaseTimes[i] = std::max(route.releaseSeconds, 0.0f);
+        spanFirst[i] = segment(route.target);
+        spanEnd[i] = segment(route.target + route.targetCount);
+        spanIntercept[i] = static_cast<double>(route.depth) - static_cast<double>(route.depthStep) * route.target;
+        spanSlope[i] = route.depthStep;
+    }
+
+    // Targets, padded with a register's worth no route reaches for the last segment's stores
+    const size_t paddedTargets = PadCount(targetCount) + PAD_LANES;
+    bases.assign(paddedTargets, 0.0f);
+    minimums.assign(paddedTargets, -1e30f);
+    maximums.assign(paddedTargets, 1e30f);
+    values.assign(paddedTargets, 0.0f);
+    lineDeltas.assign(2 * segmentStarts.size(), 0.0);
+    integrated.clear();
+    integratedWrap.clear();
+    for (size_t t = 0; t < targetCount; ++t) {
+        const ModulationTarget& target = patch.targets[t];
+        bases[t] = target.base;
+        minimums[t] = target.minimum;
+        maximums[t] = target.maximum;
+        values[t] = target.base;
+        if (target.integrate) {
+            integrated.push_back(static_cast<uint32_t>(t));
+            integratedWrap.push_back(target.wrap);
+        }
+    }
+    integratedValues.assign(integrated.size(), 0.0);
+    for (uint32_t t : integrated) values[t] = 0.0f;
+    return true;
+}
+
+void ModulationMatrix::Reset() {
+    std::fill(routeValues.begin(), routeValues.end(), 0.0f);
+    std::fill(integratedValues.begin(), integratedValues.end(), 0.0);
+    std::copy(bases.begin(), bases.end(), values.begin());
+    for (uint32_t t : integrated) values[t] = 0.0f;
+}
+
+void ModulationMatrix::Evaluate(const ModulationInputs& inputs, float deltaTime) {
+    const Kernels kernels = SelectKernels(simdLevel);
+
+    // This update's sources, bands the analysis doesn't have reading as silent
+    size_t available = inputs.bands ? std::min(bandCount, inputs.bands->GetBandCount()) : 0;
+    for (size_t band = 0; band < available; ++band) {
+        sources[band] = inputs.bands->GetLevel(band);
+    }
+    std::fill(sources.begin() + available, sources.begin() + bandCount, 0.0f);
+    sources[GetSourceSlot(ModulationSource::Level, 0)] = inputs.level;
+    sources[GetSourceSlot(ModulationSource::Onset, 0)] = inputs.onset;
+    sources[GetSourceSlot(ModulationSource::BeatPhase, 0)] = inputs.beat ? inputs.beat->beatPhase : 0.0f;
+    sources[GetSourceSlot(ModulationSource::BeatConfidence, 0)] = inputs.beat ? inputs.beat->confidence : 0.0f;
+
+    // Smoothing rates only change with the timestep, which is normally fixed
+    const size_t paddedRoutes = routeValues.size();
+    if (deltaTime != smoothingDelta) {
+        smoothingDelta = deltaTime;
+        for (size_t i = 0; i < routeCount; ++i) {
+            attackRates[i] = GetSmoothingRate(attackTimes[i], deltaTime);
+            releaseRates[i] = GetSmoothingRate(releaseTimes[i], deltaTime);
+        }
+    }
+
+    // Gather, then every route in lanes
+    for (size_t i = 0; i < paddedRoutes; ++i) {
+        routeInputs[i] = sources[sourceSlots[i]];
+        routeVias[i] = sources[viaSlots[i]];
+    }
+    RouteTables tables;
+    tables.inputs = routeInputs.data();
+    tables.vias = routeVias.data();
+    tables.offsets = inputOffsets.data();
+    tables.scales = inputScales.data();
+    for (int c = 0; c < 4; ++c) tables.curve[c] = curveCoefficients[c].data();
+    tables.attackRates = attackRates.data();
+    tables.releaseRates = releaseRates.data();
+    tables.values = routeValues.data();
+    kernels.evaluateRoutes(tables, paddedRoutes);
+
+    // Each route's line marked at the segments it starts and stops, then swept segment by
+    // segment into the bases and clamped; the sweep clears the marks behind it for the
+    // next update
+    for (size_t i = 0; i < routeCount; ++i) {
+        double value = routeValues[i];
+        double intercept = value * spanIntercept[i];
+        double slope = value * spanSlope[i];
+        lineDeltas[2 * spanFirst[i]] += intercept;
+        lineDeltas[2 * spanFirst[i] + 1] += slope;
+        lineDeltas[2 * spanEnd[i]] -= intercept;
+        lineDeltas[2 * spanEnd[i] + 1] -= slope;
+    }
+    TargetTables targets;
+    targets.segmentStarts = segmentStarts.data();
+    targets.lineDeltas = lineDeltas.data();
+    targets.bases = bases.data();
+    targets.minimums = minimums.data();
+    targets.maximums = maximums.data();
+    targets.values = values.data();
+    kernels.sweepTargets(targets, segmentStarts.size() - 1);
+
+    // Rates into the integrated targets, kept in doubles so hours of rotation don't
+    // lose the fraction of a degree each update adds
+    for (size_t j = 0; j < integrated.size(); ++j) {
+        double value = integratedValues[j] + static_cast<double>(values[integrated[j]]) * deltaTime;
+        double wrap = integratedWrap[j];
+        if (wrap > 0.0 && (value < 0.0 || value >= wrap)) {
+            value -= wrap * std::floor(value / wrap);
+        }
+        integratedValues[j] = value;
+        values[integrated[j]] = static_cast<float>(value);
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "BeatTracker.h"
+#include "Filterbank.h"
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Audio features a route can read, each 0..1
+enum class ModulationSource : uint8_t {
+    Band,           // One band's level; the route's sourceIndex picks the band
+    Level,          // Overall level of the update's audio
+    Onset,          // Strongest onset across the update's hops, 0 if none
+    BeatPhase,      // 0 at a beat, rising to 1 at the next one
+    BeatConfidence,
+    Constant        // Always 1, for a fixed rate or offset
+};
+
+// Shape a route's input takes on its way to the target, once mapped to 0..1
+enum class ModulationCurve : uint8_t {
+    Linear,
+    Invert,         // 1 - x
+    Square,         // Soft at low levels
+    Cube,
+    SmoothStep,     // Eased at both ends
+    Decay           // (1 - x)^3: a kick that dies away as x rises, as over a beat's phase
+};
+
+// A parameter the matrix drives: base plus every route into it, clamped. An integrated
+// target treats that sum as a rate per second and accumulates it instead, wrapping at
+// wrap if that is above 0, as a rotation in degrees wraps at 360.
+struct ModulationTarget {
+    float base;
+    float minimum;
+    float maximum;
+    bool integrate;
+    float wrap;
+
+    ModulationTarget() : base(0.0f), minimum(-1e30f), maximum(1e30f), integrate(false), wrap(0.0f) {}
+};
+
+// One source to a run of targets. The source is mapped from inputMin..inputMax to 0..1,
+// shaped by the curve, scaled by the via source (Constant for none) and smoothed toward
+// with separate attack and release times; target first + i then gets depth + depthStep * i
+// times that, so one route can spread across per-instance targets.
+struct ModulationRoute {
+    ModulationSource source;
+    uint32_t sourceIndex;       // Band, for Band sources
+    float inputMin;
+    float inputMax;
+    ModulationCurve curve;
+    ModulationSource via;
+    uint32_t viaIndex;
+    float attackSeconds;        // 0 follows rises at once
+    float releaseSeconds;       // And falls
+    uint32_t target;
+    uint32_t targetCount;
+    float depth;
+    float depthStep;
+
+    ModulationRoute() :
+        source(ModulationSource::Constant),
+        sourceIndex(0),
+        inputMin(0.0f),
+        inputMax(1.0f),
+        curve(ModulationCurve::Linear),
+        via(ModulationSource::Constant),
+        viaIndex(0),
+        attackSeconds(0.0f),
+        releaseSeconds(0.0f),
+        target(0),
+        targetCount(1),
+        depth(1.0f),
+        depthStep(0.0f)
+    {}
+};
+
+// A routing, as declared: targets by index in the order added, and routes into them
+struct ModulationPatch {
+    std::vector<ModulationTarget> targets;
+    std::vector<ModulationRoute> routes;
+
+    // Appends count copies of target and returns the index of the first
+    uint32_t AddTargets(const ModulationTarget& target, uint32_t count = 1);
+};
+
+// What the audio analysis hands the matrix each update
+struct ModulationInputs {
+    const BandEnergies* bands;
+    const BeatState* beat;
+    float level;
+    float onset;    // Strongest onset across the update's hops, 0 if none
+
+    ModulationInputs() : bands(nullptr), beat(nullptr), level(0.0f), onset(0.0f) {}
+};
+
+// Audio-to-parameter modulation. Compile flattens a patch into a program of structure-of-
+// arrays route and target tables, padded to whole SIMD registers, so Evaluate is a few
+// straight loops: gather each route's inputs from one flat array of sources, then shape,
+// scale and smooth them in lanes. Each route adds a line in the target index across its
+// run of targets, and where runs start and stop cuts the targets into segments that each
+// get one summed line, so a route only marks its first and end segments and one sweep
+// carries the summed intercept and slope along, filling each segment's targets with base
+// plus line, clamped, in lanes: the cost is routes plus targets however long the runs are.
+// Then the rates are integrated. Nothing allocates after Compile.
+class ModulationMatrix {
+private:
+    // Routes, one element each
+    std::vector<uint32_t> sourceSlots;
+    std::vector<uint32_t> viaSlots;
+    std::vector<float> inputOffsets;    // -inputMin
+    std::vector<float> inputScales;     // 1 / (inputMax - inputMin)
+    std::vector<float> curveCoefficients[4];    // Each curve as a cubic in the mapped input
+    std::vector<float> attackTimes;
+    std::vector<float> releaseTimes;
+    std::vector<float> attackRates;     // Per update, for smoothingDelta
+    std::vector<float> releaseRates;
+    std::vector<float> routeInputs;     // Gathered each update
+    std::vector<float> routeVias;
+    std::vector<float> routeValues;     // Smoothed, carried between updates
+    std::vector<uint32_t> spanFirst;    // Segments a route adds to, first and one past the last
+    std::vector<uint32_t> spanEnd;
+    std::vector<double> spanIntercept;  // Its depth as a line in the target index:
+    std::vector<double> spanSlope;      // depth - depthStep * first, and depthStep
+    size_t routeCount;
+
+    // Targets
+    std::vector<float> bases;
+    std::vector<float> minimums;
+    std::vector<float> maximums;
+    std::vector<float> values;
+    std::vector<uint32_t> segmentStarts;    // First target of each segment, then targetCount
+    std::vector<double> lineDeltas;     // Intercept and slope per segment, where routes' lines start and stop
+    std::vector<uint32_t> integrated;   // Targets accumulated, and their state
+    std::vector<float> integratedWrap;
+    std::vector<double> integratedValues;
+    size_t targetCount;
+
+    // Band levels, then the other sources in ModulationSource order
+    std::vector<float> sources;
+    size_t bandCount;
+    float smoothingDelta;
+    SimdLevel simdLevel;
+
+    uint32_t GetSourceSlot(ModulationSource source, uint32_t index) const;
+
+public:
+    ModulationMatrix();
+
+    // Build the program for bandCount bands; false if a route reads a band past them or
+    // writes past the targets
+    bool Compile(const ModulationPatch& patch, size_t bands, SimdLevel maxSimdLevel = SimdLevel::AVX512);
+
+    // Smoothers and integrated targets back to rest
+    void Reset();
+
+    // Run one update of deltaTime seconds
+    void Evaluate(const ModulationInputs& inputs, float deltaTime);
+
+    const float* GetValues() const { return values.data(); }
+    float GetValue(uint32_t target) const { return values[target]; }
+    size_t GetTargetCount() const { return targetCount; }
+    size_t GetRouteCount() const { return routeCount; }
+    SimdLevel GetSimdLevel() const { return simdLevel; }
+};
@@ -0,0 +1,142 @@
+#include "OnsetDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Log compression applied to magnitudes before differencing
+    const float LOG_COMPRESSION = 100.0f;
+
+    // Per-hop decay of the running peak (about 0.5 at 3 s with 10 ms hops)
+    const float PEAK_DECAY = 0.998f;
+
+    const size_t MAX_MEDIAN_WINDOW = 64;
+}
+
+OnsetDetector::OnsetDetector() :
+    binCount(0),
+    framesSeen(0),
+    historyPosition(0),
+    historyCount(0),
+    value(0.0f),
+    previousValue(0.0f),
+    threshold(0.0f),
+    runningPeak(0.0f),
+    strength(0.0f),
+    onset(false),
+    hopsSinceOnset(0),
+    minIntervalHops(1),
+    onsetCount(0)
+{}
+
+bool OnsetDetector::Initialize(const OnsetSettings& onsetSettings, size_t bins) {
+    if (bins == 0 || onsetSettings.medianWindow == 0 || onsetSettings.medianWindow > MAX_MEDIAN_WINDOW ||
+        onsetSettings.hopSeconds <= 0.0f) {
+        return false;
+    }
+
+    settings = onsetSettings;
+    binCount = bins;
+
+    previousMagnitude.assign(binCount, 0.0f);
+    previousPhase.assign(binCount, 0.0f);
+    previousPhase2.assign(binCount, 0.0f);
+    history.assign(settings.medianWindow, 0.0f);
+    medianScratch.assign(settings.medianWindow, 0.0f);
+
+    minIntervalHops = static_cast<size_t>(settings.minIntervalSeconds / settings.hopSeconds + 0.5f);
+    if (minIntervalHops < 1) minIntervalHops = 1;
+
+    Reset();
+    return true;
+}
+
+void OnsetDetector::Reset() {
+    std::fill(previousMagnitude.begin(), previousMagnitude.end(), 0.0f);
+    std::fill(previousPhase.begin(), previousPhase.end(), 0.0f);
+    std::fill(previousPhase2.begin(), previousPhase2.end(), 0.0f);
+    std::fill(history.begin(), history.end(), 0.0f);
+    framesSeen = 0;
+    historyPosition = 0;
+    historyCount = 0;
+    value = 0.0f;
+    previousValue = 0.0f;
+    threshold = 0.0f;
+    runningPeak = 0.0f;
+    strength = 0.0f;
+    onset = false;
+    hopsSinceOnset = minIntervalHops;
+    onsetCount = 0;
+}
+
+float OnsetDetector::SpectralFlux(const float* magnitude) {
+    float flux = 0.0f;
+    for (size_t k = 0; k < binCount; ++k) {
+        float logMagnitude = std::log(1.0f + LOG_COMPRESSION * magnitude[k]);
+        float rise = logMagnitude - previousMagnitude[k];
+        if (rise > 0.0f) flux += rise;
+        previousMagnitude[k] = logMagnitude;
+    }
+    return flux / static_cast<float>(binCount);
+}
+
+float OnsetDetector::ComplexDomain(const float* magnitude, const float* phase) {
+    float distance = 0.0f;
+    for (size_t k = 0; k < binCount; ++k) {
+        // Only rising bins count, so note offsets don't register as onsets
+        if (magnitude[k] >= previousMagnitude[k]) {
+            float predictedPhase = 2.0f * previousPhase[k] - previousPhase2[k];
+            float m = magnitude[k];
+            float p = previousMagnitude[k];
+            float squared = m * m + p * p - 2.0f * m * p * std::cos(phase[k] - predictedPhase);
+            if (squared > 0.0f) distance += std::sqrt(squared);
+        }
+        previousPhase2[k] = previousPhase[k];
+        previousPhase[k] = phase[k];
+        previousMagnitude[k] = magnitude[k];
+    }
+    return distance / static_cast<float>(binCount);
+}
+
+bool OnsetDetector::Process(const float* magnitude, const float* phase) {
+    previousValue = value;
+
+    if (settings.method == OnsetMethod::ComplexDomain && phase) {
+        value = ComplexDomain(magnitude, phase);
+    }
+    else {
+        value = SpectralFlux(magnitude);
+    }
+
+    // The first frames only prime the history
+    ++framesSeen;
+    if (framesSeen <= 2) {
+        value = 0.0f;
+    }
+
+    runningPeak = std::max(value, runningPeak * PEAK_DECAY);
+
+    // Adaptive threshold from the median of past values (the current one excluded)
+    float median = 0.0f;
+    if (historyCount > 0) {
+        std::copy(history.begin(), history.begin() + historyCount, medianScratch.begin());
+        std::nth_element(medianScratch.begin(), medianScratch.begin() + historyCount / 2, medianScratch.begin() + historyCount);
+        median = medianScratch[historyCount / 2];
+    }
+    threshold = settings.thresholdScale * median + settings.thresholdOffset * runningPeak;
+
+    history[historyPosition] = value;
+    historyPosition = (historyPosition + 1) % history.size();
+    if (historyCount < history.size()) ++historyCount;
+
+    // Fire on the rising edge as soon as the threshold is crossed, rather than waiting
+    // a hop to confirm the peak
+    ++hopsSinceOnset;
+    onset = value > threshold && value > previousValue && hopsSinceOnset >= minIntervalHops;
+    if (onset) {
+        hopsSinceOnset = 0;
+        ++onsetCount;
+    }
+
+    strength = runningPeak > 0.0f ? value / runningPeak : 0.0f;
+    return onset;
+}
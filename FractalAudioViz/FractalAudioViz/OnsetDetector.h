@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Onset detection functions
+enum class OnsetMethod {
+    SpectralFlux,  // Half-wave rectified rise in log magnitude
+    ComplexDomain  // Rectified distance from the phase/magnitude predicted by the last two frames
+};
+
+struct OnsetSettings {
+    OnsetMethod method;
+    size_t medianWindow;       // Past detection values the threshold is computed over (<= 64)
+    float thresholdScale;      // Threshold = scale * median + offset * running peak
+    float thresholdOffset;
+    float minIntervalSeconds;  // Refractory period between onsets
+    float hopSeconds;          // STFT hop duration
+
+    OnsetSettings() :
+        method(OnsetMethod::SpectralFlux),
+        medianWindow(16),
+        thresholdScale(1.5f),
+        thresholdOffset(0.05f),
+        minIntervalSeconds(0.08f),
+        hopSeconds(512.0f / 48000.0f)
+    {}
+};
+
+// Incremental onset detector, run once per STFT hop. All state is sized in Initialize;
+// Process does no allocation and only looks at the current and previous frames, so it
+// adds no buffering latency beyond the STFT itself.
+class OnsetDetector {
+private:
+    OnsetSettings settings;
+    size_t binCount;
+
+    // Previous frames: log magnitude (flux) or magnitude and two phases (complex domain)
+    std::vector<float> previousMagnitude;
+    std::vector<float> previousPhase;
+    std::vector<float> previousPhase2;
+    size_t framesSeen;
+
+    // Ring of past detection values for the adaptive threshold
+    std::vector<float> history;
+    std::vector<float> medianScratch;
+    size_t historyPosition;
+    size_t historyCount;
+
+    float value;
+    float previousValue;
+    float threshold;
+    float runningPeak;
+    float strength;
+    bool onset;
+    size_t hopsSinceOnset;
+    size_t minIntervalHops;
+    uint64_t onsetCount;
+
+    float SpectralFlux(const float* magnitude);
+    float ComplexDomain(const float* magnitude, const float* phase);
+
+public:
+    OnsetDetector();
+
+    bool Initialize(const OnsetSettings& settings, size_t binCount);
+    void Reset();
+
+    // Feed one STFT frame (phase is only read by the complex-domain method).
+    // Returns true if an onset was detected in this frame.
+    bool Process(const float* magnitude, const float* phase);
+
+    float GetValue() const { return value; }          // Detection function for this hop
+    float GetThreshold() const { return threshold; }
+    float GetStrength() const { return strength; }    // value relative to the running peak, 0..1
+    bool IsOnset() const { return onset; }
+    uint64_t GetOnsetCount() const { return onsetCount; }
+    const OnsetSettings& GetSettings() const { return settings; }
+};
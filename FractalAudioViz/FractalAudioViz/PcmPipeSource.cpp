@@ -0,0 +1,106 @@
+#include "PcmPipeSource.h"
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+    // Frames converted per fread for integer samples
+    const size_t READ_BLOCK_FRAMES = 1024;
+}
+
+PcmPipeSource::PcmPipeSource(const std::string& streamPath, int sampleRate, int channels, PcmSampleFormat pcmFormat) :
+    path(streamPath),
+    stream(nullptr),
+    ownsStream(false),
+    sampleFormat(pcmFormat)
+{
+    format.sampleRate = sampleRate;
+    format.channels = channels;
+}
+
+PcmPipeSource::~PcmPipeSource() {
+    Close();
+}
+
+bool PcmPipeSource::Open() {
+    Close();
+
+    if (format.sampleRate <= 0 || format.channels <= 0) {
+        return false;
+    }
+
+    if (path == "-") {
+        stream = stdin;
+        ownsStream = false;
+#ifdef _WIN32
+        // stdin opens in text mode, which would turn CR LF into LF and stop at 0x1A
+        if (_setmode(_fileno(stdin), _O_BINARY) == -1) {
+            stream = nullptr;
+        }
+#endif
+    }
+    else {
+#ifdef _MSC_VER
+        if (fopen_s(&stream, path.c_str(), "rb") != 0) {
+            stream = nullptr;
+        }
+#else
+        stream = std::fopen(path.c_str(), "rb");
+#endif
+        ownsStream = true;
+    }
+
+    // Sized once here, so Read never allocates on the capture thread
+    if (sampleFormat == PcmSampleFormat::Int16) {
+        readBuffer.resize(READ_BLOCK_FRAMES * format.channels * sizeof(int16_t));
+    }
+
+    return stream != nullptr;
+}
+
+void PcmPipeSource::Close() {
+    if (stream && ownsStream) {
+        std::fclose(stream);
+    }
+    stream = nullptr;
+    ownsStream = false;
+}
+
+size_t PcmPipeSource::Read(float* frames, size_t frameCount) {
+    if (!stream) {
+        return 0;
+    }
+
+    const size_t sampleCount = frameCount * format.channels;
+
+    if (sampleFormat == PcmSampleFormat::Float32) {
+        // Float samples can be read straight into the destination
+        size_t samplesRead = std::fread(frames, sizeof(float), sampleCount, stream);
+        return samplesRead / format.channels;
+    }
+
+    // Integer samples are converted a block at a time through the buffer
+    const size_t blockSamples = READ_BLOCK_FRAMES * format.channels;
+    size_t samplesDone = 0;
+    while (samplesDone < sampleCount) {
+        size_t samplesWanted = sampleCount - samplesDone;
+        if (samplesWanted > blockSamples) samplesWanted = blockSamples;
+
+        size_t samplesRead = std::fread(readBuffer.data(), sizeof(int16_t), samplesWanted, stream);
+        for (size_t i = 0; i < samplesRead; ++i) {
+            const unsigned char* p = &readBuffer[i * 2];
+            int16_t s = static_cast<int16_t>(p[0] | (p[1] << 8));
+            frames[samplesDone + i] = s * (1.0f / 32768.0f);
+        }
+        samplesDone += samplesRead;
+        if (samplesRead < samplesWanted) {
+            break;
+        }
+    }
+
+    return samplesDone / format.channels;
+}
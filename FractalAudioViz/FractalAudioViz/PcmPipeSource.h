@@ -0,0 +1,36 @@
+#pragma once
+
+#include "AudioSource.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Sample encodings accepted on a raw PCM pipe
+enum class PcmSampleFormat {
+    Int16,
+    Float32
+};
+
+// Reads headerless little-endian PCM from a file, named pipe or stdin ("-"),
+// e.g. `ffmpeg -i song.mp3 -f f32le -ac 2 -ar 48000 - | FractalAudioVizBench ...`
+class PcmPipeSource : public AudioSource {
+private:
+    std::string path;
+    std::FILE* stream;
+    bool ownsStream;
+    AudioFormat format;
+    PcmSampleFormat sampleFormat;
+    std::vector<unsigned char> readBuffer;
+
+public:
+    PcmPipeSource(const std::string& path, int sampleRate, int channels, PcmSampleFormat sampleFormat);
+    ~PcmPipeSource();
+
+    bool Open() override;
+    void Close() override;
+    AudioFormat GetFormat() const override { return format; }
+    size_t Read(float* frames, size_t frameCount) override;
+
+    // A pipe is fed by its writer at the audio rate, so don't pace it
+    bool IsRealtime() const override { return true; }
+};
@@ -0,0 +1,288 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+namespace {
+    uint64_t QuantizeDepth(float depth) {
+        if (!(depth > 0.0f)) return 0;
+        if (depth >= 1.0f) return 0xFFFFFF;
+        return static_cast<uint64_t>(depth * 16777215.0f);
+    }
+
+    inline void Mix(uint64_t& hash, uint64_t value) {
+        hash = (hash ^ value) * 0x100000001B3ull;
+    }
+}
+
+namespace SortKey {
+    // [63:60 layer][59 translucent = 0][58:47 pipeline][46:35 geometry][34:11 depth]
+    uint64_t Opaque(unsigned layer, RenderHandle pipeline, RenderHandle geometry, float depth) {
+        return (static_cast<uint64_t>(layer & 0xF) << 60) |
+            (static_cast<uint64_t>(pipeline & 0xFFF) << 47) |
+            (static_cast<uint64_t>(geometry & 0xFFF) << 35) |
+            (QuantizeDepth(depth) << 11);
+    }
+
+    // [63:60 layer][59 translucent = 1][58:35 inverted depth][34:23 pipeline]
+    uint64_t Translucent(unsigned layer, RenderHandle pipeline, float depth) {
+        return (static_cast<uint64_t>(layer & 0xF) << 60) |
+            (1ull << 59) |
+            ((0xFFFFFF - QuantizeDepth(depth)) << 35) |
+            (static_cast<uint64_t>(pipeline & 0xFFF) << 23);
+    }
+}
+
+void RecordingBackend::Reset() {
+    pipelineCalls = 0;
+    vertexBufferCalls = 0;
+    indexBufferCalls = 0;
+    instanceCalls = 0;
+    constantCalls = 0;
+    drawCalls = 0;
+    checksum = 0xCBF29CE484222325ull;
+}
+
+uint64_t RecordingBackend::GetTotalCalls() const {
+    return pipelineCalls + vertexBufferCalls + indexBufferCalls + instanceCalls + constantCalls + drawCalls;
+}
+
+void RecordingBackend::SetPipeline(RenderHandle pipeline) {
+    ++pipelineCalls;
+    Mix(checksum, 0x10000u | pipeline);
+}
+
+void RecordingBackend::SetVertexBuffer(RenderHandle buffer) {
+    ++vertexBufferCalls;
+    Mix(checksum, 0x20000u | buffer);
+}
+
+void RecordingBackend::SetIndexBuffer(RenderHandle buffer) {
+    ++indexBufferCalls;
+    Mix(checksum, 0x30000u | buffer);
+}
+
+void RecordingBackend::SetInstances(RenderHandle instances) {
+    ++instanceCalls;
+    Mix(checksum, 0x40000u | instances);
+}
+
+void RecordingBackend::SetDrawConstants(const void* data, size_t size) {
+    ++constantCalls;
+    uint64_t first = 0;
+    std::memcpy(&first, data, size < sizeof(first) ? size : sizeof(first));
+    Mix(checksum, first);
+}
+
+void RecordingBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) {
+    ++drawCalls;
+    Mix(checksum, (static_cast<uint64_t>(indexCount) << 32) ^ startIndex ^ (static_cast<uint64_t>(baseVertex) << 16));
+}
+
+void RecordingBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) {
+    ++drawCalls;
+    Mix(checksum, (static_cast<uint64_t>(indexCount) << 32) ^ instanceCount ^ startIndex ^ (static_cast<uint64_t>(baseVertex) << 16));
+}
+
+void RenderStateCache::Invalidate() {
+    pipeline = 0;
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    instances = 0;
+    constants = nullptr;
+    valid = false;
+}
+
+void RenderCommandList::Clear() {
+    packets.clear();
+    constantData.clear();
+}
+
+uint32_t RenderCommandList::AddConstants(const void* data, size_t size) {
+    // 16-byte aligned, matching constant register size
+    size_t offset = (constantData.size() + 15) & ~static_cast<size_t>(15);
+    constantData.resize(offset + size);
+    std::memcpy(&constantData[offset], data, size);
+    return static_cast<uint32_t>(offset);
+}
+
+RenderQueue::RenderQueue() :
+    sorted(false)
+{
+    lists.resize(1);
+}
+
+void RenderQueue::SetListCount(size_t count) {
+    if (count < 1) count = 1;
+    if (count > MAX_LISTS) count = MAX_LISTS;
+    lists.resize(count);
+    Clear();
+}
+
+void RenderQueue::Clear() {
+    for (RenderCommandList& list : lists) {
+        list.Clear();
+    }
+    keys.clear();
+    refs.clear();
+    sorted = false;
+}
+
+size_t RenderQueue::GetPacketCount() const {
+    size_t count = 0;
+    for (const RenderCommandList& list : lists) {
+        count += list.packets.size();
+    }
+    return count;
+}
+
+void RenderQueue::RadixSort() {
+    const size_t count = keys.size();
+    keyScratch.resize(count);
+    refScratch.resize(count);
+
+    // All eight byte histograms in one pass
+    uint32_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = keys[i];
+        for (int pass = 0; pass < 8; ++pass) {
+            ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+        }
+    }
+
+    uint64_t* sourceKeys = keys.data();
+    uint32_t* sourceRefs = refs.data();
+    uint64_t* destKeys = keyScratch.data();
+    uint32_t* destRefs = refScratch.data();
+
+    for (int pass = 0; pass < 8; ++pass) {
+        uint32_t* histogram = histograms[pass];
+        int shift = pass * 8;
+
+        // A byte that's the same in every key doesn't reorder anything; skip the pass.
+        // Sort keys leave whole bytes unused, so this typically saves half the passes.
+        if (histogram[(sourceKeys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        uint32_t offsets[256];
+        uint32_t sum = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            offsets[bucket] = sum;
+            sum += histogram[bucket];
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t position = offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+            destKeys[position] = sourceKeys[i];
+            destRefs[position] = sourceRefs[i];
+        }
+
+        uint64_t* swapKeys = sourceKeys;
+        sourceKeys = destKeys;
+        destKeys = swapKeys;
+        uint32_t* swapRefs = sourceRefs;
+        sourceRefs = destRefs;
+        destRefs = swapRefs;
+    }
+
+    // An odd number of passes left the result in the scratch arrays
+    if (sourceKeys != keys.data()) {
+        keys.swap(keyScratch);
+        refs.swap(refScratch);
+    }
+}
+
+void RenderQueue::Sort() {
+    keys.clear();
+    refs.clear();
+    for (size_t l = 0; l < lists.size(); ++l) {
+        const std::vector<DrawPacket>& packets = lists[l].packets;
+        size_t count = packets.size() < MAX_PACKETS_PER_LIST ? packets.size() : MAX_PACKETS_PER_LIST;
+        for (size_t p = 0; p < count; ++p) {
+            keys.push_back(packets[p].sortKey);
+            refs.push_back(static_cast<uint32_t>((l << 24) | p));
+        }
+    }
+
+    if (!keys.empty()) {
+        RadixSort();
+    }
+    sorted = true;
+}
+
+void RenderQueue::Execute(RenderBackend& backend, RenderStateCache& cache) {
+    if (!sorted) {
+        Sort();
+    }
+
+    stats = RenderQueueStats();
+    stats.packets = static_cast<uint32_t>(refs.size());
+
+    // Constant pointers are only meaningful within this frame's lists
+    cache.constants = nullptr;
+
+    for (uint32_t ref : refs) {
+        const RenderCommandList& list = lists[ref >> 24];
+        const DrawPacket& packet = list.packets[ref & 0xFFFFFF];
+
+        if (!cache.valid || packet.pipeline != cache.pipeline) {
+            backend.SetPipeline(packet.pipeline);
+            cache.pipeline = packet.pipeline;
+            ++stats.pipelineChanges;
+        }
+        else {
+            ++stats.skippedBindings;
+        }
+
+        if (!cache.valid || packet.vertexBuffer != cache.vertexBuffer) {
+            backend.SetVertexBuffer(packet.vertexBuffer);
+            cache.vertexBuffer = packet.vertexBuffer;
+            ++stats.vertexBufferChanges;
+        }
+        else {
+            ++stats.skippedBindings;
+        }
+
+        if (!cache.valid || packet.indexBuffer != cache.indexBuffer) {
+            backend.SetIndexBuffer(packet.indexBuffer);
+            cache.indexBuffer = packet.indexBuffer;
+            ++stats.indexBufferChanges;
+        }
+        else {
+            ++stats.skippedBindings;
+        }
+
+        // Instance streams only matter to instanced draws, so plain draws leave them be
+        if (packet.instanceCount > 0) {
+            if (!cache.valid || packet.instances != cache.instances) {
+                backend.SetInstances(packet.instances);
+                cache.instances = packet.instances;
+                ++stats.instanceChanges;
+            }
+            else {
+                ++stats.skippedBindings;
+            }
+        }
+
+        cache.valid = true;
+
+        if (packet.constants != DrawPacket::NO_CONSTANTS) {
+            const uint8_t* constants = list.GetConstantData(packet.constants);
+            if (constants != cache.constants) {
+                backend.SetDrawConstants(constants, packet.constantSize);
+                cache.constants = constants;
+                ++stats.constantChanges;
+            }
+            else {
+                ++stats.skippedBindings;
+            }
+        }
+
+        if (packet.instanceCount > 0) {
+            backend.DrawIndexedInstanced(packet.indexCount, packet.instanceCount, packet.startIndex, packet.baseVertex);
+        }
+        else {
+            backend.DrawIndexed(packet.indexCount, packet.startIndex, packet.baseVertex);
+        }
+    }
+}
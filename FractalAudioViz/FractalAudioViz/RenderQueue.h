@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index into one of the backend's resource tables; 0 means "nothing bound"
+typedef uint16_t RenderHandle;
+
+// One recorded draw. Packets only reference resources by handle, so recording never
+// touches the device and any thread can do it.
+struct DrawPacket {
+    uint64_t sortKey;
+    RenderHandle pipeline;      // Shaders, input layout and topology
+    RenderHandle vertexBuffer;
+    RenderHandle indexBuffer;
+    RenderHandle instances;     // Per-instance streams, 0 for a plain draw
+    uint32_t constants;         // Offset into the list's constant data, or NO_CONSTANTS
+    uint32_t constantSize;
+    uint32_t indexCount;
+    uint32_t startIndex;
+    int32_t baseVertex;
+    uint32_t instanceCount;     // 0 = non-instanced DrawIndexed
+
+    static const uint32_t NO_CONSTANTS = 0xFFFFFFFFu;
+};
+
+// 64-bit sort keys. Opaque draws group by pipeline, then geometry, then front to back;
+// translucent draws go after, back to front. depth is view depth normalized to 0..1.
+namespace SortKey {
+    uint64_t Opaque(unsigned layer, RenderHandle pipeline, RenderHandle geometry, float depth);
+    uint64_t Translucent(unsigned layer, RenderHandle pipeline, float depth);
+}
+
+// What replaying a queue calls. DXRenderer forwards these to the immediate context;
+// RecordingBackend just counts them.
+class RenderBackend {
+public:
+    virtual ~RenderBackend() {}
+
+    virtual void SetPipeline(RenderHandle pipeline) = 0;
+    virtual void SetVertexBuffer(RenderHandle buffer) = 0;
+    virtual void SetIndexBuffer(RenderHandle buffer) = 0;
+    virtual void SetInstances(RenderHandle instances) = 0;
+    virtual void SetDrawConstants(const void* data, size_t size) = 0;
+    virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+    virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) = 0;
+};
+
+// Backend that records call counts instead of drawing, for tests and benchmarks
+class RecordingBackend : public RenderBackend {
+public:
+    uint64_t pipelineCalls;
+    uint64_t vertexBufferCalls;
+    uint64_t indexBufferCalls;
+    uint64_t instanceCalls;
+    uint64_t constantCalls;
+    uint64_t drawCalls;
+    uint64_t checksum;  // Order-sensitive hash of everything seen, to compare replays
+
+    RecordingBackend() { Reset(); }
+
+    void Reset();
+    uint64_t GetTotalCalls() const;
+
+    void SetPipeline(RenderHandle pipeline) override;
+    void SetVertexBuffer(RenderHandle buffer) override;
+    void SetIndexBuffer(RenderHandle buffer) override;
+    void SetInstances(RenderHandle instances) override;
+    void SetDrawConstants(const void* data, size_t size) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) override;
+};
+
+// Bindings last sent to the backend. Persists across frames; Invalidate after anything
+// changes device state behind the queue's back.
+struct RenderStateCache {
+    RenderHandle pipeline;
+    RenderHandle vertexBuffer;
+    RenderHandle indexBuffer;
+    RenderHandle instances;
+    const void* constants;
+    bool valid;
+
+    RenderStateCache() { Invalidate(); }
+    void Invalidate();
+};
+
+struct RenderQueueStats {
+    uint32_t packets;
+    uint32_t pipelineChanges;
+    uint32_t vertexBufferChanges;
+    uint32_t indexBufferChanges;
+    uint32_t instanceChanges;
+    uint32_t constantChanges;
+    uint32_t skippedBindings;  // Bindings the cache found already in place
+
+    RenderQueueStats() :
+        packets(0), pipelineChanges(0), vertexBufferChanges(0), indexBufferChanges(0),
+        instanceChanges(0), constantChanges(0), skippedBindings(0) {}
+};
+
+// Packets recorded by one thread, with their per-draw constants alongside
+class RenderCommandList {
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<uint8_t> constantData;
+
+    friend class RenderQueue;
+
+public:
+    void Clear();
+
+    // Copy per-draw constants into the list; returns the offset for DrawPacket::constants
+    uint32_t AddConstants(const void* data, size_t size);
+
+    void Add(const DrawPacket& packet) { packets.push_back(packet); }
+
+    size_t GetPacketCount() const { return packets.size(); }
+    const DrawPacket& GetPacket(size_t index) const { return packets[index]; }
+    const uint8_t* GetConstantData(uint32_t offset) const { return &constantData[offset]; }
+};
+
+// A frame's draws: a fixed set of command lists (one per recording thread), merged and
+// radix sorted by key, then replayed through a state cache.
+class RenderQueue {
+private:
+    std::vector<RenderCommandList> lists;
+
+    // Sort entries: key, and the list and packet it came from packed into 32 bits
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> refs;
+    std::vector<uint64_t> keyScratch;
+    std::vector<uint32_t> refScratch;
+    bool sorted;
+
+    RenderQueueStats stats;
+
+    void RadixSort();
+
+public:
+    // Packet references keep 8 bits for the list and 24 for the packet
+    static const size_t MAX_LISTS = 256;
+    static const size_t MAX_PACKETS_PER_LIST = 1 << 24;
+
+    RenderQueue();
+
+    // Number of command lists, one per thread that records; clears the queue
+    void SetListCount(size_t count);
+    size_t GetListCount() const { return lists.size(); }
+
+    // Each list may be recorded by a different thread at the same time
+    RenderCommandList& GetList(size_t index) { return lists[index]; }
+
+    // Start a new frame
+    void Clear();
+
+    // Merge all lists and sort by key (stable, so equal keys keep recording order)
+    void Sort();
+
+    // Replay the sorted packets, sending only the bindings that differ from the cache
+    void Execute(RenderBackend& backend, RenderStateCache& cache);
+
+    size_t GetPacketCount() const;
+    const RenderQueueStats& GetStats() const { return stats; }
+};
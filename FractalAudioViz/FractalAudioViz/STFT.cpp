@@ -0,0 +1,171 @@
+#include "STFT.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const double PI = 3.14159265358979323846;
+}
+
+void BuildWindow(WindowFunction function, float* window, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        double x = 2.0 * PI * static_cast<double>(i) / static_cast<double>(size);
+        double value = 1.0;
+
+        switch (function) {
+        case WindowFunction::Rectangular:
+            value = 1.0;
+            break;
+        case WindowFunction::Hann:
+            value = 0.5 - 0.5 * std::cos(x);
+            break;
+        case WindowFunction::Hamming:
+            value = 0.54 - 0.46 * std::cos(x);
+            break;
+        case WindowFunction::Blackman:
+            value = 0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2.0 * x);
+            break;
+        case WindowFunction::BlackmanHarris:
+            value = 0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2.0 * x) - 0.01168 * std::cos(3.0 * x);
+            break;
+        }
+
+        window[i] = static_cast<float>(value);
+    }
+}
+
+STFT::STFT() :
+    historyPosition(0),
+    samplesUntilHop(0),
+    magnitudeScale(1.0f),
+    newFrame(false),
+    frameCount(0),
+    samplesConsumed(0),
+    frameEndSample(0)
+{}
+
+bool STFT::Initialize(const StftSettings& stftSettings) {
+    if (stftSettings.hopSize == 0 || stftSettings.hopSize > stftSettings.fftSize) {
+        return false;
+    }
+
+    if (!plan.Initialize(stftSettings.fftSize, stftSettings.maxSimdLevel)) {
+        return false;
+    }
+
+    settings = stftSettings;
+    const size_t fftSize = settings.fftSize;
+    const size_t bins = plan.GetBinCount();
+
+    window.resize(fftSize);
+    BuildWindow(settings.window, window.data(), fftSize);
+
+    // Normalize so a sine of amplitude A shows up with magnitude ~A
+    double windowSum = 0.0;
+    for (size_t i = 0; i < fftSize; ++i) {
+        windowSum += window[i];
+    }
+    magnitudeScale = static_cast<float>(2.0 / windowSum);
+
+    history.assign(fftSize, 0.0f);
+    frame.assign(fftSize, 0.0f);
+    binRe.assign(bins, 0.0f);
+    binIm.assign(bins, 0.0f);
+    magnitude.assign(bins, 0.0f);
+    phase.assign(settings.computePhase ? bins : 0, 0.0f);
+
+    Reset();
+    return true;
+}
+
+void STFT::Reset() {
+    std::fill(history.begin(), history.end(), 0.0f);
+    historyPosition = 0;
+    samplesUntilHop = settings.hopSize;
+    newFrame = false;
+    frameCount = 0;
+    samplesConsumed = 0;
+    frameEndSample = 0;
+}
+
+size_t STFT::Consume(const float* frames, size_t count, int channels) {
+    newFrame = false;
+
+    size_t toConsume = count < samplesUntilHop ? count : samplesUntilHop;
+    const size_t mask = settings.fftSize - 1;
+
+    if (channels == 1) {
+        for (size_t i = 0; i < toConsume; ++i) {
+            history[historyPosition] = frames[i];
+            historyPosition = (historyPosition + 1) & mask;
+        }
+    }
+    else {
+        const float mix = 1.0f / static_cast<float>(channels);
+        for (size_t i = 0; i < toConsume; ++i) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; ++c) {
+                sum += frames[i * channels + c];
+            }
+            history[historyPosition] = sum * mix;
+            historyPosition = (historyPosition + 1) & mask;
+        }
+    }
+
+    samplesConsumed += toConsume;
+    samplesUntilHop -= toConsume;
+
+    if (samplesUntilHop == 0) {
+        AnalyzeFrame();
+        samplesUntilHop = settings.hopSize;
+    }
+
+    return toConsume;
+}
+
+void STFT::AnalyzeFrame() {
+    const size_t fftSize = settings.fftSize;
+    const size_t bins = magnitude.size();
+
+    // Unroll the circular history (oldest sample first) and apply the window
+    size_t firstPart = fftSize - historyPosition;
+    const float* w = window.data();
+    const float* older = history.data() + historyPosition;
+    for (size_t i = 0; i < firstPart; ++i) {
+        frame[i] = older[i] * w[i];
+    }
+    for (size_t i = firstPart; i < fftSize; ++i) {
+        frame[i] = history[i - firstPart] * w[i];
+    }
+
+    plan.ForwardReal(frame.data(), binRe.data(), binIm.data());
+
+    // Magnitude is cheap and vectorizes; phase needs atan2 per bin
+    const float* re = binRe.data();
+    const float* im = binIm.data();
+    float* mag = magnitude.data();
+    size_t k = 0;
+#if FAV_X86
+    if (plan.GetSimdLevel() >= SimdLevel::SSE2) {
+        const __m128 scale = _mm_set1_ps(magnitudeScale);
+        for (; k + 4 <= bins; k += 4) {
+            __m128 r = _mm_loadu_ps(re + k);
+            __m128 i = _mm_loadu_ps(im + k);
+            __m128 power = _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i));
+            _mm_storeu_ps(mag + k, _mm_mul_ps(_mm_sqrt_ps(power), scale));
+        }
+    }
+#endif
+    for (; k < bins; ++k) {
+        mag[k] = std::sqrt(re[k] * re[k] + im[k] * im[k]) * magnitudeScale;
+    }
+
+    if (settings.computePhase) {
+        for (size_t b = 0; b < bins; ++b) {
+            phase[b] = std::atan2(im[b], re[b]);
+        }
+    }
+
+    newFrame = true;
+    frameEndSample = samplesConsumed;
+    ++frameCount;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "FFT.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Analysis window shapes
+enum class WindowFunction {
+    Rectangular,
+    Hann,
+    Hamming,
+    Blackman,
+    BlackmanHarris
+};
+
+struct StftSettings {
+    size_t fftSize;        // Power of two, 16..32768 and up
+    size_t hopSize;        // Samples between successive frames (fftSize / 4 = 75% overlap)
+    WindowFunction window;
+    bool computePhase;     // Phase costs an atan2 per bin; skip it if nobody needs it
+    SimdLevel maxSimdLevel;
+
+    StftSettings() :
+        fftSize(4096),
+        hopSize(1024),
+        window(WindowFunction::Hann),
+        computePhase(true),
+        maxSimdLevel(SimdLevel::AVX512)
+    {}
+};
+
+// Streaming short-time Fourier transform. Samples are pushed in arbitrary block
+// sizes; every hopSize samples a new windowed frame of the last fftSize samples is
+// transformed and its magnitude (and phase) written into buffers allocated once in
+// Initialize. Magnitudes are scaled so a full-scale sine peaks at about 1.0.
+class STFT {
+private:
+    StftSettings settings;
+    FFTPlan plan;
+
+    std::vector<float> window;
+    std::vector<float> history;  // Circular buffer of the last fftSize samples
+    size_t historyPosition;
+    size_t samplesUntilHop;
+
+    std::vector<float> frame;    // Windowed, unrolled copy of the history
+    std::vector<float> binRe;
+    std::vector<float> binIm;
+    std::vector<float> magnitude;
+    std::vector<float> phase;
+    float magnitudeScale;
+
+    bool newFrame;
+    uint64_t frameCount;
+    uint64_t samplesConsumed;
+    uint64_t frameEndSample;
+
+    void AnalyzeFrame();
+
+public:
+    STFT();
+
+    bool Initialize(const StftSettings& settings);
+    void Reset();
+
+    // Consume interleaved frames (mixed down to mono) up to and including the next
+    // hop boundary. Returns how many frames were consumed; call again with the rest.
+    // HasNewFrame() is true if this call produced a new spectrum.
+    size_t Consume(const float* frames, size_t frameCount, int channels = 1);
+
+    bool HasNewFrame() const { return newFrame; }
+    uint64_t GetFrameCount() const { return frameCount; }
+
+    // Sample position (since Reset) of the end of the latest analysis frame
+    uint64_t GetFrameEndSample() const { return frameEndSample; }
+
+    const StftSettings& GetSettings() const { return settings; }
+    size_t GetBinCount() const { return magnitude.size(); }
+    const float* GetMagnitude() const { return magnitude.data(); }
+    const float* GetPhase() const { return phase.data(); }
+    const float* GetReal() const { return binRe.data(); }
+    const float* GetImaginary() const { return binIm.data(); }
+};
+
+// Fill window with the given shape (periodic form, as used for overlapped analysis)
+void BuildWindow(WindowFunction function, float* window, size_t size);
@@ -0,0 +1,401 @@
+#include "ShaderCache.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // The pack's layout, little-endian: a header, entryCount entries sorted by key, then
+    // the bytecode, each 16-byte aligned. The checksum covers everything after the header.
+    struct PackHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t compilerVersion;
+        uint64_t entryCount;
+        uint64_t size;
+        uint64_t checksum;
+        uint64_t reserved;
+    };
+
+    struct PackEntry {
+        uint64_t keyLow;
+        uint64_t keyHigh;
+        uint64_t offset;        // From the start of the pack
+        uint64_t size;
+    };
+
+    const size_t PACK_ALIGNMENT = 16;
+
+    size_t AlignUp(size_t value) {
+        return (value + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+    }
+
+    // FNV-1a over 64-bit words; the pack pads everything to whole words
+    uint64_t Checksum(const uint8_t* bytes, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Two independent byte-wise hashes for the two halves of a key
+    struct KeyHasher {
+        uint64_t low;
+        uint64_t high;
+
+        KeyHasher() : low(14695981039346656037ull), high(0x243F6A8885A308D3ull) {}
+
+        void Add(const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                low = (low ^ bytes[i]) * 1099511628211ull;
+                high = (high ^ bytes[i]) * 0x9E3779B97F4A7C15ull;
+                high ^= high >> 32;
+            }
+        }
+
+        void Add(uint64_t value) {
+            Add(&value, sizeof(value));
+        }
+
+        // Length first, so adjacent strings can't trade characters
+        void Add(const std::string& text) {
+            Add(static_cast<uint64_t>(text.size()));
+            Add(text.data(), text.size());
+        }
+    };
+
+    // Write the whole file beside path, then rename it over path
+    bool ReplaceFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+        const std::string temporary = path + ".tmp";
+        std::FILE* file = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&file, temporary.c_str(), "wb") != 0) {
+            file = nullptr;
+        }
+#else
+        file = std::fopen(temporary.c_str(), "wb");
+#endif
+        if (!file) {
+            return false;
+        }
+        bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+        written = written && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        written = written && std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+        if (!written) {
+            std::remove(temporary.c_str());
+        }
+        return written;
+    }
+}
+
+bool StubShaderCompiler::Compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) {
+    ++compiles;
+    if (desc.source.find("#error") != std::string::npos) {
+        errors = desc.name + ": #error";
+        return false;
+    }
+
+    // An LCG run over the key, as long as the source is, then its states as the bytes
+    const ShaderKey key = ShaderCache::GetKey(desc, version);
+    uint64_t state = key.low ^ key.high;
+    const uint64_t work = static_cast<uint64_t>(workIterations) * desc.source.size();
+    for (uint64_t i = 0; i < work; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+    }
+
+    bytecode.resize(32 + (desc.source.size() / 2 + 3) / 4 * 4);
+    std::memcpy(bytecode.data(), "STUB", 4);
+    for (size_t i = 4; i < bytecode.size(); ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        bytecode[i] = static_cast<uint8_t>(state >> 56);
+    }
+    return true;
+}
+
+ShaderCache::ShaderCache() :
+    pack(nullptr),
+    packSize(0),
+    mapping(nullptr),
+    fileHandle(nullptr),
+    mappingHandle(nullptr)
+{}
+
+ShaderCache::~ShaderCache() {
+    Close();
+}
+
+ShaderKey ShaderCache::GetKey(const ShaderDesc& desc, uint64_t compilerVersion) {
+    KeyHasher hasher;
+    hasher.Add(compilerVersion);
+    hasher.Add(desc.source);
+    hasher.Add(desc.entryPoint);
+    hasher.Add(desc.profile);
+    hasher.Add(static_cast<uint64_t>(desc.flags));
+    hasher.Add(static_cast<uint64_t>(desc.defines.size()));
+    for (const ShaderDefine& define : desc.defines) {
+        hasher.Add(define.name);
+        hasher.Add(define.value);
+    }
+    ShaderKey key = { hasher.low, hasher.high };
+    return key;
+}
+
+bool ShaderCache::Attach(const uint8_t* data, size_t size, uint64_t compilerVersion) {
+    PackHeader header;
+    if (!data || size < sizeof(header) || size % 8 != 0) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != PACK_MAGIC || header.version != PACK_VERSION || header.compilerVersion != compilerVersion ||
+        header.size != size || header.entryCount > (size - sizeof(header)) / sizeof(PackEntry) ||
+        header.checksum != Checksum(data + sizeof(header), size - sizeof(header))) {
+        return false;
+    }
+
+    // Every entry inside the data and the keys strictly increasing, for bisection
+    const PackEntry* entries = reinterpret_cast<const PackEntry*>(data + sizeof(header));
+    const size_t dataStart = sizeof(header) + header.entryCount * sizeof(PackEntry);
+    for (size_t i = 0; i < header.entryCount; ++i) {
+        const PackEntry& entry = entries[i];
+        if (entry.offset < dataStart || entry.offset % PACK_ALIGNMENT != 0 || entry.offset > size ||
+            entry.size > size - entry.offset) {
+            return false;
+        }
+        if (i > 0) {
+            ShaderKey previous = { entries[i - 1].keyLow, entries[i - 1].keyHigh };
+            ShaderKey key = { entry.keyLow, entry.keyHigh };
+            if (!(previous < key)) {
+                return false;
+            }
+        }
+    }
+
+    pack = data;
+    packSize = size;
+    return true;
+}
+
+bool ShaderCache::Map(const std::string& path, uint64_t compilerVersion) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE view = nullptr;
+    void* data = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (view) {
+            data = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+    fileHandle = file;
+    mappingHandle = view;
+    mapping = data;
+    if (!data || !Attach(static_cast<const uint8_t*>(data), static_cast<size_t>(size.QuadPart), compilerVersion)) {
+        Close();
+        return false;
+    }
+    return true;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat status;
+    void* data = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+    }
+    close(file);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    mapping = data;
+    packSize = static_cast<size_t>(status.st_size);
+    if (!Attach(static_cast<const uint8_t*>(data), packSize, compilerVersion)) {
+        Close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool ShaderCache::Open(const std::string& path, uint64_t compilerVersion) {
+    Close();
+    return Map(path, compilerVersion);
+}
+
+void ShaderCache::Close() {
+#ifdef _WIN32
+    if (mapping) UnmapViewOfFile(mapping);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+#else
+    if (mapping) munmap(mapping, packSize);
+#endif
+    mapping = nullptr;
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+    pack = nullptr;
+    packSize = 0;
+    memoryPack.clear();
+    memoryPack.shrink_to_fit();
+}
+
+size_t ShaderCache::GetEntryCount() const {
+    if (!pack) return 0;
+    PackHeader header;
+    std::memcpy(&header, pack, sizeof(header));
+    return static_cast<size_t>(header.entryCount);
+}
+
+bool ShaderCache::Find(const ShaderKey& key, ShaderBytecode& bytecode) const {
+    if (!pack) {
+        return false;
+    }
+    const PackEntry* first = reinterpret_cast<const PackEntry*>(pack + sizeof(PackHeader));
+    const PackEntry* last = first + GetEntryCount();
+    const PackEntry* entry = std::lower_bound(first, last, key, [](const PackEntry& e, const ShaderKey& k) {
+        ShaderKey entryKey = { e.keyLow, e.keyHigh };
+        return entryKey < k;
+    });
+    if (entry == last || entry->keyLow != key.low || entry->keyHigh != key.high) {
+        return false;
+    }
+    bytecode.data = pack + entry->offset;
+    bytecode.size = static_cast<size_t>(entry->size);
+    return true;
+}
+
+bool ShaderCache::Load(const std::string& path, const std::vector<ShaderDesc>& shaders, ShaderCompiler& compiler,
+    std::vector<ShaderBytecode>& bytecode, std::string& errors, unsigned threadCount, JobSystem* jobs) {
+    const double start = FrameStats::NowSeconds();
+    const uint64_t compilerVersion = compiler.GetVersion();
+    stats = ShaderCacheStats();
+    stats.shaders = shaders.size();
+    errors.clear();
+
+    stats.packValid = Open(path, compilerVersion);
+    stats.openSeconds = FrameStats::NowSeconds() - start;
+
+    std::vector<ShaderKey> keys(shaders.size());
+    std::vector<size_t> missing;
+    ShaderBytecode none = { nullptr, 0 };
+    bytecode.assign(shaders.size(), none);
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        keys[i] = GetKey(shaders[i], compilerVersion);
+        if (Find(keys[i], bytecode[i])) ++stats.hits;
+        else missing.push_back(i);
+    }
+    if (missing.empty()) {
+        stats.packBytes = packSize;
+        stats.seconds = FrameStats::NowSeconds() - start;
+        return true;
+    }
+
+    // The misses, each into its own buffer
+    double phase = FrameStats::NowSeconds();
+    std::vector<std::vector<uint8_t>> compiled(missing.size());
+    std::vector<std::string> messages(missing.size());
+    std::vector<char> succeeded(missing.size(), 0);
+    ParallelForEach(missing.size(), jobs, threadCount, [&](size_t m) {
+        succeeded[m] = compiler.Compile(shaders[missing[m]], compiled[m], messages[m]) ? 1 : 0;
+    });
+    stats.compiled = missing.size();
+    stats.compileSeconds = FrameStats::NowSeconds() - phase;
+    for (size_t m = 0; m < missing.size(); ++m) {
+        if (!succeeded[m]) {
+            errors += shaders[missing[m]].name + ":\n" + messages[m] + "\n";
+        }
+    }
+    if (!errors.empty()) {
+        stats.seconds = FrameStats::NowSeconds() - start;
+        return false;
+    }
+
+    // The new pack: the old entries, which other shader sets may still want, and the
+    // compiled ones, a shader listed twice only once
+    phase = FrameStats::NowSeconds();
+    struct Blob {
+        ShaderKey key;
+        const uint8_t* data;
+        size_t size;
+    };
+    std::vector<Blob> blobs;
+    if (pack) {
+        const PackEntry* oldEntries = reinterpret_cast<const PackEntry*>(pack + sizeof(PackHeader));
+        for (size_t i = 0; i < GetEntryCount(); ++i) {
+            Blob blob = { { oldEntries[i].keyLow, oldEntries[i].keyHigh }, pack + oldEntries[i].offset,
+                static_cast<size_t>(oldEntries[i].size) };
+            blobs.push_back(blob);
+        }
+    }
+    for (size_t m = 0; m < missing.size(); ++m) {
+        Blob blob = { keys[missing[m]], compiled[m].data(), compiled[m].size() };
+        blobs.push_back(blob);
+    }
+    std::stable_sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.key < b.key; });
+    blobs.erase(std::unique(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.key == b.key; }),
+        blobs.end());
+
+    PackHeader header = {};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.compilerVersion = compilerVersion;
+    header.entryCount = blobs.size();
+    size_t size = AlignUp(sizeof(header) + blobs.size() * sizeof(PackEntry));
+    std::vector<PackEntry> entries(blobs.size());
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        PackEntry entry = { blobs[i].key.low, blobs[i].key.high, size, blobs[i].size };
+        entries[i] = entry;
+        size = AlignUp(size + blobs[i].size);
+    }
+    header.size = size;
+
+    std::vector<uint8_t> image(size, 0);
+    std::memcpy(image.data() + sizeof(header), entries.data(), entries.size() * sizeof(PackEntry));
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        std::memcpy(image.data() + entries[i].offset, blobs[i].data, blobs[i].size);
+    }
+    header.checksum = Checksum(image.data() + sizeof(header), size - sizeof(header));
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    // Unmapped before it's replaced; kept in memory if it can't be written or mapped back
+    Close();
+    if (!ReplaceFile(path, image) || !Map(path, compilerVersion)) {
+        Close();
+        memoryPack.swap(image);
+        Attach(memoryPack.data(), memoryPack.size(), compilerVersion);
+    }
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        Find(keys[i], bytecode[i]);
+    }
+    stats.writeSeconds = FrameStats::NowSeconds() - phase;
+    stats.packBytes = packSize;
+    stats.seconds = FrameStats::NowSeconds() - start;
+    return true;
+}
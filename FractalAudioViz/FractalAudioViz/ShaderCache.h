@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+// One shader to compile: everything here but the name goes into its cache key
+struct ShaderDesc {
+    std::string name;                   // For error messages and debug info
+    std::string source;
+    std::string entryPoint;
+    std::string profile;                // vs_4_0, ps_4_0, ...
+    std::vector<ShaderDefine> defines;
+    uint32_t flags;                     // The compiler's own, D3DCOMPILE_* for D3D
+
+    ShaderDesc() : flags(0) {}
+};
+
+// 128-bit hash of a ShaderDesc and the compiler version
+struct ShaderKey {
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(const ShaderKey& other) const { return low == other.low && high == other.high; }
+    bool operator<(const ShaderKey& other) const { return high != other.high ? high < other.high : low < other.low; }
+};
+
+// Compiled code in the pack or in memory; valid until the cache's next Load or Close
+struct ShaderBytecode {
+    const void* data;
+    size_t size;
+};
+
+// What ShaderCache compiles with. DXRenderer wraps D3DCompile in one; StubShaderCompiler
+// stands in for it off Windows.
+class ShaderCompiler {
+public:
+    virtual ~ShaderCompiler() {}
+
+    // Identifies the compiler build: a pack written by another is thrown away whole
+    virtual uint64_t GetVersion() const = 0;
+
+    // Called from several threads at once; false with the messages in errors on failure
+    virtual bool Compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) = 0;
+};
+
+// Compiler that hashes its input into bytecode instead, for tests and benchmarks: the same
+// desc always gives the same bytes, a source holding "#error" fails, and workIterations
+// rounds of busy work per source byte stand in for the time a real compiler takes
+class StubShaderCompiler : public ShaderCompiler {
+public:
+    uint64_t version;
+    unsigned workIterations;
+    std::atomic<uint64_t> compiles;
+
+    StubShaderCompiler(uint64_t compilerVersion = 1, unsigned iterations = 0) :
+        version(compilerVersion),
+        workIterations(iterations),
+        compiles(0)
+    {}
+
+    uint64_t GetVersion() const override { return version; }
+    bool Compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) override;
+};
+
+struct ShaderCacheStats {
+    size_t shaders;         // Asked for by the last Load
+    size_t hits;            // Found in the pack
+    size_t compiled;
+    bool packValid;         // An existing pack opened and passed validation
+    double openSeconds;     // Mapping and validating the pack
+    double compileSeconds;
+    double writeSeconds;    // Writing and remapping the new pack
+    double seconds;         // The whole Load
+    size_t packBytes;
+
+    ShaderCacheStats() :
+        shaders(0), hits(0), compiled(0), packValid(false), openSeconds(0.0), compileSeconds(0.0), writeSeconds(0.0),
+        seconds(0.0), packBytes(0)
+    {}
+};
+
+// Compiled shaders kept across runs in one pack file, which is memory-mapped and validated
+// in place and hands out bytecode pointing into the mapping, without copies. The pack is a
+// header, a table of entries sorted by key and searched by bisection, and the bytecode,
+// each 16-byte aligned; a checksum over all of it catches torn or corrupted writes. Shaders
+// the pack lacks are compiled in parallel, then a new pack holding the old entries and the
+// new ones is written beside it and renamed over it, so a crash never leaves half a pack.
+class ShaderCache {
+public:
+    static const uint32_t PACK_MAGIC = 0x53564146;     // "FAVS"
+    static const uint32_t PACK_VERSION = 1;
+
+private:
+    // The pack in use: a mapping of the file, or memoryPack when it couldn't be written
+    const uint8_t* pack;
+    size_t packSize;
+    std::vector<uint8_t> memoryPack;
+
+    // Platform handles of the mapping
+    void* mapping;
+    void* fileHandle;
+    void* mappingHandle;
+
+    ShaderCacheStats stats;
+
+    bool Attach(const uint8_t* data, size_t size, uint64_t compilerVersion);
+    bool Map(const std::string& path, uint64_t compilerVersion);
+
+public:
+    ShaderCache();
+    ~ShaderCache();
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    static ShaderKey GetKey(const ShaderDesc& desc, uint64_t compilerVersion);
+
+    // Map the pack at path; false, with nothing open, if it's missing, from another
+    // compiler or fails validation
+    bool Open(const std::string& path, uint64_t compilerVersion);
+    void Close();
+
+    bool Find(const ShaderKey& key, ShaderBytecode& bytecode) const;
+    size_t GetEntryCount() const;
+
+    // Every shader's bytecode, in order, from the pack at path, compiling those it lacks on
+    // threadCount threads (0 = one per hardware thread) or the job system and rewriting
+    // the pack with them. False, with the failing shaders' messages in errors, if any
+    // fails to compile. An unwritable pack only costs the next start its compiles.
+    bool Load(const std::string& path, const std::vector<ShaderDesc>& shaders, ShaderCompiler& compiler,
+        std::vector<ShaderBytecode>& bytecode, std::string& errors, unsigned threadCount = 0, JobSystem* jobs = nullptr);
+
+    const ShaderCacheStats& GetStats() const { return stats; }
+};
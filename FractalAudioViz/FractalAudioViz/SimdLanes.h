@@ -0,0 +1,332 @@
+#pragma once
+
+#include "SimdSupport.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// The lane types kernels are written over, one namespace per instruction set: Vec holds
+// LANES floats, Mask a comparison result, and the operations work lane by lane (Ramp is
+// 0, 1, 2, ... across the lanes). A kernel source is included once per level inside a
+// namespace that uses one of these (and, for AVX2 and AVX-512, inside that level's target
+// region), so every level runs the same sequence of operations; only MulAdd rounds
+// differently, fused on the FMA levels. The Double namespaces hold doubles, half as many,
+// with the few operations the perturbation kernels need and a Gather of one array element
+// per lane at indices held as whole numbers in a Vec. Random holds a xorshift32 state per
+// lane, which NextRandom steps for a uniform float in [0, 1) from its top 23 bits.
+namespace SimdLanes {
+    // One lane. Min and Max pick like minps / maxps and rounding is to nearest even, so
+    // this is the SSE2 code one point at a time.
+    namespace Scalar {
+        typedef float Vec;
+        typedef bool Mask;
+        const size_t LANES = 1;
+
+        inline Vec Set(float v) { return v; }
+        inline Vec Ramp() { return 0.0f; }
+        inline Vec Load(const float* p) { return *p; }
+        inline void Store(float* p, Vec v) { *p = v; }
+        inline Vec Add(Vec a, Vec b) { return a + b; }
+        inline Vec Sub(Vec a, Vec b) { return a - b; }
+        inline Vec Mul(Vec a, Vec b) { return a * b; }
+        inline Vec Div(Vec a, Vec b) { return a / b; }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return a * b + c; }
+        inline Vec Min(Vec a, Vec b) { return a < b ? a : b; }
+        inline Vec Max(Vec a, Vec b) { return a > b ? a : b; }
+        inline Vec Sqrt(Vec v) { return std::sqrt(v); }
+        inline Vec Abs(Vec v) { return std::fabs(v); }
+        inline Vec RoundNearest(Vec v) { return std::nearbyint(v); }
+        inline Mask Less(Vec a, Vec b) { return a < b; }
+        inline Mask Equal(Vec a, Vec b) { return a == b; }
+        inline Mask And(Mask a, Mask b) { return a && b; }
+        inline bool Any(Mask m) { return m; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return m ? a : b; }
+
+        // 2^n for a whole n in -126..127
+        inline Vec Pow2(Vec n) {
+            uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        // x = mantissa * 2^exponent with the mantissa in [1, 2), for positive normal x
+        inline void SplitExponent(Vec x, Vec& mantissa, Vec& exponent) {
+            uint32_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+            bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+            std::memcpy(&mantissa, &bits, sizeof(mantissa));
+        }
+
+        typedef uint32_t Random;
+        inline Random LoadRandom(const uint32_t* p) { return *p; }
+        inline Vec NextRandom(Random& state) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            uint32_t bits = (state >> 9) | 0x3F800000u;
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result - 1.0f;
+        }
+    }
+
+    namespace ScalarDouble {
+        typedef double Vec;
+        typedef bool Mask;
+        const size_t LANES = 1;
+
+        inline Vec Set(double v) { return v; }
+        inline Vec Ramp() { return 0.0; }
+        inline Vec Load(const double* p) { return *p; }
+        inline void Store(double* p, Vec v) { *p = v; }
+        inline Vec Add(Vec a, Vec b) { return a + b; }
+        inline Vec Sub(Vec a, Vec b) { return a - b; }
+        inline Vec Mul(Vec a, Vec b) { return a * b; }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return a * b + c; }
+        inline Mask Less(Vec a, Vec b) { return a < b; }
+        inline Mask Equal(Vec a, Vec b) { return a == b; }
+        inline Mask And(Mask a, Mask b) { return a && b; }
+        inline Mask Or(Mask a, Mask b) { return a || b; }
+        inline bool Any(Mask m) { return m; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return m ? a : b; }
+        inline Vec Gather(const double* base, Vec index) { return base[static_cast<size_t>(index)]; }
+    }
+
+#if FAV_X86
+    namespace Sse {
+        typedef __m128 Vec;
+        typedef __m128 Mask;
+        const size_t LANES = 4;
+
+        inline Vec Set(float v) { return _mm_set1_ps(v); }
+        inline Vec Ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+        inline Vec Load(const float* p) { return _mm_loadu_ps(p); }
+        inline void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+        inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        inline Vec Div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        inline Vec Min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+        inline Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+        inline Vec Sqrt(Vec v) { return _mm_sqrt_ps(v); }
+        inline Vec Abs(Vec v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+        inline Vec RoundNearest(Vec v) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(v)); }
+        inline Mask Less(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+        inline Mask Equal(Vec a, Vec b) { return _mm_cmpeq_ps(a, b); }
+        inline Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+        inline bool Any(Mask m) { return _mm_movemask_ps(m) != 0; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+        inline Vec Pow2(Vec n) {
+            __m128i biased = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+            return _mm_castsi128_ps(_mm_slli_epi32(biased, 23));
+        }
+
+        inline void SplitExponent(Vec x, Vec& mantissa, Vec& exponent) {
+            __m128i bits = _mm_castps_si128(x);
+            exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+            bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000));
+            mantissa = _mm_castsi128_ps(bits);
+        }
+
+        typedef __m128i Random;
+        inline Random LoadRandom(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        inline Vec NextRandom(Random& state) {
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+            state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+            __m128i bits = _mm_or_si128(_mm_srli_epi32(state, 9), _mm_set1_epi32(0x3F800000));
+            return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f));
+        }
+    }
+
+    namespace SseDouble {
+        typedef __m128d Vec;
+        typedef __m128d Mask;
+        const size_t LANES = 2;
+
+        inline Vec Set(double v) { return _mm_set1_pd(v); }
+        inline Vec Ramp() { return _mm_setr_pd(0.0, 1.0); }
+        inline Vec Load(const double* p) { return _mm_loadu_pd(p); }
+        inline void Store(double* p, Vec v) { _mm_storeu_pd(p, v); }
+        inline Vec Add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        inline Vec Sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        inline Vec Mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        inline Mask Less(Vec a, Vec b) { return _mm_cmplt_pd(a, b); }
+        inline Mask Equal(Vec a, Vec b) { return _mm_cmpeq_pd(a, b); }
+        inline Mask And(Mask a, Mask b) { return _mm_and_pd(a, b); }
+        inline Mask Or(Mask a, Mask b) { return _mm_or_pd(a, b); }
+        inline bool Any(Mask m) { return _mm_movemask_pd(m) != 0; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+        inline Vec Gather(const double* base, Vec index) {
+            __m128i i = _mm_cvttpd_epi32(index);
+            return _mm_setr_pd(base[_mm_cvtsi128_si32(i)], base[_mm_cvtsi128_si32(_mm_srli_si128(i, 4))]);
+        }
+    }
+
+FAV_BEGIN_TARGET_AVX2
+    namespace Avx2 {
+        typedef __m256 Vec;
+        typedef __m256 Mask;
+        const size_t LANES = 8;
+
+        inline Vec Set(float v) { return _mm256_set1_ps(v); }
+        inline Vec Ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+        inline Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+        inline void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+        inline Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        inline Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        inline Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        inline Vec Div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+        inline Vec Min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+        inline Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+        inline Vec Sqrt(Vec v) { return _mm256_sqrt_ps(v); }
+        inline Vec Abs(Vec v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+        inline Vec RoundNearest(Vec v) { return _mm256_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        inline Mask Less(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        inline Mask Equal(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        inline Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        inline bool Any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return _mm256_blendv_ps(b, a, m); }
+
+        inline Vec Pow2(Vec n) {
+            __m256i biased = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+            return _mm256_castsi256_ps(_mm256_slli_epi32(biased, 23));
+        }
+
+        inline void SplitExponent(Vec x, Vec& mantissa, Vec& exponent) {
+            __m256i bits = _mm256_castps_si256(x);
+            exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+            bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000));
+            mantissa = _mm256_castsi256_ps(bits);
+        }
+
+        typedef __m256i Random;
+        inline Random LoadRandom(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        inline Vec NextRandom(Random& state) {
+            state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+            state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+            state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+            __m256i bits = _mm256_or_si256(_mm256_srli_epi32(state, 9), _mm256_set1_epi32(0x3F800000));
+            return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.0f));
+        }
+    }
+
+    namespace Avx2Double {
+        typedef __m256d Vec;
+        typedef __m256d Mask;
+        const size_t LANES = 4;
+
+        inline Vec Set(double v) { return _mm256_set1_pd(v); }
+        inline Vec Ramp() { return _mm256_setr_pd(0.0, 1.0, 2.0, 3.0); }
+        inline Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+        inline void Store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+        inline Vec Add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+        inline Vec Sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+        inline Vec Mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+        inline Mask Less(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        inline Mask Equal(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        inline Mask And(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+        inline Mask Or(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+        inline bool Any(Mask m) { return _mm256_movemask_pd(m) != 0; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return _mm256_blendv_pd(b, a, m); }
+        inline Vec Gather(const double* base, Vec index) {
+            return _mm256_i32gather_pd(base, _mm256_cvttpd_epi32(index), 8);
+        }
+    }
+FAV_END_TARGET
+
+// GCC reports the self-initialized _mm512_undefined_ps inside the unmasked intrinsics as
+// uninitialized once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+FAV_BEGIN_TARGET_AVX512
+    namespace Avx512 {
+        typedef __m512 Vec;
+        typedef __mmask16 Mask;
+        const size_t LANES = 16;
+
+        inline Vec Set(float v) { return _mm512_set1_ps(v); }
+        inline Vec Ramp() {
+            return _mm512_set_ps(15.0f, 14.0f, 13.0f, 12.0f, 11.0f, 10.0f, 9.0f, 8.0f, 7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+        }
+        inline Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+        inline void Store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+        inline Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        inline Vec Sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        inline Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        inline Vec Div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+        inline Vec Min(Vec a, Vec b) { return _mm512_min_ps(a, b); }
+        inline Vec Max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+        inline Vec Sqrt(Vec v) { return _mm512_sqrt_ps(v); }
+        inline Vec Abs(Vec v) { return _mm512_abs_ps(v); }
+        inline Vec RoundNearest(Vec v) { return _mm512_roundscale_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        inline Mask Less(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        inline Mask Equal(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+        inline Mask And(Mask a, Mask b) { return static_cast<Mask>(a & b); }
+        inline bool Any(Mask m) { return m != 0; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return _mm512_mask_blend_ps(m, b, a); }
+
+        inline Vec Pow2(Vec n) {
+            __m512i biased = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+            return _mm512_castsi512_ps(_mm512_slli_epi32(biased, 23));
+        }
+
+        inline void SplitExponent(Vec x, Vec& mantissa, Vec& exponent) {
+            __m512i bits = _mm512_castps_si512(x);
+            exponent = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+            bits = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3F800000));
+            mantissa = _mm512_castsi512_ps(bits);
+        }
+
+        typedef __m512i Random;
+        inline Random LoadRandom(const uint32_t* p) { return _mm512_loadu_si512(p); }
+        inline Vec NextRandom(Random& state) {
+            state = _mm512_xor_si512(state, _mm512_slli_epi32(state, 13));
+            state = _mm512_xor_si512(state, _mm512_srli_epi32(state, 17));
+            state = _mm512_xor_si512(state, _mm512_slli_epi32(state, 5));
+            __m512i bits = _mm512_or_si512(_mm512_srli_epi32(state, 9), _mm512_set1_epi32(0x3F800000));
+            return _mm512_sub_ps(_mm512_castsi512_ps(bits), _mm512_set1_ps(1.0f));
+        }
+    }
+
+    namespace Avx512Double {
+        typedef __m512d Vec;
+        typedef __mmask8 Mask;
+        const size_t LANES = 8;
+
+        inline Vec Set(double v) { return _mm512_set1_pd(v); }
+        inline Vec Ramp() { return _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0); }
+        inline Vec Load(const double* p) { return _mm512_loadu_pd(p); }
+        inline void Store(double* p, Vec v) { _mm512_storeu_pd(p, v); }
+        inline Vec Add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+        inline Vec Sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+        inline Vec Mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+        inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+        inline Mask Less(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        inline Mask Equal(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+        inline Mask And(Mask a, Mask b) { return static_cast<Mask>(a & b); }
+        inline Mask Or(Mask a, Mask b) { return static_cast<Mask>(a | b); }
+        inline bool Any(Mask m) { return m != 0; }
+        inline Vec Select(Mask m, Vec a, Vec b) { return _mm512_mask_blend_pd(m, b, a); }
+        inline Vec Gather(const double* base, Vec index) {
+            return _mm512_i32gather_pd(_mm512_cvttpd_epi32(index), base, 8);
+        }
+    }
+FAV_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+}
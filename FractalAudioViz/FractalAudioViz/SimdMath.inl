@@ -0,0 +1,102 @@
+// Vectorized math over the lanes of SimdLanes.h that the including namespace uses,
+// included ahead of a kernel source once per instruction set. The transcendental
+// functions are polynomial approximations, so every level computes them with the same
+// operations rather than each calling its own library. Nothing here may include headers
+// or call library math.
+
+inline Vec Negate(Vec v) {
+    return Sub(Set(0.0f), v);
+}
+
+inline Vec Floor(Vec v) {
+    Vec rounded = RoundNearest(v);
+    return Sub(rounded, Select(Less(v, rounded), Set(1.0f), Set(0.0f)));
+}
+
+// e^x (Cephes expf): 2^n times a polynomial on the remainder, |x - n ln 2| <= ln 2 / 2
+inline Vec Exp(Vec x) {
+    x = Min(Max(x, Set(-87.3f)), Set(88.3f));
+    Vec n = RoundNearest(Mul(x, Set(1.44269504f)));
+    x = Sub(x, Mul(n, Set(0.693359375f)));
+    x = Sub(x, Mul(n, Set(-2.12194440e-4f)));
+    Vec z = Mul(x, x);
+    Vec y = Set(1.9875691500e-4f);
+    y = MulAdd(y, x, Set(1.3981999507e-3f));
+    y = MulAdd(y, x, Set(8.3334519073e-3f));
+    y = MulAdd(y, x, Set(4.1665795894e-2f));
+    y = MulAdd(y, x, Set(1.6666665459e-1f));
+    y = MulAdd(y, x, Set(5.0000001201e-1f));
+    y = Add(MulAdd(y, z, x), Set(1.0f));
+    return Mul(y, Pow2(n));
+}
+
+// ln x (Cephes logf) for x > 0: the exponent, plus a polynomial on the mantissa taken
+// into [sqrt(1/2), sqrt(2)]
+inline Vec Log(Vec x) {
+    Vec mantissa, exponent;
+    SplitExponent(Max(x, Set(1e-30f)), mantissa, exponent);
+    Mask high = Less(Set(1.41421356f), mantissa);
+    mantissa = Select(high, Mul(mantissa, Set(0.5f)), mantissa);
+    exponent = Select(high, Add(exponent, Set(1.0f)), exponent);
+
+    Vec f = Sub(mantissa, Set(1.0f));
+    Vec z = Mul(f, f);
+    Vec y = Set(7.0376836292e-2f);
+    y = MulAdd(y, f, Set(-1.1514610310e-1f));
+    y = MulAdd(y, f, Set(1.1676998740e-1f));
+    y = MulAdd(y, f, Set(-1.2420140846e-1f));
+    y = MulAdd(y, f, Set(1.4249322787e-1f));
+    y = MulAdd(y, f, Set(-1.6668057665e-1f));
+    y = MulAdd(y, f, Set(2.0000714765e-1f));
+    y = MulAdd(y, f, Set(-2.4999993993e-1f));
+    y = MulAdd(y, f, Set(3.3333331174e-1f));
+    y = Mul(Mul(y, f), z);
+    y = Add(y, Mul(exponent, Set(-2.12194440e-4f)));
+    y = Sub(y, Mul(z, Set(0.5f)));
+    return Add(Add(f, y), Mul(exponent, Set(0.693359375f)));
+}
+
+// atan2 (Cephes atanf on min / max of the magnitudes, reduced to |t| <= tan(pi / 8))
+inline Vec Atan2(Vec y, Vec x) {
+    Vec ay = Abs(y), ax = Abs(x);
+    Vec t = Div(Min(ax, ay), Max(Max(ax, ay), Set(1e-30f)));
+    Mask reduce = Less(Set(0.4142135623f), t);
+    t = Select(reduce, Div(Sub(t, Set(1.0f)), Add(t, Set(1.0f))), t);
+    Vec z = Mul(t, t);
+    Vec p = Set(8.05374449538e-2f);
+    p = MulAdd(p, z, Set(-1.38776856032e-1f));
+    p = MulAdd(p, z, Set(1.99777106478e-1f));
+    p = MulAdd(p, z, Set(-3.33329491539e-1f));
+    Vec angle = Add(Mul(Mul(p, z), t), t);
+    angle = Add(angle, Select(reduce, Set(0.785398163f), Set(0.0f)));
+
+    angle = Select(Less(ax, ay), Sub(Set(1.570796327f), angle), angle);
+    angle = Select(Less(x, Set(0.0f)), Sub(Set(3.141592654f), angle), angle);
+    return Select(Less(y, Set(0.0f)), Negate(angle), angle);
+}
+
+// sin and cos (Cephes sinf / cosf): the argument less the nearest multiple of pi / 2 in
+// three exact parts, then the quadrant picks and signs the two polynomials
+inline void SinCos(Vec a, Vec& sine, Vec& cosine) {
+    Vec n = RoundNearest(Mul(a, Set(0.636619772f)));
+    Vec r = Sub(a, Mul(n, Set(1.5703125f)));
+    r = Sub(r, Mul(n, Set(4.837512969970703125e-4f)));
+    r = Sub(r, Mul(n, Set(7.54978995489188216e-8f)));
+    Vec z = Mul(r, r);
+
+    Vec s = Set(-1.9515295891e-4f);
+    s = MulAdd(s, z, Set(8.3321608736e-3f));
+    s = MulAdd(s, z, Set(-1.6666654611e-1f));
+    s = Add(Mul(Mul(s, z), r), r);
+    Vec c = Set(2.443315711809948e-5f);
+    c = MulAdd(c, z, Set(-1.388731625493765e-3f));
+    c = MulAdd(c, z, Set(4.166664568298827e-2f));
+    c = Add(Sub(Mul(Mul(c, z), z), Mul(z, Set(0.5f))), Set(1.0f));
+
+    Vec quadrant = Sub(n, Mul(Floor(Mul(n, Set(0.25f))), Set(4.0f)));
+    Mask odd = Equal(Sub(quadrant, Mul(Floor(Mul(quadrant, Set(0.5f))), Set(2.0f))), Set(1.0f));
+    sine = Select(odd, c, s);
+    cosine = Select(odd, s, c);
+    sine = Select(Less(Set(1.5f), quadrant), Negate(sine), sine);
+    cosine = Select(And(Less(Set(0.5f), quadrant), Less(quadrant, Set(2.5f))), Negate(cosine), cosine);
+}
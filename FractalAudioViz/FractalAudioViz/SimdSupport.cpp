@@ -0,0 +1,76 @@
+#include "SimdSupport.h"
+
+#if FAV_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+    SimdLevel DetectSimdLevel() {
+#if FAV_X86 && defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        bool sse2 = (info[3] & (1 << 26)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+
+        bool avx2 = false;
+        bool avx512 = false;
+        if (maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+            avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 17)) != 0; // F + DQ
+        }
+
+        // The OS must save the wider registers on context switches
+        bool osAvx = false;
+        bool osAvx512 = false;
+        if (osxsave) {
+            unsigned long long xcr0 = _xgetbv(0);
+            osAvx = (xcr0 & 0x6) == 0x6;
+            osAvx512 = (xcr0 & 0xE6) == 0xE6;
+        }
+
+        if (avx512 && avx2 && fma && osAvx512) return SimdLevel::AVX512;
+        if (avx2 && fma && osAvx) return SimdLevel::AVX2;
+        if (avx && osAvx) return SimdLevel::AVX;
+        if (sse2) return SimdLevel::SSE2;
+        return SimdLevel::Scalar;
+#elif FAV_X86
+        // __builtin_cpu_supports also checks that the OS enabled the registers
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+            __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("avx")) return SimdLevel::AVX;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+        return SimdLevel::Scalar;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+}
+
+SimdLevel GetSimdLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+SimdLevel ResolveSimdLevel(SimdLevel requested) {
+    SimdLevel supported = GetSimdLevel();
+    return requested < supported ? requested : supported;
+}
+
+const char* GetSimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::SSE2: return "sse2";
+    case SimdLevel::AVX: return "avx";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Instruction set support shared by the SIMD kernels (FFT, filterbank, fractal generators).
+// Kernels are compiled for every level and picked at runtime, so the executables run on
+// any x86 CPU and non-x86 builds fall back to the scalar paths.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FAV_X86 1
+#include <immintrin.h>
+#else
+#define FAV_X86 0
+#endif
+
+// GCC and Clang only emit AVX instructions inside functions marked for them;
+// MSVC accepts the intrinsics anywhere.
+#if FAV_X86 && (defined(__GNUC__) || defined(__clang__))
+#define FAV_TARGET_AVX __attribute__((target("avx")))
+#define FAV_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define FAV_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx2,fma")))
+#else
+#define FAV_TARGET_AVX
+#define FAV_TARGET_AVX2
+#define FAV_TARGET_AVX512
+#endif
+
+// The same for every function defined between BEGIN and END, templates included, so one
+// kernel source can be included once per level
+#if FAV_X86 && defined(__clang__)
+#define FAV_BEGIN_TARGET_AVX2 \
+    _Pragma("clang attribute push(__attribute__((target(\"avx2,fma\"))), apply_to = function)")
+#define FAV_BEGIN_TARGET_AVX512 \
+    _Pragma("clang attribute push(__attribute__((target(\"avx512f,avx512dq,avx2,fma\"))), apply_to = function)")
+#define FAV_END_TARGET _Pragma("clang attribute pop")
+#elif FAV_X86 && defined(__GNUC__)
+#define FAV_BEGIN_TARGET_AVX2 _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+#define FAV_BEGIN_TARGET_AVX512 _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f,avx512dq,avx2,fma\")")
+#define FAV_END_TARGET _Pragma("GCC pop_options")
+#else
+#define FAV_BEGIN_TARGET_AVX2
+#define FAV_BEGIN_TARGET_AVX512
+#define FAV_END_TARGET
+#endif
+
+// Ordered so a kernel can be chosen with "level >= X"
+enum class SimdLevel {
+    Scalar = 0,
+    SSE2 = 1,
+    AVX = 2,
+    AVX2 = 3,   // AVX2 + FMA
+    AVX512 = 4  // AVX-512 F + DQ
+};
+
+// Highest level supported by both the CPU and the OS (cached after the first call)
+SimdLevel GetSimdLevel();
+
+// Clamp a requested level to what this machine supports
+SimdLevel ResolveSimdLevel(SimdLevel requested);
+
+const char* GetSimdLevelName(SimdLevel level);
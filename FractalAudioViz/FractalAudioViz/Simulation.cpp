@@ -0,0 +1,384 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+
+Simulation::Simulation() :
+    sourceEnded(false),
+    framesRead(0),
+    audioFrameCount(0),
+    audioFramesOwed(0.0),
+    audioLevel(0.0f),
+    audioOnset(0.0f),
+    fractalDirty(false),
+    fractalVersion(0),
+    time(0.0),
+    frameStats(nullptr),
+    jobs(nullptr)
+{
+    audioFormat.sampleRate = 0;
+    audioFormat.channels = 0;
+}
+
+Simulation::~Simulation() {
+    Shutdown();
+}
+
+bool Simulation::Initialize(const SimulationSettings& simulationSettings, std::unique_ptr<AudioSource> source) {
+    Shutdown();
+    settings = simulationSettings;
+
+    if (!source) {
+        return false;
+    }
+
+    // Start audio on its own thread, or open it to be read in step with the updates
+    if (settings.liveAudio) {
+        if (!audioCapture.Start(std::move(source))) {
+            return false;
+        }
+        audioFormat = audioCapture.GetFormat();
+    }
+    else {
+        if (!source->Open()) {
+            return false;
+        }
+        steppedSource = std::move(source);
+        audioFormat = steppedSource->GetFormat();
+    }
+    sourceEnded = false;
+    framesRead = 0;
+    audioFramesOwed = 0.0;
+
+    // Scratch space for one fixed update worth of frames, allocated once up front
+    size_t framesPerUpdate = static_cast<size_t>(audioFormat.sampleRate * FIXED_TIMESTEP) + 1;
+    audioFrames.assign(framesPerUpdate * audioFormat.channels, 0.0f);
+    audioFrameCount = 0;
+
+    StftSettings spectrumSettings;
+    spectrumSettings.fftSize = settings.spectrumSize;
+    spectrumSettings.hopSize = settings.spectrumHop;
+    spectrumSettings.window = WindowFunction::Hann;
+
+    FilterbankSettings bandSettings;
+    bandSettings.scale = settings.bandScale;
+    bandSettings.bandCount = settings.bandCount;
+    bandSettings.sampleRate = audioFormat.sampleRate;
+    bandSettings.fftSize = spectrumSettings.fftSize;
+
+    if (!spectrum.Initialize(spectrumSettings) || !filterbank.Initialize(bandSettings)) {
+        return false;
+    }
+    filterbank.PrepareOutput(bandEnergies);
+
+    StftSettings onsetSpectrumSettings;
+    onsetSpectrumSettings.fftSize = settings.onsetSize;
+    onsetSpectrumSettings.hopSize = settings.onsetHop;
+    onsetSpectrumSettings.window = WindowFunction::Hann;
+    onsetSpectrumSettings.computePhase = false;
+    float onsetHopSeconds = static_cast<float>(onsetSpectrumSettings.hopSize) / audioFormat.sampleRate;
+
+    OnsetSettings onsetSettings;
+    onsetSettings.method = OnsetMethod::SpectralFlux;
+    onsetSettings.hopSeconds = onsetHopSeconds;
+
+    BeatTrackerSettings beatSettings;
+    beatSettings.hopSeconds = onsetHopSeconds;
+
+    if (!onsetSpectrum.Initialize(onsetSpectrumSettings) ||
+        !onsetDetector.Initialize(onsetSettings, onsetSpectrum.GetBinCount()) ||
+        !beatTracker.Initialize(beatSettings)) {
+        return false;
+    }
+
+    // The first fractal is built now so a renderer can upload it before the first frame
+    fractalSettings = settings.fractal;
+    if (!RebuildFractal()) {
+        return false;
+    }
+
+    scene = SceneState();
+    time = 0.0;
+    audioLevel = 0.0f;
+    audioOnset = 0.0f;
+    return modulation.Compile(CreateScenePatch(bandEnergies.GetBandCount()), bandEnergies.GetBandCount());
+}
+
+ModulationPatch Simulation::CreateScenePatch(size_t bandCount) {
+    ModulationPatch patch;
+    ModulationTarget rotation;
+    rotation.base = 15.0f;
+    rotation.integrate = true;
+    rotation.wrap = 360.0f;
+    patch.AddTargets(rotation);
+    ModulationTarget scale;
+    scale.base = 1.0f;
+    patch.AddTargets(scale);
+
+    size_t bassBands = bandCount / 8;
+    for (size_t band = 0; band < bassBands; ++band) {
+        ModulationRoute bass;
+        bass.source = ModulationSource::Band;
+        bass.sourceIndex = static_cast<uint32_t>(band);
+        bass.target = CUBE_SCALE_TARGET;
+        bass.depth = 0.25f / static_cast<float>(bassBands);
+        patch.routes.push_back(bass);
+    }
+
+    ModulationRoute kick;
+    kick.source = ModulationSource::BeatPhase;
+    kick.curve = ModulationCurve::Decay;
+    kick.via = ModulationSource::BeatConfidence;
+    kick.target = CUBE_SCALE_TARGET;
+    kick.depth = 0.15f;
+    patch.routes.push_back(kick);
+    return patch;
+}
+
+bool Simulation::SetModulationPatch(const ModulationPatch& patch) {
+    // The scene reads its targets by index: a rotation integrated and wrapped at 360
+    // degrees, then a plain scale
+    if (patch.targets.size() < SCENE_TARGET_COUNT) {
+        return false;
+    }
+    const ModulationTarget& rotation = patch.targets[CUBE_ROTATION_TARGET];
+    const ModulationTarget& scale = patch.targets[CUBE_SCALE_TARGET];
+    if (!rotation.integrate || rotation.wrap != 360.0f || scale.integrate) {
+        return false;
+    }
+    ModulationMatrix compiled;
+    if (!compiled.Compile(patch, bandEnergies.GetBandCount())) {
+        return false;
+    }
+    modulation = std::move(compiled);
+    return true;
+}
+
+void Simulation::Shutdown() {
+    audioCapture.Stop();
+    if (steppedSource) {
+        steppedSource->Close();
+        steppedSource.reset();
+    }
+}
+
+void Simulation::SetFractalSettings(const FractalSettings& fractal) {
+    fractalSettings = fractal;
+    fractalDirty = true;
+}
+
+void Simulation::SetCameraPath(const CameraPath& path) {
+    cameraPath = path;
+}
+
+void Simulation::SetViewport(float fieldOfView, float viewportHeight) {
+    settings.lod.fieldOfView = fieldOfView;
+    settings.lod.viewportHeight = viewportHeight;
+    fractalLod.SetViewport(fieldOfView, viewportHeight);
+}
+
+bool Simulation::RebuildFractal() {
+    fractalDirty = false;
+
+    // With level of detail, start again from the root cube and refine around the camera
+    bool built = settings.fractalLod ?
+        fractalLod.Initialize(fractalSettings, settings.lod) :
+        FractalGenerator::Generate(fractalSettings, fractalInstances, jobs);
+    if (!built) {
+        return false;
+    }
+    ++fractalVersion;
+    return true;
+}
+
+void Simulation::SkipAudio(double seconds) {
+    audioFramesOwed += audioFormat.sampleRate * seconds;
+    uint64_t frames = static_cast<uint64_t>(audioFramesOwed);
+    audioFramesOwed -= static_cast<double>(frames);
+
+    if (settings.liveAudio) {
+        audioCapture.Skip(static_cast<size_t>(frames));
+        return;
+    }
+
+    // Stepped: read and throw away, a timestep's scratch at a time
+    size_t capacity = audioFrames.size() / audioFormat.channels;
+    while (frames > 0 && !sourceEnded) {
+        size_t read = steppedSource->Read(audioFrames.data(), static_cast<size_t>(std::min<uint64_t>(frames, capacity)));
+        if (read == 0) {
+            sourceEnded = true;
+        }
+        framesRead += read;
+        frames -= read;
+    }
+}
+
+uint64_t Simulation::GetAudioFramesDelivered() const {
+    return settings.liveAudio ? audioCapture.GetFramesCaptured() : framesRead;
+}
+
+void Simulation::IngestAudio(float deltaTime) {
+    // Exactly one timestep of audio; the fraction of a frame left over carries forward
+    audioFramesOwed += audioFormat.sampleRate * static_cast<double>(deltaTime);
+    audioFrameCount = static_cast<size_t>(audioFramesOwed);
+    if (audioFrameCount > audioFrames.size() / audioFormat.channels) {
+        audioFrameCount = audioFrames.size() / audioFormat.channels;
+    }
+    audioFramesOwed -= static_cast<double>(audioFrameCount);
+
+    if (settings.liveAudio) {
+        // Lock-free, no allocation; underruns come back as silence
+        audioCapture.Consume(audioFrames.data(), audioFrameCount);
+        return;
+    }
+
+    // Stepped: read until the timestep is full, then silence once the source has ended
+    size_t filled = 0;
+    while (filled < audioFrameCount && !sourceEnded) {
+        size_t read = steppedSource->Read(&audioFrames[filled * audioFormat.channels], audioFrameCount - filled);
+        if (read == 0) {
+            sourceEnded = true;
+        }
+        filled += read;
+    }
+    framesRead += filled;
+    std::fill(audioFrames.begin() + filled * audioFormat.channels,
+        audioFrames.begin() + audioFrameCount * audioFormat.channels, 0.0f);
+}
+
+void Simulation::AnalyzeSpectrum() {
+    uint64_t start = FrameStats::Now();
+
+    // The update's overall level, in decibels mapped to 0..1 as the band levels are
+    size_t sampleCount = audioFrameCount * audioFormat.channels;
+    if (sampleCount > 0) {
+        double sumSquares = 0.0;
+        for (size_t i = 0; i < sampleCount; ++i) {
+            sumSquares += static_cast<double>(audioFrames[i]) * audioFrames[i];
+        }
+        float decibels = 10.0f * std::log10(static_cast<float>(sumSquares / sampleCount) + 1e-12f);
+        audioLevel = std::min(std::max(1.0f - decibels / bandEnergies.floorDb, 0.0f), 1.0f);
+    }
+
+    // Run the spectrum stage over the new audio, one analysis hop at a time
+    size_t analyzed = 0;
+    while (analyzed < audioFrameCount) {
+        analyzed += spectrum.Consume(&audioFrames[analyzed * audioFormat.channels],
+            audioFrameCount - analyzed, audioFormat.channels);
+
+        if (spectrum.HasNewFrame()) {
+            filterbank.Apply(spectrum.GetMagnitude(), bandEnergies);
+            bandEnergies.frame = spectrum.GetFrameCount();
+        }
+    }
+    costs.spectrum = FrameStats::Now() - start;
+}
+
+void Simulation::TrackBeats() {
+    uint64_t start = FrameStats::Now();
+
+    // Same audio through the onset detector and beat tracker, once per (shorter) hop
+    size_t analyzed = 0;
+    while (analyzed < audioFrameCount) {
+        analyzed += onsetSpectrum.Consume(&audioFrames[analyzed * audioFormat.channels],
+            audioFrameCount - analyzed, audioFormat.channels);
+
+        if (onsetSpectrum.HasNewFrame()) {
+            bool onset = onsetDetector.Process(onsetSpectrum.GetMagnitude(), nullptr);
+            beatTracker.Process(onsetDetector.GetValue(), onset, onsetDetector.GetStrength());
+            if (onset) {
+                audioOnset = std::max(audioOnset, onsetDetector.GetStrength());
+            }
+        }
+    }
+    costs.beatTracking = FrameStats::Now() - start;
+}
+
+void Simulation::UpdateCamera() {
+    uint64_t start = FrameStats::Now();
+
+    // Scripted camera, evaluated at the simulation clock
+    if (!cameraPath.IsEmpty()) {
+        scene.camera = cameraPath.Evaluate(time);
+    }
+    costs.camera = FrameStats::Now() - start;
+}
+
+void Simulation::UpdateFractal() {
+    uint64_t start = FrameStats::Now();
+
+    // Regenerate the fractal after a depth or type change
+    if (fractalDirty) {
+        RebuildFractal();
+    }
+
+    // Refine toward the camera and merge away from it. The fractal is placed by the
+    // cube's scale and rotation about y, so undo them to get the eye in its own space.
+    if (settings.fractalLod) {
+        const float* position = scene.camera.position;
+        float angle = scene.cubeRotationY * 0.0174532925f;
+        float c = std::cos(angle);
+        float s = std::sin(angle);
+        float eye[3] = {
+            (position[0] * c - position[2] * s) / scene.cubeScale,
+            position[1] / scene.cubeScale,
+            (position[0] * s + position[2] * c) / scene.cubeScale
+        };
+        if (fractalLod.Update(eye)) {
+            ++fractalVersion;
+        }
+    }
+    costs.fractal = FrameStats::Now() - start;
+}
+
+void Simulation::Animate(float deltaTime) {
+    // The cube's turn and pulse, and whatever else the patch drives, from this update's
+    // analysis
+    ModulationInputs inputs;
+    inputs.bands = &bandEnergies;
+    inputs.beat = &beatTracker.GetState();
+    inputs.level = audioLevel;
+    inputs.onset = audioOnset;
+    modulation.Evaluate(inputs, deltaTime);
+    audioOnset = 0.0f;
+    scene.cubeRotationY = modulation.GetValue(CUBE_ROTATION_TARGET);
+    scene.cubeScale = modulation.GetValue(CUBE_SCALE_TARGET);
+}
+
+void Simulation::Update(float deltaTime) {
+    uint64_t start = FrameStats::Now();
+    IngestAudio(deltaTime);
+    costs.audioIngest = FrameStats::Now() - start;
+
+    time += deltaTime;
+
+    if (jobs) {
+        // The frame as a graph: the stages under one parent, the fractal starting once the
+        // camera has moved, and the animation as the parent's continuation
+        Simulation* simulation = this;
+        Job* stages = jobs->CreateJob([]() {});
+        jobs->Run(jobs->CreateChildJob(stages, [simulation]() { simulation->AnalyzeSpectrum(); }));
+        jobs->Run(jobs->CreateChildJob(stages, [simulation]() { simulation->TrackBeats(); }));
+
+        Job* camera = jobs->CreateChildJob(stages, [simulation]() { simulation->UpdateCamera(); });
+        Job* fractal = jobs->CreateChildJob(stages, [simulation]() { simulation->UpdateFractal(); });
+        jobs->AddContinuation(camera, fractal);
+        jobs->Run(camera);
+
+        Job* animate = jobs->CreateJob([simulation, deltaTime]() { simulation->Animate(deltaTime); });
+        jobs->AddContinuation(stages, animate);
+        jobs->Run(stages);
+        jobs->Wait(animate);
+    }
+    else {
+        AnalyzeSpectrum();
+        TrackBeats();
+        UpdateCamera();
+        UpdateFractal();
+        Animate(deltaTime);
+    }
+
+    if (frameStats) {
+        frameStats->AddPhaseTime(FramePhase::AudioAnalysis, costs.audioIngest + costs.spectrum + costs.beatTracking);
+        frameStats->AddPhaseTime(FramePhase::SceneBuild, costs.fractal);
+    }
+}
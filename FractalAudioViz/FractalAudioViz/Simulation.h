@@ -0,0 +1,208 @@
+#pragma once
+
+#include "AudioCapture.h"
+#include "BeatTracker.h"
+#include "CameraPath.h"
+#include "Filterbank.h"
+#include "FractalGenerator.h"
+#include "FractalLod.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "ModulationMatrix.h"
+#include "OnsetDetector.h"
+#include "STFT.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Game timing constants
+constexpr float FIXED_TIMESTEP = 1.0f / 60.0f; // 60 updates per second
+
+struct SimulationSettings {
+    // Live audio runs the source on a capture thread at the audio rate, as the window
+    // does. Otherwise each update pulls exactly its share of frames from the source on
+    // the calling thread, so a run is a pure function of the source and the timesteps.
+    bool liveAudio;
+
+    size_t spectrumSize;   // Long window for band energies
+    size_t spectrumHop;
+    BandScale bandScale;
+    size_t bandCount;
+    size_t onsetSize;      // Short window for onsets and beats
+    size_t onsetHop;
+
+    FractalSettings fractal;
+
+    // Refine the fractal per subtree around the camera instead of to a fixed depth
+    // (fractal.depth is then the deepest it goes)
+    bool fractalLod;
+    FractalLodSettings lod;
+
+    SimulationSettings() :
+        liveAudio(true),
+        spectrumSize(4096),
+        spectrumHop(1024),
+        bandScale(BandScale::Mel),
+        bandCount(64),
+        onsetSize(1024),
+        onsetHop(256),
+        fractalLod(false)
+    {
+        // Depth 3 Menger sponge (8000 instances) filling the cube's -1..1 bounds
+        fractal.type = FractalType::MengerSponge;
+        fractal.depth = 3;
+        fractal.halfExtent = 1.0f;
+    }
+};
+
+// What the renderer needs from the simulation each frame
+struct SceneState {
+    CameraPose camera;
+    float cubeRotationY;  // Degrees, as Cube takes them
+    float cubeScale;      // Uniform pulse from the bass bands and the beat
+
+    SceneState() : cubeRotationY(0.0f), cubeScale(1.0f) {}
+};
+
+// Nanoseconds each subsystem took in the last Update (work time, on whichever thread)
+struct SimulationCosts {
+    uint64_t audioIngest;
+    uint64_t spectrum;      // STFT and filterbank
+    uint64_t beatTracking;  // Onset STFT, detector and tracker
+    uint64_t camera;
+    uint64_t fractal;       // Instance regeneration, 0 on most updates
+
+    SimulationCosts() : audioIngest(0), spectrum(0), beatTracking(0), camera(0), fractal(0) {}
+};
+
+// Everything that advances per fixed timestep, with no window or device: audio ingest
+// and analysis, the camera script, fractal generation and the cube's animation.
+// GameWindow drives it from the message loop; the benchmark drives it headless. Results
+// are the same with or without a job system.
+class Simulation {
+private:
+    SimulationSettings settings;
+
+    // Audio ingest: a capture thread (live) or the source itself (stepped), plus one
+    // fixed timestep worth of drained frames
+    AudioCapture audioCapture;
+    std::unique_ptr<AudioSource> steppedSource;
+    bool sourceEnded;
+    uint64_t framesRead;        // From the stepped source
+    AudioFormat audioFormat;
+    std::vector<float> audioFrames;
+    size_t audioFrameCount;
+    double audioFramesOwed;
+
+    // Spectrum analysis of the drained audio, reduced to perceptual bands
+    STFT spectrum;
+    Filterbank filterbank;
+    BandEnergies bandEnergies;
+
+    // Onsets and beat phase, from a short-window spectrum of its own so detection latency
+    // isn't tied to the long analysis window above
+    STFT onsetSpectrum;
+    OnsetDetector onsetDetector;
+    BeatTracker beatTracker;
+
+    // Audio features to scene parameters, through the modulation patch; the level is the
+    // update's RMS, mapped to 0..1 as band levels are, and the onset the strongest across
+    // the update's hops, latched by TrackBeats until Animate hands it on
+    ModulationMatrix modulation;
+    float audioLevel;
+    float audioOnset;
+
+    FractalSettings fractalSettings;
+    FractalInstances fractalInstances;
+    FractalLod fractalLod;
+    bool fractalDirty;
+    uint64_t fractalVersion;
+
+    CameraPath cameraPath;
+    SceneState scene;
+    double time;
+
+    SimulationCosts costs;
+    FrameStats* frameStats;
+    JobSystem* jobs;
+
+    // Update stages. With a job system, ingest runs first on the calling thread, then
+    // spectrum, beats and camera run as sibling jobs, the fractal (whose detail follows
+    // the camera) once the camera is done, and Animate (which needs both analyses) runs
+    // as the continuation of them all.
+    void IngestAudio(float deltaTime);
+    void AnalyzeSpectrum();
+    void TrackBeats();
+    void UpdateCamera();
+    void UpdateFractal();
+    void Animate(float deltaTime);
+    bool RebuildFractal();
+
+public:
+    Simulation();
+    ~Simulation();
+
+    bool Initialize(const SimulationSettings& simulationSettings, std::unique_ptr<AudioSource> source);
+    void Shutdown();
+
+    // Advance by one timestep
+    void Update(float deltaTime);
+
+    // Drop this much audio unanalyzed, as when the loop skips updates after a stall,
+    // keeping the fraction of a frame owed the same way Update does
+    void SkipAudio(double seconds);
+
+    // Frames the source has delivered. Live, the capture thread's count: the only clock
+    // an AudioTimeline can follow. Stepped, those the updates have read so far, which
+    // only move when the timeline steps; following them would chase its own tail.
+    uint64_t GetAudioFramesDelivered() const;
+
+    // Fractal edits take effect (and bump the version) on the next Update
+    const FractalSettings& GetFractalSettings() const { return fractalSettings; }
+    void SetFractalSettings(const FractalSettings& fractal);
+    const FractalInstances& GetFractalInstances() const {
+        return settings.fractalLod ? fractalLod.GetInstances() : fractalInstances;
+    }
+    uint64_t GetFractalVersion() const { return fractalVersion; }
+
+    // Level of detail state, when it's on; the viewport sets how big a cube looks
+    const FractalLodStats& GetFractalLodStats() const { return fractalLod.GetStats(); }
+    void SetViewport(float fieldOfView, float viewportHeight);
+
+    // With a path set the camera follows it; otherwise the pose is whatever was last set
+    void SetCameraPath(const CameraPath& path);
+    bool HasCameraPath() const { return !cameraPath.IsEmpty(); }
+    void SetCameraPose(const CameraPose& pose) { scene.camera = pose; }
+
+    // Targets every modulation patch starts with, which the scene reads back each update
+    static const uint32_t CUBE_ROTATION_TARGET = 0;     // Degrees, integrated from degrees per second
+    static const uint32_t CUBE_SCALE_TARGET = 1;
+    static const uint32_t SCENE_TARGET_COUNT = 2;
+
+    // The scene's own routing: a 15 degree per second turn, and a pulse from the lowest
+    // eighth of the bands plus a kick on each beat that decays over it, scaled by how sure
+    // the tracker is. Patches add their targets and routes after these.
+    static ModulationPatch CreateScenePatch(size_t bandCount);
+
+    // Replace the routing (after Initialize); false, keeping the old one, if it doesn't
+    // start with the scene's targets (a rotation integrated and wrapped at 360, then a
+    // scale that isn't integrated) or doesn't compile against the bands
+    bool SetModulationPatch(const ModulationPatch& patch);
+    const ModulationMatrix& GetModulation() const { return modulation; }
+
+    const SceneState& GetScene() const { return scene; }
+    const BandEnergies& GetBandEnergies() const { return bandEnergies; }
+    const BeatState& GetBeatState() const { return beatTracker.GetState(); }
+    AudioFormat GetAudioFormat() const { return audioFormat; }
+    double GetTime() const { return time; }
+
+    // True once a stepped finite source has run out (updates then see silence)
+    bool IsAudioFinished() const { return settings.liveAudio ? audioCapture.IsFinished() : sourceEnded; }
+
+    // Per-subsystem cost of the last Update; also added to frame phases if stats are set
+    const SimulationCosts& GetCosts() const { return costs; }
+    void SetFrameStats(FrameStats* stats) { frameStats = stats; }
+
+    // Run each update as a task graph on these threads (nullptr = all on the caller)
+    void SetJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+};
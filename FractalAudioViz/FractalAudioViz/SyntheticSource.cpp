@@ -0,0 +1,99 @@
+#include "SyntheticSource.h"
+#include <cmath>
+
+namespace {
+    const double TWO_PI = 6.283185307179586;
+
+    // Click shape: 2 ms exponentially decaying burst
+    const double CLICK_SECONDS = 0.002;
+    const double CLICK_FREQUENCY = 2000.0;
+}
+
+SyntheticSource::SyntheticSource(const SyntheticSettings& synthSettings) :
+    settings(synthSettings),
+    framePosition(0),
+    totalFrames(0),
+    phase(0.0),
+    noiseState(synthSettings.seed)
+{}
+
+bool SyntheticSource::Open() {
+    if (settings.sampleRate <= 0 || settings.channels <= 0) {
+        return false;
+    }
+
+    framePosition = 0;
+    phase = 0.0;
+    noiseState = settings.seed ? settings.seed : 1u;
+    totalFrames = static_cast<uint64_t>(settings.durationSeconds * settings.sampleRate);
+    return true;
+}
+
+AudioFormat SyntheticSource::GetFormat() const {
+    AudioFormat format;
+    format.sampleRate = settings.sampleRate;
+    format.channels = settings.channels;
+    return format;
+}
+
+float SyntheticSource::NextSample() {
+    const double t = static_cast<double>(framePosition) / settings.sampleRate;
+    double value = 0.0;
+
+    switch (settings.signal) {
+    case SyntheticSignal::Sine:
+        value = std::sin(phase);
+        phase += TWO_PI * settings.frequency / settings.sampleRate;
+        break;
+
+    case SyntheticSignal::Sweep: {
+        // Exponential sweep, restarting every sweepSeconds
+        double period = settings.sweepSeconds > 0.0f ? settings.sweepSeconds : 1.0;
+        double local = std::fmod(t, period) / period;
+        double freq = settings.frequency * std::pow(settings.sweepEndFrequency / settings.frequency, local);
+        value = std::sin(phase);
+        phase += TWO_PI * freq / settings.sampleRate;
+        break;
+    }
+
+    case SyntheticSignal::WhiteNoise:
+        // xorshift32
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        value = (noiseState * (1.0 / 4294967296.0)) * 2.0 - 1.0;
+        break;
+
+    case SyntheticSignal::ClickTrack: {
+        double beatPeriod = 60.0 / settings.tempoBpm;
+        double sinceBeat = std::fmod(t, beatPeriod);
+        if (sinceBeat < CLICK_SECONDS * 4.0) {
+            value = std::sin(TWO_PI * CLICK_FREQUENCY * sinceBeat) * std::exp(-sinceBeat / CLICK_SECONDS);
+        }
+        break;
+    }
+    }
+
+    // Keep the oscillator phase bounded so precision doesn't degrade over long runs
+    if (phase > TWO_PI) phase -= TWO_PI;
+
+    return static_cast<float>(value * settings.amplitude);
+}
+
+size_t SyntheticSource::Read(float* frames, size_t frameCount) {
+    if (totalFrames > 0) {
+        uint64_t remaining = totalFrames - framePosition;
+        if (frameCount > remaining) frameCount = static_cast<size_t>(remaining);
+    }
+
+    const int channels = settings.channels;
+    for (size_t i = 0; i < frameCount; ++i) {
+        float sample = NextSample();
+        for (int c = 0; c < channels; ++c) {
+            frames[i * channels + c] = sample;
+        }
+        ++framePosition;
+    }
+
+    return frameCount;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "AudioSource.h"
+#include <cstdint>
+
+// Kinds of test signal the synthetic source can generate
+enum class SyntheticSignal {
+    Sine,       // Constant tone at frequency
+    Sweep,      // Logarithmic sweep from frequency to sweepEndFrequency over sweepSeconds
+    WhiteNoise, // Uniform white noise
+    ClickTrack  // Short decaying clicks at tempoBpm
+};
+
+struct SyntheticSettings {
+    SyntheticSignal signal;
+    int sampleRate;
+    int channels;
+    float amplitude;
+    float frequency;
+    float sweepEndFrequency;
+    float sweepSeconds;
+    float tempoBpm;
+    double durationSeconds; // 0 = endless
+    uint32_t seed;
+
+    SyntheticSettings() :
+        signal(SyntheticSignal::Sine),
+        sampleRate(48000),
+        channels(2),
+        amplitude(0.5f),
+        frequency(440.0f),
+        sweepEndFrequency(8000.0f),
+        sweepSeconds(10.0f),
+        tempoBpm(120.0f),
+        durationSeconds(0.0),
+        seed(0x12345678u)
+    {}
+};
+
+// Deterministic signal generator, used to drive the pipeline without any audio hardware
+class SyntheticSource : public AudioSource {
+private:
+    SyntheticSettings settings;
+    uint64_t framePosition;
+    uint64_t totalFrames;
+    double phase;
+    uint32_t noiseState;
+
+    float NextSample();
+
+public:
+    explicit SyntheticSource(const SyntheticSettings& settings = SyntheticSettings());
+
+    bool Open() override;
+    void Close() override {}
+    AudioFormat GetFormat() const override;
+    size_t Read(float* frames, size_t frameCount) override;
+
+    const SyntheticSettings& GetSettings() const { return settings; }
+};
@@ -0,0 +1,133 @@
+#include "UploadArena.h"
+#include <cstring>
+
+UploadArena::UploadArena() :
+    target(nullptr),
+    fence(nullptr),
+    capacity(0),
+    alignment(1),
+    head(0),
+    tail(0),
+    needsDiscard(true),
+    frameStart(0),
+    frameCount(0)
+{}
+
+bool UploadArena::Initialize(UploadTarget* uploadTarget, UploadFence* uploadFence, size_t byteAlignment) {
+    if (!uploadTarget || !uploadFence || byteAlignment == 0 || (byteAlignment & (byteAlignment - 1)) != 0) {
+        return false;
+    }
+
+    size_t size = uploadTarget->GetSize();
+    if (size < byteAlignment || size % byteAlignment != 0) {
+        return false;
+    }
+
+    target = uploadTarget;
+    fence = uploadFence;
+    capacity = size;
+    alignment = byteAlignment;
+    frames.assign(MAX_FRAMES_IN_FLIGHT, FrameMark());
+    frameStart = 0;
+    frameCount = 0;
+    head = 0;
+    tail = 0;
+
+    // Nothing has been written yet, so the first map may as well discard
+    needsDiscard = true;
+    stats = UploadArenaStats();
+    return true;
+}
+
+void UploadArena::Shutdown() {
+    target = nullptr;
+    fence = nullptr;
+    capacity = 0;
+    frameCount = 0;
+}
+
+void UploadArena::Retire() {
+    // The tail only moves to the end of a finished frame, never into the current one
+    uint64_t completed = fence->GetCompletedValue();
+    while (frameCount > 0 && frames[frameStart].fence <= completed) {
+        tail = frames[frameStart].end;
+        frameStart = (frameStart + 1) % frames.size();
+        --frameCount;
+    }
+}
+
+void UploadArena::BeginFrame() {
+    if (target) {
+        Retire();
+    }
+}
+
+void UploadArena::EndFrame() {
+    if (!target) {
+        return;
+    }
+
+    FrameMark mark;
+    mark.fence = fence->Signal();
+    mark.end = head;
+
+    if (frameCount == frames.size()) {
+        // Out of marks: fold this frame into the newest one. Its memory then comes back
+        // a frame later than it could have, which is harmless.
+        frames[(frameStart + frameCount - 1) % frames.size()] = mark;
+        return;
+    }
+
+    frames[(frameStart + frameCount) % frames.size()] = mark;
+    ++frameCount;
+}
+
+bool UploadArena::Upload(const void* data, size_t size, size_t& offset) {
+    if (!target || size == 0 || size > capacity) {
+        ++stats.failures;
+        return false;
+    }
+
+    size_t alignedSize = (size + alignment - 1) & ~(alignment - 1);
+
+    // Aligned start; allocations never straddle the end of the buffer
+    uint64_t start = (head + alignment - 1) & ~static_cast<uint64_t>(alignment - 1);
+    if (start % capacity + alignedSize > capacity) {
+        start += capacity - start % capacity;
+    }
+
+    // Past the oldest in-flight byte: see if the GPU has caught up, otherwise discard
+    UploadMapMode mode = needsDiscard ? UploadMapMode::Discard : UploadMapMode::NoOverwrite;
+    if (start + alignedSize - tail > capacity) {
+        Retire();
+        if (start + alignedSize - tail > capacity) {
+            mode = UploadMapMode::Discard;
+        }
+    }
+
+    if (mode == UploadMapMode::Discard) {
+        // Fresh buffer: restart at offset zero with nothing in flight in it
+        if (!needsDiscard) ++stats.discards;
+        start = head + (capacity - head % capacity) % capacity;
+        tail = start;
+        frameCount = 0;
+        needsDiscard = false;
+    }
+
+    uint8_t* mapped = target->Map(mode);
+    ++stats.maps;
+    if (!mapped) {
+        ++stats.failures;
+        return false;
+    }
+
+    offset = static_cast<size_t>(start % capacity);
+    std::memcpy(mapped + offset, data, size);
+    target->Unmap();
+
+    stats.bytesWasted += (start - head) + (alignedSize - size);
+    stats.bytesAllocated += size;
+    ++stats.allocations;
+    head = start + alignedSize;
+    return true;
+}
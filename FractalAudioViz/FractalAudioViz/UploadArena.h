@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How a mapping may treat the buffer's existing contents
+enum class UploadMapMode {
+    NoOverwrite, // Caller promises not to touch ranges the GPU may still read
+    Discard      // Contents are thrown away; the driver hands back fresh memory
+};
+
+// A CPU-writable GPU buffer, as the arena sees it. DXRenderer wraps a dynamic D3D11
+// buffer; tests and benchmarks use plain memory.
+class UploadTarget {
+public:
+    virtual ~UploadTarget() {}
+
+    virtual size_t GetSize() const = 0;
+    virtual uint8_t* Map(UploadMapMode mode) = 0;
+    virtual void Unmap() = 0;
+};
+
+// Monotonic GPU progress marker. Signal is called once at the end of each frame's
+// submission; GetCompletedValue returns the highest signaled value the GPU has finished.
+class UploadFence {
+public:
+    virtual ~UploadFence() {}
+
+    virtual uint64_t Signal() = 0;
+    virtual uint64_t GetCompletedValue() = 0;
+};
+
+struct UploadArenaStats {
+    uint64_t allocations;
+    uint64_t bytesAllocated;
+    uint64_t bytesWasted;   // Alignment padding and skipped tails at wrap-around
+    uint64_t maps;
+    uint64_t discards;      // Wraps onto memory the GPU hadn't released
+    uint64_t failures;      // Requests larger than the buffer
+
+    UploadArenaStats() : allocations(0), bytesAllocated(0), bytesWasted(0), maps(0), discards(0), failures(0) {}
+};
+
+// Linear sub-allocator over one dynamic buffer, used as a ring across frames.
+//
+// Each upload maps with NoOverwrite and appends after the previous one. Ranges are
+// handed back a whole frame at a time once the fence shows the GPU is past that frame.
+// If the ring runs into memory that's still in flight, the arena maps with Discard
+// instead of waiting: the driver renames the buffer, everything in flight stays valid in
+// the old copy, and the arena starts over at offset zero.
+class UploadArena {
+private:
+    struct FrameMark {
+        uint64_t fence;
+        uint64_t end;  // Ring position after the frame's last allocation
+    };
+
+    UploadTarget* target;
+    UploadFence* fence;
+    size_t capacity;
+    size_t alignment;
+
+    // Positions grow monotonically; offset in the buffer = position % capacity
+    uint64_t head;
+    uint64_t tail;
+    bool needsDiscard;
+
+    std::vector<FrameMark> frames;  // In-flight frames, oldest first, fixed capacity
+    size_t frameStart;
+    size_t frameCount;
+
+    UploadArenaStats stats;
+
+    void Retire();
+
+public:
+    // In-flight frames tracked before the oldest marks are merged
+    static const size_t MAX_FRAMES_IN_FLIGHT = 16;
+
+    UploadArena();
+
+    // alignment must be a power of two (256 for constant buffer offsets)
+    bool Initialize(UploadTarget* target, UploadFence* fence, size_t alignment);
+    void Shutdown();
+
+    // Release memory the GPU has finished with; call at the start of each frame
+    void BeginFrame();
+
+    // Mark the end of the frame's allocations and signal the fence
+    void EndFrame();
+
+    // Copy size bytes into the buffer; writes the byte offset of the copy to offset.
+    // Fails only if size exceeds the buffer.
+    bool Upload(const void* data, size_t size, size_t& offset);
+
+    size_t GetCapacity() const { return capacity; }
+    size_t GetAlignment() const { return alignment; }
+
+    // Bytes between the oldest in-flight allocation and the write position
+    size_t GetBytesInFlight() const { return static_cast<size_t>(head - tail); }
+    size_t GetFramesInFlight() const { return frameCount; }
+    const UploadArenaStats& GetStats() const { return stats; }
+    void ResetStats() { stats = UploadArenaStats(); }
+};
@@ -0,0 +1,321 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float POSITION_LEVELS = 65535.0f;
+    const float COLOR_LEVELS = 255.0f;
+    const float NORMAL_LEVELS = 32767.0f;
+
+    // Keeps a zero normal from dividing by zero; it encodes as +z
+    const float MIN_NORMAL_LENGTH = 1e-20f;
+
+    struct PackConstants {
+        float origin[3];
+        float inverseStep;
+        uint32_t defaultNormal;  // Encoded +z, for meshes without normals
+    };
+
+    // Every path multiplies, clamps, then adds the rounding half, in that order, so no
+    // multiply-add can be fused differently between the scalar and SIMD code
+    uint32_t QuantizeUnorm(float value, float scale, float levels) {
+        float t = std::min(std::max(value * scale, 0.0f), levels) + 0.5f;
+        return static_cast<uint32_t>(t);
+    }
+
+    int32_t QuantizeSnorm(float value) {
+        float t = std::min(std::max(value * NORMAL_LEVELS, -NORMAL_LEVELS), NORMAL_LEVELS);
+        t += t >= 0.0f ? 0.5f : -0.5f;
+        return static_cast<int32_t>(t);
+    }
+
+    uint32_t EncodeNormalWord(float x, float y, float z) {
+        float length = std::max(std::fabs(x) + std::fabs(y) + std::fabs(z), MIN_NORMAL_LENGTH);
+        float u = x / length;
+        float v = y / length;
+
+        // The lower half folds over the diagonals onto the corners of the square
+        if (z < 0.0f) {
+            float foldedU = 1.0f - std::fabs(v);
+            float foldedV = 1.0f - std::fabs(u);
+            u = u >= 0.0f ? foldedU : -foldedU;
+            v = v >= 0.0f ? foldedV : -foldedV;
+        }
+        return (static_cast<uint32_t>(QuantizeSnorm(u)) & 0xFFFF) | (static_cast<uint32_t>(QuantizeSnorm(v)) << 16);
+    }
+
+    void PackScalar(const MeshVertex* vertices, const float* normals, size_t first, size_t end,
+        const PackConstants& constants, PackedVertex* out) {
+        for (size_t i = first; i < end; ++i) {
+            const MeshVertex& vertex = vertices[i];
+            PackedVertex& packed = out[i];
+            packed.x = static_cast<uint16_t>(QuantizeUnorm(vertex.x - constants.origin[0], constants.inverseStep, POSITION_LEVELS));
+            packed.y = static_cast<uint16_t>(QuantizeUnorm(vertex.y - constants.origin[1], constants.inverseStep, POSITION_LEVELS));
+            packed.z = static_cast<uint16_t>(QuantizeUnorm(vertex.z - constants.origin[2], constants.inverseStep, POSITION_LEVELS));
+            packed.w = 0;
+            packed.color = QuantizeUnorm(vertex.r, COLOR_LEVELS, COLOR_LEVELS) |
+                (QuantizeUnorm(vertex.g, COLOR_LEVELS, COLOR_LEVELS) << 8) |
+                (QuantizeUnorm(vertex.b, COLOR_LEVELS, COLOR_LEVELS) << 16) |
+                (QuantizeUnorm(vertex.a, COLOR_LEVELS, COLOR_LEVELS) << 24);
+
+            uint32_t normal = normals ? EncodeNormalWord(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2])
+                : constants.defaultNormal;
+            packed.normalU = static_cast<int16_t>(normal & 0xFFFF);
+            packed.normalV = static_cast<int16_t>(normal >> 16);
+        }
+    }
+
+#if FAV_X86
+    // Four vertices at a time: fields are gathered into lanes, quantized exactly as the
+    // scalar path does, then the four 32-bit words of each vertex are transposed back
+    __m128i QuantizeUnormSSE(__m128 value, __m128 scale, __m128 levels) {
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale), _mm_setzero_ps()), levels);
+        return _mm_cvttps_epi32(_mm_add_ps(t, _mm_set1_ps(0.5f)));
+    }
+
+    __m128i QuantizeSnormSSE(__m128 value) {
+        __m128 levels = _mm_set1_ps(NORMAL_LEVELS);
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, levels), _mm_sub_ps(_mm_setzero_ps(), levels)), levels);
+        __m128 positive = _mm_cmpge_ps(t, _mm_setzero_ps());
+        __m128 half = _mm_or_ps(_mm_and_ps(positive, _mm_set1_ps(0.5f)), _mm_andnot_ps(positive, _mm_set1_ps(-0.5f)));
+        return _mm_cvttps_epi32(_mm_add_ps(t, half));
+    }
+
+    __m128i EncodeNormalSSE(__m128 x, __m128 y, __m128 z) {
+        __m128 signBit = _mm_set1_ps(-0.0f);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 length = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBit, x), _mm_andnot_ps(signBit, y)),
+            _mm_andnot_ps(signBit, z)), _mm_set1_ps(MIN_NORMAL_LENGTH));
+        __m128 u = _mm_div_ps(x, length);
+        __m128 v = _mm_div_ps(y, length);
+
+        __m128 foldedU = _mm_sub_ps(one, _mm_andnot_ps(signBit, v));
+        __m128 foldedV = _mm_sub_ps(one, _mm_andnot_ps(signBit, u));
+        foldedU = _mm_xor_ps(foldedU, _mm_andnot_ps(_mm_cmpge_ps(u, zero), signBit));
+        foldedV = _mm_xor_ps(foldedV, _mm_andnot_ps(_mm_cmpge_ps(v, zero), signBit));
+        __m128 lower = _mm_cmplt_ps(z, zero);
+        u = _mm_or_ps(_mm_and_ps(lower, foldedU), _mm_andnot_ps(lower, u));
+        v = _mm_or_ps(_mm_and_ps(lower, foldedV), _mm_andnot_ps(lower, v));
+
+        return _mm_or_si128(_mm_and_si128(QuantizeSnormSSE(u), _mm_set1_epi32(0xFFFF)),
+            _mm_slli_epi32(QuantizeSnormSSE(v), 16));
+    }
+
+    void PackSSE(const MeshVertex* vertices, const float* normals, size_t count,
+        const PackConstants& constants, PackedVertex* out) {
+        __m128 inverseStep = _mm_set1_ps(constants.inverseStep);
+        __m128 positionLevels = _mm_set1_ps(POSITION_LEVELS);
+        __m128 colorLevels = _mm_set1_ps(COLOR_LEVELS);
+        __m128 originX = _mm_set1_ps(constants.origin[0]);
+        __m128 originY = _mm_set1_ps(constants.origin[1]);
+        __m128 originZ = _mm_set1_ps(constants.origin[2]);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const MeshVertex* v = vertices + i;
+            __m128i qx = QuantizeUnormSSE(_mm_sub_ps(_mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x), originX), inverseStep, positionLevels);
+            __m128i qy = QuantizeUnormSSE(_mm_sub_ps(_mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y), originY), inverseStep, positionLevels);
+            __m128i qz = QuantizeUnormSSE(_mm_sub_ps(_mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z), originZ), inverseStep, positionLevels);
+            __m128i r = QuantizeUnormSSE(_mm_setr_ps(v[0].r, v[1].r, v[2].r, v[3].r), colorLevels, colorLevels);
+            __m128i g = QuantizeUnormSSE(_mm_setr_ps(v[0].g, v[1].g, v[2].g, v[3].g), colorLevels, colorLevels);
+            __m128i b = QuantizeUnormSSE(_mm_setr_ps(v[0].b, v[1].b, v[2].b, v[3].b), colorLevels, colorLevels);
+            __m128i a = QuantizeUnormSSE(_mm_setr_ps(v[0].a, v[1].a, v[2].a, v[3].a), colorLevels, colorLevels);
+
+            __m128i normal;
+            if (normals) {
+                const float* n = normals + i * 3;
+                normal = EncodeNormalSSE(_mm_setr_ps(n[0], n[3], n[6], n[9]), _mm_setr_ps(n[1], n[4], n[7], n[10]),
+                    _mm_setr_ps(n[2], n[5], n[8], n[11]));
+            }
+            else {
+                normal = _mm_set1_epi32(static_cast<int>(constants.defaultNormal));
+            }
+
+            __m128i word0 = _mm_or_si128(qx, _mm_slli_epi32(qy, 16));
+            __m128i word1 = qz;
+            __m128i word2 = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+            __m128i word3 = normal;
+
+            __m128i low01 = _mm_unpacklo_epi32(word0, word1);
+            __m128i low23 = _mm_unpacklo_epi32(word2, word3);
+            __m128i high01 = _mm_unpackhi_epi32(word0, word1);
+            __m128i high23 = _mm_unpackhi_epi32(word2, word3);
+            __m128i* destination = reinterpret_cast<__m128i*>(out + i);
+            _mm_storeu_si128(destination, _mm_unpacklo_epi64(low01, low23));
+            _mm_storeu_si128(destination + 1, _mm_unpackhi_epi64(low01, low23));
+            _mm_storeu_si128(destination + 2, _mm_unpacklo_epi64(high01, high23));
+            _mm_storeu_si128(destination + 3, _mm_unpackhi_epi64(high01, high23));
+        }
+        PackScalar(vertices, normals, i, count, constants, out);
+    }
+
+    // Eight vertices at a time, with the fields gathered straight from the vertex array
+    FAV_TARGET_AVX2 __m256i QuantizeUnormAVX2(__m256 value, __m256 scale, __m256 levels) {
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(value, scale), _mm256_setzero_ps()), levels);
+        return _mm256_cvttps_epi32(_mm256_add_ps(t, _mm256_set1_ps(0.5f)));
+    }
+
+    FAV_TARGET_AVX2 __m256i QuantizeSnormAVX2(__m256 value) {
+        __m256 levels = _mm256_set1_ps(NORMAL_LEVELS);
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(value, levels), _mm256_sub_ps(_mm256_setzero_ps(), levels)), levels);
+        __m256 positive = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GE_OQ);
+        __m256 half = _mm256_blendv_ps(_mm256_set1_ps(-0.5f), _mm256_set1_ps(0.5f), positive);
+        return _mm256_cvttps_epi32(_mm256_add_ps(t, half));
+    }
+
+    FAV_TARGET_AVX2 __m256i EncodeNormalAVX2(__m256 x, __m256 y, __m256 z) {
+        __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one = _mm256_set1_ps(1.0f);
+        __m256 length = _mm256_max_ps(_mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signBit, x),
+            _mm256_andnot_ps(signBit, y)), _mm256_andnot_ps(signBit, z)), _mm256_set1_ps(MIN_NORMAL_LENGTH));
+        __m256 u = _mm256_div_ps(x, length);
+        __m256 v = _mm256_div_ps(y, length);
+
+        __m256 foldedU = _mm256_sub_ps(one, _mm256_andnot_ps(signBit, v));
+        __m256 foldedV = _mm256_sub_ps(one, _mm256_andnot_ps(signBit, u));
+        foldedU = _mm256_xor_ps(foldedU, _mm256_andnot_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), signBit));
+        foldedV = _mm256_xor_ps(foldedV, _mm256_andnot_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), signBit));
+        __m256 lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+        u = _mm256_blendv_ps(u, foldedU, lower);
+        v = _mm256_blendv_ps(v, foldedV, lower);
+
+        return _mm256_or_si256(_mm256_and_si256(QuantizeSnormAVX2(u), _mm256_set1_epi32(0xFFFF)),
+            _mm256_slli_epi32(QuantizeSnormAVX2(v), 16));
+    }
+
+    FAV_TARGET_AVX2 void PackAVX2(const MeshVertex* vertices, const float* normals, size_t count,
+        const PackConstants& constants, PackedVertex* out) {
+        const int stride = static_cast<int>(sizeof(MeshVertex) / sizeof(float));
+        __m256i vertexIndex = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+        __m256i normalIndex = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        __m256 inverseStep = _mm256_set1_ps(constants.inverseStep);
+        __m256 positionLevels = _mm256_set1_ps(POSITION_LEVELS);
+        __m256 colorLevels = _mm256_set1_ps(COLOR_LEVELS);
+        __m256 originX = _mm256_set1_ps(constants.origin[0]);
+        __m256 originY = _mm256_set1_ps(constants.origin[1]);
+        __m256 originZ = _mm256_set1_ps(constants.origin[2]);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const float* v = &vertices[i].x;
+            __m256i qx = QuantizeUnormAVX2(_mm256_sub_ps(_mm256_i32gather_ps(v, vertexIndex, 4), originX), inverseStep, positionLevels);
+            __m256i qy = QuantizeUnormAVX2(_mm256_sub_ps(_mm256_i32gather_ps(v + 1, vertexIndex, 4), originY), inverseStep, positionLevels);
+            __m256i qz = QuantizeUnormAVX2(_mm256_sub_ps(_mm256_i32gather_ps(v + 2, vertexIndex, 4), originZ), inverseStep, positionLevels);
+            __m256i r = QuantizeUnormAVX2(_mm256_i32gather_ps(v + 3, vertexIndex, 4), colorLevels, colorLevels);
+            __m256i g = QuantizeUnormAVX2(_mm256_i32gather_ps(v + 4, vertexIndex, 4), colorLevels, colorLevels);
+            __m256i b = QuantizeUnormAVX2(_mm256_i32gather_ps(v + 5, vertexIndex, 4), colorLevels, colorLevels);
+            __m256i a = QuantizeUnormAVX2(_mm256_i32gather_ps(v + 6, vertexIndex, 4), colorLevels, colorLevels);
+
+            __m256i normal;
+            if (normals) {
+                const float* n = normals + i * 3;
+                normal = EncodeNormalAVX2(_mm256_i32gather_ps(n, normalIndex, 4), _mm256_i32gather_ps(n + 1, normalIndex, 4),
+                    _mm256_i32gather_ps(n + 2, normalIndex, 4));
+            }
+            else {
+                normal = _mm256_set1_epi32(static_cast<int>(constants.defaultNormal));
+            }
+
+            __m256i word0 = _mm256_or_si256(qx, _mm256_slli_epi32(qy, 16));
+            __m256i word1 = qz;
+            __m256i word2 = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+                _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_slli_epi32(a, 24)));
+            __m256i word3 = normal;
+
+            // Transposed within each 128-bit half: rows hold vertices (0, 4), (1, 5), ...
+            __m256i low01 = _mm256_unpacklo_epi32(word0, word1);
+            __m256i low23 = _mm256_unpacklo_epi32(word2, word3);
+            __m256i high01 = _mm256_unpackhi_epi32(word0, word1);
+            __m256i high23 = _mm256_unpackhi_epi32(word2, word3);
+            __m256i row0 = _mm256_unpacklo_epi64(low01, low23);
+            __m256i row1 = _mm256_unpackhi_epi64(low01, low23);
+            __m256i row2 = _mm256_unpacklo_epi64(high01, high23);
+            __m256i row3 = _mm256_unpackhi_epi64(high01, high23);
+
+            __m256i* destination = reinterpret_cast<__m256i*>(out + i);
+            _mm256_storeu_si256(destination, _mm256_permute2x128_si256(row0, row1, 0x20));
+            _mm256_storeu_si256(destination + 1, _mm256_permute2x128_si256(row2, row3, 0x20));
+            _mm256_storeu_si256(destination + 2, _mm256_permute2x128_si256(row0, row1, 0x31));
+            _mm256_storeu_si256(destination + 3, _mm256_permute2x128_si256(row2, row3, 0x31));
+        }
+        PackScalar(vertices, normals, i, count, constants, out);
+    }
+#endif
+}
+
+VertexQuantization VertexQuantization::FromBounds(const float minimum[3], const float maximum[3]) {
+    VertexQuantization quantization;
+    float extent = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        quantization.origin[axis] = minimum[axis];
+        extent = std::max(extent, maximum[axis] - minimum[axis]);
+    }
+    quantization.step = extent > 0.0f ? extent / POSITION_LEVELS : 1.0f;
+    return quantization;
+}
+
+VertexQuantization VertexQuantization::FromMesh(const FractalMesh& mesh) {
+    VertexQuantization quantization;
+    for (int axis = 0; axis < 3; ++axis) {
+        quantization.origin[axis] = mesh.origin[axis];
+    }
+    quantization.step = mesh.cellEdge > 0.0f ? mesh.cellEdge : 1.0f;
+    return quantization;
+}
+
+void VertexPacker::Pack(const MeshVertex* vertices, const float* normals, size_t count,
+    const VertexQuantization& quantization, PackedVertex* out, SimdLevel maxSimdLevel) {
+    PackConstants constants;
+    for (int axis = 0; axis < 3; ++axis) {
+        constants.origin[axis] = quantization.origin[axis];
+    }
+    constants.inverseStep = 1.0f / quantization.step;
+    constants.defaultNormal = EncodeNormalWord(0.0f, 0.0f, 1.0f);
+
+#if FAV_X86
+    SimdLevel level = ResolveSimdLevel(maxSimdLevel);
+    if (level >= SimdLevel::AVX2) {
+        PackAVX2(vertices, normals, count, constants, out);
+        return;
+    }
+    if (level >= SimdLevel::SSE2) {
+        PackSSE(vertices, normals, count, constants, out);
+        return;
+    }
+#else
+    (void)maxSimdLevel;
+#endif
+    PackScalar(vertices, normals, 0, count, constants, out);
+}
+
+void VertexPacker::EncodeNormal(const float normal[3], int16_t& u, int16_t& v) {
+    uint32_t word = EncodeNormalWord(normal[0], normal[1], normal[2]);
+    u = static_cast<int16_t>(word & 0xFFFF);
+    v = static_cast<int16_t>(word >> 16);
+}
+
+void VertexPacker::DecodeNormal(int16_t u, int16_t v, float normal[3]) {
+    // As the shader does: SNORM to -1..1, unfold the lower half, normalize
+    float x = std::max(u / NORMAL_LEVELS, -1.0f);
+    float y = std::max(v / NORMAL_LEVELS, -1.0f);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        float foldedX = 1.0f - std::fabs(y);
+        float foldedY = 1.0f - std::fabs(x);
+        x = x >= 0.0f ? foldedX : -foldedX;
+        y = y >= 0.0f ? foldedY : -foldedY;
+    }
+    float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+void VertexPacker::DecodePosition(const PackedVertex& vertex, const VertexQuantization& quantization, float position[3]) {
+    position[0] = quantization.origin[0] + vertex.x * quantization.step;
+    position[1] = quantization.origin[1] + vertex.y * quantization.step;
+    position[2] = quantization.origin[2] + vertex.z * quantization.step;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "FractalMesh.h"
+#include "SimdSupport.h"
+#include <cstddef>
+#include <cstdint>
+
+// 16 bytes against MeshVertex's 28 (40 with a float normal). Read by the packed input
+// layout as position R16G16B16A16_UNORM (w unused), color R8G8B8A8_UNORM and an
+// octahedral normal R16G16_SNORM.
+struct PackedVertex {
+    uint16_t x, y, z, w;
+    uint32_t color;
+    int16_t normalU, normalV;
+};
+
+// How positions map to 16-bit grid coordinates: stored = round((p - origin) / step). One
+// step for all axes keeps the dequantizing transform a uniform scale, so normals come
+// through it unchanged in direction.
+struct VertexQuantization {
+    float origin[3];
+    float step;
+
+    VertexQuantization() : origin(), step(1.0f) {}
+
+    // The tightest step covering a box
+    static VertexQuantization FromBounds(const float minimum[3], const float maximum[3]);
+
+    // The fractal mesh's own cell grid, on which every vertex packs exactly
+    static VertexQuantization FromMesh(const FractalMesh& mesh);
+
+    // Scale then offset that turns UNORM positions back into the originals; put in front
+    // of the world matrix
+    float GetScale() const { return step * 65535.0f; }
+};
+
+class VertexPacker {
+public:
+    // Pack count vertices. normals holds x, y, z per vertex (unit length), or is null for
+    // +z everywhere. Every SIMD level gives the same bytes as the scalar path.
+    static void Pack(const MeshVertex* vertices, const float* normals, size_t count,
+        const VertexQuantization& quantization, PackedVertex* out, SimdLevel maxSimdLevel = SimdLevel::AVX512);
+
+    // Octahedral normal encoding: the unit sphere folded onto a square
+    static void EncodeNormal(const float normal[3], int16_t& u, int16_t& v);
+    static void DecodeNormal(int16_t u, int16_t v, float normal[3]);
+
+    static void DecodePosition(const PackedVertex& vertex, const VertexQuantization& quantization, float position[3]);
+};
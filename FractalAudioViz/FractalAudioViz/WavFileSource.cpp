@@ -0,0 +1,207 @@
+#include "WavFileSource.h"
+#include <cstring>
+
+namespace {
+    // WAVE format tags
+    const uint16_t WAVE_FORMAT_PCM = 0x0001;
+    const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+    const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+    // Frames converted per fread
+    const size_t READ_BLOCK_FRAMES = 1024;
+
+    uint16_t ReadU16(const unsigned char* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t ReadU32(const unsigned char* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+            (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+}
+
+WavFileSource::WavFileSource(const std::string& filePath, bool loopPlayback) :
+    path(filePath),
+    file(nullptr),
+    loop(loopPlayback),
+    bitsPerSample(0),
+    isFloat(false),
+    dataStart(0),
+    dataSize(0),
+    dataRemaining(0)
+{
+    format.sampleRate = 0;
+    format.channels = 0;
+}
+
+WavFileSource::~WavFileSource() {
+    Close();
+}
+
+bool WavFileSource::Open() {
+    Close();
+
+#ifdef _MSC_VER
+    if (fopen_s(&file, path.c_str(), "rb") != 0) {
+        file = nullptr;
+    }
+#else
+    file = std::fopen(path.c_str(), "rb");
+#endif
+
+    if (!file) {
+        return false;
+    }
+
+    if (!ParseHeader()) {
+        Close();
+        return false;
+    }
+
+    readBuffer.resize(READ_BLOCK_FRAMES * format.channels * (bitsPerSample / 8));
+    return true;
+}
+
+void WavFileSource::Close() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+bool WavFileSource::ParseHeader() {
+    unsigned char riffHeader[12];
+    if (std::fread(riffHeader, 1, sizeof(riffHeader), file) != sizeof(riffHeader)) {
+        return false;
+    }
+
+    if (std::memcmp(riffHeader, "RIFF", 4) != 0 || std::memcmp(riffHeader + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool haveFormat = false;
+
+    // Walk the chunk list until we find the sample data
+    unsigned char chunkHeader[8];
+    while (std::fread(chunkHeader, 1, sizeof(chunkHeader), file) == sizeof(chunkHeader)) {
+        uint32_t chunkSize = ReadU32(chunkHeader + 4);
+
+        if (std::memcmp(chunkHeader, "fmt ", 4) == 0) {
+            unsigned char fmt[40] = {};
+            uint32_t toRead = chunkSize < sizeof(fmt) ? chunkSize : static_cast<uint32_t>(sizeof(fmt));
+            if (toRead < 16 || std::fread(fmt, 1, toRead, file) != toRead) {
+                return false;
+            }
+
+            uint16_t formatTag = ReadU16(fmt);
+            format.channels = ReadU16(fmt + 2);
+            format.sampleRate = static_cast<int>(ReadU32(fmt + 4));
+            bitsPerSample = ReadU16(fmt + 14);
+
+            // Extensible files keep the real format tag at the start of the sub-format GUID
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE && toRead >= 26) {
+                formatTag = ReadU16(fmt + 24);
+            }
+
+            if (formatTag == WAVE_FORMAT_IEEE_FLOAT && bitsPerSample == 32) {
+                isFloat = true;
+            }
+            else if (formatTag == WAVE_FORMAT_PCM && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32)) {
+                isFloat = false;
+            }
+            else {
+                return false;
+            }
+
+            // Skip anything in the chunk we didn't read (chunks are word aligned)
+            long skip = static_cast<long>(chunkSize - toRead + (chunkSize & 1));
+            if (skip > 0) {
+                std::fseek(file, skip, SEEK_CUR);
+            }
+            haveFormat = true;
+        }
+        else if (std::memcmp(chunkHeader, "data", 4) == 0) {
+            if (!haveFormat || format.channels <= 0 || format.sampleRate <= 0) {
+                return false;
+            }
+
+            dataStart = std::ftell(file);
+            dataSize = chunkSize;
+            dataRemaining = chunkSize;
+            return true;
+        }
+        else {
+            std::fseek(file, static_cast<long>(chunkSize + (chunkSize & 1)), SEEK_CUR);
+        }
+    }
+
+    return false;
+}
+
+size_t WavFileSource::Read(float* frames, size_t frameCount) {
+    if (!file) {
+        return 0;
+    }
+
+    const size_t bytesPerSample = bitsPerSample / 8;
+    const size_t bytesPerFrame = bytesPerSample * format.channels;
+    size_t framesDone = 0;
+
+    while (framesDone < frameCount) {
+        if (dataRemaining < bytesPerFrame) {
+            if (!loop || dataSize < bytesPerFrame) {
+                break;
+            }
+
+            // Rewind to the start of the sample data
+            std::fseek(file, dataStart, SEEK_SET);
+            dataRemaining = dataSize;
+        }
+
+        size_t framesWanted = frameCount - framesDone;
+        if (framesWanted > READ_BLOCK_FRAMES) framesWanted = READ_BLOCK_FRAMES;
+        if (framesWanted > dataRemaining / bytesPerFrame) framesWanted = dataRemaining / bytesPerFrame;
+
+        size_t framesRead = std::fread(readBuffer.data(), bytesPerFrame, framesWanted, file);
+        if (framesRead == 0) {
+            // Truncated file; treat what we have as the whole stream
+            dataRemaining = 0;
+            if (!loop) break;
+            continue;
+        }
+        dataRemaining -= static_cast<uint32_t>(framesRead * bytesPerFrame);
+
+        // Convert the block to float
+        const unsigned char* src = readBuffer.data();
+        float* dst = frames + framesDone * format.channels;
+        size_t sampleCount = framesRead * format.channels;
+
+        if (isFloat) {
+            std::memcpy(dst, src, sampleCount * sizeof(float));
+        }
+        else if (bitsPerSample == 16) {
+            for (size_t i = 0; i < sampleCount; ++i) {
+                int16_t s = static_cast<int16_t>(ReadU16(src + i * 2));
+                dst[i] = s * (1.0f / 32768.0f);
+            }
+        }
+        else if (bitsPerSample == 24) {
+            for (size_t i = 0; i < sampleCount; ++i) {
+                const unsigned char* p = src + i * 3;
+                int32_t s = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                    (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+                dst[i] = s * (1.0f / 8388608.0f);
+            }
+        }
+        else {
+            for (size_t i = 0; i < sampleCount; ++i) {
+                int32_t s = static_cast<int32_t>(ReadU32(src + i * 4));
+                dst[i] = static_cast<float>(s) * (1.0f / 2147483648.0f);
+            }
+        }
+
+        framesDone += framesRead;
+    }
+
+    return framesDone;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "AudioSource.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Streams PCM (16/24/32-bit integer) or 32-bit float RIFF/WAVE files
+class WavFileSource : public AudioSource {
+private:
+    std::string path;
+    std::FILE* file;
+    AudioFormat format;
+    bool loop;
+
+    int bitsPerSample;
+    bool isFloat;
+    long dataStart;
+    uint32_t dataSize;
+    uint32_t dataRemaining;
+
+    // Raw bytes read from disk before conversion, reused between reads
+    std::vector<unsigned char> readBuffer;
+
+    bool ParseHeader();
+
+public:
+    WavFileSource(const std::string& path, bool loop = false);
+    ~WavFileSource();
+
+    bool Open() override;
+    void Close() override;
+    AudioFormat GetFormat() const override { return format; }
+    size_t Read(float* frames, size_t frameCount) override;
+};
@@ -1,11 +1,17 @@
 #include <windows.h>
 #include <windowsx.h>
+#include <shellapi.h>
+#include <mmsystem.h>
 #include "window.h"
+#include "SyntheticSource.h"
 #include <string>
 #include <cmath>
+#include <cstdio>
+
+#pragma comment(lib, "winmm.lib")
 
 // GameTimer implementation
-GameTimer::GameTimer() : deltaTime(0.0f), totalTime(0.0f), accumulator(0.0f) {
+GameTimer::GameTimer() : deltaTime(0.0f), rawDeltaTime(0.0f), totalTime(0.0f), stallCount(0) {
     Reset();
 }
 
@@ -13,40 +19,42 @@ void GameTimer::Reset() {
     lastFrameTime = std::chrono::steady_clock::now();
     currentFrameTime = lastFrameTime;
     deltaTime = 0.0f;
+    rawDeltaTime = 0.0f;
     totalTime = 0.0f;
-    accumulator = 0.0f;
+    stallCount = 0;
 }
 
 void GameTimer::Tick() {
     currentFrameTime = std::chrono::steady_clock::now();
 
     // Calculate delta time in seconds
-    deltaTime = std::chrono::duration<float>(currentFrameTime - lastFrameTime).count();
+    rawDeltaTime = std::chrono::duration<float>(currentFrameTime - lastFrameTime).count();
+    deltaTime = rawDeltaTime;
 
-    // Cap delta time to avoid spiral of death when debugging
+    // Cap delta time to avoid spiral of death when debugging; count it so stalls stay visible
     if (deltaTime > 0.25f) {
         deltaTime = 0.25f;
+        ++stallCount;
     }
 
     lastFrameTime = currentFrameTime;
     totalTime += deltaTime;
-    accumulator += deltaTime;
 }
 
 float GameTimer::GetDeltaTime() const {
     return deltaTime;
 }
 
-float GameTimer::GetTotalTime() const {
-    return totalTime;
+float GameTimer::GetRawDeltaTime() const {
+    return rawDeltaTime;
 }
 
-float GameTimer::GetAccumulator() const {
-    return accumulator;
+unsigned GameTimer::GetStallCount() const {
+    return stallCount;
 }
 
-void GameTimer::ConsumeAccumulatedTime(float amount) {
-    accumulator -= amount;
+float GameTimer::GetTotalTime() const {
+    return totalTime;
 }
 
 // GameWindow implementation
@@ -56,11 +64,25 @@ GameWindow::GameWindow() :
     running(false), 
     width(800), 
     height(600),
-    captureMouse(false)
+    captureMouse(false),
+    uploadedFractalVersion(0),
+    scriptedCamera(false),
+    drawMergedMesh(false),
+    packMergedMesh(false),
+    mergedMeshBuilt(false),
+    mergedMeshPacked(false),
+    drawIsosurface(false),
+    drawBackdrop(false),
+    drawDeepZoom(false),
+    deepZoomHeight(DeepZoomModulation().startHeight),
+    drawFlame(false),
+    lastStatsTime(0)
 {}
 
 GameWindow::~GameWindow() {
     // Clean up resources
+    simulation.Shutdown();
+    jobs.Shutdown();
     renderer.Shutdown();
 }
 
@@ -102,6 +124,14 @@ LRESULT CALLBACK GameWindow::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPA
         // Resize DirectX buffers if initialized
         if (width > 0 && height > 0 && renderer.GetDevice()) {
             renderer.ResizeBuffers(width, height);
+            backdrop.Resize(width, height);
+            deepZoom.Resize(width, height);
+            flame.Resize(width, height);
+        }
+
+        // Cubes cover more pixels in a taller window, so get more detail
+        if (height > 0) {
+            simulation.SetViewport(DirectX::XM_PIDIV4, static_cast<float>(height));
         }
         return 0;
 
@@ -154,6 +184,61 @@ LRESULT CALLBACK GameWindow::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPA
         }
         return 0;
 
+    case WM_KEYDOWN:
+        // 1-5 pick the deepest fractal level, T switches between Menger and Sierpinski, M
+        // between instanced cubes and the merged exterior mesh, P the mesh's vertex format, I
+        // to the music's Mandelbulb isosurface, B the Julia set backdrop, Z the deep zoom one and
+        // F the flame
+        if (wParam >= '1' && wParam <= '5') {
+            FractalSettings fractal = simulation.GetFractalSettings();
+            int level = static_cast<int>(wParam - '0');
+            fractal.depth = fractal.type == FractalType::Sierpinski ? 2 * level : level;
+            simulation.SetFractalSettings(fractal);
+        }
+        else if (wParam == 'T') {
+            FractalSettings fractal = simulation.GetFractalSettings();
+            if (fractal.type == FractalType::Sierpinski) {
+                fractal.type = FractalType::MengerSponge;
+                fractal.depth /= 2;
+            }
+            else {
+                fractal.type = FractalType::Sierpinski;
+                fractal.depth *= 2;
+            }
+            simulation.SetFractalSettings(fractal);
+        }
+        else if (wParam == 'M') {
+            // The isosurface may have replaced the merged mesh in the renderer's buffers
+            drawMergedMesh = !drawMergedMesh;
+            drawIsosurface = false;
+            mergedMeshBuilt = false;
+        }
+        else if (wParam == 'I') {
+            drawIsosurface = !drawIsosurface;
+            drawMergedMesh = false;
+            isosurface.Invalidate();
+        }
+        else if (wParam == 'P') {
+            packMergedMesh = !packMergedMesh;
+        }
+        else if (wParam == 'B') {
+            drawBackdrop = !drawBackdrop;
+            drawDeepZoom = false;
+            drawFlame = false;
+            backdrop.Invalidate();
+        }
+        else if (wParam == 'Z') {
+            drawDeepZoom = !drawDeepZoom;
+            drawBackdrop = false;
+            drawFlame = false;
+        }
+        else if (wParam == 'F') {
+            drawFlame = !drawFlame;
+            drawBackdrop = false;
+            drawDeepZoom = false;
+        }
+        return 0;
+
     default:
         return DefWindowProc(hwnd, uMsg, wParam, lParam);
     }
@@ -218,12 +303,82 @@ bool GameWindow::Initialize(HINSTANCE hInst, int nCmdShow) {
     // Position the cube in front of the camera
     cube.SetPosition(0.0f, 0.0f, 0.0f);
 
+    // One worker per spare hardware thread for the simulation's jobs
+    if (!jobs.Initialize()) {
+        MessageBox(hwnd, L"Failed to start worker threads!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+    simulation.SetJobSystem(&jobs);
+
+    // Audio analysis and the scene, fed by a synthetic sweep until an input is chosen
+    SyntheticSettings audioSettings;
+    audioSettings.signal = SyntheticSignal::Sweep;
+
+    // A depth 5 sponge in full is 3.2M cubes; refined around the camera it's a few thousand
+    // from the starting position, more closer in
+    SimulationSettings simulationSettings;
+    simulationSettings.fractal.depth = 5;
+    simulationSettings.fractalLod = true;
+    simulationSettings.lod.fieldOfView = DirectX::XM_PIDIV4;
+    simulationSettings.lod.viewportHeight = static_cast<float>(height);
+    if (!simulation.Initialize(simulationSettings, std::make_unique<SyntheticSource>(audioSettings))) {
+        MessageBox(hwnd, L"Failed to initialize audio analysis!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+    simulation.SetFrameStats(&frameStats);
+
+    // 64 cells across the Mandelbulb, 64 chunks to re-mesh independently
+    IsosurfaceSettings isosurfaceSettings;
+    isosurfaceSettings.halfExtent = 1.3f;
+    if (!isosurface.Initialize(isosurfaceSettings)) {
+        MessageBox(hwnd, L"Failed to initialize the isosurface!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+
+    // The backdrop gets 4 ms of the simulation's workers per update
+    EscapeSettings backdropSettings;
+    backdropSettings.width = width;
+    backdropSettings.height = height;
+    backdropSettings.budgetSeconds = 0.004;
+    if (!backdrop.Initialize(backdropSettings)) {
+        MessageBox(hwnd, L"Failed to initialize the backdrop!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+    DeepZoomSettings deepZoomSettings;
+    deepZoomSettings.width = width;
+    deepZoomSettings.height = height;
+    if (!deepZoom.Initialize(deepZoomSettings)) {
+        MessageBox(hwnd, L"Failed to initialize the deep zoom!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+    FlameSettings flameSettings;
+    flameSettings.width = width;
+    flameSettings.height = height;
+    flameSettings.points = 2000000;
+    if (!flame.Initialize(flameSettings)) {
+        MessageBox(hwnd, L"Failed to initialize the flame!", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+
+    if (scriptedCamera) {
+        simulation.SetCameraPath(CameraPath::Orbit(5.0f, 1.5f, 2.0f, 8, 40.0f));
+    }
+
+    // Sort the first fractal (8000 instances) into the culling tree
+    UpdateFractal();
+
     // Show the window
     ShowWindow(hwnd, nCmdShow);
     UpdateWindow(hwnd);
 
-    // Reset the timer
+    // Reset the timer, and the timeline to lock onto the audio clock from the first frame
     timer.Reset();
+    AudioTimelineSettings timelineSettings;
+    timelineSettings.sampleRate = simulation.GetAudioFormat().sampleRate;
+    timelineSettings.stepSeconds = FIXED_TIMESTEP;
+    audioTimeline.Reset(timelineSettings);
+    frameScheduler.Reset(FrameSchedulerSettings());
+    lastStatsTime = FrameStats::Now();
 
     // Set running flag
     running = true;
@@ -234,69 +389,380 @@ bool GameWindow::Initialize(HINSTANCE hInst, int nCmdShow) {
 void GameWindow::Run() {
     MSG msg = {};
 
+    // The frame scheduler's waits need sleeps finer than the default 15.6 ms tick
+    timeBeginPeriod(1);
+
     // Main game loop
     while (running) {
-        // Handle Windows messages
-        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+        frameStats.BeginFrame();
 
-            if (msg.message == WM_QUIT) {
-                running = false;
-                break;
+        // Hold the frame back to the latest start that still makes the next vblank, then
+        // sample input and audio as late as that allows
+        {
+            PhaseScope scope(frameStats, FramePhase::Wait);
+            FrameScheduler::WaitUntil(frameScheduler.GetStartTime(FrameStats::Now() * 1e-9));
+        }
+        frameScheduler.BeginWork(FrameStats::Now() * 1e-9);
+
+        // Handle Windows messages
+        {
+            PhaseScope scope(frameStats, FramePhase::MessagePump);
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+
+                if (msg.message == WM_QUIT) {
+                    running = false;
+                    break;
+                }
             }
         }
 
         if (!running)
             break;
+        frameScheduler.MarkInput(FrameStats::Now() * 1e-9);
 
-        // Update game timer
+        // Update game timer, which still counts stalls for the title bar
         timer.Tick();
 
-        // Fixed time step for logic updates
-        while (timer.GetAccumulator() >= FIXED_TIMESTEP) {
-            Update(FIXED_TIMESTEP);
-            timer.ConsumeAccumulatedTime(FIXED_TIMESTEP);
+        // Fixed time step for logic updates on the audio clock, counting how many steps
+        // this frame caught up. Once a finite source ends the timeline runs on by itself.
+        uint32_t catchUpIterations = 0;
+        {
+            PhaseScope scope(frameStats, FramePhase::Update);
+            double now = FrameStats::Now() * 1e-9;
+            if (!simulation.IsAudioFinished()) {
+                audioTimeline.Observe(simulation.GetAudioFramesDelivered(), now);
+            }
+            uint64_t skipped = 0;
+            uint64_t steps = audioTimeline.Advance(now, skipped);
+            if (skipped > 0) {
+                simulation.SkipAudio(skipped * static_cast<double>(FIXED_TIMESTEP));
+            }
+            for (uint64_t step = 0; step < steps; ++step) {
+                Update(FIXED_TIMESTEP);
+                ++catchUpIterations;
+            }
+            if (steps > 0) {
+                frameScheduler.MarkAudio(now);
+            }
+        }
+
+        // Backdrops are rendered once a frame from the latest update's band levels, not
+        // once per step caught up
+        if (catchUpIterations > 0) {
+            RenderBackdrop();
+            RenderDeepZoom();
+            RenderFlame();
         }
 
-        // Render the current frame
+        // Draw the cube where the playhead is between the last two updates, then render
+        // the frame; Present blocks until the vblank it lands on
+        InterpolateCube(static_cast<float>(audioTimeline.GetStepFraction(FrameStats::Now() * 1e-9)));
         Render();
+        frameScheduler.EndFrame(FrameStats::Now() * 1e-9);
+
+        frameStats.EndFrame(catchUpIterations);
+        UpdateFrameStats();
+    }
+
+    timeEndPeriod(1);
+
+    frameStats.Collect();
+    if (!statsCsvPath.empty() && !WriteFrameStats()) {
+        MessageBox(nullptr, L"Failed to write frame statistics!", L"Error", MB_OK | MB_ICONERROR);
     }
 }
 
+void GameWindow::SetStatsCsvPath(const std::wstring& path) {
+    statsCsvPath = path;
+}
+
+void GameWindow::SetScriptedCamera(bool scripted) {
+    scriptedCamera = scripted;
+}
+
+void GameWindow::UpdateFrameStats() {
+    // Once a second is plenty for the title bar and keeps the ring far from full
+    uint64_t now = FrameStats::Now();
+    if (now - lastStatsTime < 1000000000ull) {
+        return;
+    }
+    lastStatsTime = now;
+    frameStats.Collect();
+
+    const LatencyHistogram& frame = frameStats.GetHistogram(FramePhase::Frame);
+    const CullStats& cull = culler.GetStats();
+    const FrameSchedulerStats& schedule = frameScheduler.GetStats();
+    wchar_t title[288];
+    swprintf_s(title, L"Fractal Audio Visualizer - frame p50 %.2f ms, p99 %.2f ms, max %.2f ms, %u stalls - "
+        L"to present: input %.1f ms, audio %.1f ms - %u visible, %u culled, %u nodes",
+        frame.GetPercentile(0.50) * 1e-6, frame.GetPercentile(0.99) * 1e-6, frame.GetMax() * 1e-6,
+        timer.GetStallCount(), schedule.inputToPresent.GetPercentile(0.50) * 1e-6,
+        schedule.audioToPresent.GetPercentile(0.50) * 1e-6, cull.visible, cull.culled, cull.nodesVisited);
+    SetWindowText(hwnd, title);
+}
+
+bool GameWindow::WriteFrameStats() {
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, statsCsvPath.c_str(), L"w") != 0 || !file) {
+        return false;
+    }
+
+    bool ok = frameStats.WriteCsv(file);
+    std::fprintf(file, "\n");
+    ok = frameScheduler.WriteCsv(file) && ok;
+    return fclose(file) == 0 && ok;
+}
+
 void GameWindow::Update(float deltaTime) {
-    // Update game logic here
-    camera.Update(deltaTime);
+    // Keyboard camera, unless the simulation is flying a scripted path
+    if (!simulation.HasCameraPath()) {
+        camera.Update(deltaTime);
+
+        CameraPose pose;
+        DirectX::XMFLOAT3 position = camera.GetPosition();
+        DirectX::XMFLOAT3 rotation = camera.GetRotation();
+        pose.position[0] = position.x;
+        pose.position[1] = position.y;
+        pose.position[2] = position.z;
+        pose.rotation[0] = rotation.x;
+        pose.rotation[1] = rotation.y;
+        pose.rotation[2] = rotation.z;
+        simulation.SetCameraPose(pose);
+    }
+
+    // Audio analysis, fractal regeneration and animation
+    previousScene = simulation.GetScene();
+    simulation.Update(deltaTime);
+    const SceneState& scene = simulation.GetScene();
+
+    if (simulation.HasCameraPath()) {
+        camera.SetPosition(scene.camera.position[0], scene.camera.position[1], scene.camera.position[2]);
+        camera.SetRotation(scene.camera.rotation[0], scene.camera.rotation[1], scene.camera.rotation[2]);
+    }
+
+    // Rebuild the culling tree, or the merged mesh, after a depth or type change
+    UpdateFractal();
+    UpdateMergedMesh();
+    UpdateIsosurface();
+    UpdateDeepZoom(deltaTime);
+}
+
+void GameWindow::InterpolateCube(float fraction) {
+    // Rotate and pulse the cube, turning the short way across the rotation's wrap
+    const SceneState& scene = simulation.GetScene();
+    float turn = scene.cubeRotationY - previousScene.cubeRotationY;
+    if (turn > 180.0f) turn -= 360.0f;
+    else if (turn < -180.0f) turn += 360.0f;
+    float scale = previousScene.cubeScale + (scene.cubeScale - previousScene.cubeScale) * fraction;
+    cube.SetRotation(0.0f, previousScene.cubeRotationY + turn * fraction, 0.0f);
+    cube.SetScale(scale, scale, scale);
+}
+
+void GameWindow::UpdateFractal() {
+    if (simulation.GetFractalVersion() == uploadedFractalVersion) {
+        return;
+    }
+
+    PhaseScope scope(frameStats, FramePhase::SceneBuild);
+    uploadedFractalVersion = simulation.GetFractalVersion();
+    culler.Build(simulation.GetFractalInstances());
+}
+
+void GameWindow::UpdateMergedMesh() {
+    const FractalSettings& fractal = simulation.GetFractalSettings();
+    if (!drawMergedMesh || (mergedMeshBuilt && fractal.type == mergedMeshFractal.type &&
+        fractal.depth == mergedMeshFractal.depth && packMergedMesh == mergedMeshPacked)) {
+        return;
+    }
+
+    // Chunks are built on the simulation's workers, between its updates
+    PhaseScope scope(frameStats, FramePhase::SceneBuild);
+    mergedMeshFractal = fractal;
+    mergedMeshBuilt = true;
+    mergedMeshPacked = packMergedMesh;
+
+    // Packed vertices carry normals and are lit in the shader rather than pre-shaded
+    FractalMeshSettings meshSettings;
+    meshSettings.normals = packMergedMesh;
+    if (!FractalMeshBuilder::Build(fractal, meshSettings, mergedMesh, nullptr, &jobs)) {
+        mergedMesh = FractalMesh();
+        renderer.UploadMesh(mergedMesh);
+        return;
+    }
+
+    // Shared corners welded, triangles ordered for the vertex cache and outside in for
+    // early-Z, vertices in first-use order
+    MeshOptimizer::Optimize(mergedMesh);
+
+    if (packMergedMesh) {
+        // On the mesh's own grid, so the positions pack exactly
+        mergedMeshQuantization = VertexQuantization::FromMesh(mergedMesh);
+        packedVertices.resize(mergedMesh.vertices.size());
+        VertexPacker::Pack(mergedMesh.vertices.data(), mergedMesh.normals.data(), mergedMesh.vertices.size(),
+            mergedMeshQuantization, packedVertices.data());
+        renderer.UploadMesh(packedVertices, mergedMesh.indices);
+    }
+    else {
+        packedVertices.clear();
+        renderer.UploadMesh(mergedMesh);
+    }
+}
+
+void GameWindow::UpdateIsosurface() {
+    if (!drawIsosurface) {
+        return;
+    }
+
+    // Chunks are sampled and meshed on the simulation's workers
+    PhaseScope scope(frameStats, FramePhase::SceneBuild);
+    DistanceParams params = DistanceEstimator::Modulate(DistanceParams(), simulation.GetBandEnergies());
+    if (isosurface.Update(params, &jobs)) {
+        renderer.UploadMesh(isosurface.GetMesh());
+    }
+}
+
+void GameWindow::RenderBackdrop() {
+    if (!drawBackdrop) {
+        return;
+    }
+
+    PhaseScope scope(frameStats, FramePhase::SceneBuild);
+    EscapeParams params = EscapeTimeRenderer::Modulate(EscapeParams(EscapeFractal::Julia), simulation.GetBandEnergies());
+    backdrop.Render(params, &jobs);
+}
+
+void GameWindow::UpdateDeepZoom(float deltaTime) {
+    if (!drawDeepZoom) {
+        return;
+    }
+
+    deepZoomHeight = DeepZoomRenderer::Zoom(deepZoomHeight, simulation.GetBandEnergies(), deltaTime);
+}
+
+void GameWindow::RenderDeepZoom() {
+    if (!drawDeepZoom) {
+        return;
+    }
+
+    PhaseScope scope(frameStats, FramePhase::SceneBuild);
+    deepZoom.Render(deepZoomHeight, &jobs);
+}
+
+void GameWindow::RenderFlame() {
+    if (!drawFlame) {
+        return;
+    }
+
+    PhaseScope scope(frameStats, FramePhase::SceneBuild);
+    flame.Render(FlameRenderer::Modulate(FlameParams(), simulation.GetBandEnergies()), &jobs);
+}
 
-    // Update the cube - maybe rotate it slowly
-    static float rotationY = 0.0f;
-    rotationY += 15.0f * deltaTime; // 15 degrees per second
-    if (rotationY > 360.0f) rotationY -= 360.0f;
+bool GameWindow::UploadVisibleFractal() {
+    // The instances are placed by the cube's transform, so cull in the cube's space
+    DirectX::XMFLOAT4X4 worldViewProjection;
+    DirectX::XMStoreFloat4x4(&worldViewProjection,
+        cube.GetWorldMatrix() * camera.GetViewMatrix() * camera.GetProjectionMatrix());
+    culler.Cull(Frustum::FromMatrix(&worldViewProjection.m[0][0]));
 
-    cube.SetRotation(0.0f, rotationY, 0.0f);
-    cube.Update(deltaTime);
+    culler.GatherVisible(visibleInstances);
+    return renderer.UploadInstances(visibleInstances);
 }
 
 void GameWindow::Render() {
-    // Clear the back buffer - use a dark blue background
-    renderer.BeginFrame(0.0f, 0.0f, 0.2f, 1.0f);
+    {
+        PhaseScope scope(frameStats, FramePhase::SceneBuild);
 
-    // Set up world and camera matrices
-    DirectX::XMMATRIX worldMatrix = DirectX::XMMatrixIdentity();
-    renderer.SetMatrices(worldMatrix, &camera);
+        // Clear the back buffer - use a dark blue background
+        renderer.BeginFrame(0.0f, 0.0f, 0.2f, 1.0f);
+        if (drawBackdrop) {
+            renderer.DrawBackdrop(backdrop.GetPixels(), backdrop.GetWidth(), backdrop.GetHeight(), backdrop.GetPitch());
+        }
+        else if (drawDeepZoom) {
+            renderer.DrawBackdrop(deepZoom.GetPixels(), deepZoom.GetWidth(), deepZoom.GetHeight(), deepZoom.GetPitch());
+        }
+        else if (drawFlame) {
+            renderer.DrawBackdrop(flame.GetPixels(), flame.GetWidth(), flame.GetHeight(), flame.GetPitch());
+        }
 
-    // Render game objects here
-    cube.Render(&renderer);
+        // Per-frame camera constants
+        renderer.SetCamera(&camera);
+
+        // The fractal, placed by the cube's transform and sorted by distance over the far
+        // plane: every visible instance in one instanced draw of the shared cube mesh, or
+        // the merged mesh or isosurface
+        DirectX::XMFLOAT3 eye = camera.GetPosition();
+        float depth = std::sqrt(eye.x * eye.x + eye.y * eye.y + eye.z * eye.z) / 1000.0f;
+        if (drawMergedMesh || drawIsosurface) {
+            // Already in the fractal's space, so one plain draw; packed positions are scaled
+            // back to the grid first
+            if (renderer.GetMeshIndexCount() > 0) {
+                DirectX::XMMATRIX world = cube.GetWorldMatrix();
+                RenderHandle pipeline = renderer.GetBasicPipeline();
+                if (drawMergedMesh && mergedMeshPacked) {
+                    float scale = mergedMeshQuantization.GetScale();
+                    world = DirectX::XMMatrixScaling(scale, scale, scale) *
+                        DirectX::XMMatrixTranslation(mergedMeshQuantization.origin[0], mergedMeshQuantization.origin[1],
+                            mergedMeshQuantization.origin[2]) * world;
+                    pipeline = renderer.GetPackedPipeline();
+                }
+
+                DrawConstants constants;
+                constants.world = DirectX::XMMatrixTranspose(world);
+
+                RenderCommandList& list = renderer.GetCommandList();
+                DrawPacket packet = {};
+                packet.sortKey = SortKey::Opaque(0, pipeline, renderer.GetMeshVertexBuffer(), depth);
+                packet.pipeline = pipeline;
+                packet.vertexBuffer = renderer.GetMeshVertexBuffer();
+                packet.indexBuffer = renderer.GetMeshIndexBuffer();
+                packet.constants = list.AddConstants(&constants, sizeof(constants));
+                packet.constantSize = sizeof(constants);
+                packet.indexCount = renderer.GetMeshIndexCount();
+                list.Add(packet);
+            }
+        }
+        else if (UploadVisibleFractal()) {
+            cube.Render(renderer.GetCommandList(), renderer.GetInstancedPipeline(), depth,
+                DXRenderer::FRACTAL_INSTANCES, renderer.GetInstanceCount());
+        }
+    }
+
+    // Sort and submit everything recorded this frame
+    {
+        PhaseScope scope(frameStats, FramePhase::Submit);
+        renderer.ExecuteQueue();
+    }
 
     // Present the frame
-    renderer.EndFrame();
+    frameScheduler.MarkSubmit(FrameStats::Now() * 1e-9);
+    {
+        PhaseScope scope(frameStats, FramePhase::Present);
+        renderer.EndFrame();
+    }
 }
 
 // Global function to initialize window
-bool InitWindow(HINSTANCE hInstance, int nCmdShow) {
+bool InitWindow(HINSTANCE hInstance, int nCmdShow, LPCWSTR commandLine) {
     // Create game window
     static GameWindow gameWindow;
 
+    // Parse command line options
+    int argCount = 0;
+    LPWSTR* args = (commandLine && *commandLine) ? CommandLineToArgvW(commandLine, &argCount) : nullptr;
+    if (args) {
+        for (int i = 0; i < argCount; ++i) {
+            if (wcscmp(args[i], L"--stats-csv") == 0 && i + 1 < argCount) {
+                gameWindow.SetStatsCsvPath(args[++i]);
+            }
+            else if (wcscmp(args[i], L"--scripted") == 0) {
+                gameWindow.SetScriptedCamera(true);
+            }
+        }
+        LocalFree(args);
+    }
+
     // Initialize the window
     if (!gameWindow.Initialize(hInstance, nCmdShow)) {
         return false;
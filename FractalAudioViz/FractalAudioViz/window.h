@@ -1,12 +1,23 @@
 #pragma once
 #include <windows.h>
 #include <chrono>
+#include <vector>
+#include "AudioTimeline.h"
 #include "DXRenderer.h"
+#include "DeepZoom.h"
+#include "EscapeTime.h"
 #include "Camera.h"
 #include "Cube.h"
-
-// Game timing constants
-constexpr float FIXED_TIMESTEP = 1.0f / 60.0f; // 60 updates per second
+#include "Simulation.h"
+#include "FrameScheduler.h"
+#include "FrameStats.h"
+#include "InstanceCuller.h"
+#include "FractalFlame.h"
+#include "FractalMesh.h"
+#include "Isosurface.h"
+#include "MeshOptimizer.h"
+#include "VertexPacking.h"
+#include <string>
 
 // Timer class to handle game timing
 class GameTimer {
@@ -14,8 +25,9 @@ private:
     std::chrono::steady_clock::time_point lastFrameTime;
     std::chrono::steady_clock::time_point currentFrameTime;
     float deltaTime;
+    float rawDeltaTime;
     float totalTime;
-    float accumulator;
+    unsigned stallCount;
     bool captureMouse;
 
 public:
@@ -23,9 +35,9 @@ public:
     void Reset();
     void Tick();
     float GetDeltaTime() const;
+    float GetRawDeltaTime() const;   // Before the 0.25 s cap
+    unsigned GetStallCount() const;  // Frames whose delta hit the cap
     float GetTotalTime() const;
-    float GetAccumulator() const;
-    void ConsumeAccumulatedTime(float amount);
 };
 
 // Window class declaration
@@ -39,25 +51,132 @@ private:
     int height;
     bool captureMouse;
     Camera camera;
+
+    // Unit cube mesh, drawn once per fractal instance; its transform places the whole fractal
     Cube cube;
 
+    // Worker threads the simulation runs each update's task graph on
+    JobSystem jobs;
+
+    // Audio analysis, camera script, fractal and animation; the window only adds input
+    // and rendering. Fractal instances are uploaded whenever their version moves on.
+    Simulation simulation;
+    uint64_t uploadedFractalVersion;
+
+    // The clock the fixed updates step on: the audio capture's delivered frames, so
+    // each update takes in exactly the audio that arrived for it
+    AudioTimeline audioTimeline;
+    bool scriptedCamera;
+
+    // The scene before the last update; the cube is drawn between it and the latest by
+    // how far the timeline's playhead is into the next step
+    SceneState previousScene;
+
+    // Fractal instances in a culling tree, rebuilt when the version moves on; each frame
+    // only those in the camera's frustum are gathered and uploaded
+    InstanceCuller culler;
+    FractalInstances visibleInstances;
+
+    // With M, the fractal at its full depth as one mesh of its exterior instead of
+    // instanced cubes; rebuilt when the fractal's type or depth changes. P switches it
+    // to packed 16-byte vertices.
+    bool drawMergedMesh;
+    bool packMergedMesh;
+    FractalMesh mergedMesh;
+    std::vector<PackedVertex> packedVertices;
+    VertexQuantization mergedMeshQuantization;
+    FractalSettings mergedMeshFractal;
+    bool mergedMeshBuilt;
+    bool mergedMeshPacked;
+
+    // With I, a Mandelbulb moved by the music, meshed from its distance field in place of
+    // the fractal; each update re-meshes the chunks where it moved. Shares the mesh
+    // buffers with the merged mesh, so only one of them is shown.
+    bool drawIsosurface;
+    IsosurfaceMesher isosurface;
+
+    // With B, a Julia set moved by the music behind the scene in place of the clear color,
+    // rendered on the CPU at the window's size within a few milliseconds per update and
+    // refined over the following ones while the music holds still
+    bool drawBackdrop;
+    EscapeTimeRenderer backdrop;
+
+    // With Z, a zoom into the Mandelbrot set in place of the Julia set, deeper than
+    // doubles reach and faster the louder the music
+    bool drawDeepZoom;
+    DeepZoomRenderer deepZoom;
+    double deepZoomHeight;
+
+    // With F, a fractal flame with its variations moved by the music, a couple of
+    // million points a frame across the simulation's workers
+    bool drawFlame;
+    FlameRenderer flame;
+
     // DirectX renderer
     DXRenderer renderer;
 
+    // Per-phase frame timing, shown in the title bar and optionally written out at exit
+    FrameStats frameStats;
+
+    // When each frame starts, late enough that the input and audio it shows are fresh at
+    // its present; its latencies go in the title bar and the CSV with the frame timing
+    FrameScheduler frameScheduler;
+    uint64_t lastStatsTime;
+    std::wstring statsCsvPath;
+
     // Private window procedure
     static LRESULT CALLBACK WindowProcStatic(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+    // Pose the cube fraction of the way from the previous update's scene to the latest
+    void InterpolateCube(float fraction);
+
+    // Rebuild the culling tree if the simulation's fractal instances changed
+    void UpdateFractal();
+
+    // Cull the fractal against the camera and upload what's visible
+    bool UploadVisibleFractal();
+
+    // Build and upload the merged mesh if it's shown and out of date
+    void UpdateMergedMesh();
+
+    // Re-mesh the isosurface with this update's band levels and upload it if it changed
+    void UpdateIsosurface();
+
+    // Render the backdrop with the latest update's band levels
+    void RenderBackdrop();
+
+    // Zoom the deep zoom backdrop on by this update's band levels
+    void UpdateDeepZoom(float deltaTime);
+
+    // Render the deep zoom backdrop at its latest view height
+    void RenderDeepZoom();
+
+    // Render the flame backdrop with the latest update's band levels
+    void RenderFlame();
+
+    // Fold recent frames into the statistics and refresh the title bar
+    void UpdateFrameStats();
+    bool WriteFrameStats();
+
 public:
     GameWindow();
     ~GameWindow();
     bool Initialize(HINSTANCE hInstance, int nCmdShow);
     void Run();
 
+    // Write frame statistics as CSV to this file when Run returns
+    void SetStatsCsvPath(const std::wstring& path);
+
+    // Fly the camera along the scripted path instead of the keyboard (before Initialize)
+    void SetScriptedCamera(bool scripted);
+
     // Game loop methods
     void Update(float deltaTime);
     void Render();
 };
 
-// Main window initialization function
-bool InitWindow(HINSTANCE hInstance, int nCmdShow);
\ No newline at end of file
+// Main window initialization function. Command line options:
+//   --stats-csv <path>   write frame timing statistics to <path> on exit
+//   --scripted           scripted camera path, for repeatable runs
+bool InitWindow(HINSTANCE hInstance, int nCmdShow, LPCWSTR commandLine);
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "Bench.h"
+#include "AudioCapture.h"
+#include "AudioRingBuffer.h"
+#include "PcmPipeSource.h"
+#include "SyntheticSource.h"
+#include "WavFileSource.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+    const int SAMPLE_RATE = 48000;
+    const int CHANNELS = 2;
+
+    // Frames the game loop drains per fixed 60 Hz update
+    const size_t FRAMES_PER_UPDATE = SAMPLE_RATE / 60;
+
+    void PrintStats(const char* label, const AudioCaptureStats& stats, uint64_t framesConsumed) {
+        double audioSeconds = static_cast<double>(stats.framesCaptured) / SAMPLE_RATE;
+        std::printf("  %-22s %10.2f Mframes/s  %8.1fx realtime  consumed %llu/%llu  overrun %llu  underrun %llu\n",
+            label,
+            stats.framesPerSecond * 1e-6,
+            stats.elapsedSeconds > 0.0 ? audioSeconds / stats.elapsedSeconds : 0.0,
+            static_cast<unsigned long long>(framesConsumed),
+            static_cast<unsigned long long>(stats.framesCaptured),
+            static_cast<unsigned long long>(stats.overrunFrames),
+            static_cast<unsigned long long>(stats.underrunFrames));
+    }
+
+    // Raw SPSC throughput: one producer thread against one consumer, no source overhead
+    void BenchRingBuffer(uint64_t totalFrames) {
+        AudioRingBuffer ring;
+        ring.Initialize(CHANNELS, 16384);
+
+        std::vector<float> producerBlock(256 * CHANNELS, 0.25f);
+        std::vector<float> consumerBlock(FRAMES_PER_UPDATE * CHANNELS);
+
+        double start = BenchNowSeconds();
+
+        std::thread producer([&]() {
+            uint64_t written = 0;
+            while (written < totalFrames) {
+                size_t n = ring.GetFreeFrames() >= 256 ? ring.Write(producerBlock.data(), 256) : 0;
+                if (n == 0) std::this_thread::yield();
+                written += n;
+            }
+        });
+
+        uint64_t read = 0;
+        while (read < totalFrames) {
+            size_t n = ring.Read(consumerBlock.data(), FRAMES_PER_UPDATE);
+            if (n == 0) std::this_thread::yield();
+            read += n;
+        }
+        producer.join();
+
+        double elapsed = BenchNowSeconds() - start;
+        std::printf("  %-22s %10.2f Mframes/s  (%llu frames, %.3f s)\n", "ring buffer spsc",
+            totalFrames / elapsed * 1e-6, static_cast<unsigned long long>(totalFrames), elapsed);
+    }
+
+    // Drive a capture to completion while draining like the game loop would.
+    // Unpaced runs drain as fast as possible; paced runs drain once per 60 Hz tick.
+    uint64_t RunCapture(const char* label, std::unique_ptr<AudioSource> source, bool paced, double maxSeconds) {
+        AudioCapture capture;
+        if (!capture.Start(std::move(source), paced, 0.5, 256)) {
+            std::printf("  %-22s could not open source\n", label);
+            return 0;
+        }
+
+        std::vector<float> frames(FRAMES_PER_UPDATE * CHANNELS);
+        uint64_t consumed = 0;
+        double start = BenchNowSeconds();
+        double nextTick = start;
+
+        while (BenchNowSeconds() - start < maxSeconds) {
+            if (paced) {
+                nextTick += 1.0 / 60.0;
+                while (BenchNowSeconds() < nextTick) std::this_thread::yield();
+                capture.Consume(frames.data(), FRAMES_PER_UPDATE);
+                consumed += FRAMES_PER_UPDATE;
+            }
+            else {
+                size_t n = capture.Drain(frames.data(), FRAMES_PER_UPDATE);
+                consumed += n;
+                if (n == 0) {
+                    if (capture.IsFinished() && capture.GetAvailableFrames() == 0) break;
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        AudioCaptureStats stats = capture.GetStats();
+        capture.Stop();
+        PrintStats(label, stats, consumed);
+        return stats.framesCaptured;
+    }
+
+    bool WriteTestWav(const char* path, double seconds) {
+        std::FILE* file = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&file, path, "wb") != 0) file = nullptr;
+#else
+        file = std::fopen(path, "wb");
+#endif
+        if (!file) return false;
+
+        uint32_t frames = static_cast<uint32_t>(seconds * SAMPLE_RATE);
+        uint32_t dataBytes = frames * CHANNELS * 2;
+        uint32_t riffSize = 36 + dataBytes;
+        uint16_t formatTag = 1, channels = CHANNELS, bits = 16, blockAlign = CHANNELS * 2;
+        uint32_t fmtSize = 16, rate = SAMPLE_RATE, byteRate = SAMPLE_RATE * CHANNELS * 2;
+
+        std::fwrite("RIFF", 1, 4, file); std::fwrite(&riffSize, 4, 1, file); std::fwrite("WAVE", 1, 4, file);
+        std::fwrite("fmt ", 1, 4, file); std::fwrite(&fmtSize, 4, 1, file);
+        std::fwrite(&formatTag, 2, 1, file); std::fwrite(&channels, 2, 1, file);
+        std::fwrite(&rate, 4, 1, file); std::fwrite(&byteRate, 4, 1, file);
+        std::fwrite(&blockAlign, 2, 1, file); std::fwrite(&bits, 2, 1, file);
+        std::fwrite("data", 1, 4, file); std::fwrite(&dataBytes, 4, 1, file);
+
+        std::vector<int16_t> block(1024 * CHANNELS);
+        for (uint32_t i = 0; i < frames; i += 1024) {
+            uint32_t n = frames - i < 1024 ? frames - i : 1024;
+            for (uint32_t j = 0; j < n; ++j) {
+                int16_t s = static_cast<int16_t>(16000.0 * std::sin(6.283185307 * 440.0 * (i + j) / SAMPLE_RATE));
+                block[j * 2] = s;
+                block[j * 2 + 1] = s;
+            }
+            std::fwrite(block.data(), 2 * CHANNELS, n, file);
+        }
+
+        std::fclose(file);
+        return true;
+    }
+
+    bool WriteTestPcm(const char* path, double seconds) {
+        std::FILE* file = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&file, path, "wb") != 0) file = nullptr;
+#else
+        file = std::fopen(path, "wb");
+#endif
+        if (!file) return false;
+
+        SyntheticSettings settings;
+        settings.signal = SyntheticSignal::WhiteNoise;
+        settings.durationSeconds = seconds;
+        SyntheticSource source(settings);
+        source.Open();
+
+        std::vector<float> block(1024 * CHANNELS);
+        size_t n;
+        while ((n = source.Read(block.data(), 1024)) > 0) {
+            std::fwrite(block.data(), sizeof(float) * CHANNELS, n, file);
+        }
+
+        std::fclose(file);
+        return true;
+    }
+}
+
+int RunAudioBench(const BenchOptions& options) {
+    const double audioSeconds = options.quick ? 60.0 : 600.0;
+    const double pacedSeconds = options.quick ? 1.0 : 5.0;
+    int failures = 0;
+
+    BenchRingBuffer(static_cast<uint64_t>(audioSeconds * SAMPLE_RATE));
+
+    // Unpaced synthetic source: the load test for the capture thread + ring buffer
+    SyntheticSettings synth;
+    synth.signal = SyntheticSignal::Sweep;
+    synth.durationSeconds = audioSeconds;
+    uint64_t expected = static_cast<uint64_t>(audioSeconds * SAMPLE_RATE);
+    if (RunCapture("synthetic unpaced", std::make_unique<SyntheticSource>(synth), false, 60.0) != expected) {
+        ++failures;
+    }
+
+    // Paced like a live device, drained at 60 Hz like GameWindow::Update
+    synth.durationSeconds = 0.0;
+    RunCapture("synthetic paced 60Hz", std::make_unique<SyntheticSource>(synth), true, pacedSeconds);
+
+    // WAV reader round trip
+    const char* wavPath = "FractalAudioVizBench_tmp.wav";
+    if (WriteTestWav(wavPath, audioSeconds / 4.0)) {
+        uint64_t wavFrames = static_cast<uint64_t>(audioSeconds / 4.0 * SAMPLE_RATE);
+        if (RunCapture("wav 16-bit unpaced", std::make_unique<WavFileSource>(wavPath), false, 60.0) != wavFrames) {
+            ++failures;
+        }
+        std::remove(wavPath);
+    }
+
+    // Raw PCM pipe, either user supplied or a generated file standing in for one
+    if (!options.pcmPath.empty()) {
+        RunCapture("pcm pipe (user)", std::make_unique<PcmPipeSource>(options.pcmPath, SAMPLE_RATE, CHANNELS, PcmSampleFormat::Float32), false, 3600.0);
+    }
+    else {
+        const char* pcmPath = "FractalAudioVizBench_tmp.f32";
+        if (WriteTestPcm(pcmPath, audioSeconds / 4.0)) {
+            uint64_t pcmFrames = static_cast<uint64_t>(audioSeconds / 4.0 * SAMPLE_RATE);
+            if (RunCapture("pcm f32 unpaced", std::make_unique<PcmPipeSource>(pcmPath, SAMPLE_RATE, CHANNELS, PcmSampleFormat::Float32), false, 60.0) != pcmFrames) {
+                ++failures;
+            }
+            std::remove(pcmPath);
+        }
+    }
+
+    return failures;
+}
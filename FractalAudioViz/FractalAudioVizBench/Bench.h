@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AudioSource;
+class JobSystem;
+class Simulation;
+
+// Options shared by all benchmark suites
+struct BenchOptions {
+    bool quick;              // Shorter runs, for smoke testing
+    std::string pcmPath;     // Optional raw float32 stereo 48 kHz input ("-" = stdin) or .wav file
+    int frames;              // Frames for the headless run, 0 = suite default
+
+    BenchOptions() : quick(false), frames(0) {}
+};
+
+// Seconds on the monotonic clock, for timing benchmark sections
+inline double BenchNowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The suites' audio: options.pcmPath when given (.wav, or raw float32 stereo 48 kHz),
+// otherwise a synthetic click track at tempoBpm (0 = SyntheticSource's default)
+std::unique_ptr<AudioSource> MakeBenchSource(const BenchOptions& options, float tempoBpm = 0.0f);
+
+// Initialize simulation on jobs (null = serial), reading MakeBenchSource's audio as fast
+// as it's updated; false, after saying so, if the source won't open
+bool CreateBenchSimulation(const BenchOptions& options, JobSystem* jobs, Simulation& simulation);
+
+// The value fraction (0-1) of the way through values, by nearest rank
+double BenchPercentile(std::vector<double> values, double fraction);
+
+// Benchmark suites; each prints its own report and returns non-zero on failure
+int RunAudioBench(const BenchOptions& options);
+int RunFFTBench(const BenchOptions& options);
+int RunFilterbankBench(const BenchOptions& options);
+int RunOnsetBench(const BenchOptions& options);
+int RunFractalBench(const BenchOptions& options);
+int RunUploadBench(const BenchOptions& options);
+int RunQueueBench(const BenchOptions& options);
+int RunFrameStatsBench(const BenchOptions& options);
+int RunHeadlessBench(const BenchOptions& options);
+int RunJobsBench(const BenchOptions& options);
+int RunCullBench(const BenchOptions& options);
+int RunLodBench(const BenchOptions& options);
+int RunMeshBench(const BenchOptions& options);
+int RunVertexBench(const BenchOptions& options);
+int RunOptimizeBench(const BenchOptions& options);
+int RunDistanceBench(const BenchOptions& options);
+int RunIsosurfaceBench(const BenchOptions& options);
+int RunEscapeBench(const BenchOptions& options);
+int RunDeepZoomBench(const BenchOptions& options);
+int RunFlameBench(const BenchOptions& options);
+int RunLSystemBench(const BenchOptions& options);
+int RunShaderCacheBench(const BenchOptions& options);
+int RunTimelineBench(const BenchOptions& options);
+int RunSchedulerBench(const BenchOptions& options);
+int RunModulationBench(const BenchOptions& options);
@@ -0,0 +1,146 @@
+// BenchMain.cpp : Headless benchmark runner for the platform-neutral subsystems.
+//
+// Builds with the FractalAudioViz solution on Windows. On Linux, from this directory:
+//   g++ -std=c++14 -O2 -pthread -I../FractalAudioViz -o FractalAudioVizBench *.cpp $(sed -n 's/.*ClCompile Include="\(\.\.\\FractalAudioViz\\[^"]*\)".*/\1/p' FractalAudioVizBench.vcxproj | tr '\\' '/')
+//
+// (the sed pulls the shared sources out of the project file, so it stays the one list to maintain)
+//
+// Usage: FractalAudioVizBench [--quick] [--pcm <path|->] [--frames <n>] [suite ...]
+
+#include "Bench.h"
+#include "PcmPipeSource.h"
+#include "Simulation.h"
+#include "SyntheticSource.h"
+#include "WavFileSource.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+    struct BenchSuite {
+        const char* name;
+        int (*run)(const BenchOptions& options);
+        const char* description;
+    };
+
+    const BenchSuite SUITES[] = {
+        { "audio", RunAudioBench, "Ring buffer and capture thread ingest throughput" },
+        { "fft", RunFFTBench, "Real FFT accuracy and transforms/sec per size and ISA, STFT throughput" },
+        { "filterbank", RunFilterbankBench, "Sparse band filterbank vs dense matrix at 8k bins" },
+        { "onset", RunOnsetBench, "Onset and beat tracking accuracy, latency and CPU on click tracks" },
+        { "fractal", RunFractalBench, "Menger/Sierpinski instance generation, serial vs parallel" },
+        { "upload", RunUploadBench, "Constant upload arena against a simulated GPU: cost, discards, overwrite check" },
+        { "queue", RunQueueBench, "Draw packet recording, radix sort and cached replay into a recording backend" },
+        { "framestats", RunFrameStatsBench, "Frame phase scope overhead, histogram percentile error, cross-thread collection" },
+        { "headless", RunHeadlessBench, "Scripted camera and audio through the simulation and render queue: frame times, subsystem costs" },
+        { "jobs", RunJobsBench, "Work-stealing job system: job overhead and 1..N thread scaling on fractal, transforms, audio, frame graph" },
+        { "cull", RunCullBench, "Frustum culling 1M instances through a Morton-ordered 4-wide tree, per ISA, against brute force" },
+        { "lod", RunLodBench, "Fractal level of detail along a camera path: instances and update times against a fixed-depth build" },
+        { "mesh", RunMeshBench, "Merged exterior mesh of the fractal: triangles against instanced cubes, build times, closure" },
+        { "vertex", RunVertexBench, "Packed vertex format: memory against float vertices, packing throughput per ISA, accuracy" },
+        { "optimize", RunOptimizeBench, "Vertex cache, overdraw and fetch ordering of fractal meshes: ACMR/ATVR, overdraw, throughput" },
+        { "distance", RunDistanceBench, "Vectorized Mandelbulb, Mandelbox and IFS distance estimators: points/s per level, error vs double" },
+        { "isosurface", RunIsosurfaceBench, "Chunked marching cubes of distance fields: triangles/s, closure, chunks re-meshed under music" },
+        { "escape", RunEscapeBench, "Tiled SIMD Mandelbrot and Julia images: Mpixels/s at 1080p and 4K, progressive refinement in a budget" },
+        { "deepzoom", RunDeepZoomBench, "Perturbation deep zoom to 1e-100: frame times per depth, series skip, rebases, accuracy vs double" },
+        { "flame", RunFlameBench, "Chaos-game fractal flames: points/s per level and 1..N threads, histogram merge, memory per resolution" },
+        { "lsystem", RunLSystemBench, "Parallel L-system trees: rewrite and turtle symbols/s for generations 6-10, peak memory, vs serial" },
+        { "shadercache", RunShaderCacheBench, "Shader bytecode pack with a stub compiler: cold and warm start, parallel compile, invalidation" },
+        { "timeline", RunTimelineBench, "Audio-clock timeline against wall-clock stepping: sync error and drift over hour-long drifting clocks" },
+        { "scheduler", RunSchedulerBench, "Latency-aware frame scheduling on a simulated display: input and audio to present, missed vblanks" },
+        { "modulation", RunModulationBench, "Compiled modulation matrix: per-update cost per ISA for thousands of routes into per-instance targets" },
+    };
+
+    void PrintUsage() {
+        std::printf("Usage: FractalAudioVizBench [--quick] [--pcm <path|->] [--frames <n>] [suite ...]\n\nSuites:\n");
+        for (const BenchSuite& suite : SUITES) {
+            std::printf("  %-12s %s\n", suite.name, suite.description);
+        }
+    }
+}
+
+std::unique_ptr<AudioSource> MakeBenchSource(const BenchOptions& options, float tempoBpm) {
+    const std::string& path = options.pcmPath;
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".wav") == 0) {
+        return std::make_unique<WavFileSource>(path);
+    }
+    if (!path.empty()) {
+        return std::make_unique<PcmPipeSource>(path, 48000, 2, PcmSampleFormat::Float32);
+    }
+
+    SyntheticSettings settings;
+    settings.signal = SyntheticSignal::ClickTrack;
+    if (tempoBpm > 0.0f) settings.tempoBpm = tempoBpm;
+    return std::make_unique<SyntheticSource>(settings);
+}
+
+bool CreateBenchSimulation(const BenchOptions& options, JobSystem* jobs, Simulation& simulation) {
+    SimulationSettings settings;
+    settings.liveAudio = false;
+    simulation.SetJobSystem(jobs);
+    if (!simulation.Initialize(settings, MakeBenchSource(options))) {
+        std::printf("  could not open the audio source (%s)\n",
+            options.pcmPath.empty() ? "synthetic" : options.pcmPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+double BenchPercentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    std::vector<const BenchSuite*> selected;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        }
+        else if (std::strcmp(argv[i], "--pcm") == 0 && i + 1 < argc) {
+            options.pcmPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--help") == 0) {
+            PrintUsage();
+            return 0;
+        }
+        else {
+            const BenchSuite* match = nullptr;
+            for (const BenchSuite& suite : SUITES) {
+                if (std::strcmp(argv[i], suite.name) == 0) match = &suite;
+            }
+            if (!match) {
+                std::printf("Unknown suite or option: %s\n\n", argv[i]);
+                PrintUsage();
+                return 1;
+            }
+            selected.push_back(match);
+        }
+    }
+
+    // Run everything if no suite was named
+    if (selected.empty()) {
+        for (const BenchSuite& suite : SUITES) {
+            selected.push_back(&suite);
+        }
+    }
+
+    int failures = 0;
+    for (const BenchSuite* suite : selected) {
+        std::printf("=== %s ===\n", suite->name);
+        if (suite->run(options) != 0) {
+            std::printf("%s: FAILED\n", suite->name);
+            ++failures;
+        }
+        std::printf("\n");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
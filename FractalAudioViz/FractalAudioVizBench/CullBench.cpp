@@ -0,0 +1,159 @@
+#include "Bench.h"
+#include "CameraPath.h"
+#include "FractalGenerator.h"
+#include "InstanceCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    // Camera's projection: 45 degrees vertical, 16:9, 0.1 to 1000
+    const float FIELD_OF_VIEW = 0.785398163f;
+    const float ASPECT_RATIO = 16.0f / 9.0f;
+    const float NEAR_PLANE = 0.1f;
+    const float FAR_PLANE = 1000.0f;
+
+    // View * projection for a pose, the way Camera builds it (LookAtLH along the pitch/yaw
+    // forward vector, PerspectiveFovLH), as a row-vector matrix
+    void BuildViewProjection(const CameraPose& pose, float out[16]) {
+        float pitch = pose.rotation[0], yaw = pose.rotation[1];
+        float forward[3] = { std::sin(yaw) * std::cos(pitch), -std::sin(pitch), std::cos(yaw) * std::cos(pitch) };
+
+        // Right = up x forward, up' = forward x right
+        float right[3] = { forward[2], 0.0f, -forward[0] };
+        float length = std::sqrt(right[0] * right[0] + right[2] * right[2]);
+        right[0] /= length;
+        right[2] /= length;
+        float up[3] = {
+            forward[1] * right[2] - forward[2] * right[1],
+            forward[2] * right[0] - forward[0] * right[2],
+            forward[0] * right[1] - forward[1] * right[0]
+        };
+        const float* eye = pose.position;
+
+        float view[16] = {
+            right[0], up[0], forward[0], 0.0f,
+            right[1], up[1], forward[1], 0.0f,
+            right[2], up[2], forward[2], 0.0f,
+            -(right[0] * eye[0] + right[1] * eye[1] + right[2] * eye[2]),
+            -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]),
+            -(forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2]), 1.0f
+        };
+
+        float yScale = 1.0f / std::tan(FIELD_OF_VIEW * 0.5f);
+        float xScale = yScale / ASPECT_RATIO;
+        float range = FAR_PLANE / (FAR_PLANE - NEAR_PLANE);
+        float projection[16] = {
+            xScale, 0.0f, 0.0f, 0.0f,
+            0.0f, yScale, 0.0f, 0.0f,
+            0.0f, 0.0f, range, 1.0f,
+            0.0f, 0.0f, -range * NEAR_PLANE, 0.0f
+        };
+
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k) sum += view[r * 4 + k] * projection[k * 4 + c];
+                out[r * 4 + c] = sum;
+            }
+        }
+    }
+
+    // Every instance against every plane, the answer the tree has to reproduce
+    size_t CullBruteForce(const FractalInstances& instances, const Frustum& frustum, std::vector<uint32_t>& visible) {
+        size_t written = 0;
+        for (size_t i = 0; i < instances.count; ++i) {
+            bool outside = false;
+            for (int p = 0; p < Frustum::PlaneCount; ++p) {
+                const float* plane = frustum.planes[p];
+                float reach = std::fabs(plane[0]) + std::fabs(plane[1]) + std::fabs(plane[2]);
+                float distance = plane[0] * instances.x[i] + plane[1] * instances.y[i] + plane[2] * instances.z[i] + plane[3];
+                outside |= distance + instances.scale[i] * reach < 0.0f;
+            }
+            if (!outside) visible[written++] = static_cast<uint32_t>(i);
+        }
+        return written;
+    }
+}
+
+int RunCullBench(const BenchOptions& options) {
+    const int frames = options.quick ? 60 : 600;
+    int failures = 0;
+
+    // A depth 10 Sierpinski tetrahedron: 1,048,576 cubes
+    FractalSettings settings;
+    settings.type = FractalType::Sierpinski;
+    settings.depth = 10;
+    FractalInstances instances;
+    FractalGenerator::Generate(settings, instances);
+
+    // Swinging in close enough that the frustum cuts through the fractal, and out again
+    const float radius = 1.5f, swing = 1.1f;
+    CameraPath path = CameraPath::Orbit(radius, swing, 0.8f, 8, 10.0f);
+
+    std::printf("  %zu instances, %d frames on an orbit %.1f to %.1f units out\n", instances.count, frames,
+        radius - swing, radius + swing);
+    std::printf("  %-7s | %8s %6s | %8s %8s %8s | %7s %7s %8s | %8s | %s\n", "simd", "build ms", "nodes",
+        "cull p50", "p99 us", "brute us", "visited", "culled", "tested", "visible", "check");
+
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX };
+    std::vector<uint32_t> reference(instances.count);
+    FractalInstances gathered;
+    double gatherTime = 0.0;
+    size_t gatheredTotal = 0;
+
+    for (SimdLevel level : levels) {
+        if (ResolveSimdLevel(level) != level) continue;
+
+        InstanceCuller culler;
+        double start = BenchNowSeconds();
+        culler.Build(instances, level);
+        double buildTime = BenchNowSeconds() - start;
+        const FractalInstances& sorted = culler.GetSortedInstances();
+
+        std::vector<double> cullTimes, bruteTimes;
+        double visited = 0.0, culled = 0.0, tested = 0.0, visible = 0.0;
+        bool ok = sorted.count == instances.count;
+        for (int frame = 0; frame < frames && ok; ++frame) {
+            float matrix[16];
+            BuildViewProjection(path.Evaluate(10.0 * frame / frames), matrix);
+            Frustum frustum = Frustum::FromMatrix(matrix);
+
+            start = BenchNowSeconds();
+            size_t count = culler.Cull(frustum);
+            cullTimes.push_back(BenchNowSeconds() - start);
+
+            start = BenchNowSeconds();
+            size_t referenceCount = CullBruteForce(sorted, frustum, reference);
+            bruteTimes.push_back(BenchNowSeconds() - start);
+
+            ok = count == referenceCount && std::equal(reference.begin(), reference.begin() + count, culler.GetVisible());
+
+            const CullStats& stats = culler.GetStats();
+            visited += stats.nodesVisited;
+            culled += stats.boxesCulled;
+            tested += stats.instancesTested;
+            visible += stats.visible;
+
+            if (level == levels[0]) {
+                start = BenchNowSeconds();
+                culler.GatherVisible(gathered);
+                gatherTime += BenchNowSeconds() - start;
+                gatheredTotal += gathered.count;
+            }
+        }
+        if (!ok) ++failures;
+
+        std::printf("  %-7s | %8.1f %6zu | %8.1f %8.1f %8.1f | %7.0f %7.0f %8.0f | %7.1f%% | %s\n",
+            GetSimdLevelName(level), buildTime * 1e3, culler.GetNodeCount(),
+            BenchPercentile(cullTimes, 0.5) * 1e6, BenchPercentile(cullTimes, 0.99) * 1e6,
+            BenchPercentile(bruteTimes, 0.5) * 1e6,
+            visited / frames, culled / frames, tested / frames, 100.0 * visible / (frames * static_cast<double>(instances.count)),
+            ok ? "identical" : "MISMATCH");
+    }
+
+    std::printf("  gather for upload: %.2f ms per frame, %.0f instances\n",
+        gatherTime / frames * 1e3, static_cast<double>(gatheredTotal) / frames);
+    return failures;
+}
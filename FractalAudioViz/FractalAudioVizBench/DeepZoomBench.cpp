@@ -0,0 +1,198 @@
+#include "Bench.h"
+#include "DeepZoom.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+    // Smoothed escape counts of the renderer's view around c = i iterated directly in
+    // doubles, as the renderer places its pixels
+    std::vector<float> DirectValues(const DeepZoomRenderer& renderer, double viewHeight) {
+        const size_t width = renderer.GetWidth(), height = renderer.GetHeight();
+        const double pixelSize = viewHeight / height;
+        const int maxIterations = renderer.GetMaxIterations(viewHeight);
+        std::vector<float> values(width * height);
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                double cx = (static_cast<double>(x) + 0.5 - 0.5 * width) * pixelSize;
+                double cy = 1.0 + (0.5 * height - 0.5 - static_cast<double>(y)) * pixelSize;
+                double zx = 0.0, zy = 0.0, r2 = 0.0;
+                int n = 0;
+                for (; n < maxIterations && r2 <= 65536.0; ++n) {
+                    double nextX = zx * zx - zy * zy + cx;
+                    zy = 2.0 * zx * zy + cy;
+                    zx = nextX;
+                    r2 = zx * zx + zy * zy;
+                }
+                values[y * width + x] = r2 > 65536.0 ?
+                    static_cast<float>(n + 1.0 - std::log2(0.5 * std::log2(r2))) : -1.0f;
+            }
+        }
+        return values;
+    }
+
+    // Fraction of pixels within 0.01 of the direct escape values, or inside for both
+    double Agreement(const DeepZoomRenderer& renderer, const std::vector<float>& expected) {
+        const float* values = renderer.GetValues();
+        size_t agree = 0;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            bool bothInside = expected[i] < 0.0f && values[i] < 0.0f;
+            agree += bothInside || std::fabs(expected[i] - values[i]) < 0.01f;
+        }
+        return static_cast<double>(agree) / expected.size();
+    }
+}
+
+int RunDeepZoomBench(const BenchOptions& options) {
+    int failures = 0;
+    JobSystem jobs;
+    jobs.Initialize();
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    // Where doubles still resolve the pixels, perturbation against iterating them directly:
+    // every level with the series and rebasing, then without each
+    const double checkHeight = 1e-10;
+    {
+        DeepZoomSettings settings;
+        settings.width = 640;
+        settings.height = 360;
+        DeepZoomRenderer renderer;
+        renderer.Initialize(settings);
+        const std::vector<float> expected = DirectValues(renderer, checkHeight);
+
+        std::printf("  at 640x360, view height %.0e around c = i: escape values within 0.01 of direct doubles\n",
+            checkHeight);
+        std::printf("  %-22s | %9s %8s %9s | %s\n", "variant", "agreement", "skipped", "rebases", "check");
+        struct Variant {
+            const char* name;
+            SimdLevel level;
+            bool series;
+            bool rebase;
+            bool checked;
+        };
+        const Variant variants[] = {
+            { "scalar", SimdLevel::Scalar, true, true, true },
+            { "SSE2", SimdLevel::SSE2, true, true, true },
+            { "AVX2", SimdLevel::AVX2, true, true, true },
+            { "AVX-512", SimdLevel::AVX512, true, true, true },
+            { "best, no series", SimdLevel::AVX512, false, true, true },
+            { "best, no rebasing", SimdLevel::AVX512, true, false, false },
+        };
+        for (const Variant& variant : variants) {
+            if (ResolveSimdLevel(variant.level) != variant.level && variant.level != SimdLevel::AVX512) {
+                std::printf("  %-22s | %9s\n", variant.name, "-");
+                continue;
+            }
+            settings.maxSimdLevel = variant.level;
+            settings.series = variant.series;
+            settings.rebase = variant.rebase;
+            renderer.Initialize(settings);
+            renderer.Render(checkHeight, &jobs);
+            double agreement = Agreement(renderer, expected);
+            bool ok = !variant.checked || agreement >= 0.99;
+            if (!ok) ++failures;
+            std::printf("  %-22s | %8.2f%% %8zu %9llu | %s\n", variant.name, 100.0 * agreement,
+                renderer.GetStats().skipped, static_cast<unsigned long long>(renderer.GetStats().rebases),
+                !variant.checked ? "shown" : ok ? "ok" : "DIFFERS");
+        }
+        std::printf("  without rebasing only the reference's end restarts a pixel, so those that pass near 0\n");
+        std::printf("  lose their precision; that one isn't checked\n\n");
+    }
+
+    // A full frame at each depth from scratch, so the reference is computed too
+    const double depths[] = { 1e-10, 1e-20, 1e-50, 1e-100 };
+    const size_t width = 1920, height = 1080;
+    std::printf("  %zux%zu frames on %u worker threads: reference, series and pixel ms at the best level,\n",
+        width, height, static_cast<unsigned>(jobs.GetThreadCount()));
+    std::printf("  then pixel ms per level, and at the best level without the series\n");
+    std::printf("  %-7s %5s %6s | %8s %7s %7s %9s %8s %8s |", "height", "bits", "limit", "ref ms", "ser ms", "skipped",
+        "Miter/s", "rebases", "frame ms");
+    for (SimdLevel level : levels) std::printf(" %8s", GetSimdLevelName(level));
+    std::printf(" | %9s\n", "no series");
+    for (double depth : depths) {
+        DeepZoomSettings settings;
+        settings.width = width;
+        settings.height = height;
+
+        std::vector<double> levelSeconds;
+        for (SimdLevel level : levels) {
+            if (ResolveSimdLevel(level) != level || (options.quick && level == SimdLevel::Scalar)) {
+                levelSeconds.push_back(-1.0);
+                continue;
+            }
+            settings.maxSimdLevel = level;
+            DeepZoomRenderer renderer;
+            renderer.Initialize(settings);
+            renderer.Render(depth, &jobs);
+            const DeepZoomStats& stats = renderer.GetStats();
+            levelSeconds.push_back(stats.seconds - stats.referenceSeconds - stats.seriesSeconds);
+        }
+
+        settings.maxSimdLevel = SimdLevel::AVX512;
+        DeepZoomRenderer renderer;
+        renderer.Initialize(settings);
+        renderer.Render(depth, &jobs);
+        const DeepZoomStats stats = renderer.GetStats();
+        double pixelSeconds = stats.seconds - stats.referenceSeconds - stats.seriesSeconds;
+
+        renderer.SetSeries(false);
+        renderer.Render(depth, &jobs);
+        const DeepZoomStats plain = renderer.GetStats();
+
+        std::printf("  %-7.0e %5zu %6d | %8.2f %7.2f %7zu %9.1f %8llu %8.1f |", depth, stats.precisionBits,
+            stats.maxIterations, stats.referenceSeconds * 1e3, stats.seriesSeconds * 1e3, stats.skipped,
+            stats.iterations / pixelSeconds * 1e-6, static_cast<unsigned long long>(stats.rebases), stats.seconds * 1e3);
+        for (double seconds : levelSeconds) {
+            if (seconds < 0.0) std::printf(" %8s", "-");
+            else std::printf(" %8.1f", seconds * 1e3);
+        }
+        std::printf(" | %9.1f\n", (plain.seconds - plain.seriesSeconds) * 1e3);
+    }
+    std::printf("  limit: iteration limit; skipped: iterations the series stood in for\n");
+
+    // The music driving the zoom, sped up to cross the whole range in a few seconds: the
+    // reference is computed again each time the zoom needs more bits
+    const int frames = options.frames > 0 ? options.frames : options.quick ? 120 : 600;
+    Simulation simulation;
+    if (!CreateBenchSimulation(options, &jobs, simulation)) {
+        jobs.Shutdown();
+        return failures + 1;
+    }
+
+    DeepZoomModulation modulation;
+    modulation.baseRate = 20.0;
+    modulation.levelRate = 200.0;
+    DeepZoomSettings settings;
+    settings.width = 640;
+    settings.height = 360;
+    DeepZoomRenderer renderer;
+    renderer.Initialize(settings);
+
+    double viewHeight = modulation.startHeight, deepest = viewHeight, decades = 0.0;
+    size_t references = 0;
+    std::vector<double> frameMs;
+    for (int frame = 0; frame < frames; ++frame) {
+        simulation.Update(FIXED_TIMESTEP);
+        double next = DeepZoomRenderer::Zoom(viewHeight, simulation.GetBandEnergies(), FIXED_TIMESTEP, modulation);
+        if (next < viewHeight) decades += std::log10(viewHeight / next);
+        viewHeight = next;
+        deepest = std::min(deepest, viewHeight);
+        renderer.Render(viewHeight, &jobs);
+        references += renderer.GetStats().referenceSeconds > 0.0;
+        frameMs.push_back(renderer.GetStats().seconds * 1e3);
+    }
+    std::printf("\n  zoom under %s at 640x360, %d frames at %.0f + %.0f x level decades/s:\n",
+        options.pcmPath.empty() ? "a click track" : options.pcmPath.c_str(), frames, modulation.baseRate,
+        modulation.levelRate);
+    std::printf("  %.1f decades zoomed, deepest %.0e, %zu references; frame p50 %.2fms p99 %.2fms max %.2fms\n",
+        decades, deepest, references, BenchPercentile(frameMs, 0.5), BenchPercentile(frameMs, 0.99),
+        BenchPercentile(frameMs, 1.0));
+
+    simulation.Shutdown();
+    jobs.Shutdown();
+    return failures;
+}
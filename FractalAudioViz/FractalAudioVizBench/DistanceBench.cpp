@@ -0,0 +1,162 @@
+#include "Bench.h"
+#include "DistanceEstimator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    struct Points {
+        std::vector<float> x, y, z;
+    };
+
+    // Uniform in the cube of half size extent around the origin
+    Points MakePoints(size_t count, float extent, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> uniform(-extent, extent);
+        Points points;
+        points.x.resize(count);
+        points.y.resize(count);
+        points.z.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            points.x[i] = uniform(random);
+            points.y[i] = uniform(random);
+            points.z[i] = uniform(random);
+        }
+        return points;
+    }
+
+    double EvaluateSeconds(const DistanceParams& params, const Points& points, std::vector<float>& out,
+        SimdLevel level, int repeats) {
+        double best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            double start = BenchNowSeconds();
+            DistanceEstimator::Evaluate(params, points.x.data(), points.y.data(), points.z.data(), out.size(),
+                out.data(), level);
+            best = std::min(best, BenchNowSeconds() - start);
+        }
+        return best;
+    }
+
+    // Relative to max(|expected|, 1e-3), at the 50th, 99th and 99.9th percentile
+    struct ErrorPercentiles {
+        double median, p99, p999;
+    };
+
+    ErrorPercentiles MeasureError(std::vector<double>& errors) {
+        std::sort(errors.begin(), errors.end());
+        ErrorPercentiles result = { errors[errors.size() / 2], errors[errors.size() * 99 / 100],
+            errors[errors.size() * 999 / 1000] };
+        return result;
+    }
+
+    double RelativeError(double value, double expected) {
+        return std::fabs(value - expected) / std::max(std::fabs(expected), 1e-3);
+    }
+
+    // A frame of loud bass, moderate mids and quiet treble
+    BandEnergies MakeBands() {
+        BandEnergies bands;
+        const size_t count = 64;
+        bands.power.assign(count, 0.0f);
+        bands.centerFrequency.assign(count, 0.0f);
+        bands.decibels.resize(count);
+        for (size_t band = 0; band < count; ++band) {
+            bands.decibels[band] = band < count / 8 ? -15.0f : (band < count / 2 ? -45.0f : -70.0f);
+        }
+        return bands;
+    }
+}
+
+int RunDistanceBench(const BenchOptions& options) {
+    int failures = 0;
+
+    struct Case {
+        const char* name;
+        DistanceParams params;
+        float extent;  // Sampled cube half size, around the fractal's bounds
+    };
+    const BandEnergies bands = MakeBands();
+    DistanceParams general;
+    general.specialize = false;
+    DistanceParams power3;
+    power3.power = 3.0f;
+    DistanceParams box(DistanceFractal::Mandelbox);
+    DistanceParams inwardBox(DistanceFractal::Mandelbox);
+    inwardBox.scale = -1.5f;
+    DistanceParams ifs(DistanceFractal::KaleidoscopicIFS);
+    DistanceParams odd(DistanceFractal::KaleidoscopicIFS);
+    odd.iterations = 10;
+    const Case cases[] = {
+        { "Mandelbulb 8", DistanceParams(), 1.3f },
+        { "Mandelbulb 8 general", general, 1.3f },
+        { "Mandelbulb 3", power3, 1.3f },
+        { "Mandelbulb modulated", DistanceEstimator::Modulate(DistanceParams(), bands), 1.3f },
+        { "Mandelbox 2", box, 6.0f },
+        { "Mandelbox -1.5", inwardBox, 2.5f },
+        { "Menger IFS", ifs, 1.2f },
+        { "IFS 10 modulated", DistanceEstimator::Modulate(odd, bands), 1.2f },
+    };
+
+    // An odd count, so every level runs a padded tail
+    const size_t count = options.quick ? (1 << 16) + 5 : (1 << 18) + 5;
+    const size_t referenceCount = options.quick ? 4096 : 16384;
+    const int repeats = options.quick ? 2 : 5;
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    std::printf("  %zu points per case; Mpoints/s per level, then the distance error against the double\n", count);
+    std::printf("  reference over %zu points, relative to max(|reference|, 1e-3)\n\n", referenceCount);
+    std::printf("  %-21s %-5s %-6s |", "case", "kind", "power");
+    for (SimdLevel level : levels) std::printf(" %8s", GetSimdLevelName(level));
+    std::printf(" %8s | %9s | %9s %9s %9s | %s\n", "speedup", "levels", "median", "99%", "99.9%", "check");
+
+    for (const Case& c : cases) {
+        Points points = MakePoints(count, c.extent, 11);
+        std::vector<float> reference(count), out(count);
+        double scalarSeconds = EvaluateSeconds(c.params, points, reference, SimdLevel::Scalar, repeats);
+
+        char power[16];
+        std::snprintf(power, sizeof(power), "%.3g", c.params.type == DistanceFractal::Mandelbulb ? c.params.power :
+            c.params.scale);
+        std::printf("  %-21s %-5s %-6s |", c.name, DistanceEstimator::IsSpecialized(c.params) ? "fixed" : "loop", power);
+
+        // Every level against the scalar kernel. The FMA levels round differently, which
+        // matters as much as float against double does.
+        double levelError = 0.0;
+        double bestSeconds = scalarSeconds;
+        std::vector<double> errors(count);
+        for (SimdLevel level : levels) {
+            if (ResolveSimdLevel(level) != level) {
+                std::printf(" %8s", "-");
+                continue;
+            }
+            double seconds = scalarSeconds;
+            if (level != SimdLevel::Scalar) {
+                seconds = EvaluateSeconds(c.params, points, out, level, repeats);
+                for (size_t i = 0; i < count; ++i) errors[i] = RelativeError(out[i], reference[i]);
+                levelError = std::max(levelError, MeasureError(errors).p99);
+            }
+            bestSeconds = std::min(bestSeconds, seconds);
+            std::printf(" %8.1f", count / seconds * 1e-6);
+        }
+
+        // Accuracy. Points right at the boundary can escape an iteration apart in float and
+        // double, so the tolerance is on the 99th percentile, not the worst point.
+        errors.resize(referenceCount);
+        for (size_t i = 0; i < referenceCount; ++i) {
+            errors[i] = RelativeError(reference[i],
+                DistanceEstimator::EvaluateReference(c.params, points.x[i], points.y[i], points.z[i]));
+        }
+        ErrorPercentiles error = MeasureError(errors);
+
+        bool consistent = levelError < 1e-3;
+        bool accurate = error.median < 1e-5 && error.p99 < 1e-3;
+        if (!consistent || !accurate) ++failures;
+        std::printf(" %7.1fx | %9.2g | %9.2g %9.2g %9.2g | %s\n", scalarSeconds / bestSeconds, levelError,
+            error.median, error.p99, error.p999, !consistent ? "LEVELS DIFFER" : !accurate ? "INACCURATE" : "ok");
+    }
+    std::printf("  kind: fixed = power and iteration count unrolled, loop = general kernel; power column shows\n");
+    std::printf("  the Mandelbox and IFS scale; levels: 99th percentile difference of any level from scalar\n");
+    return failures;
+}
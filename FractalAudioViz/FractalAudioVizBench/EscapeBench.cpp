@@ -0,0 +1,215 @@
+#include "Bench.h"
+#include "EscapeTime.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+    bool SameImage(const EscapeTimeRenderer& a, const EscapeTimeRenderer& b) {
+        return a.GetWidth() == b.GetWidth() && a.GetHeight() == b.GetHeight() &&
+            std::memcmp(a.GetPixels(), b.GetPixels(), a.GetWidth() * a.GetHeight() * sizeof(uint32_t)) == 0;
+    }
+
+    // Fraction of pixels whose escape values at two levels are within 0.01 of each other,
+    // or inside for both
+    double LevelAgreement(const EscapeParams& params, size_t width, size_t height, SimdLevel level,
+        SimdLevel reference) {
+        std::vector<float> expected(width), values(width);
+        size_t agree = 0;
+        for (size_t y = 0; y < height; ++y) {
+            EscapeTimeRenderer::EvaluateRow(params, width, height, 0, y, 1, width, expected.data(), reference);
+            EscapeTimeRenderer::EvaluateRow(params, width, height, 0, y, 1, width, values.data(), level);
+            for (size_t x = 0; x < width; ++x) {
+                bool bothInside = expected[x] < 0.0f && values[x] < 0.0f;
+                agree += bothInside || std::fabs(expected[x] - values[x]) < 0.01f;
+            }
+        }
+        return static_cast<double>(agree) / (width * height);
+    }
+}
+
+int RunEscapeBench(const BenchOptions& options) {
+    int failures = 0;
+    JobSystem jobs;
+    jobs.Initialize();
+
+    struct Case {
+        const char* name;
+        EscapeParams params;
+    };
+    EscapeParams seahorse;
+    seahorse.centerX = -0.745f;
+    seahorse.centerY = 0.11f;
+    seahorse.viewHeight = 0.02f;
+    seahorse.maxIterations = 1024;
+    const Case cases[] = {
+        { "Mandelbrot", EscapeParams() },
+        { "Mandelbrot seahorse", seahorse },
+        { "Julia", EscapeParams(EscapeFractal::Julia) },
+    };
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    // Each level against the one that rounds like it: SSE2 against scalar, AVX-512 against
+    // AVX2, which fuse their multiply-adds. Across the two, rounding apart near the set's
+    // boundary moves where orbits escape, so that's shown but not checked. Then the image
+    // refined tile by tile against the same image computed in one pass.
+    std::printf("  at 640x360: escape values within 0.01 of the level rounding alike; progressive image against direct\n");
+    std::printf("  %-20s |", "case");
+    for (SimdLevel level : levels) std::printf(" %8s", GetSimdLevelName(level));
+    std::printf(" | %8s | %7s %11s | %s\n", "fma/not", "renders", "progressive", "check");
+    for (const Case& c : cases) {
+        const size_t width = 640, height = 360;
+        std::printf("  %-20s |", c.name);
+        double worst = 1.0;
+        for (SimdLevel level : levels) {
+            if (ResolveSimdLevel(level) != level) {
+                std::printf(" %8s", "-");
+                continue;
+            }
+            SimdLevel reference = level >= SimdLevel::AVX2 ? SimdLevel::AVX2 : SimdLevel::Scalar;
+            double agreement = LevelAgreement(c.params, width, height, level, reference);
+            worst = std::min(worst, agreement);
+            std::printf(" %7.2f%%", 100.0 * agreement);
+        }
+        if (ResolveSimdLevel(SimdLevel::AVX2) == SimdLevel::AVX2) {
+            std::printf(" | %7.2f%%", 100.0 * LevelAgreement(c.params, width, height, SimdLevel::AVX2, SimdLevel::Scalar));
+        }
+        else {
+            std::printf(" | %8s", "-");
+        }
+
+        EscapeSettings settings;
+        settings.width = width;
+        settings.height = height;
+        settings.threadCount = 1;
+        EscapeTimeRenderer direct, progressive;
+        direct.Initialize(settings);
+        direct.Render(c.params);
+
+        // A budget too small for anything but the pass each Render always runs: the
+        // whole image at the coarsest spacing, then one tile at a time
+        settings.budgetSeconds = 1e-9;
+        progressive.Initialize(settings);
+        progressive.Render(c.params, &jobs);
+        bool coarseFirst = progressive.GetStats().stride == EscapeTimeRenderer::COARSEST_STRIDE;
+        size_t renders = 1;
+        while (progressive.GetStats().stride != 1 && renders < 1000) {
+            progressive.Render(c.params, &jobs);
+            ++renders;
+        }
+        bool same = SameImage(direct, progressive);
+
+        const size_t expectedRenders = 1 + 3 * progressive.GetStats().tiles;
+        bool ok = worst == 1.0 && same && coarseFirst && renders == expectedRenders;
+        if (!ok) ++failures;
+        std::printf(" | %7zu %11s | %s\n", renders, same ? "identical" : "DIFFERS",
+            worst < 1.0 ? "LEVELS DIFFER" : !same ? "PROGRESSIVE DIFFERS" : !ok ? "WRONG PASSES" : "ok");
+    }
+    std::printf("  fma/not: AVX2 against scalar; renders: to complete the progressive image, one tile each\n");
+    std::printf("  after the first\n\n");
+
+    // Whole images at full resolution, tiles on the job system's threads
+    const size_t sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const int repeats = options.quick ? 1 : 3;
+    std::printf("  full renders on %u worker threads, best of %d: Mpixels/s per level, then Giterations/s and ms\n",
+        static_cast<unsigned>(jobs.GetThreadCount()), repeats);
+    std::printf("  at the best level\n");
+    std::printf("  %-20s %-9s |", "case", "size");
+    for (SimdLevel level : levels) std::printf(" %8s", GetSimdLevelName(level));
+    std::printf(" | %8s %8s %8s\n", "speedup", "Giter/s", "ms");
+    for (const Case& c : cases) {
+        for (const auto& size : sizes) {
+            char label[16];
+            std::snprintf(label, sizeof(label), "%zux%zu", size[0], size[1]);
+            std::printf("  %-20s %-9s |", c.name, label);
+
+            double scalarSeconds = 0.0, bestSeconds = 1e30;
+            uint64_t bestIterations = 0;
+            for (SimdLevel level : levels) {
+                if (ResolveSimdLevel(level) != level || (options.quick && level == SimdLevel::Scalar && size[0] > 1920)) {
+                    std::printf(" %8s", "-");
+                    continue;
+                }
+                EscapeSettings settings;
+                settings.width = size[0];
+                settings.height = size[1];
+                settings.maxSimdLevel = level;
+                EscapeTimeRenderer renderer;
+                renderer.Initialize(settings);
+
+                double seconds = 1e30;
+                for (int r = 0; r < repeats; ++r) {
+                    renderer.Invalidate();
+                    renderer.Render(c.params, &jobs);
+                    seconds = std::min(seconds, renderer.GetStats().seconds);
+                }
+                if (level == SimdLevel::Scalar) scalarSeconds = seconds;
+                if (seconds < bestSeconds) {
+                    bestSeconds = seconds;
+                    bestIterations = renderer.GetStats().iterations;
+                }
+                std::printf(" %8.1f", size[0] * size[1] / seconds * 1e-6);
+            }
+            if (scalarSeconds > 0.0) std::printf(" | %7.1fx", scalarSeconds / bestSeconds);
+            else std::printf(" | %8s", "-");
+            std::printf(" %8.2f %8.1f\n", bestIterations / bestSeconds * 1e-9, bestSeconds * 1e3);
+        }
+    }
+
+    // A Julia set moved by the audio every frame at 1080p, within a budget: each change
+    // starts over at the finest spacing predicted to fit, and what time is left refines it
+    const int frames = options.frames > 0 ? options.frames : options.quick ? 60 : 300;
+    Simulation simulation;
+    if (!CreateBenchSimulation(options, &jobs, simulation)) {
+        jobs.Shutdown();
+        return failures + 1;
+    }
+
+    const double budgets[] = { 0.004, 0.016 };
+    std::printf("\n  Julia under %s at 1920x1080, %d frames: share of frames by the spacing reached\n",
+        options.pcmPath.empty() ? "a click track" : options.pcmPath.c_str(), frames);
+    std::printf("  %-8s | %7s %7s %7s %7s | %8s %8s %8s | %9s\n", "budget", "1", "2", "4", "8", "p50", "p99", "max",
+        "Mpixel/s");
+    for (double budget : budgets) {
+        EscapeSettings settings;
+        settings.width = 1920;
+        settings.height = 1080;
+        settings.budgetSeconds = budget;
+        EscapeTimeRenderer renderer;
+        renderer.Initialize(settings);
+
+        size_t byStride[4] = {};
+        size_t computed = 0;
+        double seconds = 0.0;
+        std::vector<double> renderMs;
+        for (int frame = 0; frame < frames; ++frame) {
+            simulation.Update(FIXED_TIMESTEP);
+            EscapeParams params = EscapeTimeRenderer::Modulate(EscapeParams(EscapeFractal::Julia),
+                simulation.GetBandEnergies());
+            renderer.Render(params, &jobs);
+
+            const EscapeStats& stats = renderer.GetStats();
+            size_t stride = stats.stride;
+            ++byStride[stride >= 8 ? 3 : stride >= 4 ? 2 : stride >= 2 ? 1 : 0];
+            computed += stats.pixelsComputed;
+            seconds += stats.seconds;
+            renderMs.push_back(stats.seconds * 1e3);
+        }
+
+        std::printf("  %6.0fms |", budget * 1e3);
+        for (size_t count : byStride) std::printf(" %6.1f%%", 100.0 * count / frames);
+        std::printf(" | %6.2fms %6.2fms %6.2fms | %9.1f\n", BenchPercentile(renderMs, 0.5),
+            BenchPercentile(renderMs, 0.99), BenchPercentile(renderMs, 1.0),
+            seconds > 0.0 ? computed / seconds * 1e-6 : 0.0);
+    }
+    std::printf("  a frame over its budget ran the coarsest pass, which always runs\n");
+
+    simulation.Shutdown();
+    jobs.Shutdown();
+    return failures;
+}
@@ -0,0 +1,175 @@
+#include "Bench.h"
+#include "FFT.h"
+#include "STFT.h"
+#include "SyntheticSource.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const double PI = 3.14159265358979323846;
+    const double FRAME_BUDGET_SECONDS = 1.0 / 60.0;
+
+    // Reference DFT in double precision; returns the max bin error relative to the peak
+    double CheckAgainstDft(FFTPlan& plan) {
+        const size_t n = plan.GetSize();
+        const size_t bins = plan.GetBinCount();
+
+        std::vector<float> input(n);
+        uint32_t state = 0x9E3779B9u;
+        for (size_t i = 0; i < n; ++i) {
+            state = state * 1664525u + 1013904223u;
+            input[i] = static_cast<float>((state >> 8) * (1.0 / 16777216.0) * 2.0 - 1.0);
+        }
+
+        std::vector<float> re(bins), im(bins);
+        plan.ForwardReal(input.data(), re.data(), im.data());
+
+        double maxError = 0.0;
+        double peak = 1e-30;
+        for (size_t k = 0; k < bins; ++k) {
+            double sr = 0.0, si = 0.0;
+            for (size_t t = 0; t < n; ++t) {
+                double angle = -2.0 * PI * static_cast<double>((k * t) % n) / static_cast<double>(n);
+                sr += input[t] * std::cos(angle);
+                si += input[t] * std::sin(angle);
+            }
+            double error = std::sqrt((sr - re[k]) * (sr - re[k]) + (si - im[k]) * (si - im[k]));
+            if (error > maxError) maxError = error;
+            double mag = std::sqrt(sr * sr + si * si);
+            if (mag > peak) peak = mag;
+        }
+
+        return maxError / peak;
+    }
+
+    // Forward + inverse round trip; returns the max sample error
+    double CheckRoundTrip(FFTPlan& plan) {
+        const size_t n = plan.GetSize();
+        std::vector<float> input(n), output(n), re(plan.GetBinCount()), im(plan.GetBinCount());
+        for (size_t i = 0; i < n; ++i) {
+            input[i] = static_cast<float>(std::sin(0.37 * i) + 0.25 * std::cos(1.91 * i));
+        }
+
+        plan.ForwardReal(input.data(), re.data(), im.data());
+        plan.InverseReal(re.data(), im.data(), output.data());
+
+        double maxError = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            double error = std::fabs(input[i] - output[i]);
+            if (error > maxError) maxError = error;
+        }
+        return maxError;
+    }
+
+    double TimeForward(FFTPlan& plan, double minSeconds) {
+        const size_t n = plan.GetSize();
+        std::vector<float> input(n, 0.0f), re(plan.GetBinCount()), im(plan.GetBinCount());
+        for (size_t i = 0; i < n; ++i) input[i] = static_cast<float>(std::sin(0.01 * i));
+
+        // Warm up caches and tables
+        plan.ForwardReal(input.data(), re.data(), im.data());
+
+        size_t iterations = 0;
+        size_t batch = 1;
+        double start = BenchNowSeconds();
+        double elapsed = 0.0;
+        while (elapsed < minSeconds) {
+            for (size_t i = 0; i < batch; ++i) {
+                plan.ForwardReal(input.data(), re.data(), im.data());
+            }
+            iterations += batch;
+            batch *= 2;
+            elapsed = BenchNowSeconds() - start;
+        }
+
+        // Keep the result alive so the work can't be optimized away
+        volatile float sink = re[1];
+        (void)sink;
+
+        return iterations / elapsed;
+    }
+}
+
+int RunFFTBench(const BenchOptions& options) {
+    int failures = 0;
+    const double minSeconds = options.quick ? 0.05 : 0.5;
+
+    std::printf("  Detected SIMD level: %s\n", GetSimdLevelName(GetSimdLevel()));
+
+    // Correctness against a double precision DFT, and round trip accuracy
+    std::printf("  %-8s %-8s %14s %14s\n", "size", "isa", "dft rel err", "roundtrip err");
+    for (size_t n = 16; n <= 32768; n *= 2) {
+        for (int level = 0; level <= static_cast<int>(SimdLevel::AVX); ++level) {
+            FFTPlan plan;
+            plan.Initialize(n, static_cast<SimdLevel>(level));
+            if (static_cast<int>(plan.GetSimdLevel()) != level) continue;
+
+            // The O(n^2) reference is too slow past 4096; larger sizes only round trip
+            const bool checkDft = n <= 4096;
+            double dftError = checkDft ? CheckAgainstDft(plan) : 0.0;
+            double roundTripError = CheckRoundTrip(plan);
+            bool ok = (!checkDft || dftError < 1e-5) && roundTripError < 1e-4;
+            if (!ok) ++failures;
+
+            if (!ok || (checkDft ? (n == 16 || n == 1024 || n == 4096) : n == 32768)) {
+                char dftText[32];
+                if (checkDft) std::snprintf(dftText, sizeof(dftText), "%.2e", dftError);
+                else std::snprintf(dftText, sizeof(dftText), "-");
+                std::printf("  %-8zu %-8s %14s %14.2e %s\n", n, GetSimdLevelName(plan.GetSimdLevel()),
+                    dftText, roundTripError, ok ? "" : "FAIL");
+            }
+        }
+    }
+
+    // Throughput per size and instruction set
+    std::printf("\n  %-8s %-8s %14s %12s %14s\n", "size", "isa", "transforms/s", "us/transform", "% of 60Hz frame");
+    for (size_t n = 256; n <= 32768; n *= 2) {
+        for (int level = 0; level <= static_cast<int>(SimdLevel::AVX); ++level) {
+            FFTPlan plan;
+            plan.Initialize(n, static_cast<SimdLevel>(level));
+            if (static_cast<int>(plan.GetSimdLevel()) != level) continue;
+
+            double perSecond = TimeForward(plan, minSeconds);
+            double microseconds = 1e6 / perSecond;
+            std::printf("  %-8zu %-8s %14.0f %12.2f %13.3f%%\n", n, GetSimdLevelName(plan.GetSimdLevel()),
+                perSecond, microseconds, 100.0 * (microseconds * 1e-6) / FRAME_BUDGET_SECONDS);
+        }
+    }
+
+    // Streaming STFT on a sweep, mixed down from stereo like the game loop does
+    std::printf("\n  %-8s %-6s %-6s %12s %14s\n", "fft", "hop", "phase", "frames/s", "x realtime");
+    const size_t fftSizes[] = { 4096, 16384, 32768 };
+    for (size_t fftSize : fftSizes) {
+        for (int withPhase = 0; withPhase <= 1; ++withPhase) {
+            StftSettings settings;
+            settings.fftSize = fftSize;
+            settings.hopSize = fftSize / 4;
+            settings.computePhase = withPhase != 0;
+
+            STFT stft;
+            stft.Initialize(settings);
+
+            SyntheticSettings synth;
+            synth.signal = SyntheticSignal::Sweep;
+            SyntheticSource source(synth);
+            source.Open();
+
+            const double audioSeconds = options.quick ? 5.0 : 30.0;
+            std::vector<float> audio(static_cast<size_t>(audioSeconds * synth.sampleRate) * synth.channels);
+            size_t totalFrames = source.Read(audio.data(), audio.size() / synth.channels);
+
+            double start = BenchNowSeconds();
+            size_t offset = 0;
+            while (offset < totalFrames) {
+                offset += stft.Consume(&audio[offset * synth.channels], totalFrames - offset, synth.channels);
+            }
+            double elapsed = BenchNowSeconds() - start;
+
+            std::printf("  %-8zu %-6zu %-6s %12.0f %14.1f\n", fftSize, settings.hopSize, withPhase ? "yes" : "no",
+                stft.GetFrameCount() / elapsed, audioSeconds / elapsed);
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,134 @@
+#include "Bench.h"
+#include "Filterbank.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const size_t FFT_SIZE = 16384; // 8193 bins
+
+    const char* ScaleName(BandScale scale) {
+        switch (scale) {
+        case BandScale::Mel: return "mel";
+        case BandScale::Bark: return "bark";
+        case BandScale::Log: return "log";
+        case BandScale::ConstantQ: return "cq";
+        }
+        return "?";
+    }
+
+    // The naive approach: a dense bands x bins matrix applied to the power spectrum
+    void ApplyDense(const std::vector<float>& matrix, const float* magnitude, size_t bins, size_t bands,
+        std::vector<float>& power, std::vector<float>& out) {
+        for (size_t b = 0; b < bins; ++b) {
+            power[b] = magnitude[b] * magnitude[b];
+        }
+
+        for (size_t band = 0; band < bands; ++band) {
+            const float* row = &matrix[band * bins];
+            float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+            size_t b = 0;
+            for (; b + 4 <= bins; b += 4) {
+                s0 += row[b] * power[b];
+                s1 += row[b + 1] * power[b + 1];
+                s2 += row[b + 2] * power[b + 2];
+                s3 += row[b + 3] * power[b + 3];
+            }
+            for (; b < bins; ++b) s0 += row[b] * power[b];
+            out[band] = (s0 + s1) + (s2 + s3);
+        }
+    }
+
+    template <typename Fn>
+    double TimePerCall(Fn fn, double minSeconds) {
+        fn();
+        size_t iterations = 0;
+        size_t batch = 1;
+        double start = BenchNowSeconds();
+        double elapsed = 0.0;
+        while (elapsed < minSeconds) {
+            for (size_t i = 0; i < batch; ++i) fn();
+            iterations += batch;
+            batch *= 2;
+            elapsed = BenchNowSeconds() - start;
+        }
+        return elapsed / iterations;
+    }
+}
+
+int RunFilterbankBench(const BenchOptions& options) {
+    const double minSeconds = options.quick ? 0.02 : 0.25;
+    const size_t bins = FFT_SIZE / 2 + 1;
+    int failures = 0;
+
+    // A plausible music-like spectrum: pink-ish slope plus a few partials
+    std::vector<float> magnitude(bins);
+    for (size_t b = 0; b < bins; ++b) {
+        magnitude[b] = 0.05f / std::sqrt(1.0f + b) + ((b % 97) == 11 ? 0.3f : 0.0f);
+    }
+
+    std::printf("  %u bins (fft %u)\n", static_cast<unsigned>(bins), static_cast<unsigned>(FFT_SIZE));
+    std::printf("  %-5s %6s %10s %10s %10s %10s %9s %10s\n",
+        "scale", "bands", "nnz", "stored", "sparse us", "dense us", "speedup", "max err");
+
+    const BandScale scales[] = { BandScale::Mel, BandScale::Bark, BandScale::Log, BandScale::ConstantQ };
+    const size_t bandCounts[] = { 32, 64, 128, 256 };
+
+    for (BandScale scale : scales) {
+        for (size_t bands : bandCounts) {
+            FilterbankSettings settings;
+            settings.scale = scale;
+            settings.bandCount = bands;
+            settings.fftSize = FFT_SIZE;
+
+            Filterbank filterbank;
+            if (!filterbank.Initialize(settings)) {
+                std::printf("  %-5s %6zu failed to initialize\n", ScaleName(scale), bands);
+                ++failures;
+                continue;
+            }
+
+            BandEnergies energies;
+            filterbank.PrepareOutput(energies);
+
+            std::vector<float> matrix;
+            filterbank.BuildDenseMatrix(matrix);
+            std::vector<float> power(bins), dense(bands);
+
+            double sparseTime = TimePerCall([&]() { filterbank.Apply(magnitude.data(), energies); }, minSeconds);
+            double denseTime = TimePerCall([&]() { ApplyDense(matrix, magnitude.data(), bins, bands, power, dense); }, minSeconds);
+
+            // Both paths must agree
+            double maxError = 0.0;
+            for (size_t band = 0; band < bands; ++band) {
+                double error = std::fabs(energies.power[band] - dense[band]) / (std::fabs(dense[band]) + 1e-20);
+                if (error > maxError) maxError = error;
+            }
+            if (maxError > 1e-3) ++failures;
+
+            std::printf("  %-5s %6zu %10zu %10zu %10.2f %10.2f %8.1fx %10.1e\n",
+                ScaleName(scale), bands, filterbank.GetNonZeroWeightCount(), filterbank.GetStoredWeightCount(),
+                sparseTime * 1e6, denseTime * 1e6, denseTime / sparseTime, maxError);
+        }
+    }
+
+    // Same layout at each instruction set level
+    std::printf("\n  mel x 128 bands by ISA:\n");
+    for (int level = 0; level <= static_cast<int>(SimdLevel::AVX2); ++level) {
+        FilterbankSettings settings;
+        settings.bandCount = 128;
+        settings.fftSize = FFT_SIZE;
+        settings.maxSimdLevel = static_cast<SimdLevel>(level);
+
+        Filterbank filterbank;
+        filterbank.Initialize(settings);
+        if (static_cast<int>(filterbank.GetSimdLevel()) != level) continue;
+
+        BandEnergies energies;
+        filterbank.PrepareOutput(energies);
+        double t = TimePerCall([&]() { filterbank.Apply(magnitude.data(), energies); }, minSeconds);
+        std::printf("  %-8s %10.2f us\n", GetSimdLevelName(filterbank.GetSimdLevel()), t * 1e6);
+    }
+
+    return failures;
+}
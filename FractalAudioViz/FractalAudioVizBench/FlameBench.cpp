@@ -0,0 +1,180 @@
+#include "Bench.h"
+#include "FractalFlame.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Hits in the merged histogram, which should be every point plotted
+    double MergedHits(const FlameRenderer& renderer) {
+        const float* density = renderer.GetDensity();
+        double sum = 0.0;
+        for (size_t i = 0; i < renderer.GetWidth() * renderer.GetHeight(); ++i) sum += density[i];
+        return sum;
+    }
+
+    // Half the summed difference between two density images, each normalized to a total
+    // of 1: 0 for the same shape, 1 for nothing in common
+    double DensityDistance(const std::vector<float>& a, const std::vector<float>& b) {
+        double totalA = 0.0, totalB = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            totalA += a[i];
+            totalB += b[i];
+        }
+        double distance = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) distance += std::fabs(a[i] / totalA - b[i] / totalB);
+        return 0.5 * distance;
+    }
+
+    std::vector<float> CopyDensity(const FlameRenderer& renderer) {
+        return std::vector<float>(renderer.GetDensity(), renderer.GetDensity() + renderer.GetWidth() * renderer.GetHeight());
+    }
+}
+
+int RunFlameBench(const BenchOptions& options) {
+    int failures = 0;
+    JobSystem jobs;
+    jobs.Initialize();
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    // One thread per level: each lane is a walker of its own, so the levels plot different
+    // points of the same attractor. The merged histogram must hold every plotted point,
+    // the same seed must give the same image, and the density's shape must match scalar's
+    // to within the sampling noise: half again as far as scalar's from another seed.
+    const uint64_t points = options.quick ? 4000000 : 16000000;
+    auto render = [points](FlameRenderer& renderer, SimdLevel level, uint32_t seed) {
+        FlameSettings settings;
+        settings.width = 640;
+        settings.height = 360;
+        settings.points = points;
+        settings.threadCount = 1;
+        settings.seed = seed;
+        settings.maxSimdLevel = level;
+        renderer.Initialize(settings);
+        renderer.Render(FlameParams());
+    };
+    FlameRenderer reseeded;
+    render(reseeded, SimdLevel::Scalar, 2);
+    const std::vector<float> noiseDensity = CopyDensity(reseeded);
+    double noise = 0.0;
+
+    std::printf("  %zu points at 640x360 on 1 thread: Mpoints/s per level; density against scalar's\n",
+        static_cast<size_t>(points));
+    std::printf("  %-8s | %9s %8s %9s %9s | %s\n", "level", "Mpoints/s", "in view", "distance", "repeat", "check");
+    std::vector<float> scalarDensity;
+    for (SimdLevel level : levels) {
+        if (ResolveSimdLevel(level) != level) {
+            std::printf("  %-8s | %9s\n", GetSimdLevelName(level), "-");
+            continue;
+        }
+        FlameRenderer renderer;
+        render(renderer, level, 1);
+        const FlameStats stats = renderer.GetStats();
+        std::vector<float> density = CopyDensity(renderer);
+        std::vector<uint32_t> image(renderer.GetPixels(), renderer.GetPixels() + 640 * 360);
+
+        renderer.Render(FlameParams());
+        bool repeats = std::memcmp(image.data(), renderer.GetPixels(), image.size() * sizeof(uint32_t)) == 0;
+        bool merged = MergedHits(renderer) == static_cast<double>(stats.plotted);
+        if (level == SimdLevel::Scalar) {
+            scalarDensity = density;
+            noise = DensityDistance(scalarDensity, noiseDensity);
+        }
+        double distance = DensityDistance(scalarDensity, density);
+
+        bool ok = repeats && merged && distance <= 1.5 * noise;
+        if (!ok) ++failures;
+        std::printf("  %-8s | %9.1f %7.1f%% %9.4f %9s | %s\n", GetSimdLevelName(level),
+            stats.points / stats.iterateSeconds * 1e-6, 100.0 * stats.plotted / stats.points, distance,
+            repeats ? "identical" : "DIFFERS", !merged ? "MERGE LOST POINTS" : !ok ? "DIFFERS" : "ok");
+    }
+    std::printf("  distance: half the summed difference of the normalized densities, 0 to 1; scalar's\n");
+    std::printf("  from another seed %.4f\n\n", noise);
+
+    // 1 to N threads on one histogram size, without the job system so the count is exact
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < hardware; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(hardware);
+    const uint64_t scalingPoints = options.quick ? 8000000 : 32000000;
+    std::printf("  %zu points at 1920x1080 at the best level, by threads (%u hardware)\n",
+        static_cast<size_t>(scalingPoints), hardware);
+    std::printf("  %-7s | %9s %8s | %9s %8s %8s %9s | %9s\n", "threads", "Mpoints/s", "speedup", "iterate", "merge",
+        "tone", "total ms", "hist MB");
+    double oneThread = 0.0;
+    for (unsigned threads : threadCounts) {
+        FlameSettings settings;
+        settings.width = 1920;
+        settings.height = 1080;
+        settings.points = scalingPoints;
+        settings.threadCount = threads;
+        FlameRenderer renderer;
+        renderer.Initialize(settings);
+        renderer.Render(FlameParams());
+        const FlameStats& stats = renderer.GetStats();
+        double rate = stats.points / stats.seconds;
+        if (threads == 1) oneThread = rate;
+        std::printf("  %-7u | %9.1f %7.2fx | %8.1fms %6.1fms %6.1fms %9.1f | %9.1f\n", threads, rate * 1e-6,
+            rate / oneThread, stats.iterateSeconds * 1e3, stats.mergeSeconds * 1e3, stats.toneSeconds * 1e3,
+            stats.seconds * 1e3, stats.histogramBytes / 1048576.0);
+    }
+    std::printf("  Mpoints/s over the whole Render, clearing, merging and tone mapping included\n\n");
+
+    // Memory: a 16-byte private histogram per thread, then the merged planes
+    const size_t sizes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    std::printf("  histogram memory by resolution, MB\n");
+    std::printf("  %-9s | %10s %9s | %9s %9s %9s\n", "size", "per thread", "merged", "1 thread", "8 threads",
+        "32 threads");
+    for (const auto& size : sizes) {
+        char label[16];
+        std::snprintf(label, sizeof(label), "%zux%zu", size[0], size[1]);
+        size_t one = FlameRenderer::GetHistogramBytes(size[0], size[1], 1);
+        size_t two = FlameRenderer::GetHistogramBytes(size[0], size[1], 2);
+        size_t perThread = two - one;
+        std::printf("  %-9s | %10.1f %9.1f | %9.1f %9.1f %9.1f\n", label, perThread / 1048576.0,
+            (one - perThread) / 1048576.0, one / 1048576.0,
+            FlameRenderer::GetHistogramBytes(size[0], size[1], 8) / 1048576.0,
+            FlameRenderer::GetHistogramBytes(size[0], size[1], 32) / 1048576.0);
+    }
+
+    // The variations moved by the music every frame, on the job system's threads
+    const int frames = options.frames > 0 ? options.frames : options.quick ? 30 : 120;
+    Simulation simulation;
+    if (!CreateBenchSimulation(options, &jobs, simulation)) {
+        jobs.Shutdown();
+        return failures + 1;
+    }
+
+    FlameSettings settings;
+    settings.width = 1280;
+    settings.height = 720;
+    settings.points = 2000000;
+    FlameRenderer renderer;
+    renderer.Initialize(settings);
+    std::vector<double> frameMs;
+    double minSpherical = 1e30, maxSpherical = -1e30;
+    for (int frame = 0; frame < frames; ++frame) {
+        simulation.Update(FIXED_TIMESTEP);
+        FlameParams params = FlameRenderer::Modulate(FlameParams(), simulation.GetBandEnergies());
+        float spherical = params.transforms[0].variations[static_cast<size_t>(FlameVariation::Spherical)];
+        minSpherical = std::min<double>(minSpherical, spherical);
+        maxSpherical = std::max<double>(maxSpherical, spherical);
+        renderer.Render(params, &jobs);
+        frameMs.push_back(renderer.GetStats().seconds * 1e3);
+    }
+    std::printf("\n  flame under %s at 1280x720, 2M points, %d frames on %u worker threads:\n",
+        options.pcmPath.empty() ? "a click track" : options.pcmPath.c_str(), frames,
+        static_cast<unsigned>(jobs.GetThreadCount()));
+    std::printf("  spherical weight %.2f..%.2f; frame p50 %.1fms p99 %.1fms max %.1fms\n", minSpherical, maxSpherical,
+        BenchPercentile(frameMs, 0.5), BenchPercentile(frameMs, 0.99), BenchPercentile(frameMs, 1.0));
+
+    simulation.Shutdown();
+    jobs.Shutdown();
+    return failures;
+}
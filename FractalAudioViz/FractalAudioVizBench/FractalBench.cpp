@@ -0,0 +1,97 @@
+#include "Bench.h"
+#include "FractalGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace {
+    const char* TypeName(FractalType type) {
+        return type == FractalType::Sierpinski ? "sierpinski" : "menger";
+    }
+
+    // Every leaf must sit inside the root cube at the leaf size for its depth
+    bool CheckInstances(const FractalSettings& settings, const FractalInstances& instances) {
+        float expectedHalf = settings.halfExtent *
+            std::pow(settings.type == FractalType::Sierpinski ? 0.5f : 1.0f / 3.0f, static_cast<float>(settings.depth));
+        for (size_t i = 0; i < instances.count; ++i) {
+            if (std::fabs(instances.scale[i] - expectedHalf) > 1e-4f * expectedHalf + 1e-7f) return false;
+            float limit = settings.halfExtent - instances.scale[i] + 1e-4f;
+            if (std::fabs(instances.x[i] - settings.centerX) > limit) return false;
+            if (std::fabs(instances.y[i] - settings.centerY) > limit) return false;
+            if (std::fabs(instances.z[i] - settings.centerZ) > limit) return false;
+        }
+        return true;
+    }
+
+    bool SameInstances(const FractalInstances& a, const FractalInstances& b) {
+        if (a.count != b.count) return false;
+        size_t floats = a.count * sizeof(float);
+        return std::memcmp(a.x.data(), b.x.data(), floats) == 0 &&
+            std::memcmp(a.y.data(), b.y.data(), floats) == 0 &&
+            std::memcmp(a.z.data(), b.z.data(), floats) == 0 &&
+            std::memcmp(a.scale.data(), b.scale.data(), floats) == 0 &&
+            std::memcmp(a.color.data(), b.color.data(), a.count * sizeof(uint32_t)) == 0;
+    }
+
+    double TimeGenerate(const FractalSettings& settings, FractalInstances& instances, int repeats) {
+        double best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            double start = BenchNowSeconds();
+            FractalGenerator::Generate(settings, instances);
+            double elapsed = BenchNowSeconds() - start;
+            if (elapsed < best) best = elapsed;
+        }
+        return best;
+    }
+}
+
+int RunFractalBench(const BenchOptions& options) {
+    const int repeats = options.quick ? 2 : 5;
+    const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    int failures = 0;
+
+    struct Case { FractalType type; int depth; };
+    const Case cases[] = {
+        { FractalType::MengerSponge, 2 }, { FractalType::MengerSponge, 3 },
+        { FractalType::MengerSponge, 4 }, { FractalType::MengerSponge, 5 },
+        { FractalType::Sierpinski, 6 }, { FractalType::Sierpinski, 8 }, { FractalType::Sierpinski, 10 },
+    };
+
+    std::printf("  best of %d, %u hardware threads; 20 bytes per instance\n", repeats, hardwareThreads);
+    std::printf("  %-10s %5s %10s %8s %10s %10s %10s %9s\n",
+        "type", "depth", "instances", "MB", "1 thr ms", "N thr ms", "Minst/s", "check");
+
+    FractalInstances serial;
+    FractalInstances parallel;
+    for (const Case& c : cases) {
+        FractalSettings settings;
+        settings.type = c.type;
+        settings.depth = c.depth;
+
+        settings.threadCount = 1;
+        double serialTime = TimeGenerate(settings, serial, repeats);
+
+        settings.threadCount = 0;
+        double parallelTime = TimeGenerate(settings, parallel, repeats);
+
+        bool ok = serial.count == FractalGenerator::GetInstanceCount(c.type, c.depth) &&
+            CheckInstances(settings, parallel) && SameInstances(serial, parallel);
+        if (!ok) ++failures;
+
+        std::printf("  %-10s %5d %10zu %8.1f %10.3f %10.3f %10.1f %9s\n",
+            TypeName(c.type), c.depth, parallel.count, parallel.count * 20.0 / (1 << 20),
+            serialTime * 1e3, parallelTime * 1e3, parallel.count / parallelTime * 1e-6, ok ? "ok" : "MISMATCH");
+    }
+
+    // Depths past the limit must be refused rather than allocate without bound
+    FractalSettings tooDeep;
+    tooDeep.depth = 6;
+    if (FractalGenerator::Generate(tooDeep, parallel)) {
+        std::printf("  depth 6 menger was not rejected\n");
+        ++failures;
+    }
+
+    return failures;
+}
@@ -0,0 +1,112 @@
+#include "Bench.h"
+#include "FrameStats.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Percentile of an already sorted sample set, by the same rank rule as the histogram
+    uint64_t ExactPercentile(const std::vector<uint64_t>& sorted, double fraction) {
+        size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.5);
+        rank = std::max<size_t>(1, std::min(rank, sorted.size()));
+        return sorted[rank - 1];
+    }
+}
+
+int RunFrameStatsBench(const BenchOptions& options) {
+    int failures = 0;
+
+    // Cost of one PhaseScope: two clock reads and an add
+    const int scopes = options.quick ? 1000000 : 10000000;
+    FrameStats stats;
+    stats.BeginFrame();
+    double start = BenchNowSeconds();
+    for (int i = 0; i < scopes; ++i) {
+        PhaseScope scope(stats, FramePhase::Update);
+    }
+    double scopeNs = (BenchNowSeconds() - start) / scopes * 1e9;
+    stats.EndFrame(0);
+
+    // Cost of a whole instrumented frame: seven scopes plus the ring push
+    const int frames = options.quick ? 100000 : 1000000;
+    uint32_t catchUp = 0;
+    start = BenchNowSeconds();
+    for (int i = 0; i < frames; ++i) {
+        stats.BeginFrame();
+        for (int phase = 0; phase < static_cast<int>(FramePhase::Frame); ++phase) {
+            PhaseScope scope(stats, static_cast<FramePhase>(phase));
+        }
+        stats.EndFrame(catchUp++ & 3);
+        if ((i & 255) == 255) stats.Collect();
+    }
+    double frameNs = (BenchNowSeconds() - start) / frames * 1e9;
+
+    bool fastEnough = scopeNs < 1000.0;
+    if (!fastEnough) ++failures;
+    std::printf("  PhaseScope: %.1f ns per scope (budget 1000 ns) %s\n", scopeNs, fastEnough ? "ok" : "OVER BUDGET");
+    std::printf("  Instrumented frame (7 scopes + ring push, collect every 256): %.1f ns\n", frameNs);
+
+    // Histogram accuracy on a log-normal frame time distribution with rare long stalls
+    std::printf("\n  Histogram vs exact percentiles (log-normal around 16.7 ms, 0.5%% stalls to 2 s):\n");
+    std::printf("  %8s %12s %12s %9s\n", "", "exact ms", "histogram ms", "error");
+    const size_t samples = options.quick ? 100000 : 1000000;
+    std::mt19937_64 random(12345);
+    std::lognormal_distribution<double> frameTime(std::log(16.7e6), 0.15);
+    std::uniform_real_distribution<double> stall(0.1e9, 2.0e9);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<uint64_t> values(samples);
+    LatencyHistogram histogram;
+    for (size_t i = 0; i < samples; ++i) {
+        double value = unit(random) < 0.005 ? stall(random) : frameTime(random);
+        values[i] = static_cast<uint64_t>(value);
+        histogram.Record(values[i]);
+    }
+    std::sort(values.begin(), values.end());
+
+    const double fractions[] = { 0.50, 0.95, 0.99, 0.999, 1.0 };
+    const char* labels[] = { "p50", "p95", "p99", "p99.9", "max" };
+    for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); ++i) {
+        uint64_t exact = ExactPercentile(values, fractions[i]);
+        uint64_t approx = fractions[i] >= 1.0 ? histogram.GetMax() : histogram.GetPercentile(fractions[i]);
+        double error = std::fabs(static_cast<double>(approx) - static_cast<double>(exact)) / exact;
+        bool ok = error <= 1.0 / 64.0;
+        if (!ok) ++failures;
+        std::printf("  %8s %12.4f %12.4f %8.3f%% %s\n", labels[i], exact * 1e-6, approx * 1e-6, error * 100.0, ok ? "" : "TOO FAR");
+    }
+
+    // Producer and collector on different threads: nothing lost unless the ring overflows
+    FrameStats shared;
+    std::atomic<bool> done(false);
+    const int sharedFrames = options.quick ? 200000 : 2000000;
+    std::thread collector([&]() {
+        while (!done.load(std::memory_order_acquire)) {
+            shared.Collect();
+            std::this_thread::yield();
+        }
+        shared.Collect();
+    });
+    for (int i = 0; i < sharedFrames; ++i) {
+        shared.BeginFrame();
+        {
+            PhaseScope scope(shared, FramePhase::Submit);
+        }
+        shared.EndFrame(1);
+    }
+    done.store(true, std::memory_order_release);
+    collector.join();
+
+    uint64_t seen = shared.GetHistogram(FramePhase::Frame).GetCount();
+    uint64_t dropped = shared.GetDroppedFrames();
+    bool accounted = seen + dropped == static_cast<uint64_t>(sharedFrames) && shared.GetCatchUpCount(1) == seen;
+    if (!accounted) ++failures;
+    std::printf("\n  Cross-thread collect: %llu frames collected, %llu dropped on a full ring, %s\n",
+        static_cast<unsigned long long>(seen), static_cast<unsigned long long>(dropped),
+        accounted ? "all accounted for" : "MISMATCH");
+
+    return failures;
+}
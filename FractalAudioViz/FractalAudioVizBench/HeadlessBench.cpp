@@ -0,0 +1,270 @@
+#include "Bench.h"
+#include "FrameStats.h"
+#include "RenderQueue.h"
+#include "Simulation.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+    // Handles the scene's draw refers to, standing in for DXRenderer's registrations
+    const RenderHandle INSTANCED_PIPELINE = 2;
+    const RenderHandle CUBE_VERTICES = 1;
+    const RenderHandle CUBE_INDICES = 1;
+    const RenderHandle FRACTAL_INSTANCES = 1;
+    const uint32_t CUBE_INDEX_COUNT = 36;
+
+    const float TEST_TEMPO = 128.0f;
+
+    // Subsystems reported separately, in report order
+    enum Subsystem {
+        AudioIngest,
+        Spectrum,
+        BeatTracking,
+        CameraScript,
+        FractalBuild,
+        InstanceUpload,
+        Record,
+        Submit,
+        SubsystemCount
+    };
+
+    const char* SUBSYSTEM_NAMES[SubsystemCount] = {
+        "audio ingest", "spectrum+bands", "onset+beat", "camera", "fractal build",
+        "instance upload", "record", "sort+submit"
+    };
+
+    struct RunResult {
+        LatencyHistogram subsystems[SubsystemCount];
+        FrameStats frameStats;
+        uint64_t hash;
+        uint64_t drawCalls;
+        BeatState beat;
+        size_t rebuilds;
+        bool ok;
+
+        RunResult() : hash(0xCBF29CE484222325ull), drawCalls(0), rebuilds(0), ok(false) {}
+    };
+
+    inline void Mix(uint64_t& hash, uint64_t value) {
+        hash = (hash ^ value) * 0x100000001B3ull;
+    }
+
+    inline void MixFloat(uint64_t& hash, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Mix(hash, bits);
+    }
+
+    // Row-vector world matrix (scale, then yaw in degrees), transposed for the shader
+    // as Cube does
+    void CubeWorldTransposed(float degrees, float scale, float out[16]) {
+        float angle = degrees * 3.14159265f / 180.0f;
+        float c = std::cos(angle) * scale;
+        float s = std::sin(angle) * scale;
+        const float world[16] = {
+            c, 0.0f, -s, 0.0f,
+            0.0f, scale, 0.0f, 0.0f,
+            s, 0.0f, c, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f
+        };
+        for (int row = 0; row < 4; ++row) {
+            for (int col = 0; col < 4; ++col) out[col * 4 + row] = world[row * 4 + col];
+        }
+    }
+
+    // Fractal edits at fixed frames, so rebuild stalls show up at the same places every run
+    void ApplyScript(Simulation& simulation, int frame, int frames) {
+        FractalSettings fractal = simulation.GetFractalSettings();
+        if (frame == frames / 4) {
+            fractal.depth = 4;
+        }
+        else if (frame == frames / 2) {
+            fractal.type = FractalType::Sierpinski;
+            fractal.depth = 6;
+        }
+        else if (frame == 3 * frames / 4) {
+            fractal.type = FractalType::MengerSponge;
+            fractal.depth = 3;
+        }
+        else {
+            return;
+        }
+        simulation.SetFractalSettings(fractal);
+    }
+
+    bool Run(const BenchOptions& options, int frames, RunResult& result) {
+        SimulationSettings settings;
+        settings.liveAudio = false;
+
+        Simulation simulation;
+        if (!simulation.Initialize(settings, MakeBenchSource(options, TEST_TEMPO))) {
+            std::printf("  failed to initialize the simulation (audio source: %s)\n",
+                options.pcmPath.empty() ? "synthetic" : options.pcmPath.c_str());
+            return false;
+        }
+        simulation.SetCameraPath(CameraPath::Orbit(5.0f, 1.5f, 2.0f, 8, 40.0f));
+        simulation.SetFrameStats(&result.frameStats);
+
+        // Staging for the instance streams, as the dynamic instance buffer would be filled
+        std::vector<float> staging(FractalGenerator::MAX_INSTANCES * 5);
+        uint64_t uploadedVersion = 0;
+
+        RenderQueue queue;
+        RecordingBackend backend;
+        RenderStateCache cache;
+
+        for (int frame = 0; frame < frames; ++frame) {
+            result.frameStats.BeginFrame();
+            ApplyScript(simulation, frame, frames);
+
+            // One fixed step per frame: the run is paced by the script, not the wall clock
+            {
+                PhaseScope scope(result.frameStats, FramePhase::Update);
+                simulation.Update(FIXED_TIMESTEP);
+            }
+            const SimulationCosts& costs = simulation.GetCosts();
+            result.subsystems[AudioIngest].Record(costs.audioIngest);
+            result.subsystems[Spectrum].Record(costs.spectrum);
+            result.subsystems[BeatTracking].Record(costs.beatTracking);
+            result.subsystems[CameraScript].Record(costs.camera);
+            if (costs.fractal > 0 && simulation.GetFractalVersion() != uploadedVersion) {
+                result.subsystems[FractalBuild].Record(costs.fractal);
+            }
+
+            uint64_t start = FrameStats::Now();
+            {
+                PhaseScope scope(result.frameStats, FramePhase::SceneBuild);
+
+                // Copy regenerated instances out as [x][y][z][scale][color] streams
+                if (simulation.GetFractalVersion() != uploadedVersion) {
+                    const FractalInstances& instances = simulation.GetFractalInstances();
+                    size_t n = instances.count;
+                    std::memcpy(&staging[0], instances.x.data(), n * sizeof(float));
+                    std::memcpy(&staging[n], instances.y.data(), n * sizeof(float));
+                    std::memcpy(&staging[2 * n], instances.z.data(), n * sizeof(float));
+                    std::memcpy(&staging[3 * n], instances.scale.data(), n * sizeof(float));
+                    std::memcpy(&staging[4 * n], instances.color.data(), n * sizeof(uint32_t));
+                    uploadedVersion = simulation.GetFractalVersion();
+                    ++result.rebuilds;
+                    result.subsystems[InstanceUpload].Record(FrameStats::Now() - start);
+                }
+
+                uint64_t recordStart = FrameStats::Now();
+                const SceneState& scene = simulation.GetScene();
+                const float* eye = scene.camera.position;
+                float depth = std::sqrt(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]) / 1000.0f;
+
+                float world[16];
+                CubeWorldTransposed(scene.cubeRotationY, scene.cubeScale, world);
+
+                queue.Clear();
+                RenderCommandList& list = queue.GetList(0);
+                DrawPacket packet = {};
+                packet.sortKey = SortKey::Opaque(0, INSTANCED_PIPELINE, CUBE_VERTICES, depth);
+                packet.pipeline = INSTANCED_PIPELINE;
+                packet.vertexBuffer = CUBE_VERTICES;
+                packet.indexBuffer = CUBE_INDICES;
+                packet.instances = FRACTAL_INSTANCES;
+                packet.constants = list.AddConstants(world, sizeof(world));
+                packet.constantSize = sizeof(world);
+                packet.indexCount = CUBE_INDEX_COUNT;
+                packet.instanceCount = static_cast<uint32_t>(simulation.GetFractalInstances().count);
+                list.Add(packet);
+                result.subsystems[Record].Record(FrameStats::Now() - recordStart);
+            }
+
+            {
+                uint64_t submitStart = FrameStats::Now();
+                PhaseScope scope(result.frameStats, FramePhase::Submit);
+                queue.Sort();
+                queue.Execute(backend, cache);
+                result.subsystems[Submit].Record(FrameStats::Now() - submitStart);
+            }
+
+            result.frameStats.EndFrame(1);
+            if ((frame & 255) == 255) result.frameStats.Collect();
+
+            // Everything the renderer would see, for the determinism check
+            const SceneState& scene = simulation.GetScene();
+            const BeatState& beat = simulation.GetBeatState();
+            for (int i = 0; i < 3; ++i) {
+                MixFloat(result.hash, scene.camera.position[i]);
+                MixFloat(result.hash, scene.camera.rotation[i]);
+            }
+            MixFloat(result.hash, scene.cubeRotationY);
+            MixFloat(result.hash, scene.cubeScale);
+            MixFloat(result.hash, beat.tempoBpm);
+            MixFloat(result.hash, beat.beatPhase);
+            Mix(result.hash, beat.beatCount);
+            Mix(result.hash, simulation.GetFractalInstances().count);
+        }
+
+        result.frameStats.Collect();
+        Mix(result.hash, backend.checksum);
+        result.drawCalls = backend.drawCalls;
+        result.beat = simulation.GetBeatState();
+        result.ok = true;
+        return true;
+    }
+
+    void PrintRow(const char* name, const LatencyHistogram& h) {
+        std::printf("  %-16s %9.1f %9.1f %9.1f %9.1f %10.1f\n", name, h.GetMean() * 1e-3,
+            h.GetPercentile(0.50) * 1e-3, h.GetPercentile(0.95) * 1e-3, h.GetPercentile(0.99) * 1e-3,
+            h.GetMax() * 1e-3);
+    }
+}
+
+int RunHeadlessBench(const BenchOptions& options) {
+    int frames = options.frames > 0 ? options.frames : (options.quick ? 600 : 3600);
+    int failures = 0;
+
+    std::printf("  %d frames at a fixed %.2f ms step (%.1f s simulated), scripted orbit camera,\n",
+        frames, FIXED_TIMESTEP * 1000.0f, frames * FIXED_TIMESTEP);
+    std::printf("  fractal edits at 1/4, 1/2, 3/4; audio: %s\n",
+        options.pcmPath.empty() ? "synthetic 128 BPM click track" : options.pcmPath.c_str());
+
+    double start = BenchNowSeconds();
+    RunResult result;
+    if (!Run(options, frames, result)) {
+        return 1;
+    }
+    double elapsed = BenchNowSeconds() - start;
+
+    std::printf("\n  %-16s %9s %9s %9s %9s %10s\n", "phase (us)", "mean", "p50", "p95", "p99", "max");
+    const FramePhase phases[] = { FramePhase::Frame, FramePhase::Update, FramePhase::AudioAnalysis,
+        FramePhase::SceneBuild, FramePhase::Submit };
+    for (FramePhase phase : phases) {
+        PrintRow(GetFramePhaseName(phase), result.frameStats.GetHistogram(phase));
+    }
+
+    std::printf("\n  %-16s %9s %9s %9s %9s %10s\n", "subsystem (us)", "mean", "p50", "p95", "p99", "max");
+    for (int i = 0; i < SubsystemCount; ++i) {
+        PrintRow(SUBSYSTEM_NAMES[i], result.subsystems[i]);
+    }
+
+    std::printf("\n  %.0f frames/s headless, %zu fractal uploads, %llu draws, tempo %.1f BPM, %llu beats\n",
+        frames / elapsed, result.rebuilds, static_cast<unsigned long long>(result.drawCalls),
+        result.beat.tempoBpm, static_cast<unsigned long long>(result.beat.beatCount));
+
+    // The click track's tempo must come out of the analysis
+    if (options.pcmPath.empty() && frames * FIXED_TIMESTEP >= 10.0f &&
+        std::fabs(result.beat.tempoBpm - TEST_TEMPO) > 2.0f) {
+        std::printf("  tempo is off from %.0f BPM\n", TEST_TEMPO);
+        ++failures;
+    }
+
+    // A second run from scratch has to reproduce the first exactly (not for pipes)
+    bool replayable = options.pcmPath.empty() || options.pcmPath.find(".wav") != std::string::npos;
+    if (replayable) {
+        RunResult second;
+        bool same = Run(options, frames, second) && second.hash == result.hash;
+        if (!same) ++failures;
+        std::printf("  replay: state hash %016llx %s\n", static_cast<unsigned long long>(result.hash),
+            same ? "identical across runs" : "DIFFERS between runs");
+    }
+
+    return failures;
+}
@@ -0,0 +1,189 @@
+#include "Bench.h"
+#include "DistanceEstimator.h"
+#include "Isosurface.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+    bool SameMesh(const FractalMesh& a, const FractalMesh& b) {
+        return a.vertices.size() == b.vertices.size() && a.indices.size() == b.indices.size() &&
+            std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(MeshVertex)) == 0 &&
+            std::memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(uint32_t)) == 0;
+    }
+
+    // Watertight and consistently wound: every directed edge is matched by as many going
+    // the other way. Also the enclosed volume, positive when wound like Cube's.
+    bool CheckClosed(const FractalMesh& mesh, double& volume) {
+        std::vector<uint64_t> forward, backward;
+        forward.reserve(mesh.indices.size());
+        backward.reserve(mesh.indices.size());
+        volume = 0.0;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const uint32_t* t = &mesh.indices[i];
+            for (int e = 0; e < 3; ++e) {
+                uint64_t a = t[e], b = t[(e + 1) % 3];
+                forward.push_back(a << 32 | b);
+                backward.push_back(b << 32 | a);
+            }
+            const MeshVertex& a = mesh.vertices[t[0]];
+            const MeshVertex& b = mesh.vertices[t[1]];
+            const MeshVertex& c = mesh.vertices[t[2]];
+            double cx = static_cast<double>(b.y) * c.z - static_cast<double>(b.z) * c.y;
+            double cy = static_cast<double>(b.z) * c.x - static_cast<double>(b.x) * c.z;
+            double cz = static_cast<double>(b.x) * c.y - static_cast<double>(b.y) * c.x;
+            volume += (a.x * cx + a.y * cy + a.z * cz) / 6.0;
+        }
+        std::sort(forward.begin(), forward.end());
+        std::sort(backward.begin(), backward.end());
+        return forward == backward && volume > 0.0;
+    }
+}
+
+int RunIsosurfaceBench(const BenchOptions& options) {
+    int failures = 0;
+    JobSystem jobs;
+    jobs.Initialize();
+
+    // Each fractal meshed from scratch: one thread against the job system, which must
+    // agree exactly, and the surface closed
+    struct Case {
+        const char* name;
+        DistanceParams params;
+        float extent;
+        float isoLevel;
+    };
+    const Case cases[] = {
+        { "Mandelbulb 8", DistanceParams(), 1.3f, 0.0f },
+        { "Mandelbox 2", DistanceParams(DistanceFractal::Mandelbox), 7.0f, 0.5f },
+        { "Menger IFS", DistanceParams(DistanceFractal::KaleidoscopicIFS), 1.3f, 0.0f },
+    };
+    const size_t resolutions[] = { 64, 128 };
+    const size_t resolutionCount = options.quick ? 1 : 2;
+
+    std::printf("  %-13s %5s | %9s %9s %7s %8s | %8s %8s %9s %9s | %s\n", "fractal", "cells", "triangles",
+        "vertices", "welded", "chunks", "serial", "jobs", "Mtri/s", "Msample/s", "check");
+    for (const Case& c : cases) {
+        for (size_t r = 0; r < resolutionCount; ++r) {
+            IsosurfaceSettings settings;
+            settings.halfExtent = c.extent;
+            settings.resolution = resolutions[r];
+            settings.isoLevel = c.isoLevel;
+            settings.threadCount = 1;
+
+            // Timed on the second pass, with the threads' buffers warm
+            IsosurfaceMesher serial, jobbed;
+            serial.Initialize(settings);
+            jobbed.Initialize(settings);
+            for (int pass = 0; pass < 2; ++pass) {
+                serial.Invalidate();
+                jobbed.Invalidate();
+                serial.Update(c.params);
+                jobbed.Update(c.params, &jobs);
+            }
+            const IsosurfaceStats& stats = jobbed.GetStats();
+
+            double volume = 0.0;
+            bool closed = CheckClosed(jobbed.GetMesh(), volume);
+            bool same = SameMesh(serial.GetMesh(), jobbed.GetMesh());
+            bool ok = closed && same && stats.triangles > 0;
+            if (!ok) ++failures;
+
+            size_t samples = settings.resolution + 1;
+            std::printf("  %-13s %4zu^3 | %9zu %9zu %7zu %3zu/%-4zu | %6.1fms %6.1fms %9.2f %9.1f | %s\n",
+                c.name, settings.resolution, stats.triangles, stats.vertices, stats.seamVertices,
+                stats.surfaceChunks, stats.chunks, serial.GetStats().updateSeconds * 1e3, stats.updateSeconds * 1e3,
+                stats.triangles / stats.updateSeconds * 1e-6,
+                static_cast<double>(samples * samples * samples) / stats.updateSeconds * 1e-6,
+                !closed ? "OPEN OR MISWOUND" : !same ? "THREADS DIFFER" : ok ? "ok" : "EMPTY");
+        }
+    }
+    std::printf("  welded: seam vertices made by two or more chunks and shared; chunks: with surface / all;\n");
+    std::printf("  Mtri/s and Msample/s over the jobs' wall time, sampling included\n\n");
+
+    // A Mandelbulb modulated by the audio each update, re-meshed where it moved. With no
+    // tolerance the mesh has to be the one a full re-mesh gives; with the default, the same
+    // triangles (every corner is on the same side) with vertices up to the tolerance off.
+    const int frames = options.frames > 0 ? options.frames : options.quick ? 120 : 600;
+    Simulation simulation;
+    if (!CreateBenchSimulation(options, &jobs, simulation)) {
+        jobs.Shutdown();
+        return failures + 1;
+    }
+
+    IsosurfaceSettings settings;
+    settings.halfExtent = 1.3f;
+    settings.resolution = options.quick ? 64 : 96;
+    IsosurfaceSettings exactSettings = settings;
+    exactSettings.remeshTolerance = 0.0f;
+
+    IsosurfaceMesher tolerant, exact, full;
+    tolerant.Initialize(settings);
+    exact.Initialize(exactSettings);
+    full.Initialize(settings);
+
+    std::vector<double> tolerantMs, exactMs, fullMs;
+    size_t tolerantRemeshed = 0, exactRemeshed = 0, surfaceChunks = 0, meshedTriangles = 0, changedFrames = 0;
+    double meshSeconds = 0.0;
+    bool exactSame = true, tolerantTopology = true, tolerantClosed = true;
+    for (int frame = 0; frame < frames; ++frame) {
+        simulation.Update(FIXED_TIMESTEP);
+        DistanceParams params = DistanceEstimator::Modulate(DistanceParams(), simulation.GetBandEnergies());
+
+        changedFrames += tolerant.Update(params, &jobs);
+        exact.Update(params, &jobs);
+        full.Invalidate();
+        full.Update(params, &jobs);
+
+        const IsosurfaceStats& stats = tolerant.GetStats();
+        tolerantMs.push_back(stats.updateSeconds * 1e3);
+        exactMs.push_back(exact.GetStats().updateSeconds * 1e3);
+        fullMs.push_back(full.GetStats().updateSeconds * 1e3);
+        tolerantRemeshed += stats.remeshed;
+        exactRemeshed += exact.GetStats().remeshed;
+        surfaceChunks += full.GetStats().surfaceChunks;
+        meshedTriangles += stats.meshedTriangles;
+        meshSeconds += stats.updateSeconds;
+
+        // Every frame is cheap to compare; closure is checked every 30th
+        exactSame &= SameMesh(exact.GetMesh(), full.GetMesh());
+        tolerantTopology &= tolerant.GetMesh().indices.size() == full.GetMesh().indices.size() &&
+            tolerant.GetMesh().vertices.size() == full.GetMesh().vertices.size();
+        if (frame % 30 == 0) {
+            double volume = 0.0;
+            tolerantClosed &= CheckClosed(tolerant.GetMesh(), volume);
+        }
+    }
+
+    const double chunkFrames = static_cast<double>(tolerant.GetStats().chunks) * frames;
+    std::printf("  Mandelbulb under %s, %zu^3 cells in %zu chunks, %d updates:\n",
+        options.pcmPath.empty() ? "a click track" : options.pcmPath.c_str(), settings.resolution,
+        tolerant.GetStats().chunks, frames);
+    std::printf("  the surface passes through %.1f%% of the chunks on average\n", 100.0 * surfaceChunks / chunkFrames);
+    std::printf("  %-25s %9s %9s | %8s %8s %8s\n", "", "re-meshed", "of surface", "p50", "p99", "max");
+    std::printf("  %-25s %8.1f%% %10s | %6.2fms %6.2fms %6.2fms\n", "full re-mesh", 100.0, "-",
+        BenchPercentile(fullMs, 0.5), BenchPercentile(fullMs, 0.99), BenchPercentile(fullMs, 1.0));
+    std::printf("  %-25s %8.1f%% %9.1f%% | %6.2fms %6.2fms %6.2fms\n", "changed chunks, exact",
+        100.0 * exactRemeshed / chunkFrames, 100.0 * exactRemeshed / std::max<size_t>(1, surfaceChunks),
+        BenchPercentile(exactMs, 0.5), BenchPercentile(exactMs, 0.99), BenchPercentile(exactMs, 1.0));
+    char label[32];
+    std::snprintf(label, sizeof(label), "changed chunks, %.2g cell", settings.remeshTolerance);
+    std::printf("  %-25s %8.1f%% %9.1f%% | %6.2fms %6.2fms %6.2fms\n", label,
+        100.0 * tolerantRemeshed / chunkFrames, 100.0 * tolerantRemeshed / std::max<size_t>(1, surfaceChunks),
+        BenchPercentile(tolerantMs, 0.5), BenchPercentile(tolerantMs, 0.99), BenchPercentile(tolerantMs, 1.0));
+    std::printf("  with tolerance: mesh changed on %zu of %d updates, %.2f Mtri/s re-meshed over update time\n",
+        changedFrames, frames, meshSeconds > 0.0 ? meshedTriangles / meshSeconds * 1e-6 : 0.0);
+
+    bool ok = exactSame && tolerantTopology && tolerantClosed;
+    if (!ok) ++failures;
+    std::printf("  exact matches full re-mesh: %s; tolerant has its triangles: %s; tolerant closed: %s\n",
+        exactSame ? "yes" : "NO", tolerantTopology ? "yes" : "NO", tolerantClosed ? "yes" : "NO");
+
+    simulation.Shutdown();
+    jobs.Shutdown();
+    return failures;
+}
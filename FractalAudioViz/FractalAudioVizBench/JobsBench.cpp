@@ -0,0 +1,227 @@
+#include "Bench.h"
+#include "FractalGenerator.h"
+#include "JobSystem.h"
+#include "STFT.h"
+#include "Simulation.h"
+#include "SyntheticSource.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    const size_t TRANSFORM_COUNT = 1 << 20;
+    const size_t AUDIO_STREAMS = 16;
+
+    template <typename Fn>
+    double Best(int repeats, Fn fn) {
+        double best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            double start = BenchNowSeconds();
+            fn();
+            best = std::min(best, BenchNowSeconds() - start);
+        }
+        return best;
+    }
+
+    // Scale, yaw and translation per object composed into a row-vector world matrix
+    struct Transforms {
+        std::vector<float> x, y, z, yaw, scale;
+        std::vector<float> world;  // 16 per object
+
+        explicit Transforms(size_t count) :
+            x(count), y(count), z(count), yaw(count), scale(count), world(count * 16)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                x[i] = static_cast<float>(i % 101);
+                y[i] = static_cast<float>(i % 37);
+                z[i] = static_cast<float>(i % 53);
+                yaw[i] = 0.001f * static_cast<float>(i);
+                scale[i] = 1.0f + 0.01f * static_cast<float>(i % 7);
+            }
+        }
+
+        void Compose(size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                float c = std::cos(yaw[i]) * scale[i];
+                float s = std::sin(yaw[i]) * scale[i];
+                float* m = &world[i * 16];
+                m[0] = c;    m[1] = 0.0f;     m[2] = -s;   m[3] = 0.0f;
+                m[4] = 0.0f; m[5] = scale[i]; m[6] = 0.0f; m[7] = 0.0f;
+                m[8] = s;    m[9] = 0.0f;     m[10] = c;   m[11] = 0.0f;
+                m[12] = x[i]; m[13] = y[i];   m[14] = z[i]; m[15] = 1.0f;
+            }
+        }
+    };
+
+    // Independent STFT + a second of audio per stream, like analyzing several inputs
+    struct AudioStreams {
+        std::unique_ptr<STFT> streams[AUDIO_STREAMS];
+        std::vector<float> audio;
+        float checksum[AUDIO_STREAMS];
+
+        AudioStreams() {
+            SyntheticSettings settings;
+            settings.signal = SyntheticSignal::WhiteNoise;
+            settings.channels = 1;
+            SyntheticSource source(settings);
+            source.Open();
+            audio.resize(48000);
+            source.Read(audio.data(), audio.size());
+        }
+
+        void Reset() {
+            StftSettings settings;
+            settings.fftSize = 4096;
+            settings.hopSize = 1024;
+            for (size_t i = 0; i < AUDIO_STREAMS; ++i) {
+                streams[i].reset(new STFT());
+                streams[i]->Initialize(settings);
+            }
+        }
+
+        void Analyze(size_t stream) {
+            STFT& stft = *streams[stream];
+            float sum = 0.0f;
+            size_t consumed = 0;
+            while (consumed < audio.size()) {
+                consumed += stft.Consume(&audio[consumed], audio.size() - consumed, 1);
+                if (stft.HasNewFrame()) sum += stft.GetMagnitude()[stream + 1];
+            }
+            checksum[stream] = sum;
+        }
+    };
+
+    uint64_t RunSimulation(JobSystem* jobs, int frames, double& seconds) {
+        SimulationSettings settings;
+        settings.liveAudio = false;
+        SyntheticSettings audio;
+        audio.signal = SyntheticSignal::ClickTrack;
+
+        Simulation simulation;
+        simulation.SetJobSystem(jobs);
+        simulation.Initialize(settings, std::make_unique<SyntheticSource>(audio));
+        simulation.SetCameraPath(CameraPath::Orbit(5.0f, 1.5f, 2.0f, 8, 40.0f));
+
+        uint64_t hash = 0xCBF29CE484222325ull;
+        double start = BenchNowSeconds();
+        for (int frame = 0; frame < frames; ++frame) {
+            // A depth 4 sponge every 60 frames gives the graph a big stage to spread out
+            if (frame % 60 == 30) {
+                FractalSettings fractal = simulation.GetFractalSettings();
+                fractal.depth = fractal.depth == 4 ? 3 : 4;
+                simulation.SetFractalSettings(fractal);
+            }
+            simulation.Update(FIXED_TIMESTEP);
+
+            uint32_t bits;
+            std::memcpy(&bits, &simulation.GetScene().cubeScale, sizeof(bits));
+            hash = (hash ^ bits) * 0x100000001B3ull;
+            hash = (hash ^ simulation.GetFractalInstances().count) * 0x100000001B3ull;
+        }
+        seconds = BenchNowSeconds() - start;
+        return hash;
+    }
+}
+
+int RunJobsBench(const BenchOptions& options) {
+    const int repeats = options.quick ? 2 : 5;
+    const int simulationFrames = options.quick ? 120 : 600;
+    const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    int failures = 0;
+
+    // 1, 2, 4, ... up to the hardware (and at least 4, to exercise stealing anywhere)
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t <= std::max(4u, hardwareThreads); t *= 2) threadCounts.push_back(t);
+    if (threadCounts.back() != std::max(4u, hardwareThreads)) threadCounts.push_back(hardwareThreads);
+
+    std::printf("  %u hardware threads; best of %d; speedup against 1 thread\n", hardwareThreads, repeats);
+    std::printf("  %7s | %9s %7s | %9s %7s | %9s %7s | %9s %7s | %9s %7s | %s\n", "threads",
+        "job ns", "steals", "menger5 ms", "x", "compose ms", "x", "audio ms", "x", "frame us", "x", "check");
+
+    Transforms transforms(TRANSFORM_COUNT);
+    std::vector<float> referenceWorld;
+    AudioStreams audio;
+    float referenceAudio[AUDIO_STREAMS] = {};
+    FractalInstances referenceFractal;
+    FractalInstances fractal;
+    FractalSettings menger;
+    menger.type = FractalType::MengerSponge;
+    menger.depth = 5;
+
+    double base[4] = {};
+    uint64_t referenceHash = 0;
+
+    for (unsigned threads : threadCounts) {
+        JobSystem jobs;
+        jobs.Initialize(threads - 1);
+
+        // Scheduling overhead: 64k trivial leaves through a grain-1 parallel for
+        const size_t leaves = 65536;
+        std::atomic<uint64_t> touched(0);
+        jobs.ResetStats();
+        double jobTime = Best(repeats, [&]() {
+            jobs.ParallelFor(leaves, 1, [&touched](size_t begin, size_t end) {
+                touched.fetch_add(end - begin, std::memory_order_relaxed);
+            });
+        });
+        JobSystemStats stats = jobs.GetStats();
+        double jobNs = jobTime / (2 * leaves) * 1e9;  // Leaves plus the splits above them
+        bool ok = touched.load() == leaves * static_cast<uint64_t>(repeats);
+
+        double fractalTime = Best(repeats, [&]() { FractalGenerator::Generate(menger, fractal, &jobs); });
+        if (threads == 1) {
+            menger.threadCount = 1;
+            FractalGenerator::Generate(menger, referenceFractal);
+        }
+        ok = ok && fractal.count == referenceFractal.count &&
+            std::memcmp(fractal.x.data(), referenceFractal.x.data(), fractal.count * sizeof(float)) == 0 &&
+            std::memcmp(fractal.color.data(), referenceFractal.color.data(), fractal.count * sizeof(uint32_t)) == 0;
+
+        double composeTime = Best(repeats, [&]() {
+            Transforms* target = &transforms;
+            jobs.ParallelFor(TRANSFORM_COUNT, 4096, [target](size_t begin, size_t end) { target->Compose(begin, end); });
+        });
+        if (threads == 1) referenceWorld = transforms.world;
+        ok = ok && transforms.world == referenceWorld;
+
+        double audioTime = Best(repeats, [&]() {
+            audio.Reset();
+            AudioStreams* target = &audio;
+            jobs.ParallelFor(AUDIO_STREAMS, 1, [target](size_t begin, size_t end) {
+                for (size_t stream = begin; stream < end; ++stream) target->Analyze(stream);
+            });
+        });
+        if (threads == 1) std::memcpy(referenceAudio, audio.checksum, sizeof(referenceAudio));
+        ok = ok && std::memcmp(referenceAudio, audio.checksum, sizeof(referenceAudio)) == 0;
+
+        // The simulation's per-frame task graph, which must not change any result
+        double simulationTime = 0.0;
+        uint64_t hash = RunSimulation(&jobs, simulationFrames, simulationTime);
+        if (threads == 1) {
+            double serialTime = 0.0;
+            referenceHash = RunSimulation(nullptr, simulationFrames, serialTime);
+        }
+        ok = ok && hash == referenceHash;
+        double frameUs = simulationTime / simulationFrames * 1e6;
+
+        if (threads == 1) {
+            base[0] = fractalTime;
+            base[1] = composeTime;
+            base[2] = audioTime;
+            base[3] = frameUs;
+        }
+        if (!ok) ++failures;
+
+        std::printf("  %7u | %9.1f %7llu | %9.2f %6.2fx | %9.2f %6.2fx | %9.2f %6.2fx | %9.1f %6.2fx | %s\n",
+            threads, jobNs, static_cast<unsigned long long>(stats.stolen),
+            fractalTime * 1e3, base[0] / fractalTime, composeTime * 1e3, base[1] / composeTime,
+            audioTime * 1e3, base[2] / audioTime, frameUs, base[3] / frameUs, ok ? "identical" : "MISMATCH");
+    }
+
+    return failures;
+}
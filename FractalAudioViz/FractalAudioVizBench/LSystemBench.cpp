@@ -0,0 +1,125 @@
+#include "Bench.h"
+#include "JobSystem.h"
+#include "LSystem.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    bool SameInstances(const LSystemInstances& a, const LSystemInstances& b) {
+        return a.count == b.count &&
+            std::memcmp(a.world.data(), b.world.data(), a.world.size() * sizeof(float)) == 0 &&
+            std::memcmp(a.color.data(), b.color.data(), a.color.size() * sizeof(uint32_t)) == 0;
+    }
+}
+
+int RunLSystemBench(const BenchOptions& options) {
+    int failures = 0;
+    JobSystem jobs;
+    jobs.Initialize();
+
+    // Generations 6-10 of the default tree on the job system, the second of two runs so
+    // the symbol buffers are already grown. The instances must match a one-thread turtle
+    // reading the same symbols, bit for bit.
+    std::printf("  default tree on %u worker threads, warm buffers; Msymbols/s over each step\n",
+        static_cast<unsigned>(jobs.GetThreadCount()));
+    std::printf("  %-3s | %10s %9s %9s | %10s %5s %5s %6s | %9s %8s | %s\n", "gen", "symbols", "rewrite", "turtle",
+        "segments", "units", "depth", "spine", "serial", "peak MB", "check");
+    for (int generations = 6; generations <= 10; ++generations) {
+        LSystemSettings settings;
+        settings.generations = generations;
+        LSystemGenerator generator;
+        LSystemInstances instances;
+        generator.Generate(settings, instances, &jobs);
+        if (!generator.Generate(settings, instances, &jobs)) {
+            std::printf("  %-3d | over %zu symbols\n", generations, LSystemGenerator::MAX_SYMBOLS);
+            ++failures;
+            continue;
+        }
+        const LSystemStats stats = generator.GetStats();
+
+        LSystemInstances serial;
+        double start = BenchNowSeconds();
+        LSystemGenerator::InterpretSerial(settings, generator.GetSymbols(), generator.GetSymbolCount(), serial);
+        double serialSeconds = BenchNowSeconds() - start;
+        bool ok = SameInstances(instances, serial);
+        if (!ok) ++failures;
+
+        std::printf("  %-3d | %10zu %9.1f %9.1f | %10zu %5zu %5zu %5.1f%% | %8.1fx %8.1f | %s\n", generations,
+            stats.symbols, stats.rewrittenSymbols / stats.rewriteSeconds * 1e-6,
+            stats.symbols / stats.interpretSeconds * 1e-6, instances.count, stats.units, stats.splitDepth,
+            100.0 * stats.spineSymbols / stats.symbols, serialSeconds / stats.interpretSeconds,
+            stats.peakBytes / 1048576.0, ok ? "ok" : "DIFFERS");
+    }
+    std::printf("  rewrite counts every symbol written over all generations; serial: the one-thread turtle's\n");
+    std::printf("  time over the parallel one's; spine: symbols read on one thread before the units\n\n");
+
+    // 1 to N threads on the largest tree, without the job system so the count is exact
+    const int scalingGenerations = options.quick ? 9 : 10;
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < hardware; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(hardware);
+    std::printf("  generation %d by threads (%u hardware)\n", scalingGenerations, hardware);
+    std::printf("  %-7s | %9s %9s | %9s %9s %8s\n", "threads", "rewrite", "turtle", "rewrite", "turtle", "speedup");
+    double oneThread = 0.0;
+    LSystemInstances reference;
+    for (unsigned threads : threadCounts) {
+        LSystemSettings settings;
+        settings.generations = scalingGenerations;
+        settings.threadCount = threads;
+        LSystemGenerator generator;
+        LSystemInstances instances;
+        generator.Generate(settings, instances);
+        generator.Generate(settings, instances);
+        const LSystemStats& stats = generator.GetStats();
+        double seconds = stats.rewriteSeconds + stats.interpretSeconds;
+        if (threads == 1) {
+            oneThread = seconds;
+            reference = instances;
+        }
+        else if (!SameInstances(reference, instances)) {
+            std::printf("  %u threads: instances differ from 1 thread's\n", threads);
+            ++failures;
+        }
+        std::printf("  %-7u | %8.1fms %8.1fms | %9.1f %9.1f %7.2fx\n", threads, stats.rewriteSeconds * 1e3,
+            stats.interpretSeconds * 1e3, stats.rewrittenSymbols / stats.rewriteSeconds * 1e-6,
+            stats.symbols / stats.interpretSeconds * 1e-6, oneThread / seconds);
+    }
+    std::printf("  Msymbols/s as above; speedup of rewrite and turtle together\n\n");
+
+    // Branch angle and segment length moved by the music, the tree regenerated every frame
+    const int frames = options.frames > 0 ? options.frames : options.quick ? 30 : 120;
+    Simulation simulation;
+    if (!CreateBenchSimulation(options, &jobs, simulation)) {
+        jobs.Shutdown();
+        return failures + 1;
+    }
+
+    LSystemSettings base;
+    base.generations = 7;
+    LSystemGenerator generator;
+    LSystemInstances instances;
+    std::vector<double> frameMs;
+    double minAngle = 1e30, maxAngle = -1e30;
+    for (int frame = 0; frame < frames; ++frame) {
+        simulation.Update(FIXED_TIMESTEP);
+        LSystemSettings settings = LSystemGenerator::Modulate(base, simulation.GetBandEnergies());
+        minAngle = std::min<double>(minAngle, settings.angle);
+        maxAngle = std::max<double>(maxAngle, settings.angle);
+        generator.Generate(settings, instances, &jobs);
+        frameMs.push_back((generator.GetStats().rewriteSeconds + generator.GetStats().interpretSeconds) * 1e3);
+    }
+    std::printf("  generation 7 under %s, %zu segments, %d frames:\n",
+        options.pcmPath.empty() ? "a click track" : options.pcmPath.c_str(), instances.count, frames);
+    std::printf("  angle %.1f..%.1f degrees; frame p50 %.2fms p99 %.2fms max %.2fms\n", minAngle, maxAngle,
+        BenchPercentile(frameMs, 0.5), BenchPercentile(frameMs, 0.99), BenchPercentile(frameMs, 1.0));
+
+    simulation.Shutdown();
+    jobs.Shutdown();
+    return failures;
+}
@@ -0,0 +1,99 @@
+#include "Bench.h"
+#include "CameraPath.h"
+#include "FractalGenerator.h"
+#include "FractalLod.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+    bool SameInstances(const FractalInstances& a, const FractalInstances& b) {
+        if (a.count != b.count) return false;
+        size_t floats = a.count * sizeof(float);
+        return std::memcmp(a.x.data(), b.x.data(), floats) == 0 &&
+            std::memcmp(a.y.data(), b.y.data(), floats) == 0 &&
+            std::memcmp(a.z.data(), b.z.data(), floats) == 0 &&
+            std::memcmp(a.scale.data(), b.scale.data(), floats) == 0 &&
+            std::memcmp(a.color.data(), b.color.data(), a.count * sizeof(uint32_t)) == 0;
+    }
+}
+
+int RunLodBench(const BenchOptions& options) {
+    const int frames = options.quick ? 300 : 2400;
+    int failures = 0;
+
+    FractalSettings settings;
+    settings.type = FractalType::MengerSponge;
+    settings.depth = 5;
+
+    // Fixed depth: everything at full detail
+    FractalInstances fixed;
+    double start = BenchNowSeconds();
+    FractalGenerator::Generate(settings, fixed);
+    double fixedTime = BenchNowSeconds() - start;
+    std::printf("  fixed depth %d: %zu instances, built in %.1f ms\n", settings.depth, fixed.count, fixedTime * 1e3);
+
+    // Refining everything has to land on exactly the fixed-depth instances
+    FractalLodSettings everything;
+    everything.detailPixels = 0.0f;
+    everything.budgetSeconds = 0.0;
+    FractalLod full;
+    full.Initialize(settings, everything);
+    const float distantEye[3] = { 0.0f, 0.0f, -5.0f };
+    start = BenchNowSeconds();
+    full.Update(distantEye);
+    double fullTime = BenchNowSeconds() - start;
+    bool same = SameInstances(full.GetInstances(), fixed);
+    if (!same) ++failures;
+    std::printf("  fully refined: %zu instances in %.1f ms, %s fixed depth\n\n",
+        full.GetInstances().count, fullTime * 1e3, same ? "identical to" : "MISMATCH against");
+
+    // A camera swinging from well outside to skimming the surface and back, at several
+    // detail thresholds, with the default half-millisecond budget and with none
+    CameraPath path = CameraPath::Orbit(2.6f, 1.2f, 0.6f, 8, 20.0f);
+    std::printf("  %d frames, orbit 1.4 to 3.8 units out, 1080 px viewport\n", frames);
+    std::printf("  %6s %9s | %9s %9s %7s | %8s %8s %8s | %7s %7s | %s\n", "pixels", "budget",
+        "instances", "max", "x fewer", "p50 ms", "p99 ms", "max ms", "splits", "merges", "converged");
+
+    const float detailLevels[] = { 64.0f, 32.0f, 16.0f };
+    const double budgets[] = { 0.0005, 0.0 };
+    for (float detail : detailLevels) {
+        for (double budget : budgets) {
+            FractalLodSettings lodSettings;
+            lodSettings.detailPixels = detail;
+            lodSettings.viewportHeight = 1080.0f;
+            lodSettings.budgetSeconds = budget;
+
+            FractalLod lod;
+            lod.Initialize(settings, lodSettings);
+
+            std::vector<double> updateTimes;
+            double instances = 0.0, splits = 0.0, merges = 0.0;
+            size_t maxInstances = 0;
+            int converged = 0;
+            for (int frame = 0; frame < frames; ++frame) {
+                CameraPose pose = path.Evaluate(20.0 * frame / frames);
+                lod.Update(pose.position);
+
+                const FractalLodStats& stats = lod.GetStats();
+                updateTimes.push_back(stats.updateSeconds);
+                instances += static_cast<double>(stats.instances);
+                maxInstances = std::max(maxInstances, stats.instances);
+                splits += static_cast<double>(stats.splits);
+                merges += static_cast<double>(stats.merges);
+                if (stats.pending == 0) ++converged;
+            }
+
+            double meanInstances = instances / frames;
+            char budgetText[16];
+            if (budget > 0.0) std::snprintf(budgetText, sizeof(budgetText), "%.1f ms", budget * 1e3);
+            else std::snprintf(budgetText, sizeof(budgetText), "none");
+            std::printf("  %6.0f %9s | %9.0f %9zu %6.0fx | %8.3f %8.3f %8.3f | %7.1f %7.1f | %5.1f%%\n",
+                detail, budgetText, meanInstances, maxInstances, fixed.count / meanInstances,
+                BenchPercentile(updateTimes, 0.5) * 1e3, BenchPercentile(updateTimes, 0.99) * 1e3,
+                BenchPercentile(updateTimes, 1.0) * 1e3, splits / frames, merges / frames, 100.0 * converged / frames);
+        }
+    }
+    return failures;
+}
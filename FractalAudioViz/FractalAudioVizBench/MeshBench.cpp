@@ -0,0 +1,134 @@
+#include "Bench.h"
+#include "FractalGenerator.h"
+#include "FractalMesh.h"
+#include "JobSystem.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    bool SameMesh(const FractalMesh& a, const FractalMesh& b) {
+        return a.vertices.size() == b.vertices.size() && a.indices.size() == b.indices.size() &&
+            std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(MeshVertex)) == 0 &&
+            std::memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(uint32_t)) == 0;
+    }
+
+    // Volume enclosed by the triangles, positive when they wind like Cube's (the cross
+    // product of the first two edges points out). A closed, consistently wound exterior
+    // encloses exactly its cubes; a missing or flipped face shows up as a difference.
+    bool CheckMesh(const FractalMesh& mesh, double expectedVolume, double& volume) {
+        volume = 0.0;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            uint32_t ia = mesh.indices[i], ib = mesh.indices[i + 1], ic = mesh.indices[i + 2];
+            if (ia >= mesh.vertices.size() || ib >= mesh.vertices.size() || ic >= mesh.vertices.size()) {
+                return false;
+            }
+            const MeshVertex& a = mesh.vertices[ia];
+            const MeshVertex& b = mesh.vertices[ib];
+            const MeshVertex& c = mesh.vertices[ic];
+            double cx = static_cast<double>(b.y) * c.z - static_cast<double>(b.z) * c.y;
+            double cy = static_cast<double>(b.z) * c.x - static_cast<double>(b.x) * c.z;
+            double cz = static_cast<double>(b.x) * c.y - static_cast<double>(b.y) * c.x;
+            volume += (a.x * cx + a.y * cy + a.z * cz) / 6.0;
+        }
+        return std::fabs(volume - expectedVolume) <= 1e-3 * expectedVolume;
+    }
+}
+
+int RunMeshBench(const BenchOptions& options) {
+    int failures = 0;
+
+    // The digit rule against the generator: every leaf cube lands on an occupied cell
+    for (FractalType type : { FractalType::MengerSponge, FractalType::Sierpinski }) {
+        FractalSettings settings;
+        settings.type = type;
+        settings.depth = type == FractalType::Sierpinski ? 4 : 3;
+        FractalInstances instances;
+        FractalGenerator::Generate(settings, instances);
+
+        size_t resolution = FractalMeshBuilder::GetResolution(type, settings.depth);
+        size_t occupied = 0;
+        for (size_t k = 0; k < resolution; ++k) {
+            for (size_t j = 0; j < resolution; ++j) {
+                for (size_t i = 0; i < resolution; ++i) {
+                    occupied += FractalMeshBuilder::IsOccupied(type, settings.depth, i, j, k);
+                }
+            }
+        }
+        size_t matched = 0;
+        float cellEdge = 2.0f * settings.halfExtent / resolution;
+        for (size_t n = 0; n < instances.count; ++n) {
+            size_t i = static_cast<size_t>((instances.x[n] + settings.halfExtent) / cellEdge);
+            size_t j = static_cast<size_t>((instances.y[n] + settings.halfExtent) / cellEdge);
+            size_t k = static_cast<size_t>((instances.z[n] + settings.halfExtent) / cellEdge);
+            matched += FractalMeshBuilder::IsOccupied(type, settings.depth, i, j, k);
+        }
+        bool ok = occupied == instances.count && matched == instances.count;
+        if (!ok) ++failures;
+        std::printf("  %s depth %d: %zu occupied cells, %zu of %zu leaves on them - %s\n",
+            type == FractalType::Sierpinski ? "Sierpinski" : "Menger", settings.depth, occupied, matched,
+            instances.count, ok ? "ok" : "MISMATCH");
+    }
+
+    JobSystem jobs;
+    jobs.Initialize();
+
+    std::printf("\n  %-11s %5s %9s | %10s %10s %10s %7s | %9s %8s %8s %8s | %s\n", "fractal", "depth", "cubes",
+        "cube tris", "exposed", "merged", "x fewer", "vertices", "serial", "threads", "jobs", "check");
+
+    struct Case { FractalType type; int depth; };
+    const Case quickCases[] = { { FractalType::MengerSponge, 1 }, { FractalType::MengerSponge, 2 },
+        { FractalType::MengerSponge, 3 }, { FractalType::MengerSponge, 4 }, { FractalType::Sierpinski, 2 },
+        { FractalType::Sierpinski, 4 }, { FractalType::Sierpinski, 6 } };
+    const Case fullCases[] = { { FractalType::MengerSponge, 1 }, { FractalType::MengerSponge, 2 },
+        { FractalType::MengerSponge, 3 }, { FractalType::MengerSponge, 4 }, { FractalType::MengerSponge, 5 },
+        { FractalType::Sierpinski, 2 }, { FractalType::Sierpinski, 4 }, { FractalType::Sierpinski, 6 },
+        { FractalType::Sierpinski, 8 } };
+    const Case* cases = options.quick ? quickCases : fullCases;
+    size_t caseCount = options.quick ? sizeof(quickCases) / sizeof(quickCases[0]) : sizeof(fullCases) / sizeof(fullCases[0]);
+
+    for (size_t c = 0; c < caseCount; ++c) {
+        FractalSettings fractal;
+        fractal.type = cases[c].type;
+        fractal.depth = cases[c].depth;
+
+        for (bool merge : { false, true }) {
+            FractalMeshSettings settings;
+            settings.mergeFaces = merge;
+
+            // One thread, the default pool, and the job system: all must agree exactly
+            FractalMesh serial, threaded, jobbed;
+            FractalMeshStats serialStats, threadStats, jobStats;
+            settings.threadCount = 1;
+            FractalMeshBuilder::Build(fractal, settings, serial, &serialStats);
+            settings.threadCount = 0;
+            FractalMeshBuilder::Build(fractal, settings, threaded, &threadStats);
+            FractalMeshBuilder::Build(fractal, settings, jobbed, &jobStats, &jobs);
+
+            double cellEdge = 2.0 * fractal.halfExtent / serialStats.resolution;
+            double volume = 0.0;
+            bool closed = CheckMesh(serial, serialStats.cubes * cellEdge * cellEdge * cellEdge, volume);
+            bool same = SameMesh(serial, threaded) && SameMesh(serial, jobbed);
+            bool counted = serialStats.cubes == FractalGenerator::GetInstanceCount(fractal.type, fractal.depth) &&
+                serialStats.quads * 6 == serial.indices.size() &&
+                (merge || serialStats.quads == serialStats.exposedFaces);
+            bool ok = closed && same && counted;
+            if (!ok) ++failures;
+
+            char label[16];
+            std::snprintf(label, sizeof(label), "%s%s", fractal.type == FractalType::Sierpinski ? "Sierpinski" : "Menger",
+                merge ? "" : "*");
+            std::printf("  %-11s %5d %9zu | %10zu %10zu %10zu %6.1fx | %9zu %6.1fms %6.1fms %6.1fms | %s\n",
+                label, fractal.depth, serialStats.cubes, serialStats.GetCubeTriangles(),
+                serialStats.exposedFaces * 2, serialStats.GetTriangles(),
+                static_cast<double>(serialStats.GetCubeTriangles()) / serialStats.GetTriangles(),
+                serial.vertices.size(), serialStats.buildSeconds * 1e3, threadStats.buildSeconds * 1e3,
+                jobStats.buildSeconds * 1e3,
+                !closed ? "OPEN OR MISWOUND" : !same ? "THREADS DIFFER" : !counted ? "COUNT MISMATCH" : "ok");
+        }
+    }
+    std::printf("  * without merging: one quad per exposed face\n");
+
+    jobs.Shutdown();
+    return failures;
+}
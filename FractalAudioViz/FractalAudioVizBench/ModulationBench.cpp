@@ -0,0 +1,256 @@
+#include "Bench.h"
+#include "ModulationMatrix.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    const size_t BAND_COUNT = 64;
+
+    // A patch for a fractal of instances, each with a scale, a hue, a fold and a spin
+    // rate integrated into an angle, after the scene's own targets: routes from every
+    // band, the level, onsets and the beat, through each curve, spread across runs of
+    // instances with a per-instance depth ramp and some scaled by a second source
+    ModulationPatch MakeInstancePatch(size_t instances, size_t routes, uint32_t seed) {
+        ModulationPatch patch = Simulation::CreateScenePatch(BAND_COUNT);
+        ModulationTarget scale;
+        scale.base = 1.0f;
+        scale.minimum = 0.25f;
+        scale.maximum = 4.0f;
+        ModulationTarget hue;
+        hue.minimum = 0.0f;
+        hue.maximum = 1.0f;
+        ModulationTarget fold;
+        fold.base = 2.0f;
+        fold.minimum = 1.0f;
+        fold.maximum = 3.0f;
+        ModulationTarget spin;
+        spin.base = 10.0f;
+        spin.integrate = true;
+        spin.wrap = 360.0f;
+        const uint32_t firsts[] = {
+            patch.AddTargets(scale, static_cast<uint32_t>(instances)),
+            patch.AddTargets(hue, static_cast<uint32_t>(instances)),
+            patch.AddTargets(fold, static_cast<uint32_t>(instances)),
+            patch.AddTargets(spin, static_cast<uint32_t>(instances)),
+        };
+
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        const ModulationSource kinds[] = { ModulationSource::Level, ModulationSource::Onset,
+            ModulationSource::BeatPhase, ModulationSource::BeatConfidence };
+        for (size_t r = 0; r < routes; ++r) {
+            ModulationRoute route;
+            if (r % 8 < 6) {
+                route.source = ModulationSource::Band;
+                route.sourceIndex = static_cast<uint32_t>(random() % BAND_COUNT);
+            }
+            else {
+                route.source = kinds[random() % 4];
+            }
+            route.inputMin = 0.1f * unit(random);
+            route.inputMax = 0.7f + 0.3f * unit(random);
+            route.curve = static_cast<ModulationCurve>(random() % 6);
+            if (r % 4 == 0) route.via = ModulationSource::BeatConfidence;
+            route.attackSeconds = 0.05f * unit(random);
+            route.releaseSeconds = 0.5f * unit(random);
+            uint32_t count = 64 + static_cast<uint32_t>(random() % 448);
+            route.target = firsts[r % 4] + static_cast<uint32_t>(random() % (instances - count));
+            route.targetCount = count;
+            route.depth = 0.2f * (unit(random) - 0.3f);
+            route.depthStep = 0.2f / count * (unit(random) - 0.5f);
+            patch.routes.push_back(route);
+        }
+        return patch;
+    }
+
+    // Analysis output for one update of a synthetic track: bands swelling at their own
+    // rates, a 120 BPM beat, onsets on the beats
+    void MakeInputs(size_t update, BandEnergies& bands, BeatState& beat, ModulationInputs& inputs) {
+        double t = update / 60.0;
+        for (size_t band = 0; band < BAND_COUNT; ++band) {
+            double level = 0.5 + 0.5 * std::sin(t * (0.7 + 0.11 * band) + band);
+            bands.decibels[band] = static_cast<float>(bands.floorDb * (1.0 - level));
+        }
+        beat.beatPhase = static_cast<float>(std::fmod(t * 2.0, 1.0));
+        beat.confidence = 0.8f;
+        beat.onset = beat.beatPhase < 2.0f / 60.0f;
+        beat.onsetStrength = beat.onset ? 0.9f : 0.0f;
+        inputs.bands = &bands;
+        inputs.beat = &beat;
+        inputs.level = static_cast<float>(0.6 + 0.2 * std::sin(t));
+        inputs.onset = beat.onsetStrength;
+    }
+
+    // The routing written the ad-hoc way, one route at a time: a switch per curve, the
+    // smoother's rate worked out each update and every target added in its own loop
+    struct NaiveMatrix {
+        ModulationPatch patch;
+        std::vector<float> routeValues;
+        std::vector<float> values;
+        std::vector<double> angles;
+
+        float Source(ModulationSource source, uint32_t index, const ModulationInputs& inputs) const {
+            switch (source) {
+            case ModulationSource::Band: return inputs.bands->GetLevel(index);
+            case ModulationSource::Level: return inputs.level;
+            case ModulationSource::Onset: return inputs.onset;
+            case ModulationSource::BeatPhase: return inputs.beat->beatPhase;
+            case ModulationSource::BeatConfidence: return inputs.beat->confidence;
+            default: return 1.0f;
+            }
+        }
+
+        void Evaluate(const ModulationInputs& inputs, float deltaTime) {
+            routeValues.resize(patch.routes.size(), 0.0f);
+            values.resize(patch.targets.size());
+            angles.resize(patch.targets.size(), 0.0);
+            for (size_t t = 0; t < patch.targets.size(); ++t) values[t] = patch.targets[t].base;
+            for (size_t r = 0; r < patch.routes.size(); ++r) {
+                const ModulationRoute& route = patch.routes[r];
+                float x = (Source(route.source, route.sourceIndex, inputs) - route.inputMin) / (route.inputMax - route.inputMin);
+                x = std::min(std::max(x, 0.0f), 1.0f);
+                float y = x;
+                switch (route.curve) {
+                case ModulationCurve::Invert: y = 1.0f - x; break;
+                case ModulationCurve::Square: y = x * x; break;
+                case ModulationCurve::Cube: y = x * x * x; break;
+                case ModulationCurve::SmoothStep: y = x * x * (3.0f - 2.0f * x); break;
+                case ModulationCurve::Decay: y = (1.0f - x) * (1.0f - x) * (1.0f - x); break;
+                default: break;
+                }
+                y *= Source(route.via, route.viaIndex, inputs);
+                float seconds = y > routeValues[r] ? route.attackSeconds : route.releaseSeconds;
+                float rate = seconds > 0.0f ? 1.0f - std::exp(-deltaTime / seconds) : 1.0f;
+                routeValues[r] += (y - routeValues[r]) * rate;
+                for (uint32_t i = 0; i < route.targetCount; ++i) {
+                    values[route.target + i] += routeValues[r] * (route.depth + route.depthStep * i);
+                }
+            }
+            for (size_t t = 0; t < patch.targets.size(); ++t) {
+                const ModulationTarget& target = patch.targets[t];
+                values[t] = std::min(std::max(values[t], target.minimum), target.maximum);
+                if (target.integrate) {
+                    angles[t] += values[t] * deltaTime;
+                    if (target.wrap > 0.0f) angles[t] -= target.wrap * std::floor(angles[t] / target.wrap);
+                    values[t] = static_cast<float>(angles[t]);
+                }
+            }
+        }
+    };
+
+    // Median of per-update times, after a warm-up
+    template <typename Fn>
+    double MedianUpdateSeconds(size_t updates, Fn&& fn) {
+        std::vector<double> times;
+        times.reserve(updates);
+        for (size_t i = 0; i < updates + 16; ++i) {
+            double start = BenchNowSeconds();
+            fn(i);
+            if (i >= 16) times.push_back(BenchNowSeconds() - start);
+        }
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        return times[times.size() / 2];
+    }
+}
+
+int RunModulationBench(const BenchOptions& options) {
+    int failures = 0;
+    const size_t updates = options.quick ? 300 : 3000;
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    BandEnergies bands;
+    bands.power.assign(BAND_COUNT, 0.0f);
+    bands.decibels.assign(BAND_COUNT, 0.0f);
+    bands.centerFrequency.assign(BAND_COUNT, 0.0f);
+    BeatState beat;
+    ModulationInputs inputs;
+
+    // Per-update cost across patch sizes; the compiled program must fit in 0.2 ms at the
+    // best level with tens of thousands of targets and thousands of routes. The largest
+    // size is twice that again, reported for headroom.
+    struct Size { size_t instances; size_t routes; };
+    const Size sizes[] = { { 1024, 256 }, { 4096, 1024 }, { 8192, 4096 }, { 16384, 8192 } };
+    std::printf("  %8s %7s %8s %9s | %9s", "targets", "routes", "spans", "compile", "naive");
+    for (SimdLevel level : levels) std::printf(" %9s", GetSimdLevelName(level));
+    std::printf(" | %8s %s\n", "speedup", "check");
+    for (const Size& size : sizes) {
+        ModulationPatch patch = MakeInstancePatch(size.instances, size.routes, 5);
+        size_t spans = 0;
+        for (const ModulationRoute& route : patch.routes) spans += route.targetCount;
+
+        double compileStart = BenchNowSeconds();
+        ModulationMatrix matrix;
+        matrix.Compile(patch, BAND_COUNT);
+        double compileSeconds = BenchNowSeconds() - compileStart;
+
+        NaiveMatrix naive;
+        naive.patch = patch;
+        double naiveSeconds = MedianUpdateSeconds(updates, [&](size_t i) {
+            MakeInputs(i, bands, beat, inputs);
+            naive.Evaluate(inputs, FIXED_TIMESTEP);
+        });
+        std::printf("  %8zu %7zu %8zu %7.2fms | %7.1fus", patch.targets.size(), patch.routes.size(), spans,
+            compileSeconds * 1e3, naiveSeconds * 1e6);
+
+        double best = 0.0;
+        for (SimdLevel level : levels) {
+            if (ResolveSimdLevel(level) != level) {
+                std::printf(" %9s", "-");
+                continue;
+            }
+            matrix.Compile(patch, BAND_COUNT, level);
+            double seconds = MedianUpdateSeconds(updates, [&](size_t i) {
+                MakeInputs(i, bands, beat, inputs);
+                matrix.Evaluate(inputs, FIXED_TIMESTEP);
+            });
+            best = best == 0.0 ? seconds : std::min(best, seconds);
+            std::printf(" %7.1fus", seconds * 1e6);
+        }
+        bool budgeted = &size == &sizes[2];
+        bool ok = !budgeted || best < 0.0002;
+        if (!ok) ++failures;
+        std::printf(" | %7.1fx %s\n", naiveSeconds / best, !budgeted ? "-" : ok ? "ok" : "OVER BUDGET");
+    }
+
+    // Every level against the naive evaluation over a minute of updates: the same
+    // program, so only rounding (fused on AVX2 and up) may differ
+    std::printf("\n  Agreement with the naive evaluation after 3600 updates, 16384 instances:\n");
+    ModulationPatch patch = MakeInstancePatch(16384, 8192, 9);
+    NaiveMatrix naive;
+    naive.patch = patch;
+    for (size_t i = 0; i < 3600; ++i) {
+        MakeInputs(i, bands, beat, inputs);
+        naive.Evaluate(inputs, FIXED_TIMESTEP);
+    }
+    for (SimdLevel level : levels) {
+        if (ResolveSimdLevel(level) != level) continue;
+        ModulationMatrix matrix;
+        matrix.Compile(patch, BAND_COUNT, level);
+        for (size_t i = 0; i < 3600; ++i) {
+            MakeInputs(i, bands, beat, inputs);
+            matrix.Evaluate(inputs, FIXED_TIMESTEP);
+        }
+
+        // Angles are compared around the circle
+        double maxError = 0.0, maxAngleError = 0.0;
+        for (size_t t = 0; t < patch.targets.size(); ++t) {
+            double error = std::fabs(static_cast<double>(matrix.GetValue(static_cast<uint32_t>(t))) - naive.values[t]);
+            if (patch.targets[t].integrate) {
+                error = std::min(error, patch.targets[t].wrap - error);
+                maxAngleError = std::max(maxAngleError, error);
+            }
+            else {
+                maxError = std::max(maxError, error);
+            }
+        }
+        bool ok = maxError < 1e-4 && maxAngleError < 0.01;
+        if (!ok) ++failures;
+        std::printf("  %-8s max error %.2e, angles %.2e degrees %s\n", GetSimdLevelName(level), maxError, maxAngleError,
+            ok ? "ok" : "MISMATCH");
+    }
+    return failures;
+}
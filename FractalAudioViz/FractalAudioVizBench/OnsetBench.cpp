@@ -0,0 +1,203 @@
+#include "Bench.h"
+#include "BeatTracker.h"
+#include "OnsetDetector.h"
+#include "STFT.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const int SAMPLE_RATE = 48000;
+    const double PI = 3.14159265358979323846;
+
+    // Detections within this distance of a click count as hits
+    const double MATCH_WINDOW_SECONDS = 0.05;
+
+    struct ClickTrack {
+        std::vector<float> samples;
+        std::vector<uint64_t> clicks;  // Sample index of each click start
+        float bpm;
+    };
+
+    // Mono click track: 5 ms decaying noise-and-tone bursts on the beat, optionally over
+    // a sustained chord and background noise, so the detector has to reject steady energy
+    ClickTrack MakeClickTrack(float bpm, double seconds, float noiseLevel, float padLevel, uint32_t seed) {
+        ClickTrack track;
+        track.bpm = bpm;
+        size_t total = static_cast<size_t>(seconds * SAMPLE_RATE);
+        track.samples.assign(total, 0.0f);
+
+        uint32_t state = seed;
+        auto noise = [&state]() {
+            state = state * 1664525u + 1013904223u;
+            return static_cast<float>(state >> 8) / 8388608.0f - 1.0f;
+        };
+
+        // First click a little in, so the detector has primed
+        double period = 60.0 / bpm;
+        const size_t clickLength = SAMPLE_RATE / 200;
+        for (double t = 0.25; t * SAMPLE_RATE + clickLength < total; t += period) {
+            uint64_t start = static_cast<uint64_t>(t * SAMPLE_RATE);
+            track.clicks.push_back(start);
+            for (size_t i = 0; i < clickLength; ++i) {
+                float envelope = std::exp(-static_cast<float>(i) / (clickLength / 5.0f));
+                float tone = static_cast<float>(std::sin(2.0 * PI * 1800.0 * i / SAMPLE_RATE));
+                track.samples[start + i] += 0.6f * envelope * (0.5f * tone + 0.5f * noise());
+            }
+        }
+
+        for (size_t i = 0; i < total; ++i) {
+            double t = static_cast<double>(i) / SAMPLE_RATE;
+            float pad = static_cast<float>(std::sin(2.0 * PI * 220.0 * t) + std::sin(2.0 * PI * 277.2 * t) +
+                std::sin(2.0 * PI * 329.6 * t)) / 3.0f;
+            track.samples[i] += padLevel * pad + noiseLevel * noise();
+        }
+        return track;
+    }
+
+    struct TrackResult {
+        size_t truePositives;
+        size_t falsePositives;
+        size_t falseNegatives;
+        double latencySum;       // Seconds from click to the end of the detecting frame
+        double latencyMax;
+        double finalBpm;
+        double beatErrorSum;     // Seconds from each reported beat to the nearest click
+        size_t beatCount;
+        double secondsToLock;    // Until the tempo settles within 2%
+        double processSeconds;   // Detector + tracker CPU time, STFT excluded
+        size_t hops;
+    };
+
+    TrackResult RunTrack(const ClickTrack& track, size_t fftSize, size_t hopSize, OnsetMethod method) {
+        TrackResult result = {};
+        result.secondsToLock = -1.0;
+
+        StftSettings stftSettings;
+        stftSettings.fftSize = fftSize;
+        stftSettings.hopSize = hopSize;
+        stftSettings.computePhase = method == OnsetMethod::ComplexDomain;
+        STFT stft;
+        stft.Initialize(stftSettings);
+
+        const float hopSeconds = static_cast<float>(hopSize) / SAMPLE_RATE;
+        OnsetSettings onsetSettings;
+        onsetSettings.method = method;
+        onsetSettings.hopSeconds = hopSeconds;
+        OnsetDetector detector;
+        detector.Initialize(onsetSettings, stft.GetBinCount());
+
+        BeatTrackerSettings beatSettings;
+        beatSettings.hopSeconds = hopSeconds;
+        BeatTracker tracker;
+        tracker.Initialize(beatSettings);
+
+        std::vector<bool> matched(track.clicks.size(), false);
+        const uint64_t matchWindow = static_cast<uint64_t>(MATCH_WINDOW_SECONDS * SAMPLE_RATE);
+        const double clickPeriod = 60.0 / track.bpm;
+        bool inLock = false;
+
+        size_t position = 0;
+        while (position < track.samples.size()) {
+            position += stft.Consume(&track.samples[position], track.samples.size() - position);
+            if (!stft.HasNewFrame()) continue;
+
+            double start = BenchNowSeconds();
+            bool onset = detector.Process(stft.GetMagnitude(), stft.GetPhase());
+            const BeatState& beat = tracker.Process(detector.GetValue(), onset, detector.GetStrength());
+            result.processSeconds += BenchNowSeconds() - start;
+            ++result.hops;
+
+            uint64_t frameEnd = stft.GetFrameEndSample();
+            double now = static_cast<double>(frameEnd) / SAMPLE_RATE;
+
+            // The tempo counts as locked once it stays within 2% of the truth
+            bool tempoGood = std::fabs(beat.tempoBpm - track.bpm) < 0.02 * track.bpm;
+            if (tempoGood && !inLock) result.secondsToLock = now;
+            if (!tempoGood) result.secondsToLock = -1.0;
+            inLock = tempoGood;
+
+            if (onset) {
+                // Match against the latest click that started before this frame ended
+                bool hit = false;
+                for (size_t c = 0; c < track.clicks.size() && track.clicks[c] <= frameEnd; ++c) {
+                    if (!matched[c] && frameEnd - track.clicks[c] <= matchWindow + fftSize) {
+                        double latency = static_cast<double>(frameEnd - track.clicks[c]) / SAMPLE_RATE;
+                        if (latency <= MATCH_WINDOW_SECONDS + static_cast<double>(fftSize) / SAMPLE_RATE) {
+                            matched[c] = true;
+                            hit = true;
+                            result.latencySum += latency;
+                            if (latency > result.latencyMax) result.latencyMax = latency;
+                            break;
+                        }
+                    }
+                }
+                if (hit) ++result.truePositives;
+                else ++result.falsePositives;
+            }
+
+            // Beat alignment, scored after the tracker has had a few seconds
+            if (beat.beat && now > 4.0) {
+                double phase = std::fmod(now - static_cast<double>(track.clicks[0]) / SAMPLE_RATE, clickPeriod);
+                double error = phase > 0.5 * clickPeriod ? clickPeriod - phase : phase;
+                result.beatErrorSum += error;
+                ++result.beatCount;
+            }
+        }
+
+        for (bool m : matched) {
+            if (!m) ++result.falseNegatives;
+        }
+        result.finalBpm = tracker.GetState().tempoBpm;
+        return result;
+    }
+}
+
+int RunOnsetBench(const BenchOptions& options) {
+    const double seconds = options.quick ? 12.0 : 30.0;
+    const float tempos[] = { 80.0f, 97.0f, 120.0f, 140.0f, 170.0f };
+    int failures = 0;
+
+    struct Mix { const char* name; float noise; float pad; };
+    const Mix mixes[] = { { "clean", 0.0f, 0.0f }, { "noisy", 0.03f, 0.15f } };
+
+    struct Config { size_t fftSize; size_t hopSize; OnsetMethod method; const char* name; };
+    const Config configs[] = {
+        { 4096, 1024, OnsetMethod::SpectralFlux, "flux 4096/1024" },
+        { 2048, 512, OnsetMethod::SpectralFlux, "flux 2048/512" },
+        { 2048, 512, OnsetMethod::ComplexDomain, "cd 2048/512" },
+        { 1024, 256, OnsetMethod::SpectralFlux, "flux 1024/256" },
+    };
+
+    std::printf("  %.0f s click tracks, onsets matched within %.0f ms; latency = click to end of detecting frame\n",
+        seconds, MATCH_WINDOW_SECONDS * 1000.0);
+    std::printf("  %-15s %-5s %5s %6s %6s %6s %8s %8s %7s %7s %8s %8s\n", "config", "mix", "bpm",
+        "prec", "recall", "F", "lat ms", "max ms", "est bpm", "lock s", "beat ms", "us/hop");
+
+    for (const Config& config : configs) {
+        for (const Mix& mix : mixes) {
+            for (float bpm : tempos) {
+                ClickTrack track = MakeClickTrack(bpm, seconds, mix.noise, mix.pad, 0x9e3779b9u ^ static_cast<uint32_t>(bpm));
+                TrackResult r = RunTrack(track, config.fftSize, config.hopSize, config.method);
+
+                double precision = r.truePositives + r.falsePositives > 0 ?
+                    static_cast<double>(r.truePositives) / (r.truePositives + r.falsePositives) : 0.0;
+                double recall = r.truePositives + r.falseNegatives > 0 ?
+                    static_cast<double>(r.truePositives) / (r.truePositives + r.falseNegatives) : 0.0;
+                double f = precision + recall > 0.0 ? 2.0 * precision * recall / (precision + recall) : 0.0;
+                double latency = r.truePositives > 0 ? r.latencySum / r.truePositives : 0.0;
+                double beatError = r.beatCount > 0 ? r.beatErrorSum / r.beatCount : 0.0;
+
+                std::printf("  %-15s %-5s %5.0f %6.3f %6.3f %6.3f %8.1f %8.1f %7.1f %7.1f %8.1f %8.2f\n",
+                    config.name, mix.name, bpm, precision, recall, f, latency * 1000.0, r.latencyMax * 1000.0,
+                    r.finalBpm, r.secondsToLock, beatError * 1000.0, r.processSeconds / r.hops * 1e6);
+
+                // Clean clicks must be found, and the tempo must settle
+                if (!mix.noise && (f < 0.95 || std::fabs(r.finalBpm - bpm) > 0.02 * bpm)) ++failures;
+            }
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,199 @@
+#include "Bench.h"
+#include "FractalMesh.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+    const size_t CACHE_SIZE = 16;
+    const int RASTER_SIZE = 384;
+
+    // Orthographic views from around the mesh, none along an axis
+    const float VIEWS[][3] = {
+        { 1, 1, 1 }, { -1, 1, 1 }, { 1, -1, 1 }, { -1, -1, 1 },
+        { 1, 1, -1 }, { -1, 1, -1 }, { 1, -1, -1 }, { -1, -1, -1 },
+        { 0.3f, 0.2f, 1 }, { 1, 0.3f, -0.2f }, { -0.2f, 1, 0.3f }
+    };
+
+    // Fragments that pass the depth test over pixels covered, drawing in index order with
+    // back faces culled, averaged over the views: 1 when every pixel is shaded once
+    double MeasureOverdraw(const FractalMesh& mesh) {
+        std::vector<float> depth(RASTER_SIZE * RASTER_SIZE);
+        double shaded = 0.0, covered = 0.0;
+
+        for (const float* view : VIEWS) {
+            float length = std::sqrt(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+            float forward[3] = { -view[0] / length, -view[1] / length, -view[2] / length };
+            float right[3] = { forward[2], 0.0f, -forward[0] };
+            float rightLength = std::sqrt(right[0] * right[0] + right[2] * right[2]);
+            right[0] /= rightLength;
+            right[2] /= rightLength;
+            float up[3] = { forward[1] * right[2] - forward[2] * right[1], forward[2] * right[0] - forward[0] * right[2],
+                forward[0] * right[1] - forward[1] * right[0] };
+
+            // The fractal fits in the unit sphere's sqrt(3) radius around the origin
+            std::vector<float> screen(mesh.vertices.size() * 3);
+            const float scale = RASTER_SIZE / (2.0f * 1.75f);
+            for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+                const MeshVertex& p = mesh.vertices[v];
+                screen[v * 3] = (p.x * right[0] + p.y * right[1] + p.z * right[2]) * scale + RASTER_SIZE * 0.5f;
+                screen[v * 3 + 1] = (p.x * up[0] + p.y * up[1] + p.z * up[2]) * scale + RASTER_SIZE * 0.5f;
+                screen[v * 3 + 2] = p.x * forward[0] + p.y * forward[1] + p.z * forward[2];
+            }
+
+            std::fill(depth.begin(), depth.end(), 1e30f);
+            size_t writes = 0;
+            for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+                const MeshVertex& a = mesh.vertices[mesh.indices[t]];
+                const MeshVertex& b = mesh.vertices[mesh.indices[t + 1]];
+                const MeshVertex& c = mesh.vertices[mesh.indices[t + 2]];
+                float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+                float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+                float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                if (n[0] * forward[0] + n[1] * forward[1] + n[2] * forward[2] >= 0.0f) continue;
+
+                const float* s0 = &screen[mesh.indices[t] * 3];
+                const float* s1 = &screen[mesh.indices[t + 1] * 3];
+                const float* s2 = &screen[mesh.indices[t + 2] * 3];
+                float area = (s1[0] - s0[0]) * (s2[1] - s0[1]) - (s1[1] - s0[1]) * (s2[0] - s0[0]);
+                if (area == 0.0f) continue;
+
+                int minX = std::max(0, static_cast<int>(std::floor(std::min(std::min(s0[0], s1[0]), s2[0]))));
+                int maxX = std::min(RASTER_SIZE - 1, static_cast<int>(std::ceil(std::max(std::max(s0[0], s1[0]), s2[0]))));
+                int minY = std::max(0, static_cast<int>(std::floor(std::min(std::min(s0[1], s1[1]), s2[1]))));
+                int maxY = std::min(RASTER_SIZE - 1, static_cast<int>(std::ceil(std::max(std::max(s0[1], s1[1]), s2[1]))));
+                for (int y = minY; y <= maxY; ++y) {
+                    for (int x = minX; x <= maxX; ++x) {
+                        float px = x + 0.5f, py = y + 0.5f;
+                        float w0 = ((s2[0] - s1[0]) * (py - s1[1]) - (s2[1] - s1[1]) * (px - s1[0])) / area;
+                        float w1 = ((s0[0] - s2[0]) * (py - s2[1]) - (s0[1] - s2[1]) * (px - s2[0])) / area;
+                        float w2 = 1.0f - w0 - w1;
+                        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+                        float z = w0 * s0[2] + w1 * s1[2] + w2 * s2[2];
+                        float& stored = depth[y * RASTER_SIZE + x];
+                        if (z < stored) {
+                            stored = z;
+                            ++writes;
+                        }
+                    }
+                }
+            }
+
+            size_t pixels = 0;
+            for (float d : depth) pixels += d < 1e30f;
+            shaded += static_cast<double>(writes);
+            covered += static_cast<double>(pixels);
+        }
+        return covered > 0.0 ? shaded / covered : 0.0;
+    }
+
+    // Order-independent fingerprint of the triangles by their vertex contents, each
+    // rotated to start at its smallest vertex so winding is kept
+    uint64_t TriangleFingerprint(const FractalMesh& mesh) {
+        uint64_t sum = 0, mixed = 0;
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            const MeshVertex* v[3] = { &mesh.vertices[mesh.indices[t]], &mesh.vertices[mesh.indices[t + 1]],
+                &mesh.vertices[mesh.indices[t + 2]] };
+            int first = 0;
+            for (int k = 1; k < 3; ++k) {
+                if (std::memcmp(v[k], v[first], sizeof(MeshVertex)) < 0) first = k;
+            }
+            uint64_t hash = 14695981039346656037ull;
+            for (int k = 0; k < 3; ++k) {
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(v[(first + k) % 3]);
+                for (size_t b = 0; b < sizeof(MeshVertex); ++b) {
+                    hash = (hash ^ bytes[b]) * 1099511628211ull;
+                }
+            }
+            sum += hash;
+            mixed ^= hash * 0x9E3779B97F4A7C15ull;
+        }
+        return sum ^ (mixed << 1);
+    }
+
+    VertexCacheStats Analyze(const FractalMesh& mesh) {
+        return MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), CACHE_SIZE);
+    }
+}
+
+int RunOptimizeBench(const BenchOptions& options) {
+    int failures = 0;
+
+    struct Case { FractalType type; int depth; bool merge; };
+    const Case cases[] = { { FractalType::MengerSponge, 3, false }, { FractalType::MengerSponge, 3, true },
+        { FractalType::MengerSponge, 4, false }, { FractalType::MengerSponge, 4, true },
+        { FractalType::Sierpinski, 6, false } };
+    const size_t caseCount = options.quick ? 3 : sizeof(cases) / sizeof(cases[0]);
+
+    std::printf("  FIFO cache of %zu; ACMR = vertex shader runs per triangle, ATVR = per distinct vertex\n", CACHE_SIZE);
+    std::printf("  overdraw = shaded fragments per covered pixel, over %zu views\n\n", sizeof(VIEWS) / sizeof(VIEWS[0]));
+    std::printf("  %-18s %9s %-13s | %-17s %-17s %-17s | %-12s | %8s %8s %8s | %s\n", "mesh", "triangles", "vertices",
+        "generated", "cache order", "final", "overdraw", "Mtri/s", "cache", "overdraw", "check");
+
+    for (size_t c = 0; c < caseCount; ++c) {
+        FractalSettings fractal;
+        fractal.type = cases[c].type;
+        fractal.depth = cases[c].depth;
+        FractalMeshSettings meshSettings;
+        meshSettings.mergeFaces = cases[c].merge;
+        FractalMesh mesh;
+        FractalMeshBuilder::Build(fractal, meshSettings, mesh);
+
+        // Generation order, then welded so the cache has reuse to work with
+        VertexCacheStats generated = Analyze(mesh);
+        uint64_t fingerprint = TriangleFingerprint(mesh);
+        size_t generatedVertices = mesh.vertices.size();
+
+        FractalMesh welded = mesh;
+        {
+            std::vector<uint32_t> remap(welded.vertices.size());
+            size_t unique = MeshOptimizer::GenerateWeldRemap(welded.vertices.data(), welded.vertices.size(),
+                sizeof(MeshVertex), remap.data());
+            std::vector<MeshVertex> vertices(unique);
+            MeshOptimizer::RemapVertices(vertices.data(), welded.vertices.data(), welded.vertices.size(),
+                sizeof(MeshVertex), remap.data());
+            MeshOptimizer::RemapIndices(welded.indices.data(), welded.indices.size(), remap.data());
+            welded.vertices.swap(vertices);
+        }
+        VertexCacheStats weldedStats = Analyze(welded);
+        double overdrawBefore = MeasureOverdraw(welded);
+
+        // The cache order alone, for its own numbers
+        FractalMesh cacheOnly = welded;
+        MeshOptimizer::OptimizeVertexCache(cacheOnly.indices.data(), welded.indices.data(), welded.indices.size(),
+            welded.vertices.size(), CACHE_SIZE);
+        VertexCacheStats cacheStats = Analyze(cacheOnly);
+
+        MeshOptimizerStats stats;
+        double start = BenchNowSeconds();
+        MeshOptimizer::Optimize(mesh, MeshOptimizerSettings(), &stats);
+        double seconds = BenchNowSeconds() - start;
+        VertexCacheStats final = Analyze(mesh);
+        double overdrawAfter = MeasureOverdraw(mesh);
+
+        bool same = TriangleFingerprint(mesh) == fingerprint && final.triangles == generated.triangles &&
+            final.vertices == mesh.vertices.size();
+        bool better = final.GetACMR() <= weldedStats.GetACMR();
+        if (!same || !better) ++failures;
+
+        char label[32], vertexText[48], generatedText[32], cacheText[32], finalText[32], overdrawText[32];
+        std::snprintf(label, sizeof(label), "%s %d%s", fractal.type == FractalType::Sierpinski ? "Sierpinski" : "Menger",
+            fractal.depth, cases[c].merge ? " merged" : "");
+        std::snprintf(vertexText, sizeof(vertexText), "%zuk -> %zuk", generatedVertices / 1000, stats.verticesAfter / 1000);
+        std::snprintf(generatedText, sizeof(generatedText), "%.3f %.2f/%.3f", generated.GetACMR(),
+            weldedStats.GetACMR(), weldedStats.GetATVR());
+        std::snprintf(cacheText, sizeof(cacheText), "%.3f / %.3f", cacheStats.GetACMR(), cacheStats.GetATVR());
+        std::snprintf(finalText, sizeof(finalText), "%.3f / %.3f", final.GetACMR(), final.GetATVR());
+        std::snprintf(overdrawText, sizeof(overdrawText), "%.2f -> %.2f", overdrawBefore, overdrawAfter);
+        double triangles = static_cast<double>(generated.triangles);
+        std::printf("  %-18s %9zu %-13s | %-17s %-17s %-17s | %-12s | %8.1f %8.1f %8.1f | %s\n", label,
+            generated.triangles, vertexText, generatedText, cacheText, finalText,
+            overdrawText, triangles / seconds * 1e-6, triangles / stats.cacheSeconds * 1e-6,
+            triangles / stats.overdrawSeconds * 1e-6, !same ? "TRIANGLES CHANGED" : !better ? "NO GAIN" : "ok");
+    }
+    std::printf("  generated: ACMR as built, then ACMR/ATVR once welded; Mtri/s: whole pass, Tipsify, clustering\n");
+    return failures;
+}
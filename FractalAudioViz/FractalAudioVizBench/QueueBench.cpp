@@ -0,0 +1,175 @@
+#include "Bench.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    const RenderHandle PIPELINES = 32;
+    const RenderHandle MESHES = 256;
+    const RenderHandle INSTANCE_SETS = 4;
+
+    struct SceneObject {
+        RenderHandle pipeline;
+        RenderHandle mesh;
+        RenderHandle instances;
+        uint32_t instanceCount;
+        float depth;
+        float world[16];
+    };
+
+    std::vector<SceneObject> MakeScene(size_t count) {
+        std::vector<SceneObject> scene(count);
+        uint32_t state = 0x2545F491u;
+        auto next = [&state]() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        };
+
+        for (size_t i = 0; i < count; ++i) {
+            SceneObject& object = scene[i];
+            object.pipeline = static_cast<RenderHandle>(1 + next() % PIPELINES);
+            object.mesh = static_cast<RenderHandle>(1 + next() % MESHES);
+            bool instanced = next() % 8 == 0;
+            object.instances = instanced ? static_cast<RenderHandle>(1 + next() % INSTANCE_SETS) : 0;
+            object.instanceCount = instanced ? 1 + next() % 1000 : 0;
+            object.depth = (next() % 100000) / 100000.0f;
+            for (int m = 0; m < 16; ++m) object.world[m] = static_cast<float>(i * 16 + m);
+        }
+        return scene;
+    }
+
+    void RecordRange(const std::vector<SceneObject>& scene, size_t begin, size_t end, RenderCommandList& list, bool sortKeys) {
+        for (size_t i = begin; i < end; ++i) {
+            const SceneObject& object = scene[i];
+            DrawPacket packet = {};
+            packet.sortKey = sortKeys ? SortKey::Opaque(0, object.pipeline, object.mesh, object.depth) : 0;
+            packet.pipeline = object.pipeline;
+            packet.vertexBuffer = object.mesh;
+            packet.indexBuffer = object.mesh;
+            packet.instances = object.instances;
+            packet.constants = list.AddConstants(object.world, sizeof(object.world));
+            packet.constantSize = sizeof(object.world);
+            packet.indexCount = 36;
+            packet.instanceCount = object.instanceCount;
+            list.Add(packet);
+        }
+    }
+
+    // Record the scene into one list per thread, each thread taking a contiguous slice
+    void Record(const std::vector<SceneObject>& scene, RenderQueue& queue, unsigned threads, bool sortKeys) {
+        queue.SetListCount(threads);
+        size_t slice = (scene.size() + threads - 1) / threads;
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) {
+            size_t begin = std::min(scene.size(), t * slice);
+            size_t end = std::min(scene.size(), begin + slice);
+            pool.emplace_back(RecordRange, std::cref(scene), begin, end, std::ref(queue.GetList(t)), sortKeys);
+        }
+        RecordRange(scene, 0, std::min(scene.size(), slice), queue.GetList(0), sortKeys);
+        for (std::thread& thread : pool) thread.join();
+    }
+
+    // What scene objects did before the queue: bind everything, every draw, in scene order
+    void ReplayImmediate(const std::vector<SceneObject>& scene, RenderBackend& backend) {
+        for (const SceneObject& object : scene) {
+            backend.SetPipeline(object.pipeline);
+            backend.SetVertexBuffer(object.mesh);
+            backend.SetIndexBuffer(object.mesh);
+            if (object.instanceCount > 0) backend.SetInstances(object.instances);
+            backend.SetDrawConstants(object.world, sizeof(object.world));
+            if (object.instanceCount > 0) backend.DrawIndexedInstanced(36, object.instanceCount, 0, 0);
+            else backend.DrawIndexed(36, 0, 0);
+        }
+    }
+
+    template <typename Fn>
+    double Best(int repeats, Fn fn) {
+        double best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            double start = BenchNowSeconds();
+            fn();
+            best = std::min(best, BenchNowSeconds() - start);
+        }
+        return best;
+    }
+}
+
+int RunQueueBench(const BenchOptions& options) {
+    const int repeats = options.quick ? 3 : 10;
+    const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    int failures = 0;
+
+    std::printf("  %u pipelines, %u meshes, 1 in 8 draws instanced; times are best of %d\n",
+        PIPELINES, MESHES, repeats);
+    std::printf("  %7s %10s %10s %10s %10s %10s | %9s %9s %9s %8s\n", "draws", "record us", "radix us",
+        "std us", "replay us", "ns/draw", "immediate", "cache", "sort+cache", "saved");
+
+    const size_t sizes[] = { 1000, 10000, 100000 };
+    for (size_t count : sizes) {
+        std::vector<SceneObject> scene = MakeScene(count);
+        RenderQueue queue;
+        RecordingBackend backend;
+
+        double recordTime = Best(repeats, [&]() { queue.Clear(); Record(scene, queue, 1, true); });
+        double sortTime = Best(repeats, [&]() { queue.Sort(); });
+
+        // Reference comparison sort over the same key/index pairs
+        std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+        double stdTime = Best(repeats, [&]() {
+            for (size_t i = 0; i < count; ++i) pairs[i] = std::make_pair(queue.GetList(0).GetPacket(i).sortKey, static_cast<uint32_t>(i));
+            std::stable_sort(pairs.begin(), pairs.end(),
+                [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+        });
+
+        RenderStateCache cache;
+        double replayTime = Best(repeats, [&]() { cache.Invalidate(); backend.Reset(); queue.Execute(backend, cache); });
+        uint64_t sortedCalls = backend.GetTotalCalls();
+        RenderQueueStats stats = queue.GetStats();
+
+        // Sorted replay must change pipeline once per pipeline in use
+        if (stats.pipelineChanges > PIPELINES) ++failures;
+
+        backend.Reset();
+        ReplayImmediate(scene, backend);
+        uint64_t immediateCalls = backend.GetTotalCalls();
+
+        RenderQueue unsorted;
+        Record(scene, unsorted, 1, false);
+        cache.Invalidate();
+        backend.Reset();
+        unsorted.Execute(backend, cache);
+        uint64_t cachedCalls = backend.GetTotalCalls();
+
+        double total = recordTime + sortTime + replayTime;
+        std::printf("  %7zu %10.1f %10.1f %10.1f %10.1f %10.1f | %9llu %9llu %9llu %7.1f%%\n",
+            count, recordTime * 1e6, sortTime * 1e6, stdTime * 1e6, replayTime * 1e6, total / count * 1e9,
+            static_cast<unsigned long long>(immediateCalls), static_cast<unsigned long long>(cachedCalls),
+            static_cast<unsigned long long>(sortedCalls), 100.0 * (1.0 - static_cast<double>(sortedCalls) / immediateCalls));
+    }
+
+    // Parallel recording: same packets whatever the thread count, so the replay must match
+    std::printf("\n  100000 draws recorded in parallel sub-queues (%u hardware threads):\n", hardwareThreads);
+    std::vector<SceneObject> scene = MakeScene(100000);
+    uint64_t referenceChecksum = 0;
+    const unsigned threadCounts[] = { 1, 2, 4, 8 };
+    for (unsigned threads : threadCounts) {
+        RenderQueue queue;
+        double recordTime = Best(repeats, [&]() { queue.Clear(); Record(scene, queue, threads, true); });
+
+        RecordingBackend backend;
+        RenderStateCache cache;
+        queue.Execute(backend, cache);
+        if (threads == 1) referenceChecksum = backend.checksum;
+        bool same = backend.checksum == referenceChecksum;
+        if (!same) ++failures;
+
+        std::printf("  %2u threads: record %8.1f us, replay %s\n", threads, recordTime * 1e6, same ? "identical" : "DIFFERS");
+    }
+
+    return failures;
+}
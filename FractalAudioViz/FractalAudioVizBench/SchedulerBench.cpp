@@ -0,0 +1,112 @@
+#include "Bench.h"
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace {
+    const double DISPLAY_HZ = 59.94;            // The display's true rate; the scheduler assumes 60
+    const double PUMP_SECONDS = 0.0002;         // Message pump, after which input is sampled
+    const double UPDATE_SECONDS = 0.001;        // Updates, after which the audio snapshot is taken
+
+    struct Workload {
+        const char* name;
+        double medianMs;            // Start to submit, log-normal
+        double sigma;
+        double spikeChance;         // Of a frame taking spikeMs instead
+        double spikeMs;
+    };
+
+    struct ScheduleResult {
+        FrameSchedulerStats stats;
+        double periodErrorPpm;      // Scheduler's period against the display's
+    };
+
+    // A frame loop against a simulated vsynced display: each frame pumps input, runs its
+    // updates, builds and submits, then the GPU finishes it up to 1.5 ms later and it
+    // waits for the next vblank. The immediate loop starts each frame as soon as the
+    // previous present returns; the scheduled one waits for the scheduler's start time
+    // and wakes up to 0.2 ms late.
+    ScheduleResult Run(const Workload& workload, bool scheduled, double seconds) {
+        std::mt19937 random(11);
+        std::lognormal_distribution<double> work(std::log(workload.medianMs * 1e-3), workload.sigma);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        const double refresh = 1.0 / DISPLAY_HZ;
+        SimulatedPresentClock display(refresh, 0.0042);
+        FrameScheduler scheduler;
+        scheduler.Reset(FrameSchedulerSettings());
+
+        double now = 0.0;
+        while (now < seconds) {
+            double start = now;
+            if (scheduled) {
+                start = scheduler.GetStartTime(now);
+                if (start > now) start += 0.0002 * unit(random);
+            }
+            scheduler.BeginWork(start);
+            scheduler.MarkInput(start + PUMP_SECONDS);
+            scheduler.MarkAudio(start + PUMP_SECONDS + UPDATE_SECONDS);
+
+            double frameWork = unit(random) < workload.spikeChance ? workload.spikeMs * 1e-3 : work(random);
+            frameWork = std::max(frameWork, PUMP_SECONDS + UPDATE_SECONDS);
+            scheduler.MarkSubmit(start + frameWork);
+            double gpu = 0.0005 + 0.001 * unit(random);
+            now = display.Present(start + frameWork + gpu);
+            scheduler.EndFrame(now);
+        }
+
+        ScheduleResult result;
+        result.stats = scheduler.GetStats();
+        result.periodErrorPpm = (scheduler.GetPeriod() - refresh) / refresh * 1e6;
+        return result;
+    }
+}
+
+int RunSchedulerBench(const BenchOptions& options) {
+    int failures = 0;
+    const double seconds = options.quick ? 600.0 : 3600.0;
+    const Workload workloads[] = {
+        { "light, 3 ms", 3.0, 0.2, 0.0, 0.0 },
+        { "typical, 7 ms", 7.0, 0.2, 0.0, 0.0 },
+        { "heavy, 11 ms", 11.0, 0.1, 0.0, 0.0 },
+        { "5 ms, 2% at 20 ms", 5.0, 0.2, 0.02, 20.0 },
+    };
+
+    // The scheduler must cut the audio snapshot's age at present without missing
+    // noticeably more vblanks or showing fewer frames than starting straight away
+    std::printf("  %.0f minutes per run on a %.2f Hz display, scheduler told 60 Hz; latencies from sampling to\n",
+        seconds / 60.0, DISPLAY_HZ);
+    std::printf("  the vblank that shows it, ms\n");
+    std::printf("  %-18s %-9s | %7s %7s | %7s %7s | %7s %8s %9s | %s\n", "work", "start", "input50", "input99",
+        "audio50", "audio99", "missed", "wait/fr", "period", "check");
+    for (const Workload& workload : workloads) {
+        ScheduleResult immediate = Run(workload, false, seconds);
+        ScheduleResult scheduled = Run(workload, true, seconds);
+        const ScheduleResult* results[] = { &immediate, &scheduled };
+        for (int pass = 0; pass < 2; ++pass) {
+            const FrameSchedulerStats& stats = results[pass]->stats;
+            double missed = static_cast<double>(stats.missedFrames) / stats.frames;
+            bool ok = true;
+            if (pass == 1) {
+                double immediateMissed = static_cast<double>(immediate.stats.missedFrames) / immediate.stats.frames;
+                ok = stats.audioToPresent.GetPercentile(0.50) <= immediate.stats.audioToPresent.GetPercentile(0.50) &&
+                    missed <= immediateMissed + 0.01 && stats.frames >= immediate.stats.frames * 0.99 &&
+                    std::fabs(scheduled.periodErrorPpm) < 50.0;
+                if (!ok) ++failures;
+            }
+            char period[16] = "-";
+            if (pass == 1) std::snprintf(period, sizeof(period), "%+.1fppm", results[pass]->periodErrorPpm);
+            std::printf("  %-18s %-9s | %7.2f %7.2f | %7.2f %7.2f | %6.2f%% %8.2f %9s | %s\n",
+                pass == 0 ? workload.name : "", pass == 0 ? "immediate" : "scheduled",
+                stats.inputToPresent.GetPercentile(0.50) * 1e-6, stats.inputToPresent.GetPercentile(0.99) * 1e-6,
+                stats.audioToPresent.GetPercentile(0.50) * 1e-6, stats.audioToPresent.GetPercentile(0.99) * 1e-6,
+                missed * 100.0, stats.waitSeconds / stats.frames * 1e3, period,
+                pass == 1 ? (ok ? "ok" : "LATE") : "");
+        }
+    }
+    std::printf("  missed: frames shown a vblank or more after planned; wait/fr: ms held back per frame;\n");
+    std::printf("  period: the scheduler's refresh estimate against the display's\n");
+    return failures;
+}
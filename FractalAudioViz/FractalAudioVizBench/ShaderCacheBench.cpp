@@ -0,0 +1,181 @@
+#include "Bench.h"
+#include "ShaderCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const char* const PACK_PATH = "FractalAudioVizBench.shaders";
+
+    // Stub rounds per source byte: about 2ms per shader here, the low end of D3DCompile
+    const unsigned COMPILE_WORK = 300;
+
+    // A fractal shader's worth of source, in count variants by their defines
+    std::vector<ShaderDesc> MakeShaders(size_t count) {
+        std::string source =
+            "cbuffer FrameBuffer : register(b0) { matrix viewMatrix; matrix projectionMatrix; };\n"
+            "cbuffer DrawBuffer : register(b1) { matrix worldMatrix; };\n";
+        for (int i = 0; i < 24; ++i) {
+            source += "float Step" + std::to_string(i) + "(float3 p, float scale) {\n"
+                "    float r = length(p); p = abs(p) * scale - ITERATION_OFFSET;\n"
+                "    return r * pow(scale, -VARIANT) + dot(p, float3(0.25f, 0.5f, 0.25f));\n}\n";
+        }
+        source += "float4 main(float4 position : SV_POSITION) : SV_TARGET { return Step0(position.xyz, 2.0f); }\n";
+
+        std::vector<ShaderDesc> shaders(count);
+        for (size_t i = 0; i < count; ++i) {
+            ShaderDesc& desc = shaders[i];
+            desc.name = "Fractal" + std::to_string(i);
+            desc.source = source;
+            desc.entryPoint = "main";
+            desc.profile = i % 2 ? "ps_5_0" : "vs_5_0";
+            desc.defines.push_back({ "VARIANT", std::to_string(i) });
+            desc.defines.push_back({ "ITERATION_OFFSET", std::to_string(i % 7) });
+            desc.flags = 1u << 11;
+        }
+        return shaders;
+    }
+
+    std::vector<std::vector<uint8_t>> CopyBytecode(const std::vector<ShaderBytecode>& bytecode) {
+        std::vector<std::vector<uint8_t>> copies;
+        for (const ShaderBytecode& code : bytecode) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(code.data);
+            copies.emplace_back(bytes, bytes + code.size);
+        }
+        return copies;
+    }
+
+    bool SameBytecode(const std::vector<ShaderBytecode>& bytecode, const std::vector<std::vector<uint8_t>>& expected) {
+        if (bytecode.size() != expected.size()) return false;
+        for (size_t i = 0; i < bytecode.size(); ++i) {
+            if (!bytecode[i].data || bytecode[i].size != expected[i].size() ||
+                std::memcmp(bytecode[i].data, expected[i].data(), expected[i].size()) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Flip one byte in the middle of the pack
+    bool CorruptPack() {
+        std::FILE* file = std::fopen(PACK_PATH, "r+b");
+        if (!file) return false;
+        std::fseek(file, 0, SEEK_END);
+        long middle = std::ftell(file) / 2;
+        std::fseek(file, middle, SEEK_SET);
+        int byte = std::fgetc(file);
+        std::fseek(file, middle, SEEK_SET);
+        std::fputc(byte ^ 0x5A, file);
+        return std::fclose(file) == 0;
+    }
+}
+
+int RunShaderCacheBench(const BenchOptions& options) {
+    int failures = 0;
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    // Cold: no pack, so every shader compiles and the pack is written; warm: a new cache,
+    // as a new process would have, maps the pack and finds them all. Both must hand out
+    // the same bytes.
+    const size_t counts[] = { 4, 16, 64, 256 };
+    std::printf("  stub compiler at about 2ms per shader; a new cache per start, the pack in the OS file cache\n");
+    std::printf("  %-7s | %10s %10s %8s | %8s %8s %8s | %8s | %s\n", "shaders", "cold 1 thr", "cold", "write",
+        "warm", "validate", "speedup", "pack KB", "check");
+    for (size_t count : counts) {
+        if (options.quick && count > 64) continue;
+        const std::vector<ShaderDesc> shaders = MakeShaders(count);
+        std::vector<ShaderBytecode> bytecode;
+        std::string errors;
+
+        std::remove(PACK_PATH);
+        StubShaderCompiler compiler(1, COMPILE_WORK);
+        double serialSeconds;
+        {
+            ShaderCache cache;
+            cache.Load(PACK_PATH, shaders, compiler, bytecode, errors, 1);
+            serialSeconds = cache.GetStats().seconds;
+        }
+
+        std::remove(PACK_PATH);
+        ShaderCacheStats cold;
+        std::vector<std::vector<uint8_t>> expected;
+        {
+            ShaderCache cache;
+            bool ok = cache.Load(PACK_PATH, shaders, compiler, bytecode, errors, hardware);
+            cold = cache.GetStats();
+            expected = CopyBytecode(bytecode);
+            if (!ok || cold.compiled != count) ++failures;
+        }
+
+        compiler.compiles = 0;
+        ShaderCache cache;
+        bool loaded = cache.Load(PACK_PATH, shaders, compiler, bytecode, errors, hardware);
+        const ShaderCacheStats warm = cache.GetStats();
+        bool ok = loaded && warm.packValid && warm.hits == count && compiler.compiles == 0 &&
+            SameBytecode(bytecode, expected);
+        if (!ok) ++failures;
+
+        std::printf("  %-7zu | %8.1fms %8.1fms %6.2fms | %6.3fms %6.3fms %7.0fx | %8.1f | %s\n", count,
+            serialSeconds * 1e3, cold.seconds * 1e3, cold.writeSeconds * 1e3, warm.seconds * 1e3,
+            warm.openSeconds * 1e3, cold.seconds / warm.seconds, warm.packBytes / 1024.0, ok ? "ok" : "DIFFERS");
+    }
+    std::printf("  cold on %u threads; write: the new pack built, renamed into place and remapped;\n", hardware);
+    std::printf("  validate: mapping and checksumming the pack, part of warm\n\n");
+
+    // What makes shaders miss: one changed define recompiles that shader alone and keeps
+    // the others; a new compiler version or a damaged pack recompiles everything
+    const size_t count = 64;
+    std::vector<ShaderDesc> shaders = MakeShaders(count);
+    std::vector<ShaderBytecode> bytecode;
+    std::string errors;
+    StubShaderCompiler compiler(1, COMPILE_WORK);
+    std::remove(PACK_PATH);
+    {
+        ShaderCache cache;
+        cache.Load(PACK_PATH, shaders, compiler, bytecode, errors, hardware);
+    }
+
+    std::printf("  %zu shaders, after a cold start:\n", count);
+    std::printf("  %-22s | %5s %8s %7s %9s | %s\n", "change", "hits", "compiled", "entries", "ms", "check");
+    auto run = [&](const char* label, StubShaderCompiler& with, size_t expectHits, size_t expectEntries,
+        bool expectValid) {
+        ShaderCache cache;
+        bool loaded = cache.Load(PACK_PATH, shaders, with, bytecode, errors, hardware);
+        const ShaderCacheStats& stats = cache.GetStats();
+        bool ok = loaded && stats.hits == expectHits && stats.compiled == count - expectHits &&
+            cache.GetEntryCount() == expectEntries && stats.packValid == expectValid;
+        if (!ok) ++failures;
+        std::printf("  %-22s | %5zu %8zu %7zu %8.2fms | %s\n", label, stats.hits, stats.compiled,
+            cache.GetEntryCount(), stats.seconds * 1e3, ok ? "ok" : "UNEXPECTED");
+    };
+    run("nothing", compiler, count, count, true);
+    shaders[5].defines[0].value = "five";
+    run("one define", compiler, count - 1, count + 1, true);
+    shaders[9].flags |= 1;
+    run("one flag", compiler, count - 1, count + 2, true);
+    StubShaderCompiler newer(2, COMPILE_WORK);
+    run("compiler version", newer, 0, count, false);
+    bool corrupted = CorruptPack();
+    run("one byte damaged", newer, 0, count, false);
+    if (!corrupted) {
+        std::printf("  could not damage the pack\n");
+        ++failures;
+    }
+
+    // A shader that fails: Load reports it by name and leaves the pack as it was
+    shaders[3].source += "#error broken\n";
+    {
+        ShaderCache cache;
+        bool loaded = cache.Load(PACK_PATH, shaders, newer, bytecode, errors, hardware);
+        bool ok = !loaded && errors.find(shaders[3].name) != std::string::npos && cache.GetEntryCount() == count;
+        if (!ok) ++failures;
+        std::printf("  %-22s | %5zu %8zu %7zu %9s | %s\n", "compile error", cache.GetStats().hits,
+            cache.GetStats().compiled, cache.GetEntryCount(), "-", ok ? "ok" : "UNEXPECTED");
+    }
+
+    std::remove(PACK_PATH);
+    return failures;
+}
@@ -0,0 +1,231 @@
+#include "Bench.h"
+#include "AudioTimeline.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+    const double SAMPLE_RATE = 48000.0;
+    const uint64_t BLOCK_FRAMES = 256;          // AudioCapture's default block
+    const uint64_t RING_FRAMES = 32768;         // Its default half second, to a power of two
+
+    // The capture ring with frames known by their index in the stream: the producer
+    // drops what doesn't fit, as AudioRingBuffer does, so the ring can hold gaps
+    struct RingModel {
+        std::deque<std::pair<uint64_t, uint64_t>> runs;     // First frame and count
+        uint64_t size = 0;
+        uint64_t readEnd = 0;       // Index after the last frame read
+        uint64_t overrunFrames = 0;
+        uint64_t underrunFrames = 0;
+
+        void Write(uint64_t first, uint64_t count) {
+            uint64_t fits = std::min(count, RING_FRAMES - size);
+            overrunFrames += count - fits;
+            if (fits == 0) return;
+            if (!runs.empty() && runs.back().first + runs.back().second == first) runs.back().second += fits;
+            else runs.emplace_back(first, fits);
+            size += fits;
+        }
+
+        uint64_t Take(uint64_t count) {
+            uint64_t taken = 0;
+            while (taken < count && !runs.empty()) {
+                std::pair<uint64_t, uint64_t>& run = runs.front();
+                uint64_t part = std::min(count - taken, run.second);
+                readEnd = run.first + part;
+                run.first += part;
+                run.second -= part;
+                taken += part;
+                if (run.second == 0) runs.pop_front();
+            }
+            size -= taken;
+            return taken;
+        }
+
+        void Read(uint64_t count) { underrunFrames += count - Take(count); }
+    };
+
+    struct Scenario {
+        const char* name;
+        double ppm;                 // Audio clock against the wall clock
+        double wanderPpm;           // Plus a slow swing of this much, as with temperature
+        double stallSeconds;        // A frame this long every five minutes
+    };
+
+    struct SyncResult {
+        double meanLatency;         // Audio clock ahead of the audio shown
+        double p99Error;            // From the mean, over every frame that updated
+        double maxError;
+        double drift;               // Mean latency over the last minute less the first
+        double overrunSeconds;
+        double underrunSeconds;
+        uint64_t skippedSteps;
+        double rateErrorPpm;        // Timeline's final rate against the true one
+    };
+
+    // Hours of a 59.94 Hz display with up to 2 ms of frame jitter, blocks arriving on the
+    // audio clock up to 1 ms late, and fixed updates paced by the GameTimer-style wall
+    // accumulator or by the timeline. The audio clock's true position against the audio
+    // shown, the last frame the updates read plus the interpolated part of a step, is the
+    // latency; its spread is the sync error.
+    SyncResult Run(const Scenario& scenario, bool timeline, double hours) {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<double> jitter(0.0, 1.0);
+        const double duration = hours * 3600.0;
+        const double frameSeconds = 1.0 / 59.94;
+        const double step = FIXED_TIMESTEP;
+
+        // Audio clock position at wall time t, in frames: the integral of its rate
+        const double wanderPeriod = 600.0;
+        auto audioFrames = [&](double t) {
+            double offset = scenario.ppm * 1e-6 * t;
+            offset += scenario.wanderPpm * 1e-6 * wanderPeriod / (2.0 * 3.14159265358979323846) *
+                (1.0 - std::cos(2.0 * 3.14159265358979323846 * t / wanderPeriod));
+            return SAMPLE_RATE * (t + offset);
+        };
+
+        RingModel ring;
+        AudioTimeline clock;
+        AudioTimelineSettings settings;
+        settings.sampleRate = SAMPLE_RATE;
+        settings.stepSeconds = step;
+        clock.Reset(settings);
+
+        uint64_t delivered = 0;
+        double nextBlockWall = BLOCK_FRAMES / SAMPLE_RATE;
+        double accumulator = 0.0, lastFrame = 0.0, framesOwed = 0.0;
+        double nextStall = 300.0;
+        std::vector<double> latencies;
+        latencies.reserve(static_cast<size_t>(duration * 61.0));
+        double firstMinute = 0.0, lastMinute = 0.0;
+        size_t firstCount = 0, lastCount = 0;
+
+        auto consume = [&](double seconds, bool skip) {
+            framesOwed += SAMPLE_RATE * seconds;
+            uint64_t frames = static_cast<uint64_t>(framesOwed);
+            framesOwed -= static_cast<double>(frames);
+            if (skip) ring.Take(frames);
+            else ring.Read(frames);
+        };
+
+        for (double t = frameSeconds; t < duration; t += frameSeconds * (0.94 + 0.12 * jitter(random))) {
+            if (scenario.stallSeconds > 0.0 && t >= nextStall) {
+                t += scenario.stallSeconds;
+                nextStall += 300.0;
+            }
+
+            // Blocks the capture thread finished by now: its wall time for a block is when
+            // the audio clock passed the block's end, plus wake-up jitter
+            while (nextBlockWall <= t) {
+                ring.Write(delivered, BLOCK_FRAMES);
+                delivered += BLOCK_FRAMES;
+                const double end = static_cast<double>(delivered + BLOCK_FRAMES);
+                double due = t;
+                for (int i = 0; i < 3; ++i) due -= (audioFrames(due) - end) / SAMPLE_RATE;
+                nextBlockWall = due + 0.001 * jitter(random);
+            }
+
+            uint64_t steps = 0, skipped = 0;
+            if (timeline) {
+                clock.Observe(delivered, t);
+                steps = clock.Advance(t, skipped);
+                if (skipped > 0) consume(skipped * step, true);
+            }
+            else {
+                accumulator += std::min(t - lastFrame, 0.25);
+                while (accumulator >= step) {
+                    accumulator -= step;
+                    ++steps;
+                }
+            }
+            lastFrame = t;
+
+            for (uint64_t s = 0; s < steps; ++s) {
+                consume(step, false);
+            }
+            if (steps == 0) continue;
+
+            // Drawn between the last two updates by how far into the next step each clock
+            // is, as an interpolating renderer would; past the first ten seconds, while the
+            // loop locks and the ring settles
+            double fraction = timeline ? clock.GetStepFraction(t) : accumulator / step;
+            double shown = static_cast<double>(ring.readEnd) / SAMPLE_RATE + fraction * step;
+            double latency = audioFrames(t) / SAMPLE_RATE - shown;
+            if (t < 10.0) continue;
+            latencies.push_back(latency);
+            if (t < 70.0) {
+                firstMinute += latency;
+                ++firstCount;
+            }
+            if (t >= duration - 60.0) {
+                lastMinute += latency;
+                ++lastCount;
+            }
+        }
+
+        SyncResult result;
+        double sum = 0.0;
+        for (double latency : latencies) sum += latency;
+        result.meanLatency = sum / latencies.size();
+        std::vector<double> errors;
+        errors.reserve(latencies.size());
+        for (double latency : latencies) errors.push_back(std::fabs(latency - result.meanLatency));
+        std::sort(errors.begin(), errors.end());
+        result.p99Error = errors[static_cast<size_t>(0.99 * (errors.size() - 1))];
+        result.maxError = errors.back();
+        result.drift = lastMinute / std::max<size_t>(lastCount, 1) - firstMinute / std::max<size_t>(firstCount, 1);
+        result.overrunSeconds = ring.overrunFrames / SAMPLE_RATE;
+        result.underrunSeconds = ring.underrunFrames / SAMPLE_RATE;
+        result.skippedSteps = clock.GetStats().skippedSteps;
+        double trueRate = (audioFrames(duration) - audioFrames(duration - 1.0)) / SAMPLE_RATE;
+        result.rateErrorPpm = timeline ? (clock.GetRate() - trueRate) * 1e6 : 0.0;
+        return result;
+    }
+}
+
+int RunTimelineBench(const BenchOptions& options) {
+    int failures = 0;
+    const double hours = options.quick ? 1.0 : 4.0;
+    const Scenario scenarios[] = {
+        { "matched clocks", 0.0, 0.0, 0.0 },
+        { "audio +100 ppm", 100.0, 0.0, 0.0 },
+        { "audio -300 ppm", -300.0, 0.0, 0.0 },
+        { "+50 ppm, 200 swing", 50.0, 200.0, 0.0 },
+        { "+100 ppm, stalls", 100.0, 0.0, 0.5 },
+    };
+
+    // The timeline must hold the sync error to a couple of milliseconds with no drift,
+    // no overruns and no more underrun than the stalls themselves cause
+    std::printf("  %.0f hour%s per run at 48 kHz, 256-frame blocks, 59.94 Hz frames; latency: audio clock ahead of\n",
+        hours, hours > 1.0 ? "s" : "");
+    std::printf("  the audio shown, interpolated within a step; error: its distance from the run's mean\n");
+    std::printf("  %-19s %-8s | %8s %8s %8s %9s | %9s %9s %7s | %8s | %s\n", "clocks", "stepping", "latency", "p99 err",
+        "max err", "drift", "overrun", "underrun", "skipped", "rate err", "check");
+    for (const Scenario& scenario : scenarios) {
+        for (int pass = 0; pass < 2; ++pass) {
+            bool timeline = pass == 1;
+            SyncResult result = Run(scenario, timeline, hours);
+            bool ok = true;
+            if (timeline) {
+                ok = result.p99Error < 0.002 && std::fabs(result.drift) < 0.001 && result.overrunSeconds == 0.0 &&
+                    std::fabs(result.rateErrorPpm) < 25.0;
+                if (!ok) ++failures;
+            }
+            char rate[16] = "-";
+            if (timeline) std::snprintf(rate, sizeof(rate), "%+.1f", result.rateErrorPpm);
+            std::printf("  %-19s %-8s | %6.1fms %6.2fms %6.1fms %+7.1fms | %8.2fs %8.2fs %7zu | %8s | %s\n",
+                pass == 0 ? scenario.name : "", timeline ? "timeline" : "wall", result.meanLatency * 1e3,
+                result.p99Error * 1e3, result.maxError * 1e3, result.drift * 1e3, result.overrunSeconds,
+                result.underrunSeconds, static_cast<size_t>(result.skippedSteps), rate,
+                timeline ? (ok ? "ok" : "DRIFTS") : "");
+        }
+    }
+    std::printf("  drift: mean latency over the last minute less the first; overrun: audio the full ring\n");
+    std::printf("  dropped; underrun: silence read in its place; rate err: the timeline's final drift\n");
+    std::printf("  estimate against the true one, ppm\n");
+    return failures;
+}
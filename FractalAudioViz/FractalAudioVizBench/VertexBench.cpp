@@ -0,0 +1,122 @@
+#include "Bench.h"
+#include "FractalMesh.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    double PackSeconds(const FractalMesh& mesh, const VertexQuantization& quantization,
+        std::vector<PackedVertex>& packed, SimdLevel level, int repeats) {
+        double best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            double start = BenchNowSeconds();
+            VertexPacker::Pack(mesh.vertices.data(), mesh.normals.data(), mesh.vertices.size(), quantization,
+                packed.data(), level);
+            best = std::min(best, BenchNowSeconds() - start);
+        }
+        return best;
+    }
+}
+
+int RunVertexBench(const BenchOptions& options) {
+    int failures = 0;
+
+    FractalSettings fractal;
+    fractal.depth = options.quick ? 4 : 5;
+    FractalMeshSettings meshSettings;
+    meshSettings.normals = true;
+    FractalMesh mesh;
+    FractalMeshBuilder::Build(fractal, meshSettings, mesh);
+    const size_t count = mesh.vertices.size();
+
+    // What the GPU holds for the vertex buffer either way; the index buffer is the same
+    double floatBytes = static_cast<double>(count) * (sizeof(MeshVertex) + 3 * sizeof(float));
+    double packedBytes = static_cast<double>(count) * sizeof(PackedVertex);
+    std::printf("  Menger depth %d merged mesh: %zu vertices, %zu indices (%.1f MB)\n", fractal.depth, count,
+        mesh.indices.size(), mesh.indices.size() * 4.0 / (1 << 20));
+    std::printf("  float position + color:          %2zu B/vertex, %7.1f MB\n", sizeof(MeshVertex),
+        count * sizeof(MeshVertex) / double(1 << 20));
+    std::printf("  float position + color + normal: %2zu B/vertex, %7.1f MB\n", sizeof(MeshVertex) + 3 * sizeof(float),
+        floatBytes / (1 << 20));
+    std::printf("  packed, normal included:         %2zu B/vertex, %7.1f MB (%.0f%% smaller)\n\n",
+        sizeof(PackedVertex), packedBytes / (1 << 20), 100.0 * (1.0 - packedBytes / floatBytes));
+
+    // Throughput per instruction set, each checked byte for byte against the scalar path
+    const int repeats = options.quick ? 3 : 10;
+    VertexQuantization grid = VertexQuantization::FromMesh(mesh);
+    std::vector<PackedVertex> reference(count);
+    std::vector<PackedVertex> packed(count);
+    double scalarSeconds = PackSeconds(mesh, grid, reference, SimdLevel::Scalar, repeats);
+
+    // Also an odd count without normals, so the tails and the default normal are covered
+    const size_t oddCount = std::min<size_t>(count, 1003);
+    std::vector<PackedVertex> oddReference(oddCount), odd(oddCount);
+    VertexPacker::Pack(mesh.vertices.data(), nullptr, oddCount, grid, oddReference.data(), SimdLevel::Scalar);
+
+    std::printf("  %-8s %10s %10s %10s %8s | %s\n", "level", "ms", "Mvert/s", "in GB/s", "speedup", "bytes");
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+    for (SimdLevel level : levels) {
+        if (ResolveSimdLevel(level) != level) continue;
+        double seconds = level == SimdLevel::Scalar ? scalarSeconds : PackSeconds(mesh, grid, packed, level, repeats);
+        VertexPacker::Pack(mesh.vertices.data(), nullptr, oddCount, grid, odd.data(), level);
+        bool same = std::memcmp(odd.data(), oddReference.data(), oddCount * sizeof(PackedVertex)) == 0 &&
+            (level == SimdLevel::Scalar || std::memcmp(packed.data(), reference.data(), count * sizeof(PackedVertex)) == 0);
+        if (!same) ++failures;
+        std::printf("  %-8s %10.2f %10.1f %10.2f %7.1fx | %s\n", GetSimdLevelName(level), seconds * 1e3,
+            count / seconds * 1e-6, floatBytes / seconds * 1e-9, scalarSeconds / seconds,
+            same ? "identical" : "MISMATCH");
+    }
+
+    // Accuracy. On the mesh's own grid every position comes back exactly; on plain bounds
+    // the error stays within half a step.
+    double gridError = 0.0, boundsError = 0.0, colorError = 0.0;
+    const float minimum[3] = { -1.0f, -1.0f, -1.0f };
+    const float maximum[3] = { 1.0f, 1.0f, 1.0f };
+    VertexQuantization bounds = VertexQuantization::FromBounds(minimum, maximum);
+    VertexPacker::Pack(mesh.vertices.data(), mesh.normals.data(), count, bounds, packed.data());
+    for (size_t i = 0; i < count; ++i) {
+        const MeshVertex& vertex = mesh.vertices[i];
+        float onGrid[3], onBounds[3];
+        VertexPacker::DecodePosition(reference[i], grid, onGrid);
+        VertexPacker::DecodePosition(packed[i], bounds, onBounds);
+        const float original[3] = { vertex.x, vertex.y, vertex.z };
+        for (int axis = 0; axis < 3; ++axis) {
+            gridError = std::max(gridError, static_cast<double>(std::fabs(onGrid[axis] - original[axis])));
+            boundsError = std::max(boundsError, static_cast<double>(std::fabs(onBounds[axis] - original[axis])));
+        }
+        const float channels[3] = { vertex.r, vertex.g, vertex.b };
+        for (int c = 0; c < 3; ++c) {
+            float decoded = ((reference[i].color >> (8 * c)) & 0xFF) / 255.0f;
+            colorError = std::max(colorError, static_cast<double>(std::fabs(decoded - channels[c])));
+        }
+    }
+
+    // Octahedral normals over random directions, not just the mesh's six
+    std::mt19937 random(7);
+    std::normal_distribution<float> gaussian;
+    double normalError = 0.0;
+    for (int i = 0; i < 200000; ++i) {
+        float direction[3] = { gaussian(random), gaussian(random), gaussian(random) };
+        float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        for (float& component : direction) component /= length;
+        int16_t u, v;
+        float decoded[3];
+        VertexPacker::EncodeNormal(direction, u, v);
+        VertexPacker::DecodeNormal(u, v, decoded);
+        double dot = decoded[0] * direction[0] + decoded[1] * direction[1] + decoded[2] * direction[2];
+        normalError = std::max(normalError, std::acos(std::min(1.0, dot)) * 180.0 / 3.14159265358979);
+    }
+
+    bool accurate = gridError == 0.0 && boundsError <= 0.5 * bounds.step * 1.01 &&
+        colorError <= 0.5 / 255.0 + 1e-6 && normalError < 0.05;
+    if (!accurate) ++failures;
+    std::printf("\n  position error: %.3g on the mesh grid, %.3g on its bounds (step %.3g)\n", gridError, boundsError,
+        bounds.step);
+    std::printf("  color error: %.3g of 1; normal error: %.4f degrees max over 200k directions - %s\n", colorError,
+        normalError, accurate ? "ok" : "OUT OF TOLERANCE");
+    return failures;
+}